@@ -0,0 +1,527 @@
+#include "animation.h"
+#include "trajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Largura dos kernels: AVX (8 floats) quando o compilador o habilita, senão SSE (4 floats),
+// senão um laço escalar com a mesma interface
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ANIMATION_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ANIMATION_SSE 1
+#endif
+
+namespace {
+
+// Amostras por segmento usadas para medir e reamostrar a curva no modo de comprimento de arco
+const int kArcSamplesPerSegment = 32;
+
+#if defined(__AVX__)
+typedef __m256 vfloat;
+const int kLanes = 8;
+inline vfloat vload(const float* p) { return _mm256_loadu_ps(p); }
+inline void vstore(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+inline vfloat vset1(float v) { return _mm256_set1_ps(v); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+inline vfloat vfloor(vfloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline void vstoreIndex(int32_t* p, vfloat v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32(v)); }
+#elif defined(ANIMATION_SSE)
+typedef __m128 vfloat;
+const int kLanes = 4;
+inline vfloat vload(const float* p) { return _mm_loadu_ps(p); }
+inline void vstore(float* p, vfloat v) { _mm_storeu_ps(p, v); }
+inline vfloat vset1(float v) { return _mm_set1_ps(v); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+// SSE2 não tem floor; truncar basta porque os valores são clampados para >= 0 logo depois
+inline vfloat vfloor(vfloat a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+inline void vstoreIndex(int32_t* p, vfloat v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(v)); }
+#else
+struct vfloat { float v[4]; };
+const int kLanes = 4;
+template <typename F> inline vfloat vmap(vfloat a, vfloat b, F f)
+{
+	vfloat r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = f(a.v[i], b.v[i]);
+	return r;
+}
+inline vfloat vload(const float* p) { vfloat r; std::copy(p, p + 4, r.v); return r; }
+inline void vstore(float* p, vfloat v) { std::copy(v.v, v.v + 4, p); }
+inline vfloat vset1(float v) { vfloat r = { { v, v, v, v } }; return r; }
+inline vfloat vadd(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x + y; }); }
+inline vfloat vsub(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x - y; }); }
+inline vfloat vmul(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x * y; }); }
+inline vfloat vmin(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return std::min(x, y); }); }
+inline vfloat vmax(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return std::max(x, y); }); }
+inline vfloat vfloor(vfloat a) { return vmap(a, a, [](float x, float) { return std::floor(x); }); }
+inline void vstoreIndex(int32_t* p, vfloat v) { for (int i = 0; i < 4; i++) p[i] = static_cast<int32_t>(v.v[i]); }
+#endif
+
+inline size_t roundUpLanes(size_t count)
+{
+	return (count + kLanes - 1) / kLanes * kLanes;
+}
+
+// Pesos da Catmull-Rom uniforme para os pontos p0..p3 do segmento (p1, p2)
+inline void catmullRomWeights(float t, float w[4])
+{
+	float t2 = t * t, t3 = t2 * t;
+	w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+	w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+	w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+	w[3] = 0.5f * (t3 - t2);
+}
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+	float w[4];
+	catmullRomWeights(t, w);
+	return w[0] * p0 + w[1] * p1 + w[2] * p2 + w[3] * p3;
+}
+
+// Lê as entradas tabela[índice + offset] de cada lane e as transpõe para x, y, z em SoA.
+// Não há gather de floats no SSE: cada ponto é uma carga de 16 bytes seguida de transposição.
+#if defined(ANIMATION_SSE)
+inline void gather4(const float* table, const int32_t* index, int offset, __m128& x, __m128& y, __m128& z)
+{
+	__m128 p0 = _mm_loadu_ps(table + (index[0] + offset) * 4);
+	__m128 p1 = _mm_loadu_ps(table + (index[1] + offset) * 4);
+	__m128 p2 = _mm_loadu_ps(table + (index[2] + offset) * 4);
+	__m128 p3 = _mm_loadu_ps(table + (index[3] + offset) * 4);
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	x = p0;
+	y = p1;
+	z = p2;
+}
+#endif
+
+inline void gather(const AnimationPath& path, const int32_t* index, int offset, vfloat& x, vfloat& y, vfloat& z)
+{
+	const float* table = path.table.data();
+#if defined(__AVX__)
+	__m128 xl, yl, zl, xh, yh, zh;
+	gather4(table, index, offset, xl, yl, zl);
+	gather4(table, index + 4, offset, xh, yh, zh);
+	x = _mm256_insertf128_ps(_mm256_castps128_ps256(xl), xh, 1);
+	y = _mm256_insertf128_ps(_mm256_castps128_ps256(yl), yh, 1);
+	z = _mm256_insertf128_ps(_mm256_castps128_ps256(zl), zh, 1);
+#elif defined(ANIMATION_SSE)
+	gather4(table, index, offset, x, y, z);
+#else
+	for (int lane = 0; lane < kLanes; lane++)
+	{
+		const float* p = table + (index[lane] + offset) * 4;
+		x.v[lane] = p[0];
+		y.v[lane] = p[1];
+		z.v[lane] = p[2];
+	}
+#endif
+}
+
+// Tempo equivalente dentro da gravação, para os caminhos de trajetória darem a volta
+inline double wrapTrajectoryTime(const Trajectory& trajectory, double time)
+{
+	const double duration = trajectory.duration();
+	if (duration <= 0.0)
+		return trajectory.startTime();
+	double offset = std::fmod(time - trajectory.startTime(), duration);
+	if (offset < 0.0)
+		offset += duration;
+	return trajectory.startTime() + offset;
+}
+
+} // namespace
+
+size_t AnimationPath::segmentCount() const
+{
+	size_t extra = mode == INTERP_CATMULL_ROM ? 3 : 1;
+	return entryCount() > extra ? entryCount() - extra : 0;
+}
+
+AnimationPath buildAnimationPath(const std::vector<glm::vec3>& points, InterpolationMode mode, float segmentDuration)
+{
+	AnimationPath path;
+	path.mode = mode;
+	const size_t n = points.size();
+	if (n == 0)
+		return path;
+
+	auto push = [&path](const glm::vec3& p) {
+		path.table.insert(path.table.end(), { p.x, p.y, p.z, 0.0f });
+	};
+
+	path.period = static_cast<float>(n);
+	path.rate = segmentDuration > 0.0f ? 1.0f / segmentDuration : 0.0f;
+	path.invStep = 1.0f;
+
+	if (mode == INTERP_LINEAR)
+	{
+		for (size_t i = 0; i <= n; i++)
+			push(points[i % n]);
+		return path;
+	}
+
+	if (mode == INTERP_CATMULL_ROM)
+	{
+		push(points[n - 1]);
+		for (size_t i = 0; i <= n + 1; i++)
+			push(points[i % n]);
+		return path;
+	}
+
+	// Comprimento de arco: mede a Catmull-Rom com amostras densas (comprimento acumulado)
+	const size_t samples = n * kArcSamplesPerSegment;
+	std::vector<glm::vec3> curve(samples + 1);
+	std::vector<float> distance(samples + 1, 0.0f);
+	for (size_t s = 0; s <= samples; s++)
+	{
+		size_t segment = (s / kArcSamplesPerSegment) % n;
+		float t = static_cast<float>(s % kArcSamplesPerSegment) / kArcSamplesPerSegment;
+		curve[s] = catmullRom(points[(segment + n - 1) % n], points[segment], points[(segment + 1) % n], points[(segment + 2) % n], t);
+		if (s > 0)
+			distance[s] = distance[s - 1] + glm::length(curve[s] - curve[s - 1]);
+	}
+	const float length = distance[samples];
+	if (length <= 0.0f)
+	{
+		// Todos os pontos iguais: objeto parado
+		push(points[0]);
+		push(points[0]);
+		path.period = 1.0f;
+		path.rate = 0.0f;
+		return path;
+	}
+
+	// Reamostra em passos de distância iguais; a avaliação vira uma interpolação linear na tabela
+	const float step = length / samples;
+	size_t j = 0;
+	for (size_t k = 0; k <= samples; k++)
+	{
+		float d = std::min(k * step, length);
+		while (j + 1 < samples && distance[j + 1] < d)
+			j++;
+		float span = distance[j + 1] - distance[j];
+		float f = span > 0.0f ? (d - distance[j]) / span : 0.0f;
+		push(curve[j] + std::min(f, 1.0f) * (curve[j + 1] - curve[j]));
+	}
+	path.period = length;
+	path.invStep = 1.0f / step;
+	path.rate = segmentDuration > 0.0f ? length / (n * segmentDuration) : 0.0f;
+	return path;
+}
+
+glm::vec3 evaluatePath(const AnimationPath& path, float u)
+{
+	const size_t segments = path.segmentCount();
+	if (segments == 0)
+		return path.table.empty() ? glm::vec3(0.0f) : glm::vec3(path.table[0], path.table[1], path.table[2]);
+
+	float s = std::max(0.0f, u * path.invStep);
+	float fi = std::min(std::floor(s), static_cast<float>(segments - 1));
+	float f = s - fi;
+	size_t i = static_cast<size_t>(fi);
+
+	auto point = [&path](size_t k) { return glm::vec3(path.table[k * 4], path.table[k * 4 + 1], path.table[k * 4 + 2]); };
+	if (path.mode == INTERP_CATMULL_ROM)
+		return catmullRom(point(i), point(i + 1), point(i + 2), point(i + 3), f);
+	return point(i) + f * (point(i + 1) - point(i));
+}
+
+uint32_t AnimationSystem::addPath(const AnimationPath& path)
+{
+	mPaths.push_back(path);
+	return static_cast<uint32_t>(mPaths.size() - 1);
+}
+
+uint32_t AnimationSystem::addTrajectory(const Trajectory& trajectory)
+{
+	AnimationPath path;
+	path.trajectory = &trajectory;
+	return addPath(path);
+}
+
+void AnimationSystem::addObject(uint32_t path, glm::vec3 offset, float phase)
+{
+	if (path >= mPaths.size())
+		return;
+
+	Batch* batch = nullptr;
+	for (Batch& b : mBatches)
+		if (b.path == path)
+			batch = &b;
+	if (!batch)
+	{
+		mBatches.push_back(Batch());
+		batch = &mBatches.back();
+		batch->path = path;
+	}
+
+	const AnimationPath& p = mPaths[path];
+	size_t i = batch->count++;
+	size_t padded = roundUpLanes(batch->count);
+	for (std::vector<float>* array : { &batch->u, &batch->offsetX, &batch->offsetY, &batch->offsetZ, &batch->posX, &batch->posY, &batch->posZ })
+		array->resize(padded, 0.0f);
+	batch->offsetX[i] = offset.x;
+	batch->offsetY[i] = offset.y;
+	batch->offsetZ[i] = offset.z;
+
+	if (p.trajectory)
+	{
+		batch->time.resize(padded, 0.0);
+		batch->segment.resize(padded, 0);
+		batch->time[i] = wrapTrajectoryTime(*p.trajectory, p.trajectory->startTime() + phase);
+		batch->segment[i] = p.trajectory->seek(batch->time[i]);
+		glm::vec3 position = offset + p.trajectory->position(batch->time[i], batch->segment[i]);
+		batch->posX[i] = position.x;
+		batch->posY[i] = position.y;
+		batch->posZ[i] = position.z;
+		mCount++;
+		return;
+	}
+
+	float u = phase * p.rate;
+	if (p.period > 0.0f)
+		u = std::fmod(std::max(u, 0.0f), p.period);
+	batch->u[i] = u;
+
+	glm::vec3 position = offset + evaluatePath(p, u);
+	batch->posX[i] = position.x;
+	batch->posY[i] = position.y;
+	batch->posZ[i] = position.z;
+	mCount++;
+}
+
+void AnimationSystem::clear()
+{
+	mPaths.clear();
+	mBatches.clear();
+	mCount = 0;
+}
+
+void AnimationSystem::update(float dt)
+{
+	updateRange(dt, 0, mCount);
+}
+
+void AnimationSystem::updateRange(float dt, size_t first, size_t count)
+{
+	const size_t last = first + count;
+	size_t base = 0;
+	for (Batch& batch : mBatches)
+	{
+		// Grupos do lote cujo primeiro objeto cai na faixa
+		const size_t begin = first > base ? roundUpLanes(first - base) : 0;
+		const size_t end = std::min(batch.count, last > base ? last - base : 0);
+		base += batch.count;
+		if (begin >= end)
+			continue;
+
+		const AnimationPath& path = mPaths[batch.path];
+		if (path.trajectory)
+		{
+			// Um objeto por vez, mas com a mesma divisão em grupos dos kernels
+			const Trajectory& trajectory = *path.trajectory;
+			const size_t groupsEnd = std::min(roundUpLanes(end), batch.count);
+			for (size_t i = begin; i < groupsEnd; i++)
+			{
+				batch.time[i] = wrapTrajectoryTime(trajectory, batch.time[i] + dt);
+				glm::vec3 position = trajectory.position(batch.time[i], batch.segment[i]);
+				batch.posX[i] = position.x + batch.offsetX[i];
+				batch.posY[i] = position.y + batch.offsetY[i];
+				batch.posZ[i] = position.z + batch.offsetZ[i];
+			}
+			continue;
+		}
+		const size_t segments = path.segmentCount();
+		if (segments == 0 || path.period <= 0.0f)
+			continue;
+
+		const vfloat du = vset1(path.rate * dt);
+		const vfloat period = vset1(path.period);
+		const vfloat invPeriod = vset1(1.0f / path.period);
+		const vfloat invStep = vset1(path.invStep);
+		const vfloat zero = vset1(0.0f);
+		const vfloat lastSegment = vset1(static_cast<float>(segments - 1));
+		const bool cubic = path.mode == INTERP_CATMULL_ROM;
+
+		alignas(32) int32_t index[kLanes];
+		for (size_t i = begin; i < end; i += kLanes)
+		{
+			// Avança e dá a volta no caminho (mesmo com dt maior que uma volta)
+			vfloat u = vadd(vload(&batch.u[i]), du);
+			u = vsub(u, vmul(period, vfloor(vmul(u, invPeriod))));
+			u = vmax(u, zero);
+			vstore(&batch.u[i], u);
+
+			vfloat s = vmul(u, invStep);
+			vfloat fi = vmin(vmax(vfloor(s), zero), lastSegment);
+			vfloat t = vsub(s, fi);
+			vstoreIndex(index, fi);
+
+			vfloat x, y, z;
+			if (cubic)
+			{
+				vfloat t2 = vmul(t, t), t3 = vmul(t2, t);
+				vfloat half = vset1(0.5f), two = vset1(2.0f);
+				vfloat w0 = vmul(half, vsub(vsub(vmul(two, t2), t3), t));
+				vfloat w1 = vmul(half, vadd(vsub(vmul(vset1(3.0f), t3), vmul(vset1(5.0f), t2)), two));
+				vfloat w2 = vmul(half, vadd(vsub(vmul(vset1(4.0f), t2), vmul(vset1(3.0f), t3)), t));
+				vfloat w3 = vmul(half, vsub(t3, t2));
+
+				vfloat px, py, pz;
+				gather(path, index, 0, px, py, pz);
+				x = vmul(w0, px); y = vmul(w0, py); z = vmul(w0, pz);
+				gather(path, index, 1, px, py, pz);
+				x = vadd(x, vmul(w1, px)); y = vadd(y, vmul(w1, py)); z = vadd(z, vmul(w1, pz));
+				gather(path, index, 2, px, py, pz);
+				x = vadd(x, vmul(w2, px)); y = vadd(y, vmul(w2, py)); z = vadd(z, vmul(w2, pz));
+				gather(path, index, 3, px, py, pz);
+				x = vadd(x, vmul(w3, px)); y = vadd(y, vmul(w3, py)); z = vadd(z, vmul(w3, pz));
+			}
+			else
+			{
+				// Linear e comprimento de arco: interpolação entre duas entradas da tabela
+				vfloat ax, ay, az, bx, by, bz;
+				gather(path, index, 0, ax, ay, az);
+				gather(path, index, 1, bx, by, bz);
+				x = vadd(ax, vmul(t, vsub(bx, ax)));
+				y = vadd(ay, vmul(t, vsub(by, ay)));
+				z = vadd(az, vmul(t, vsub(bz, az)));
+			}
+
+			vstore(&batch.posX[i], vadd(x, vload(&batch.offsetX[i])));
+			vstore(&batch.posY[i], vadd(y, vload(&batch.offsetY[i])));
+			vstore(&batch.posZ[i], vadd(z, vload(&batch.offsetZ[i])));
+		}
+	}
+}
+
+void AnimationSystem::writeMatrices(const glm::mat4& local, glm::mat4* out) const
+{
+	// Só a translação muda de um objeto para outro: as três primeiras colunas são copiadas
+	// e a quarta é a de 'local' somada à posição
+#if defined(ANIMATION_SSE)
+	const __m128 c0 = _mm_loadu_ps(&local[0].x);
+	const __m128 c1 = _mm_loadu_ps(&local[1].x);
+	const __m128 c2 = _mm_loadu_ps(&local[2].x);
+	const __m128 c3 = _mm_loadu_ps(&local[3].x);
+	float* m = &out[0][0].x;
+	for (const Batch& batch : mBatches)
+	{
+		// Os arrays têm folga até múltiplos de 4, então as cargas nunca passam do fim
+		for (size_t i = 0; i < batch.count; i += 4)
+		{
+			__m128 t0 = _mm_loadu_ps(&batch.posX[i]);
+			__m128 t1 = _mm_loadu_ps(&batch.posY[i]);
+			__m128 t2 = _mm_loadu_ps(&batch.posZ[i]);
+			__m128 t3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+			const __m128 translation[4] = { t0, t1, t2, t3 };
+
+			size_t n = std::min<size_t>(4, batch.count - i);
+			for (size_t k = 0; k < n; k++, m += 16)
+			{
+				_mm_storeu_ps(m, c0);
+				_mm_storeu_ps(m + 4, c1);
+				_mm_storeu_ps(m + 8, c2);
+				_mm_storeu_ps(m + 12, _mm_add_ps(c3, translation[k]));
+			}
+		}
+	}
+#else
+	size_t k = 0;
+	for (const Batch& batch : mBatches)
+	{
+		for (size_t i = 0; i < batch.count; i++, k++)
+		{
+			glm::mat4& m = out[k];
+			m = local;
+			m[3] += glm::vec4(batch.posX[i], batch.posY[i], batch.posZ[i], 0.0f);
+		}
+	}
+#endif
+}
+
+void writeTranslationMatrices(const glm::mat4& local, const float* x, const float* y, const float* z, size_t count,
+	glm::mat4* out)
+{
+	size_t i = 0;
+#if defined(ANIMATION_SSE)
+	const __m128 c0 = _mm_loadu_ps(&local[0].x);
+	const __m128 c1 = _mm_loadu_ps(&local[1].x);
+	const __m128 c2 = _mm_loadu_ps(&local[2].x);
+	const __m128 c3 = _mm_loadu_ps(&local[3].x);
+	float* m = &out[0][0].x;
+	// Sem garantia de folga nos arrays: grupos de 4 com SSE e o resto no laço escalar
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 t0 = _mm_loadu_ps(x + i);
+		__m128 t1 = _mm_loadu_ps(y + i);
+		__m128 t2 = _mm_loadu_ps(z + i);
+		__m128 t3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+		const __m128 translation[4] = { t0, t1, t2, t3 };
+		for (int k = 0; k < 4; k++, m += 16)
+		{
+			_mm_storeu_ps(m, c0);
+			_mm_storeu_ps(m + 4, c1);
+			_mm_storeu_ps(m + 8, c2);
+			_mm_storeu_ps(m + 12, _mm_add_ps(c3, translation[k]));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = local;
+		out[i][3] += glm::vec4(x[i], y[i], z[i], 0.0f);
+	}
+}
+
+glm::mat3 normalMatrix(const glm::mat4& model)
+{
+	const glm::mat3 m(model);
+	const float l0 = glm::dot(m[0], m[0]), l1 = glm::dot(m[1], m[1]), l2 = glm::dot(m[2], m[2]);
+	const float tolerance = 1e-5f * std::max(l0, std::max(l1, l2));
+	const bool uniformScale = std::abs(l0 - l1) <= tolerance && std::abs(l0 - l2) <= tolerance
+		&& std::abs(glm::dot(m[0], m[1])) <= tolerance && std::abs(glm::dot(m[0], m[2])) <= tolerance
+		&& std::abs(glm::dot(m[1], m[2])) <= tolerance;
+	if (uniformScale && l0 > 0.0f)
+		return m * (1.0f / l0); // (s R)^-T = R / s
+	return glm::transpose(glm::inverse(m));
+}
+
+void AnimationSystem::copyPositions(float* x, float* y, float* z) const
+{
+	for (const Batch& batch : mBatches)
+	{
+		std::copy(batch.posX.begin(), batch.posX.begin() + batch.count, x);
+		std::copy(batch.posY.begin(), batch.posY.begin() + batch.count, y);
+		std::copy(batch.posZ.begin(), batch.posZ.begin() + batch.count, z);
+		x += batch.count;
+		y += batch.count;
+		z += batch.count;
+	}
+}
+
+glm::vec3 AnimationSystem::position(size_t object) const
+{
+	for (const Batch& batch : mBatches)
+	{
+		if (object < batch.count)
+			return glm::vec3(batch.posX[object], batch.posY[object], batch.posZ[object]);
+		object -= batch.count;
+	}
+	return glm::vec3(0.0f);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+class Trajectory;
+
+// Interpolação entre os pontos de um caminho (fechado: o último ponto volta ao primeiro)
+enum InterpolationMode {
+	INTERP_LINEAR = 0,      // segmentos retos, velocidade constante em cada segmento
+	INTERP_CATMULL_ROM = 1, // curva suave que passa por todos os pontos
+	INTERP_ARC_LENGTH = 2,  // mesma curva Catmull-Rom, percorrida com velocidade constante
+};
+
+// Caminho pré-processado para a avaliação em lote. Cada objeto guarda apenas um
+// parâmetro 'u' em [0, period), que avança 'rate' unidades por segundo:
+// - linear e Catmull-Rom: u em segmentos (a parte inteira é o ponto atual)
+// - comprimento de arco: u em distância percorrida ao longo da curva
+struct AnimationPath {
+	InterpolationMode mode = INTERP_LINEAR;
+	float rate = 0.0f;
+	float period = 0.0f;
+	float invStep = 1.0f; // amostras da tabela por unidade de u
+	// Tabela de pontos, 4 floats (x, y, z, 0) por entrada para que cada ponto seja uma
+	// única carga SIMD. Linear: os pontos e o primeiro repetido no fim.
+	// Catmull-Rom: os pontos com o último antes e os dois primeiros depois.
+	// Comprimento de arco: a curva reamostrada em passos de distância iguais.
+	std::vector<float> table;
+	// Trajetória gravada (AnimationSystem::addTrajectory), no lugar da tabela: os objetos guardam
+	// o tempo na gravação em double e são avaliados um a um, com a busca da trajetória
+	const Trajectory* trajectory = nullptr;
+
+	size_t entryCount() const { return table.size() / 4; }
+	size_t segmentCount() const;
+};
+
+// Monta o caminho a partir dos pontos. 'segmentDuration' é o tempo de cada trecho entre
+// pontos (duracao_ponto); no modo de comprimento de arco a volta completa leva o mesmo
+// tempo total, mas com velocidade constante.
+AnimationPath buildAnimationPath(const std::vector<glm::vec3>& points, InterpolationMode mode, float segmentDuration);
+
+// Avaliação escalar de um caminho no parâmetro 'u' (referência para os kernels SIMD)
+glm::vec3 evaluatePath(const AnimationPath& path, float u);
+
+// Matriz que leva normais do espaço do objeto ao do mundo: a inversa transposta da parte 3x3
+// de 'model'. Com escala uniforme (colunas ortogonais e de mesmo comprimento) a própria parte
+// 3x3 dividida pela escala ao quadrado já é a resposta, sem inversão.
+glm::mat3 normalMatrix(const glm::mat4& model);
+
+// Como AnimationSystem::writeMatrices, mas com as posições em arrays quaisquer (ex: o estado
+// interpolado entre dois passos da simulação): out[i] = translate(x[i], y[i], z[i]) * local
+void writeTranslationMatrices(const glm::mat4& local, const float* x, const float* y, const float* z, size_t count,
+	glm::mat4* out);
+
+// Anima muitos objetos independentes que seguem caminhos. O estado fica em estrutura de
+// arrays (SoA), agrupado por caminho, e é avançado/avaliado com SSE ou AVX.
+// As matrizes saem na ordem dos lotes: todos os objetos do caminho 0, depois do 1, etc.
+class AnimationSystem
+{
+public:
+	// Retorna o identificador do caminho
+	uint32_t addPath(const AnimationPath& path);
+	// Caminho que segue uma trajetória gravada, dando a volta no fim dela. A trajetória não é
+	// copiada e precisa existir enquanto o caminho for usado. Qualquer 'dt' (grande ou negativo,
+	// para avançar ou voltar em qualquer velocidade) custa no máximo uma busca O(log n) por objeto
+	uint32_t addTrajectory(const Trajectory& trajectory);
+	// 'phase' é o tempo (em segundos) já percorrido pelo objeto no caminho
+	void addObject(uint32_t path, glm::vec3 offset, float phase);
+	void clear();
+
+	size_t objectCount() const { return mCount; }
+
+	// Avança todos os objetos 'dt' segundos e recalcula as posições
+	void update(float dt);
+	// O mesmo só para os objetos [first, first + count) (na ordem de writeMatrices), para
+	// repartir a atualização entre tarefas. Os kernels andam em grupos de largura SIMD: um grupo
+	// pertence à faixa que contém o seu primeiro objeto, então faixas disjuntas que cobrem todos
+	// os objetos atualizam cada um exatamente uma vez
+	void updateRange(float dt, size_t first, size_t count);
+
+	// Escreve uma matriz por objeto: translate(offset + posição no caminho) * local.
+	// 'local' (escala e rotações comuns a todos) deve ser afim. 'out' pode ser memória
+	// mapeada da GPU e não precisa estar alinhada. Como só a translação varia, a matriz
+	// normal é a mesma para todos os objetos: normalMatrix(local).
+	void writeMatrices(const glm::mat4& local, glm::mat4* out) const;
+
+	glm::vec3 position(size_t object) const;
+
+	// Copia as posições atuais para arrays contíguos, na mesma ordem de writeMatrices
+	void copyPositions(float* x, float* y, float* z) const;
+
+private:
+	// Objetos de um mesmo caminho; os arrays têm folga até um múltiplo da largura SIMD
+	struct Batch {
+		uint32_t path;
+		size_t count = 0;
+		std::vector<float> u;
+		std::vector<float> offsetX, offsetY, offsetZ;
+		std::vector<float> posX, posY, posZ;
+		// Só nos caminhos de trajetória: tempo na gravação e segmento da última avaliação
+		std::vector<double> time;
+		std::vector<size_t> segment;
+	};
+
+	std::vector<AnimationPath> mPaths;
+	std::vector<Batch> mBatches;
+	size_t mCount = 0;
+};
@@ -0,0 +1,340 @@
+#include "asset_cache.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "obj_parser.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+const char* kKindNames[ASSET_KIND_COUNT] = { "malha", "material", "textura", "caminho", "trajetoria" };
+const char* kKindPlurals[ASSET_KIND_COUNT] = { "malhas", "materiais", "texturas", "caminhos", "trajetorias" };
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printBytes(std::ostream& out, size_t bytes)
+{
+	if (bytes < 1024)
+		out << bytes << " bytes";
+	else
+		out << bytes / 1024 << " KB";
+}
+
+} // namespace
+
+AssetId AssetCache::request(AssetKind kind, const std::string& path)
+{
+	return lookup(kind, path, true);
+}
+
+AssetId AssetCache::lookup(AssetKind kind, const std::string& path, bool counted)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto known = mByPath[kind].find(path);
+		if (known != mByPath[kind].end())
+		{
+			if (counted)
+				mEntries[known->second].stats.requests++;
+			return known->second;
+		}
+	}
+
+	// Caminho novo: o hash sai do arquivo mapeado, fora da trava (um arquivo grande não
+	// segura os pedidos das outras threads). O de uma trajetória válida vem do cabeçalho
+	PROFILE_SCOPE("hashAsset");
+	MappedFile file(path);
+	const bool readable = file.isOpen();
+	const size_t size = file.size();
+	uint64_t hash = kind == ASSET_TRAJECTORY && readable ? trajectoryContentHash(file.data(), size) : 0;
+	if (readable && hash == 0)
+		hash = hashBytes(file.data(), size);
+	const uint64_t key = readable ? contentKey(kind, path, file.data(), size, hash) : 0;
+	file.close();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	// Outra thread pode ter pedido o mesmo caminho nesse meio tempo
+	auto known = mByPath[kind].find(path);
+	if (known != mByPath[kind].end())
+	{
+		if (counted)
+			mEntries[known->second].stats.requests++;
+		return known->second;
+	}
+	if (readable)
+	{
+		auto same = mByHash[kind].find(key);
+		if (same != mByHash[kind].end() && mEntries[same->second].stats.fileBytes == size)
+		{
+			AssetStats& stats = mEntries[same->second].stats;
+			if (counted)
+				stats.requests++;
+			stats.aliases++;
+			mByPath[kind].emplace(path, same->second);
+			return same->second;
+		}
+	}
+
+	const AssetId asset = static_cast<AssetId>(mEntries.size());
+	mEntries.emplace_back();
+	AssetStats& stats = mEntries.back().stats;
+	stats.kind = kind;
+	stats.path = path;
+	stats.hash = hash;
+	stats.fileBytes = size;
+	stats.readable = readable;
+	stats.requests = counted ? 1 : 0;
+	mByPath[kind].emplace(path, asset);
+	if (readable)
+		mByHash[kind].emplace(key, asset);
+	return asset;
+}
+
+uint64_t AssetCache::contentKey(AssetKind kind, const std::string& path, const char* data, size_t size, uint64_t hash)
+{
+	if (kind != ASSET_MESH && kind != ASSET_MATERIAL)
+		return hash;
+
+	// O conteúdo e os assets que ele cita, já deduplicados: ids iguais são arquivos
+	// equivalentes, mesmo em pastas diferentes
+	std::vector<uint64_t> key(1, hash);
+	const std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	if (kind == ASSET_MESH)
+	{
+		std::vector<std::string> libraries;
+		findMaterialLibraries(data, data + size, libraries);
+		for (const std::string& library : libraries)
+			key.push_back(lookup(ASSET_MATERIAL, directory + library, false));
+	}
+	else
+	{
+		// Por nome do material, para a ordem não depender da tabela de hash
+		std::vector<std::pair<std::string, std::string>> textures;
+		for (const auto& named : loadMTL(path))
+			if (!named.second.map_Kd.empty())
+				textures.emplace_back(named.first, named.second.map_Kd);
+		std::sort(textures.begin(), textures.end());
+		for (const auto& texture : textures)
+		{
+			key.push_back(hashBytes(texture.first.data(), texture.first.size()));
+			key.push_back(lookup(ASSET_TEXTURE, texture.second, false));
+		}
+	}
+	return key.size() == 1 ? hash : hashBytes(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(uint64_t));
+}
+
+const std::unordered_map<std::string, Material>& AssetCache::materials(AssetId asset)
+{
+	static const std::unordered_map<std::string, Material> kNone;
+	Entry* entry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (asset >= mEntries.size() || mEntries[asset].stats.kind != ASSET_MATERIAL)
+			return kNone;
+		entry = &mEntries[asset];
+	}
+
+	// Quem chega durante a leitura espera por ela; o caminho e 'readable' não mudam depois da criação
+	std::call_once(entry->once, [this, entry]() {
+		PROFILE_SCOPE("loadMTL");
+		auto start = std::chrono::steady_clock::now();
+		if (entry->stats.readable)
+			entry->materials = loadMTL(entry->stats.path);
+		size_t bytes = 0;
+		for (const auto& named : entry->materials)
+			bytes += sizeof(Material) + named.first.size() + named.second.map_Kd.size();
+		finishLoad(*entry, millisecondsSince(start), bytes);
+	});
+	return entry->materials;
+}
+
+const std::vector<glm::vec3>& AssetCache::points(AssetId asset)
+{
+	static const std::vector<glm::vec3> kNone;
+	Entry* entry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (asset >= mEntries.size() || mEntries[asset].stats.kind != ASSET_PATH)
+			return kNone;
+		entry = &mEntries[asset];
+	}
+
+	std::call_once(entry->once, [this, entry]() {
+		PROFILE_SCOPE("loadPoints");
+		auto start = std::chrono::steady_clock::now();
+		if (entry->stats.readable)
+		{
+			// Como carregarPontos: as linhas que não começam com três números são ignoradas
+			std::ifstream file(entry->stats.path);
+			std::string line;
+			while (std::getline(file, line))
+			{
+				std::istringstream iss(line);
+				float x, y, z;
+				if (iss >> x >> y >> z)
+					entry->points.emplace_back(x, y, z);
+			}
+		}
+		finishLoad(*entry, millisecondsSince(start), entry->points.size() * sizeof(glm::vec3));
+	});
+	return entry->points;
+}
+
+const Trajectory& AssetCache::trajectory(AssetId asset)
+{
+	static const Trajectory kNone;
+	Entry* entry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (asset >= mEntries.size() || mEntries[asset].stats.kind != ASSET_TRAJECTORY)
+			return kNone;
+		entry = &mEntries[asset];
+	}
+
+	std::call_once(entry->once, [this, entry]() {
+		PROFILE_SCOPE("openTrajectory");
+		auto start = std::chrono::steady_clock::now();
+		if (entry->stats.readable)
+			entry->trajectory.open(entry->stats.path);
+		finishLoad(*entry, millisecondsSince(start), 0);
+	});
+	return entry->trajectory;
+}
+
+void AssetCache::preload(JobSystem& jobs)
+{
+	std::vector<AssetId> pending;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			const AssetStats& stats = mEntries[i].stats;
+			if (!stats.loaded && (stats.kind == ASSET_MATERIAL || stats.kind == ASSET_PATH))
+				pending.push_back(static_cast<AssetId>(i));
+		}
+	}
+	jobs.parallelFor(pending.size(), 1, [this, &pending](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			if (stats(pending[i]).kind == ASSET_MATERIAL)
+				materials(pending[i]);
+			else
+				points(pending[i]);
+		}
+	});
+}
+
+void AssetCache::loadAll(const std::vector<AssetId>& assets, JobSystem& jobs, const std::function<size_t(size_t i)>& load)
+{
+	jobs.parallelFor(assets.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			const size_t bytes = load(i);
+			Entry* entry = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				entry = &mEntries[assets[i]];
+			}
+			finishLoad(*entry, millisecondsSince(start), bytes);
+		}
+	});
+}
+
+void AssetCache::finishLoad(Entry& entry, double milliseconds, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	entry.stats.loaded = true;
+	entry.stats.loadMs += milliseconds;
+	entry.stats.residentBytes = bytes;
+}
+
+void AssetCache::addLoadTime(AssetId asset, double milliseconds)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (asset < mEntries.size())
+	{
+		mEntries[asset].stats.loaded = true;
+		mEntries[asset].stats.loadMs += milliseconds;
+	}
+}
+
+void AssetCache::setResidentBytes(AssetId asset, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (asset < mEntries.size())
+		mEntries[asset].stats.residentBytes = bytes;
+}
+
+size_t AssetCache::size() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+AssetStats AssetCache::stats(AssetId asset) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return asset < mEntries.size() ? mEntries[asset].stats : AssetStats();
+}
+
+const std::string& AssetCache::path(AssetId asset) const
+{
+	static const std::string kNone;
+	std::lock_guard<std::mutex> lock(mMutex);
+	return asset < mEntries.size() ? mEntries[asset].stats.path : kNone;
+}
+
+void AssetCache::printReport(std::ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	size_t kinds[ASSET_KIND_COUNT] = {};
+	size_t requests = 0, hits = 0, bytes = 0;
+	for (const Entry& entry : mEntries)
+	{
+		kinds[entry.stats.kind]++;
+		requests += entry.stats.requests;
+		hits += entry.stats.hits();
+		bytes += entry.stats.residentBytes;
+	}
+	out << "Assets: " << mEntries.size() << " distintos (";
+	for (int kind = 0; kind < ASSET_KIND_COUNT; kind++)
+		out << (kind ? ", " : "") << kinds[kind] << " " << (kinds[kind] == 1 ? kKindNames[kind] : kKindPlurals[kind]);
+	out << "), " << requests << " pedidos, " << hits << " reaproveitados, ";
+	printBytes(out, bytes);
+	out << " residentes" << std::endl;
+
+	for (const Entry& entry : mEntries)
+	{
+		const AssetStats& stats = entry.stats;
+		out << "  " << kKindNames[stats.kind] << " " << stats.path << ": " << stats.requests << " pedidos ("
+			<< stats.hits() << " reaproveitados";
+		if (stats.aliases)
+			out << ", " << stats.aliases + 1 << " caminhos com o mesmo conteudo";
+		out << ")";
+		if (!stats.readable)
+			out << ", nao encontrado";
+		else if (!stats.loaded)
+			out << ", nao carregado";
+		else if (stats.kind == ASSET_TRAJECTORY)
+		{
+			out << ", " << stats.loadMs << " ms, ";
+			printBytes(out, stats.fileBytes);
+			out << " mapeados";
+		}
+		else
+		{
+			out << ", " << stats.loadMs << " ms, ";
+			printBytes(out, stats.residentBytes);
+		}
+		out << std::endl;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "material.h"
+#include "trajectory.h"
+
+// Tipos de arquivo que passam pelo cache de assets
+enum AssetKind : uint8_t {
+	ASSET_MESH = 0,   // OBJ
+	ASSET_MATERIAL,   // biblioteca MTL
+	ASSET_TEXTURE,    // imagem (map_Kd)
+	ASSET_PATH,       // pontos de um caminho, um "x y z" por linha
+	ASSET_TRAJECTORY, // trajetória gravada (.traj), mapeada em vez de carregada
+	ASSET_KIND_COUNT,
+};
+
+// Identificador de um asset (índice interno do cache)
+typedef uint32_t AssetId;
+const AssetId kInvalidAsset = 0xFFFFFFFFu;
+
+struct AssetStats {
+	AssetKind kind = ASSET_MESH;
+	std::string path;          // primeiro caminho pedido com este conteúdo (o que é carregado)
+	uint64_t hash = 0;         // hashBytes do conteúdo
+	size_t fileBytes = 0;
+	bool readable = false;     // false: o arquivo não abriu (o asset fica só com o caminho)
+	size_t requests = 0;       // pedidos, por qualquer caminho com o mesmo conteúdo
+	size_t aliases = 0;        // outros caminhos com o mesmo conteúdo
+	bool loaded = false;
+	double loadMs = 0.0;       // leitura e preparo, mais o envio à GPU quando houver
+	size_t residentBytes = 0;  // memória ocupada depois de carregado (de vídeo, para malhas e texturas)
+
+	// Pedidos atendidos sem carregar de novo
+	size_t hits() const { return requests ? requests - 1 : 0; }
+};
+
+// Cache de assets endereçado pelo conteúdo.
+//
+// request() mapeia o arquivo uma vez por caminho e calcula o hash do conteúdo: caminhos
+// diferentes com os mesmos bytes (cópias, "./a.obj" e "a.obj") viram um asset só, carregado
+// uma vez e compartilhado por todos que o citam. As trajetórias trazem o hash no cabeçalho e
+// não são lidas inteiras nem aqui. O asset é carregado pelo primeiro caminho
+// (os relativos dentro dele, como o mtllib de um OBJ, partem da pasta desse caminho); por isso
+// dois OBJs só viram um asset se os MTLs citados também forem o mesmo, e dois MTLs, se as
+// texturas que eles resolvem forem.
+//
+// MTLs e caminhos de pontos são lidos pelo próprio cache no primeiro uso (materials(),
+// points()), uma vez só mesmo com pedidos simultâneos; preload() lê os que faltam em paralelo.
+// As trajetórias são só mapeadas (trajectory()), e os bytes delas não contam como residentes.
+// Malhas e texturas pertencem a quem as usa (GeometryPool, TextureStreamer): o cache só
+// deduplica, reparte a carga com loadAll() e guarda tempo e bytes de cada uma.
+//
+// Pode ser usado de qualquer thread.
+class AssetCache
+{
+public:
+	// Asset com o conteúdo do arquivo (criado no primeiro pedido)
+	AssetId request(AssetKind kind, const std::string& path);
+
+	// Vazios se o arquivo não abriu
+	const std::unordered_map<std::string, Material>& materials(AssetId asset);
+	const std::vector<glm::vec3>& points(AssetId asset);
+	// Fechada se o arquivo não é uma trajetória válida. Vale enquanto o cache existir
+	const Trajectory& trajectory(AssetId asset);
+
+	// Lê em paralelo, uma tarefa por asset, os MTLs e caminhos de pontos pedidos até aqui
+	void preload(JobSystem& jobs);
+
+	// load(i) para cada assets[i], uma tarefa por asset, medindo o tempo de cada um. load
+	// devolve os bytes residentes (ou 0, para informá-los depois com setResidentBytes)
+	void loadAll(const std::vector<AssetId>& assets, JobSystem& jobs, const std::function<size_t(size_t i)>& load);
+
+	// Trabalho de carga feito fora de loadAll (ex: o envio à GPU na thread do GL, ou as texturas
+	// preparadas pelo TextureStreamer); addLoadTime marca o asset como carregado
+	void addLoadTime(AssetId asset, double milliseconds);
+	void setResidentBytes(AssetId asset, size_t bytes);
+
+	size_t size() const;
+	AssetStats stats(AssetId asset) const;
+	const std::string& path(AssetId asset) const;
+
+	// Totais por tipo e uma linha por asset
+	void printReport(std::ostream& out) const;
+
+private:
+	struct Entry {
+		AssetStats stats;
+		std::once_flag once;
+		std::unordered_map<std::string, Material> materials; // ASSET_MATERIAL
+		std::vector<glm::vec3> points;                       // ASSET_PATH
+		Trajectory trajectory;                               // ASSET_TRAJECTORY
+	};
+
+	// request() sem contar o pedido (as dependências de contentKey)
+	AssetId lookup(AssetKind kind, const std::string& path, bool counted);
+	// Chave de deduplicação: o hash do conteúdo, mais os MTLs de um OBJ e as texturas de um MTL
+	uint64_t contentKey(AssetKind kind, const std::string& path, const char* data, size_t size, uint64_t hash);
+	void finishLoad(Entry& entry, double milliseconds, size_t bytes);
+
+	mutable std::mutex mMutex;
+	std::deque<Entry> mEntries; // deque: as entradas não mudam de endereço ao crescer
+	std::unordered_map<std::string, AssetId> mByPath[ASSET_KIND_COUNT];
+	std::unordered_map<uint64_t, AssetId> mByHash[ASSET_KIND_COUNT]; // por contentKey
+};
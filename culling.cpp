@@ -0,0 +1,484 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+namespace {
+
+// Uma subárvore é reconstruída quando sua caixa no mundo passa deste múltiplo da área original
+const float kRebuildGrowth = 2.0f;
+
+// Folga no fim dos arrays de posição para as cargas de 4 floats das folhas
+const size_t kPadding = 4;
+
+// Objetos por tarefa na cópia das posições para a ordem da BVH
+const size_t kCopyGrain = 16384;
+
+// function(begin, end) em tarefas de até 'grain' elementos, ou de uma vez sem JobSystem
+template <typename Function>
+void forRange(JobSystem* jobs, size_t count, size_t grain, const Function& function)
+{
+	if (jobs)
+		jobs->parallelFor(count, grain, function);
+	else if (count)
+		function(size_t(0), count);
+}
+
+} // namespace
+
+Frustum Frustum::fromMatrix(const glm::mat4& m)
+{
+	// Linhas da matriz (o GLM guarda colunas)
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	Frustum f;
+	f.planes[0] = row[3] + row[0]; // esquerdo
+	f.planes[1] = row[3] - row[0]; // direito
+	f.planes[2] = row[3] + row[1]; // inferior
+	f.planes[3] = row[3] - row[1]; // superior
+	f.planes[4] = row[3] + row[2]; // próximo
+	f.planes[5] = row[3] - row[2]; // distante
+	for (glm::vec4& p : f.planes)
+	{
+		float length = glm::length(glm::vec3(p));
+		if (length > 0.0f)
+			p = p / length;
+	}
+	return f;
+}
+
+uint32_t ObjectCuller::nodeCount(uint32_t objects)
+{
+	// Sem recursão (é chamada por subárvore a cada quadro). Com as divisões pela metade, os nós
+	// da profundidade d têm floor(n / 2^d) ou ceil(n / 2^d) objetos, e n mod 2^d deles têm o
+	// ceil. Na última profundidade com nós internos, os de floor objetos ainda podem ser folhas;
+	// abaixo dela só há folhas. A árvore é binária cheia: nós = 2 * folhas - 1
+	if (objects <= kLeafSize)
+		return 1;
+	uint32_t depth = 0;
+	while (((objects - 1) >> (depth + 1)) + 1 > kLeafSize) // ceil(n / 2^(depth + 1)) > kLeafSize
+		depth++;
+	const uint32_t width = 1u << depth;
+	const uint32_t larger = objects & (width - 1);
+	const uint32_t leaves = (objects >> depth) <= kLeafSize ? width + larger : 2 * width;
+	return 2 * leaves - 1;
+}
+
+void ObjectCuller::update(const float* x, const float* y, const float* z, size_t count, const glm::mat4& local,
+	glm::vec3 boundsMin, glm::vec3 boundsMax, float boundsRadius)
+{
+	auto start = std::chrono::steady_clock::now();
+	mStats = CullStats();
+
+	mSourceX.assign(x, x + count);
+	mSourceY.assign(y, y + count);
+	mSourceZ.assign(z, z + count);
+
+	// Caixa da malha levada ao mundo pela parte 3x3 de 'local' (caixa da caixa rotacionada),
+	// limitada pela caixa da esfera envolvente
+	const glm::mat3 linear(local);
+	const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	const glm::vec3 half = (boundsMax - boundsMin) * 0.5f;
+	mOffset = linear * center + glm::vec3(local[3]);
+	float maxScale = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		mHalf[i] = std::abs(linear[0][i]) * half.x + std::abs(linear[1][i]) * half.y + std::abs(linear[2][i]) * half.z;
+		maxScale = std::max(maxScale, glm::length(linear[i]));
+	}
+	if (boundsRadius > 0.0f)
+		mHalf = glm::min(mHalf, glm::vec3(boundsRadius * maxScale));
+
+	if (count != mObjects.size())
+	{
+		mObjects.resize(count);
+		std::iota(mObjects.begin(), mObjects.end(), 0u);
+		mX.assign(count + kPadding, 0.0f);
+		mY.assign(count + kPadding, 0.0f);
+		mZ.assign(count + kPadding, 0.0f);
+		mNodes.resize(count ? nodeCount(static_cast<uint32_t>(count)) : 0);
+		mSubtrees.clear();
+		mTopNodes.clear();
+		if (count)
+		{
+			build(0, 0, static_cast<uint32_t>(count));
+			findSubtrees(0);
+		}
+		mStats.rebuiltObjects = count;
+	}
+	else if (count)
+	{
+		forRange(mJobs, count, kCopyGrain, [this](size_t begin, size_t end) {
+			for (size_t k = begin; k < end; k++)
+			{
+				mX[k] = mSourceX[mObjects[k]];
+				mY[k] = mSourceY[mObjects[k]];
+				mZ[k] = mSourceZ[mObjects[k]];
+			}
+		});
+
+		// Refit das subárvores (cada uma é um trecho contíguo de mNodes) e depois dos nós de
+		// cima, de trás para frente para que os filhos estejam prontos
+		forRange(mJobs, mSubtrees.size(), 1, [this](size_t begin, size_t end) {
+			for (size_t s = begin; s < end; s++)
+				refitRange(mSubtrees[s], mSubtrees[s] + nodeCount(mNodes[mSubtrees[s]].count));
+		});
+		for (size_t i = mTopNodes.size(); i-- > 0;)
+			refitNode(mTopNodes[i]);
+
+		// De cima para baixo: a primeira subárvore degradada de cada ramo é refeita inteira.
+		// Os ancestrais continuam válidos porque o conjunto de objetos dela não muda. Os nós de
+		// cima são checados aqui; as subárvores que sobram, cada uma numa tarefa
+		mRebuildRoots.clear();
+		for (uint32_t i = 0; i < mNodes.size();)
+		{
+			const Node& node = mNodes[i];
+			if (node.count <= kSubtreeObjects)
+			{
+				mRebuildRoots.push_back(i);
+				i += nodeCount(node.count);
+			}
+			else if (worldArea(node) > kRebuildGrowth * node.buildArea)
+			{
+				const uint32_t first = node.first, objects = node.count;
+				build(i, first, objects);
+				mStats.rebuiltObjects += objects;
+				i += nodeCount(objects);
+			}
+			else
+			{
+				i++;
+			}
+		}
+		mRebuilt.assign(mRebuildRoots.size(), 0);
+		forRange(mJobs, mRebuildRoots.size(), 1, [this](size_t begin, size_t end) {
+			for (size_t r = begin; r < end; r++)
+				mRebuilt[r] = rebuildDegraded(mRebuildRoots[r], mRebuildRoots[r] + nodeCount(mNodes[mRebuildRoots[r]].count));
+		});
+		for (size_t objects : mRebuilt)
+			mStats.rebuiltObjects += objects;
+	}
+
+	mStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ObjectCuller::build(uint32_t index, uint32_t first, uint32_t count)
+{
+	// Reordena só mObjects; as posições da faixa são copiadas nas folhas
+	glm::vec3 lo(mSourceX[mObjects[first]], mSourceY[mObjects[first]], mSourceZ[mObjects[first]]);
+	glm::vec3 hi = lo;
+	for (uint32_t k = first + 1; k < first + count; k++)
+	{
+		glm::vec3 p(mSourceX[mObjects[k]], mSourceY[mObjects[k]], mSourceZ[mObjects[k]]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	Node& node = mNodes[index];
+	node.first = first;
+	node.count = count;
+	node.right = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		node.min[a] = lo[a];
+		node.max[a] = hi[a];
+	}
+	node.buildArea = worldArea(node);
+
+	if (count <= kLeafSize)
+	{
+		for (uint32_t k = first; k < first + count; k++)
+		{
+			mX[k] = mSourceX[mObjects[k]];
+			mY[k] = mSourceY[mObjects[k]];
+			mZ[k] = mSourceZ[mObjects[k]];
+		}
+		return;
+	}
+
+	// Mediana da contagem no eixo mais longo
+	const glm::vec3 extent = hi - lo;
+	const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	const std::vector<float>& key = axis == 0 ? mSourceX : axis == 1 ? mSourceY : mSourceZ;
+	const uint32_t half = count / 2;
+	std::nth_element(mObjects.begin() + first, mObjects.begin() + first + half, mObjects.begin() + first + count,
+		[&key](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+
+	const uint32_t right = index + 1 + nodeCount(half);
+	mNodes[index].right = right;
+	build(index + 1, first, half);
+	build(right, first + half, count - half);
+}
+
+void ObjectCuller::findSubtrees(uint32_t index)
+{
+	const Node& node = mNodes[index];
+	if (node.count <= kSubtreeObjects)
+	{
+		mSubtrees.push_back(index);
+		return;
+	}
+	mTopNodes.push_back(index);
+	findSubtrees(index + 1);
+	findSubtrees(node.right);
+}
+
+void ObjectCuller::refitRange(uint32_t first, uint32_t last)
+{
+	// Em pré-ordem os filhos vêm depois do pai: de trás para frente, os filhos já estão prontos
+	for (uint32_t i = last; i-- > first;)
+		refitNode(i);
+}
+
+void ObjectCuller::refitNode(uint32_t index)
+{
+	Node& node = mNodes[index];
+	if (node.count <= kLeafSize)
+	{
+		refitLeaf(node);
+		return;
+	}
+	const Node& left = mNodes[index + 1];
+	const Node& right = mNodes[node.right];
+	for (int a = 0; a < 3; a++)
+	{
+		node.min[a] = std::min(left.min[a], right.min[a]);
+		node.max[a] = std::max(left.max[a], right.max[a]);
+	}
+}
+
+void ObjectCuller::refitLeaf(Node& node)
+{
+	const uint32_t end = node.first + node.count;
+	node.min[0] = node.max[0] = mX[node.first];
+	node.min[1] = node.max[1] = mY[node.first];
+	node.min[2] = node.max[2] = mZ[node.first];
+	for (uint32_t k = node.first + 1; k < end; k++)
+	{
+		node.min[0] = std::min(node.min[0], mX[k]);
+		node.max[0] = std::max(node.max[0], mX[k]);
+		node.min[1] = std::min(node.min[1], mY[k]);
+		node.max[1] = std::max(node.max[1], mY[k]);
+		node.min[2] = std::min(node.min[2], mZ[k]);
+		node.max[2] = std::max(node.max[2], mZ[k]);
+	}
+}
+
+size_t ObjectCuller::rebuildDegraded(uint32_t first, uint32_t last)
+{
+	size_t rebuilt = 0;
+	for (uint32_t i = first; i < last;)
+	{
+		const Node& node = mNodes[i];
+		if (node.count > kLeafSize && worldArea(node) > kRebuildGrowth * node.buildArea)
+		{
+			const uint32_t objects = node.count;
+			build(i, node.first, objects);
+			rebuilt += objects;
+			i += nodeCount(objects);
+		}
+		else
+		{
+			i++;
+		}
+	}
+	return rebuilt;
+}
+
+float ObjectCuller::worldArea(const Node& node) const
+{
+	const float x = node.max[0] - node.min[0] + 2.0f * mHalf.x;
+	const float y = node.max[1] - node.min[1] + 2.0f * mHalf.y;
+	const float z = node.max[2] - node.min[2] + 2.0f * mHalf.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+void ObjectCuller::cull(const Frustum& frustum)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// A caixa de um objeto na posição p está fora do plano se n · (p + offset) + w + |n| · half < 0:
+	// tudo que não depende de p é somado uma vez por quadro
+	for (int i = 0; i < 6; i++)
+	{
+		mNormals[i] = glm::vec3(frustum.planes[i]);
+		mRadius[i] = glm::dot(glm::abs(mNormals[i]), mHalf);
+		mDistance[i] = glm::dot(mNormals[i], mOffset) + frustum.planes[i].w;
+	}
+
+	mVisible.clear();
+	mStats.nodesVisited = 0;
+	mCullTaskCount = 0;
+	if (!mNodes.empty())
+		collectCullTasks(0, 0x3F);
+	forRange(mJobs, mCullTaskCount, 1, [this](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++)
+		{
+			CullTask& task = mCullTasks[t];
+			task.visible.clear();
+			task.nodesVisited = 0;
+			cullNode(task.node, task.planeMask, task.visible, task.nodesVisited);
+		}
+	});
+	for (size_t t = 0; t < mCullTaskCount; t++)
+	{
+		mVisible.insert(mVisible.end(), mCullTasks[t].visible.begin(), mCullTasks[t].visible.end());
+		mStats.nodesVisited += mCullTasks[t].nodesVisited;
+	}
+
+	mStats.visible = mVisible.size();
+	mStats.culled = mObjects.size() - mVisible.size();
+	mStats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool ObjectCuller::testNode(const Node& node, unsigned& planeMask) const
+{
+	const glm::vec3 center((node.min[0] + node.max[0]) * 0.5f, (node.min[1] + node.max[1]) * 0.5f, (node.min[2] + node.max[2]) * 0.5f);
+	const glm::vec3 extent((node.max[0] - node.min[0]) * 0.5f, (node.max[1] - node.min[1]) * 0.5f, (node.max[2] - node.min[2]) * 0.5f);
+	for (int i = 0; i < 6; i++)
+	{
+		if (!(planeMask & (1u << i)))
+			continue;
+		const float d = glm::dot(mNormals[i], center) + mDistance[i];
+		const float r = glm::dot(glm::abs(mNormals[i]), extent) + mRadius[i];
+		if (d + r < 0.0f)
+			return false;
+		if (d - r >= 0.0f)
+			planeMask &= ~(1u << i); // nó inteiro do lado de dentro: os filhos não testam este plano
+	}
+	return true;
+}
+
+void ObjectCuller::collectCullTasks(uint32_t index, unsigned planeMask)
+{
+	// Os nós de cima são testados aqui; uma subárvore (ou um nó inteiro dentro do frustum, que
+	// só copia os seus objetos) vira uma tarefa, que testa de novo a própria raiz
+	const Node& node = mNodes[index];
+	if (node.count > kSubtreeObjects)
+	{
+		unsigned mask = planeMask;
+		if (!testNode(node, mask))
+		{
+			mStats.nodesVisited++;
+			return;
+		}
+		if (mask != 0)
+		{
+			mStats.nodesVisited++;
+			collectCullTasks(index + 1, mask);
+			collectCullTasks(node.right, mask);
+			return;
+		}
+	}
+	if (mCullTaskCount == mCullTasks.size())
+		mCullTasks.emplace_back();
+	CullTask& task = mCullTasks[mCullTaskCount++];
+	task.node = index;
+	task.planeMask = planeMask;
+}
+
+void ObjectCuller::cullNode(uint32_t index, unsigned planeMask, std::vector<uint32_t>& visible, size_t& nodesVisited) const
+{
+	const Node& node = mNodes[index];
+	nodesVisited++;
+	if (!testNode(node, planeMask))
+		return;
+
+	if (planeMask == 0)
+	{
+		for (uint32_t k = node.first; k < node.first + node.count; k++)
+			visible.push_back(k);
+		return;
+	}
+	if (node.count <= kLeafSize)
+	{
+		cullLeaf(node, planeMask, visible);
+		return;
+	}
+	const uint32_t right = node.right;
+	cullNode(index + 1, planeMask, visible, nodesVisited);
+	cullNode(right, planeMask, visible, nodesVisited);
+}
+
+void ObjectCuller::cullLeaf(const Node& node, unsigned planeMask, std::vector<uint32_t>& visible) const
+{
+	const uint32_t end = node.first + node.count;
+#if defined(CULLING_SSE)
+	// 4 objetos por vez; a folga no fim dos arrays cobre a última carga
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t k = node.first; k < end; k += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&mX[k]);
+		const __m128 y = _mm_loadu_ps(&mY[k]);
+		const __m128 z = _mm_loadu_ps(&mZ[k]);
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int i = 0; i < 6; i++)
+		{
+			if (!(planeMask & (1u << i)))
+				continue;
+			__m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(mNormals[i].x), x), _mm_mul_ps(_mm_set1_ps(mNormals[i].y), y));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(mNormals[i].z), z));
+			d = _mm_add_ps(d, _mm_set1_ps(mDistance[i] + mRadius[i]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+		}
+		const uint32_t lanes = std::min<uint32_t>(4, end - k);
+		const int bits = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < lanes; lane++)
+			if (bits & (1 << lane))
+				visible.push_back(k + lane);
+	}
+#else
+	for (uint32_t k = node.first; k < end; k++)
+	{
+		const glm::vec3 p(mX[k], mY[k], mZ[k]);
+		bool inside = true;
+		for (int i = 0; i < 6 && inside; i++)
+			if (planeMask & (1u << i))
+				inside = glm::dot(mNormals[i], p) + mDistance[i] + mRadius[i] >= 0.0f;
+		if (inside)
+			visible.push_back(k);
+	}
+#endif
+}
+
+void ObjectCuller::writeVisibleMatrices(const glm::mat4& local, glm::mat4* out) const
+{
+	writeVisibleMatrices(local, out, 0, mVisible.size());
+}
+
+void ObjectCuller::writeVisibleMatrices(const glm::mat4& local, glm::mat4* out, size_t first, size_t count) const
+{
+	const uint32_t* visible = mVisible.data() + first;
+#if defined(CULLING_SSE)
+	const __m128 c0 = _mm_loadu_ps(&local[0].x);
+	const __m128 c1 = _mm_loadu_ps(&local[1].x);
+	const __m128 c2 = _mm_loadu_ps(&local[2].x);
+	const __m128 c3 = _mm_loadu_ps(&local[3].x);
+	float* m = &out[0][0].x;
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint32_t k = visible[i];
+		_mm_storeu_ps(m, c0);
+		_mm_storeu_ps(m + 4, c1);
+		_mm_storeu_ps(m + 8, c2);
+		_mm_storeu_ps(m + 12, _mm_add_ps(c3, _mm_set_ps(0.0f, mZ[k], mY[k], mX[k])));
+		m += 16;
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint32_t k = visible[i];
+		out[i] = local;
+		out[i][3] += glm::vec4(mX[k], mY[k], mZ[k], 0.0f);
+	}
+#endif
+}
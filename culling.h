@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+
+// GLM
+#include <glm/glm.hpp>
+
+// Os 6 planos do volume de visão, extraídos de projection * view (Gribb/Hartmann).
+// xyz é a normal (apontando para dentro) e w a distância; normalizados.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+struct CullStats {
+	size_t visible = 0;
+	size_t culled = 0;
+	size_t nodesVisited = 0;
+	size_t rebuiltObjects = 0; // objetos em subárvores reconstruídas neste quadro
+	double milliseconds = 0.0; // atualização da BVH + teste contra o frustum
+};
+
+// Culling por objeto contra o frustum, apoiado numa BVH sobre as caixas no mundo.
+//
+// Todos os objetos usam a mesma malha e a mesma parte 3x3 de 'local', então a caixa de cada um
+// é a mesma caixa deslocada pela posição no caminho: a BVH guarda só posições e a meia-extensão
+// comum entra nos testes. A cada quadro as caixas dos nós são reajustadas de baixo para cima
+// (refit); uma subárvore cuja área cresceu demais desde a construção (objetos se afastando ao
+// longo dos caminhos) é reconstruída no lugar. A divisão é sempre na mediana da contagem, então
+// a forma da árvore só depende do número de objetos e qualquer subárvore pode ser refeita sem
+// mexer no resto.
+//
+// Os nós são testados com a máscara de planos do pai (um nó inteiro dentro de um plano não o
+// testa de novo nos filhos) e as folhas testam 4 objetos por vez com SSE.
+//
+// Com um JobSystem (setJobSystem) o trabalho é repartido pelas subárvores de até
+// kSubtreeObjects objetos, que não dividem nós nem objetos: o refit, a checagem de reconstrução
+// e o teste de cada uma viram uma tarefa, e só os poucos nós acima delas ficam na thread
+// chamadora. Os visíveis de cada subárvore vão para listas próprias, concatenadas na ordem da
+// árvore, então o resultado é o mesmo da versão serial.
+class ObjectCuller
+{
+public:
+	// Objetos por folha
+	static const uint32_t kLeafSize = 8;
+	// Maior subárvore tratada como uma tarefa só
+	static const uint32_t kSubtreeObjects = 4096;
+
+	// nullptr (o padrão) faz tudo na thread chamadora
+	void setJobSystem(JobSystem* jobs) { mJobs = jobs; }
+
+	// Copia as posições dos objetos (na ordem da animação, ver AnimationSystem::copyPositions)
+	// e atualiza a BVH (reconstrói tudo se a contagem mudou). A caixa da malha vai para o
+	// mundo por 'local'; a esfera envolvente limita a caixa quando a rotação a deixaria maior.
+	void update(const float* x, const float* y, const float* z, size_t count, const glm::mat4& local,
+		glm::vec3 boundsMin, glm::vec3 boundsMax, float boundsRadius);
+
+	// Guarda os objetos que tocam o frustum
+	void cull(const Frustum& frustum);
+
+	// Uma matriz por objeto visível: translate(posição) * local (como em writeMatrices)
+	void writeVisibleMatrices(const glm::mat4& local, glm::mat4* out) const;
+	// Só os visíveis [first, first + count), em out[0..count) (para repartir entre tarefas)
+	void writeVisibleMatrices(const glm::mat4& local, glm::mat4* out, size_t first, size_t count) const;
+
+	size_t visibleCount() const { return mVisible.size(); }
+	// Posição e objeto (ordem da animação) do i-ésimo visível (mesma ordem de writeVisibleMatrices)
+	glm::vec3 visiblePosition(size_t i) const
+	{
+		const uint32_t k = mVisible[i];
+		return glm::vec3(mX[k], mY[k], mZ[k]);
+	}
+	uint32_t visibleObject(size_t i) const { return mObjects[mVisible[i]]; }
+	const CullStats& stats() const { return mStats; }
+
+private:
+	// Caixas em espaço de posição: a caixa no mundo é [min + offset - half, max + offset + half]
+	struct Node {
+		float min[3];
+		uint32_t first;   // primeiro objeto (em mX/mY/mZ)
+		float max[3];
+		uint32_t count;   // objetos na subárvore; folha se <= kLeafSize
+		float buildArea;  // área da caixa no mundo quando a subárvore foi construída
+		uint32_t right;   // filho direito (o esquerdo é o nó seguinte)
+	};
+
+	// Subárvore testada numa tarefa, com a máscara de planos herdada e os visíveis dela
+	struct CullTask {
+		uint32_t node;
+		unsigned planeMask;
+		std::vector<uint32_t> visible;
+		size_t nodesVisited;
+	};
+
+	static uint32_t nodeCount(uint32_t objects);
+	void build(uint32_t node, uint32_t first, uint32_t count);
+	void findSubtrees(uint32_t node);
+	void refitRange(uint32_t first, uint32_t last);
+	void refitNode(uint32_t node);
+	void refitLeaf(Node& node);
+	size_t rebuildDegraded(uint32_t first, uint32_t last);
+	float worldArea(const Node& node) const;
+	bool testNode(const Node& node, unsigned& planeMask) const;
+	void collectCullTasks(uint32_t node, unsigned planeMask);
+	void cullNode(uint32_t node, unsigned planeMask, std::vector<uint32_t>& visible, size_t& nodesVisited) const;
+	void cullLeaf(const Node& node, unsigned planeMask, std::vector<uint32_t>& visible) const;
+
+	JobSystem* mJobs = nullptr;
+	std::vector<Node> mNodes;
+	std::vector<uint32_t> mSubtrees;  // raízes das subárvores de até kSubtreeObjects, em pré-ordem
+	std::vector<uint32_t> mTopNodes;  // nós acima delas, em pré-ordem
+	std::vector<uint32_t> mObjects;   // objeto (ordem da animação) de cada posição da BVH
+	std::vector<float> mX, mY, mZ;    // posições na ordem da BVH, com folga para a largura SIMD
+	std::vector<float> mSourceX, mSourceY, mSourceZ; // posições na ordem da animação
+	glm::vec3 mOffset = glm::vec3(0.0f);  // centro da caixa em relação à posição do objeto
+	glm::vec3 mHalf = glm::vec3(0.0f);    // meia-extensão comum das caixas no mundo
+
+	// Constantes do quadro por plano: normal, |normal| · mHalf e n · mOffset + w
+	glm::vec3 mNormals[6];
+	float mRadius[6];
+	float mDistance[6];
+
+	std::vector<CullTask> mCullTasks;  // as primeiras mCullTaskCount valem no quadro (as listas são reaproveitadas)
+	size_t mCullTaskCount = 0;
+	std::vector<uint32_t> mRebuildRoots; // subárvores a checar depois dos nós de cima
+	std::vector<size_t> mRebuilt;        // objetos reconstruídos em cada uma
+	std::vector<uint32_t> mVisible; // posições na ordem da BVH
+	CullStats mStats;
+};
@@ -0,0 +1,87 @@
+#include "draw_queue.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+namespace {
+
+const int kDigitBits = 8;
+const int kBuckets = 1 << kDigitBits;
+const int kPasses = 64 / kDigitBits;
+
+inline uint32_t digit(uint64_t key, int pass)
+{
+	return static_cast<uint32_t>(key >> (pass * kDigitBits)) & (kBuckets - 1);
+}
+
+} // namespace
+
+uint32_t depthBucket(float viewDepth, float farPlane)
+{
+	if (!(viewDepth > 0.0f) || farPlane <= 0.0f)
+		return 0;
+	float t = std::min(viewDepth / farPlane, 1.0f);
+	return static_cast<uint32_t>(t * 65535.0f + 0.5f);
+}
+
+void DrawQueue::sort(JobSystem& jobs)
+{
+	PROFILE_SCOPE("sortDraws");
+	const size_t count = mCommands.size();
+	if (count < 2)
+		return;
+
+	// Todas as contagens de uma vez, para saber quais passadas podem ser puladas
+	bool needed[kPasses];
+	{
+		std::vector<uint32_t> histogram(kPasses * kBuckets, 0);
+		for (const DrawCommand& command : mCommands)
+			for (int pass = 0; pass < kPasses; pass++)
+				histogram[pass * kBuckets + digit(command.key, pass)]++;
+		for (int pass = 0; pass < kPasses; pass++)
+		{
+			const uint32_t* h = &histogram[pass * kBuckets];
+			needed[pass] = std::find(h, h + kBuckets, static_cast<uint32_t>(count)) == h + kBuckets;
+		}
+	}
+
+	const unsigned threads = jobs.workerCount();
+	const size_t blocks = (count >= kParallelThreshold && threads > 1) ? threads : 1;
+	const size_t blockSize = (count + blocks - 1) / blocks;
+	std::vector<size_t> offsets(blocks * kBuckets);
+	mScratch.resize(count);
+
+	for (int pass = 0; pass < kPasses; pass++)
+	{
+		if (!needed[pass])
+			continue;
+
+		// Contagem por trecho
+		jobs.parallelFor(blocks, 1, [&](size_t b, size_t) {
+			size_t* h = &offsets[b * kBuckets];
+			std::fill(h, h + kBuckets, 0);
+			const size_t end = std::min(count, (b + 1) * blockSize);
+			for (size_t i = b * blockSize; i < end; i++)
+				h[digit(mCommands[i].key, pass)]++;
+		});
+
+		// Soma de prefixos na ordem (dígito, trecho): mantém a ordenação estável
+		size_t sum = 0;
+		for (int d = 0; d < kBuckets; d++)
+			for (size_t b = 0; b < blocks; b++)
+			{
+				size_t n = offsets[b * kBuckets + d];
+				offsets[b * kBuckets + d] = sum;
+				sum += n;
+			}
+
+		jobs.parallelFor(blocks, 1, [&](size_t b, size_t) {
+			size_t* h = &offsets[b * kBuckets];
+			const size_t end = std::min(count, (b + 1) * blockSize);
+			for (size_t i = b * blockSize; i < end; i++)
+				mScratch[h[digit(mCommands[i].key, pass)]++] = mCommands[i];
+		});
+
+		mCommands.swap(mScratch);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+
+// Um desenho instanciado de uma submalha: 'instanceCount' instâncias a partir de 'firstInstance'
+// no buffer de instâncias
+struct DrawCommand {
+	uint64_t key;
+	uint32_t submesh;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+};
+
+// Chaves de 64 bits: ordenar pela chave agrupa os desenhos pelo estado que custa mais trocar.
+//   opacos:        [63] 0 | [62..55] programa | [54..39] textura | [38..23] material | [22..7] profundidade
+//   transparentes: [63] 1 | [62..47] profundidade invertida | [46..39] programa | [38..23] textura | [22..7] material
+// Os opacos vêm antes, do mais perto para o mais longe dentro do mesmo estado; os transparentes
+// depois, de trás para frente (a ordem de composição manda mais que as trocas de estado).
+// 'texture' e 'material' valem 0 para "nenhum".
+inline uint64_t opaqueSortKey(uint32_t program, uint32_t texture, uint32_t material, uint32_t depth)
+{
+	return (static_cast<uint64_t>(program & 0xFF) << 55) | (static_cast<uint64_t>(texture & 0xFFFF) << 39)
+		| (static_cast<uint64_t>(material & 0xFFFF) << 23) | (static_cast<uint64_t>(depth & 0xFFFF) << 7);
+}
+
+inline uint64_t transparentSortKey(uint32_t depth, uint32_t program, uint32_t texture, uint32_t material)
+{
+	return (1ull << 63) | (static_cast<uint64_t>(0xFFFF - (depth & 0xFFFF)) << 47)
+		| (static_cast<uint64_t>(program & 0xFF) << 39) | (static_cast<uint64_t>(texture & 0xFFFF) << 23)
+		| (static_cast<uint64_t>(material & 0xFFFF) << 7);
+}
+
+inline bool isTransparentKey(uint64_t key) { return (key >> 63) != 0; }
+
+// Distância ao longo da direção da câmera quantizada em 16 bits sobre [0, farPlane]
+uint32_t depthBucket(float viewDepth, float farPlane);
+
+// Fila de desenhos de um quadro, ordenada pela chave com radix sort (LSD, 8 bits por passada,
+// estável). As passadas em que todas as chaves têm o mesmo byte são puladas, então os campos
+// sem uso não custam nada. Filas grandes (ex: muitos objetos transparentes, um desenho por
+// instância) dividem cada passada entre tarefas do JobSystem: cada uma conta os dígitos do seu
+// trecho e espalha os elementos nas posições da soma de prefixos (dígito, trecho).
+class DrawQueue
+{
+public:
+	// Abaixo disso a ordenação fica numa tarefa só
+	static const size_t kParallelThreshold = 1 << 16;
+
+	void clear() { mCommands.clear(); }
+	void add(uint64_t key, uint32_t submesh, uint32_t firstInstance, uint32_t instanceCount)
+	{
+		mCommands.push_back({ key, submesh, firstInstance, instanceCount });
+	}
+	// Preenchimento em paralelo: resize() com o total e cada tarefa escreve as suas posições
+	void resize(size_t count) { mCommands.resize(count); }
+	void set(size_t i, uint64_t key, uint32_t submesh, uint32_t firstInstance, uint32_t instanceCount)
+	{
+		mCommands[i] = { key, submesh, firstInstance, instanceCount };
+	}
+
+	void sort(JobSystem& jobs);
+
+	const std::vector<DrawCommand>& commands() const { return mCommands; }
+	size_t size() const { return mCommands.size(); }
+
+private:
+	std::vector<DrawCommand> mCommands;
+	std::vector<DrawCommand> mScratch;
+};
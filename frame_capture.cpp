@@ -0,0 +1,33 @@
+#include "frame_capture.h"
+
+#include <fstream>
+
+// STB_IMAGE_WRITE
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace {
+
+bool endsWith(const std::string& s, const char* suffix)
+{
+	std::string tail(suffix);
+	return s.size() >= tail.size() && s.compare(s.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+} // namespace
+
+bool saveFrameImage(const std::string& path, int width, int height, const std::vector<uint8_t>& rgb)
+{
+	if (rgb.size() < static_cast<size_t>(width) * height * 3)
+		return false;
+
+	if (endsWith(path, ".png"))
+		return stbi_write_png(path.c_str(), width, height, 3, rgb.data(), width * 3) != 0;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+	out << "P6\n" << width << " " << height << "\n255\n";
+	out.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(width) * height * 3);
+	return static_cast<bool>(out);
+}
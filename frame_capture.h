@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Grava um quadro RGB (3 bytes por pixel, de cima para baixo) para comparação de imagens.
+// O formato vem da extensão: ".png" (stb_image_write) ou PPM binário (P6) nos demais casos.
+bool saveFrameImage(const std::string& path, int width, int height, const std::vector<uint8_t>& rgb);
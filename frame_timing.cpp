@@ -0,0 +1,179 @@
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+TimingStats computeTimingStats(std::vector<double> samples)
+{
+	TimingStats stats;
+	stats.count = samples.size();
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+	const size_t n = samples.size();
+	stats.min = samples.front();
+	stats.max = samples.back();
+	stats.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+	size_t rank = static_cast<size_t>(std::ceil(0.99 * n));
+	stats.p99 = samples[std::max<size_t>(rank, 1) - 1];
+	double sum = 0.0;
+	for (double s : samples)
+		sum += s;
+	stats.mean = sum / n;
+	return stats;
+}
+
+void GpuTimer::create(size_t latency)
+{
+	mQueries.assign(std::max<size_t>(latency, 1), 0);
+	glGenQueries(static_cast<GLsizei>(mQueries.size()), mQueries.data());
+	mNext = 0;
+	mPending = 0;
+	mResults.clear();
+}
+
+void GpuTimer::destroy()
+{
+	if (!mQueries.empty())
+		glDeleteQueries(static_cast<GLsizei>(mQueries.size()), mQueries.data());
+	mQueries.clear();
+	mPending = 0;
+}
+
+void GpuTimer::begin()
+{
+	// Anel cheio: a query mais antiga precisa ser lida antes de ser reutilizada
+	if (mPending == mQueries.size())
+	{
+		collect();
+		if (mPending == mQueries.size())
+		{
+			size_t oldest = (mNext + mQueries.size() - mPending) % mQueries.size();
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(mQueries[oldest], GL_QUERY_RESULT, &ns);
+			mResults.push_back(ns / 1.0e6);
+			mPending--;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, mQueries[mNext]);
+}
+
+void GpuTimer::end()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	mNext = (mNext + 1) % mQueries.size();
+	mPending++;
+}
+
+void GpuTimer::collect(bool wait)
+{
+	while (mPending > 0)
+	{
+		size_t oldest = (mNext + mQueries.size() - mPending) % mQueries.size();
+		if (!wait)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(mQueries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+		}
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(mQueries[oldest], GL_QUERY_RESULT, &ns);
+		mResults.push_back(ns / 1.0e6);
+		mPending--;
+	}
+}
+
+namespace {
+
+std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			out += ' ';
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+void writeStats(std::ofstream& out, const char* name, const std::vector<double>& samples)
+{
+	TimingStats stats = computeTimingStats(samples);
+	out << "  \"" << name << "\": { \"count\": " << stats.count << ", \"min\": " << stats.min
+		<< ", \"median\": " << stats.median << ", \"p99\": " << stats.p99 << ", \"mean\": " << stats.mean
+		<< ", \"max\": " << stats.max << ", \"samples\": [";
+	for (size_t i = 0; i < samples.size(); i++)
+		out << (i ? ", " : "") << samples[i];
+	out << "] }";
+}
+
+} // namespace
+
+bool writeBenchmarkJson(const std::string& path, const BenchmarkReport& report)
+{
+	std::ofstream out(path, std::ios::trunc);
+	if (!out)
+		return false;
+	out << "{\n";
+	out << "  \"renderer\": " << jsonString(report.renderer) << ",\n";
+	out << "  \"version\": " << jsonString(report.version) << ",\n";
+	out << "  \"width\": " << report.width << ",\n";
+	out << "  \"height\": " << report.height << ",\n";
+	out << "  \"objects\": " << report.objects << ",\n";
+	out << "  \"frames\": " << report.cpuMs.size() << ",\n";
+	out << "  \"vertices_per_frame\": " << report.verticesPerFrame << ",\n";
+	out << "  \"normal_matrix\": " << jsonString(report.normalMatrix) << ",\n";
+	out << "  \"lod\": " << (report.lod ? "true" : "false") << ",\n";
+	out << "  \"visible_objects\": " << report.visibleObjects << ",\n";
+	out << "  \"gl_calls_per_frame\": { \"issued\": " << report.glCallsIssued << ", \"elided\": " << report.glCallsElided
+		<< ", \"draws\": " << report.drawCalls << " },\n";
+	out << "  \"upload\": { \"bytes_per_frame\": " << report.uploadBytes << ", \"fence_waits\": " << report.fenceWaits
+		<< ", \"fence_wait_ms\": " << report.fenceWaitMs << " },\n";
+	out << "  \"simulation\": { \"rate_hz\": " << report.simRate << ", \"steps_per_second\": " << report.simStepsPerSecond
+		<< ", \"frames_per_second\": " << report.framesPerSecond << ", \"step_ms\": " << report.simStepMs
+		<< ", \"skipped_steps\": " << report.simSkippedSteps << ", \"dropped_events\": " << report.droppedEvents << " },\n";
+	if (report.lights)
+		out << "  \"lights\": { \"count\": " << report.lights << ", \"references_per_frame\": " << report.lightReferences
+			<< ", \"max_per_cluster\": " << report.maxLightsPerCluster << " },\n";
+	if (report.jobWorkers)
+	{
+		out << "  \"jobs\": { \"workers\": " << report.jobWorkers << ", \"nodes\": {";
+		for (size_t n = 0; n < report.jobNames.size(); n++)
+		{
+			TimingStats stats = computeTimingStats(n < report.jobMs.size() ? report.jobMs[n] : std::vector<double>());
+			out << (n ? ", " : " ") << jsonString(report.jobNames[n]) << ": { \"median\": " << stats.median
+				<< ", \"p99\": " << stats.p99 << ", \"mean\": " << stats.mean << " }";
+		}
+		out << " } },\n";
+	}
+	if (report.trianglesPerSecond > 0.0)
+		out << "  \"raster\": { \"triangles_per_second\": " << report.trianglesPerSecond << ", \"pixels_per_second\": "
+			<< report.pixelsPerSecond << " },\n";
+	writeStats(out, "cpu_ms", report.cpuMs);
+	out << ",\n";
+	writeStats(out, "gpu_ms", report.gpuMs);
+	out << ",\n";
+	writeStats(out, "frame_ms", report.frameMs);
+	out << ",\n";
+	writeStats(out, "cull_ms", report.cullMs);
+	out << ",\n";
+	writeStats(out, "light_assign_ms", report.lightAssignMs);
+	out << ",\n";
+	writeStats(out, "prep_ms", report.prepMs);
+	out << "\n}\n";
+	return static_cast<bool>(out);
+}
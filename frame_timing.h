@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// Resumo de uma série de tempos (em ms)
+struct TimingStats {
+	size_t count = 0;
+	double min = 0.0;
+	double median = 0.0;
+	double p99 = 0.0; // percentil 99 (nearest-rank)
+	double mean = 0.0;
+	double max = 0.0;
+};
+
+TimingStats computeTimingStats(std::vector<double> samples);
+
+// Mede o tempo de GPU de cada quadro com queries GL_TIME_ELAPSED. As queries formam um
+// anel e são lidas com alguns quadros de atraso, para não parar a CPU esperando a GPU.
+// Os resultados saem na ordem dos quadros.
+class GpuTimer
+{
+public:
+	void create(size_t latency = 4);
+	void destroy();
+
+	void begin();
+	void end();
+
+	// Lê as queries já prontas; com 'wait' espera todas as pendentes (fim do benchmark)
+	void collect(bool wait = false);
+
+	const std::vector<double>& results() const { return mResults; }
+
+private:
+	std::vector<GLuint> mQueries;
+	size_t mNext = 0;     // próxima query a iniciar
+	size_t mPending = 0;  // queries terminadas e ainda não lidas
+	std::vector<double> mResults;
+};
+
+// Resultado do benchmark de quadros gravado em JSON
+struct BenchmarkReport {
+	std::string renderer;
+	std::string version;
+	int width = 0;
+	int height = 0;
+	size_t objects = 0;
+	double verticesPerFrame = 0.0; // vértices processados por quadro (índices x instâncias desenhadas, média)
+	double visibleObjects = 0.0;   // objetos que passaram pelo culling (média)
+	std::vector<double> cullMs;    // atualização da BVH + teste do frustum (vazio com --no-culling)
+	unsigned jobWorkers = 0;       // threads do sistema de tarefas, contando a principal (--jobs)
+	std::vector<double> prepMs;    // preparo do quadro na CPU: interpolação + grafo de tarefas até a submissão GL
+	std::vector<std::string> jobNames;      // nós do grafo de preparo
+	std::vector<std::vector<double>> jobMs; // tempo de cada nó por quadro, na ordem de jobNames
+	size_t lights = 0;             // luzes pontuais (--lights)
+	std::vector<double> lightAssignMs; // distribuição das luzes nos clusters (vazio sem --lights)
+	double lightReferences = 0.0;  // entradas nas listas dos clusters por quadro (média)
+	size_t maxLightsPerCluster = 0; // maior lista de um cluster nos quadros medidos
+	std::string normalMatrix;    // "cpu" (uniform) ou "shader" (inversa por vértice)
+	bool lod = false;            // nível de detalhe pela distância (--no-lod desliga, para comparar)
+	std::vector<double> cpuMs;   // CPU: do início do quadro até o envio do desenho
+	std::vector<double> gpuMs;   // GPU: GL_TIME_ELAPSED
+	std::vector<double> frameMs; // intervalo entre o início de quadros consecutivos
+	double glCallsIssued = 0.0;  // chamadas GL por quadro enviadas pelo GLStateCache (média)
+	double glCallsElided = 0.0;  // e as evitadas por serem redundantes
+	double drawCalls = 0.0;      // chamadas de desenho por quadro (média)
+	double uploadBytes = 0.0;    // bytes escritos no UploadRing por quadro (média)
+	size_t fenceWaits = 0;       // esperas da CPU pelas fences do anel (total)
+	double fenceWaitMs = 0.0;    // e o tempo somado delas
+	double simRate = 0.0;           // passos por segundo pedidos à simulação (--sim-rate)
+	double simStepsPerSecond = 0.0; // passos dados por segundo nos quadros medidos
+	double framesPerSecond = 0.0;   // quadros renderizados por segundo, no mesmo intervalo
+	double simStepMs = 0.0;         // custo médio de um passo da simulação
+	uint64_t simSkippedSteps = 0;   // passos pulados por atraso da simulação (total)
+	uint64_t droppedEvents = 0;     // eventos de entrada perdidos com a fila cheia (total)
+	double trianglesPerSecond = 0.0; // só no rasterizador em software (--software): vazão de triângulos
+	double pixelsPerSecond = 0.0;    // e de pixels sombreados
+};
+
+bool writeBenchmarkJson(const std::string& path, const BenchmarkReport& report);
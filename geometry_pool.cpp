@@ -0,0 +1,127 @@
+#include "geometry_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Tamanho inicial dos buffers; as malhas pequenas (ex: o cubo) cabem sem crescer
+const size_t kInitialBytes = 1 << 20;
+
+} // namespace
+
+void GeometryPool::create(VertexFormat format)
+{
+	mFormat = format;
+	mStride = format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : kVertexFloats * sizeof(GLfloat);
+
+	glCreateVertexArrays(1, &mVertexArray);
+	// As localizações seguem o layout do vertexShaderSource: 0 posição, 1 normal, 2 coordenada de textura
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		//Atributo posição: 3 x unorm16 (o shader reconstrói a partir da caixa envolvente)
+		glVertexArrayAttribFormat(mVertexArray, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+		//Atributo normal: 2 x snorm16 em codificação octaédrica
+		glVertexArrayAttribFormat(mVertexArray, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+		//Atributo coordenada de textura: 2 x half float
+		glVertexArrayAttribFormat(mVertexArray, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoord));
+	}
+	else
+	{
+		// A cor (floats 3 a 5) não é lida pelo shader e fica sem atributo
+		glVertexArrayAttribFormat(mVertexArray, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat(mVertexArray, 1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat));
+		glVertexArrayAttribFormat(mVertexArray, 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat));
+	}
+	for (GLuint attribute = 0; attribute < 3; attribute++)
+	{
+		glVertexArrayAttribBinding(mVertexArray, attribute, 0);
+		glEnableVertexArrayAttrib(mVertexArray, attribute);
+	}
+
+	reserve(mVertexBuffer, mVertexCapacity, 0, kInitialBytes);
+	reserve(mIndexBuffer, mIndexCapacity, 0, kInitialBytes);
+}
+
+void GeometryPool::destroy()
+{
+	if (mVertexArray)
+		glDeleteVertexArrays(1, &mVertexArray);
+	if (mVertexBuffer)
+		glDeleteBuffers(1, &mVertexBuffer);
+	if (mIndexBuffer)
+		glDeleteBuffers(1, &mIndexBuffer);
+	mVertexArray = mVertexBuffer = mIndexBuffer = 0;
+	mVertexCapacity = mVertexUsed = 0;
+	mIndexCapacity = mIndexUsed = mIndexWidened = 0;
+}
+
+void GeometryPool::reserve(GLuint& buffer, size_t& capacity, size_t used, size_t needed)
+{
+	if (buffer && needed <= capacity)
+		return;
+
+	size_t grown = std::max(capacity, kInitialBytes);
+	while (grown < needed)
+		grown *= 2;
+
+	GLuint replacement = 0;
+	glCreateBuffers(1, &replacement);
+	glNamedBufferData(replacement, grown, nullptr, GL_STATIC_DRAW);
+	if (buffer)
+	{
+		if (used)
+			glCopyNamedBufferSubData(buffer, replacement, 0, 0, used);
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = replacement;
+	capacity = grown;
+
+	// Só a ligação do VAO muda: o formato dos atributos é independente do buffer
+	glVertexArrayVertexBuffer(mVertexArray, 0, mVertexBuffer, 0, mStride);
+	glVertexArrayElementBuffer(mVertexArray, mIndexBuffer);
+}
+
+GeometryRange GeometryPool::add(const MeshCacheView& mesh)
+{
+	GeometryRange range;
+	if (mesh.header->vertexFormat != mFormat || mesh.header->vertexStride != mStride)
+	{
+		std::cout << "GeometryPool: malha com formato de vertice diferente do pool ignorada" << std::endl;
+		return range;
+	}
+
+	const size_t vertexBytes = mesh.vertexBytes();
+	const size_t indexCount = mesh.header->indexCount;
+	reserve(mVertexBuffer, mVertexCapacity, mVertexUsed, mVertexUsed + vertexBytes);
+	reserve(mIndexBuffer, mIndexCapacity, mIndexUsed, mIndexUsed + indexCount * sizeof(uint32_t));
+
+	range.firstIndex = static_cast<uint32_t>(mIndexUsed / sizeof(uint32_t));
+	range.baseVertex = static_cast<int32_t>(mVertexUsed / mStride);
+	range.indexCount = static_cast<uint32_t>(indexCount);
+	range.vertexCount = static_cast<uint32_t>(mesh.header->vertexCount);
+
+	if (vertexBytes)
+		glNamedBufferSubData(mVertexBuffer, mVertexUsed, vertexBytes, mesh.vertices);
+	if (indexCount)
+	{
+		if (mesh.header->indexSize == sizeof(uint32_t))
+		{
+			glNamedBufferSubData(mIndexBuffer, mIndexUsed, indexCount * sizeof(uint32_t), mesh.indices);
+		}
+		else
+		{
+			std::vector<uint32_t> widened(indexCount);
+			const uint16_t* narrow = static_cast<const uint16_t*>(mesh.indices);
+			std::copy(narrow, narrow + indexCount, widened.begin());
+			glNamedBufferSubData(mIndexBuffer, mIndexUsed, indexCount * sizeof(uint32_t), widened.data());
+			mIndexWidened += indexCount * (sizeof(uint32_t) - sizeof(uint16_t));
+		}
+	}
+
+	mVertexUsed += vertexBytes;
+	mIndexUsed += indexCount * sizeof(uint32_t);
+	return range;
+}
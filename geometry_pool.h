@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "mesh_cache.h"
+#include "vertex_format.h"
+
+// Posição de uma malha dentro do GeometryPool, nos termos de um DrawElementsIndirectCommand
+struct GeometryRange {
+	uint32_t firstIndex = 0;  // em índices, no buffer de índices do pool
+	int32_t baseVertex = 0;   // somado a cada índice (os índices da malha continuam locais)
+	uint32_t indexCount = 0;
+	uint32_t vertexCount = 0;
+};
+
+// Todas as malhas em um só par de buffers (vértices e índices) com um único VAO.
+//
+// Cada malha adicionada é copiada para o fim dos buffers, que crescem dobrando de tamanho
+// (cópia na GPU com glCopyNamedBufferSubData). O VAO usa o formato de vértice separado
+// (glVertexArrayAttribFormat), então trocar o buffer ao crescer só muda a ligação, e como
+// todas as malhas compartilham o VAO, desenhá-las não troca estado: é isso que permite um
+// único glMultiDrawElementsIndirect para a cena inteira.
+//
+// Todas as malhas do pool têm o mesmo formato de vértice. Os índices ficam em 32 bits
+// (os de 16 bits do cache são convertidos), já que um desenho indireto só tem um tipo; o
+// custo da conversão aparece em widenedIndexBytes().
+class GeometryPool
+{
+public:
+	void create(VertexFormat format);
+	void destroy();
+
+	// Copia vértices e índices do cache para o pool. Uma malha de outro formato de vértice
+	// não é adicionada (a faixa volta vazia).
+	GeometryRange add(const MeshCacheView& mesh);
+
+	GLuint vertexArray() const { return mVertexArray; }
+	VertexFormat format() const { return mFormat; }
+	size_t vertexBytes() const { return mVertexUsed; }
+	size_t indexBytes() const { return mIndexUsed; }
+	// Parte de indexBytes() que sobra por guardar em 32 bits os índices das malhas de 16 bits
+	size_t widenedIndexBytes() const { return mIndexWidened; }
+
+private:
+	// Garante 'needed' bytes no buffer, preservando os 'used' primeiros
+	void reserve(GLuint& buffer, size_t& capacity, size_t used, size_t needed);
+
+	VertexFormat mFormat = VERTEX_FORMAT_FLOAT;
+	GLuint mVertexArray = 0;
+	GLuint mVertexBuffer = 0;
+	GLuint mIndexBuffer = 0;
+	size_t mVertexCapacity = 0, mVertexUsed = 0; // em bytes
+	size_t mIndexCapacity = 0, mIndexUsed = 0;
+	size_t mIndexWidened = 0;
+	uint32_t mStride = 0;
+};
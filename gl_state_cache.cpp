@@ -0,0 +1,263 @@
+#include "gl_state_cache.h"
+
+#include <cstring>
+
+// GLM
+#include <glm/gtc/type_ptr.hpp>
+
+void GLStateCache::invalidate()
+{
+	mProgram = kUnknown;
+	mProgramState = nullptr;
+	mVertexArray = kUnknown;
+	mActiveUnit = kUnknown;
+	for (TextureBinding& binding : mTextures)
+		binding = TextureBinding();
+	mBuffers.clear();
+	mBufferBases.clear();
+	mBufferRanges.clear();
+	mCapabilities.clear();
+	for (float& c : mClearColor)
+		c = -1.0f;
+	mDepthMask = -1;
+	mBlendSource = kUnknown;
+	mBlendDestination = kUnknown;
+}
+
+void GLStateCache::beginFrame()
+{
+	mLastFrame = mFrame;
+	mFrame = GLCallCounters();
+}
+
+bool GLStateCache::changed(bool differs)
+{
+	if (differs)
+		mFrame.issued++;
+	else
+		mFrame.elided++;
+	return differs;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (!changed(program != mProgram))
+		return;
+	glUseProgram(program);
+	mProgram = program;
+	mProgramState = &mPrograms[program];
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+	if (!changed(vao != mVertexArray))
+		return;
+	glBindVertexArray(vao);
+	mVertexArray = vao;
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= static_cast<GLuint>(kTextureUnits))
+	{
+		changed(true);
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		mActiveUnit = unit;
+		return;
+	}
+
+	TextureBinding& binding = mTextures[unit];
+	if (binding.target == target && binding.texture == texture)
+	{
+		changed(false);
+		return;
+	}
+	if (changed(unit != mActiveUnit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		mActiveUnit = unit;
+	}
+	changed(true);
+	glBindTexture(target, texture);
+	binding.target = target;
+	binding.texture = texture;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		changed(true);
+		glBindBuffer(target, buffer);
+		return;
+	}
+	auto it = mBuffers.find(target);
+	if (!changed(it == mBuffers.end() || it->second != buffer))
+		return;
+	glBindBuffer(target, buffer);
+	mBuffers[target] = buffer;
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	uint64_t key = (static_cast<uint64_t>(target) << 32) | index;
+	auto it = mBufferBases.find(key);
+	if (!changed(it == mBufferBases.end() || it->second != buffer))
+		return;
+	glBindBufferBase(target, index, buffer);
+	mBufferBases[key] = buffer;
+	mBufferRanges.erase(key);
+	// glBindBufferBase também muda a ligação genérica do alvo
+	mBuffers[target] = buffer;
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, size_t offset, size_t size)
+{
+	uint64_t key = (static_cast<uint64_t>(target) << 32) | index;
+	auto it = mBufferRanges.find(key);
+	if (!changed(it == mBufferRanges.end() || it->second.buffer != buffer || it->second.offset != offset || it->second.size != size))
+		return;
+	glBindBufferRange(target, index, buffer, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+	BufferRange& range = mBufferRanges[key];
+	range.buffer = buffer;
+	range.offset = offset;
+	range.size = size;
+	mBufferBases.erase(key);
+	mBuffers[target] = buffer;
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+	auto it = mCapabilities.find(capability);
+	if (!changed(it == mCapabilities.end() || !it->second))
+		return;
+	glEnable(capability);
+	mCapabilities[capability] = true;
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+	auto it = mCapabilities.find(capability);
+	if (!changed(it == mCapabilities.end() || it->second))
+		return;
+	glDisable(capability);
+	mCapabilities[capability] = false;
+}
+
+void GLStateCache::clearColor(float r, float g, float b, float a)
+{
+	const float color[4] = { r, g, b, a };
+	if (!changed(memcmp(color, mClearColor, sizeof(color)) != 0))
+		return;
+	glClearColor(r, g, b, a);
+	memcpy(mClearColor, color, sizeof(color));
+}
+
+void GLStateCache::depthMask(bool write)
+{
+	if (!changed(mDepthMask != (write ? 1 : 0)))
+		return;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	mDepthMask = write ? 1 : 0;
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+	if (!changed(source != mBlendSource || destination != mBlendDestination))
+		return;
+	glBlendFunc(source, destination);
+	mBlendSource = source;
+	mBlendDestination = destination;
+}
+
+void GLStateCache::clear(GLbitfield mask)
+{
+	changed(true);
+	glClear(mask);
+}
+
+void GLStateCache::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+{
+	changed(true);
+	mFrame.draws++;
+	glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+void GLStateCache::drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, GLint baseVertex)
+{
+	changed(true);
+	mFrame.draws++;
+	glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, baseVertex);
+}
+
+void GLStateCache::multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+{
+	changed(true);
+	mFrame.draws++;
+	glMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+}
+
+GLint GLStateCache::uniformLocation(const char* name)
+{
+	if (!mProgramState)
+		return -1;
+	auto it = mProgramState->locations.find(name);
+	if (it != mProgramState->locations.end())
+	{
+		changed(false);
+		return it->second;
+	}
+	changed(true);
+	GLint location = glGetUniformLocation(mProgram, name);
+	mProgramState->locations.emplace(name, location);
+	return location;
+}
+
+bool GLStateCache::updateUniform(GLint location, const void* data, uint32_t size)
+{
+	// Uniform inexistente (ou otimizado pelo compilador): nada a enviar
+	if (location < 0 || !mProgramState)
+		return false;
+	UniformValue& value = mProgramState->values[location];
+	if (!changed(value.size != size || memcmp(value.data, data, size) != 0))
+		return false;
+	value.size = size;
+	memcpy(value.data, data, size);
+	return true;
+}
+
+void GLStateCache::setUniform(const char* name, GLint value)
+{
+	GLint location = uniformLocation(name);
+	if (updateUniform(location, &value, sizeof(value)))
+		glUniform1i(location, value);
+}
+
+void GLStateCache::setUniform(const char* name, float value)
+{
+	GLint location = uniformLocation(name);
+	if (updateUniform(location, &value, sizeof(value)))
+		glUniform1f(location, value);
+}
+
+void GLStateCache::setUniform(const char* name, const glm::vec3& value)
+{
+	GLint location = uniformLocation(name);
+	if (updateUniform(location, glm::value_ptr(value), sizeof(float) * 3))
+		glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void GLStateCache::setUniform(const char* name, const glm::mat3& value)
+{
+	GLint location = uniformLocation(name);
+	if (updateUniform(location, glm::value_ptr(value), sizeof(float) * 9))
+		glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void GLStateCache::setUniform(const char* name, const glm::mat4& value)
+{
+	GLint location = uniformLocation(name);
+	if (updateUniform(location, glm::value_ptr(value), sizeof(float) * 16))
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Chamadas ao GL feitas pelo cache em um quadro: enviadas ao driver e evitadas por
+// serem redundantes
+struct GLCallCounters {
+	size_t issued = 0;
+	size_t elided = 0;
+	size_t draws = 0; // chamadas de desenho (incluídas em issued)
+};
+
+// Cache do estado do OpenGL na frente das chamadas do laço de renderização. Guarda o
+// programa, VAO, texturas, buffers e capacidades ligados, e por programa as localizações
+// e os últimos valores dos uniforms, pulando as chamadas que não mudariam nada.
+//
+// O cache só conhece o que passa por ele: depois de código que muda esse estado direto
+// no GL (ex: criação de malhas e texturas), chame invalidate().
+class GLStateCache
+{
+public:
+	static const GLuint kUnknown = 0xFFFFFFFFu;
+
+	// Esquece o estado ligado (os valores dos uniforms continuam válidos: são do programa)
+	void invalidate();
+
+	// Fecha os contadores do quadro anterior e começa um novo
+	void beginFrame();
+	const GLCallCounters& frameCounters() const { return mFrame; }
+	const GLCallCounters& lastFrameCounters() const { return mLastFrame; }
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	// GL_ELEMENT_ARRAY_BUFFER faz parte do VAO e é sempre repassado
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, size_t offset, size_t size);
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void clearColor(float r, float g, float b, float a);
+	// glClear respeita a máscara: ligue a escrita de profundidade antes de limpar
+	void depthMask(bool write);
+	void blendFunc(GLenum source, GLenum destination);
+
+	// Nunca redundantes, só contadas
+	void clear(GLbitfield mask);
+	void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances);
+	void drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, GLint baseVertex);
+	// 'indirect' é o deslocamento no GL_DRAW_INDIRECT_BUFFER ligado
+	void multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+	// Localização do uniform no programa atual (glGetUniformLocation só na primeira vez)
+	GLint uniformLocation(const char* name);
+
+	// Uniforms do programa atual; valores iguais aos últimos enviados são ignorados
+	void setUniform(const char* name, GLint value);
+	void setUniform(const char* name, float value);
+	void setUniform(const char* name, const glm::vec3& value);
+	void setUniform(const char* name, const glm::mat3& value);
+	void setUniform(const char* name, const glm::mat4& value);
+
+private:
+	// Último valor enviado a uma localização, comparado byte a byte
+	struct UniformValue {
+		uint32_t size = 0;
+		uint32_t data[16];
+	};
+	struct ProgramState {
+		std::unordered_map<std::string, GLint> locations;
+		std::unordered_map<GLint, UniformValue> values;
+	};
+
+	// Retorna true se o valor mudou (e o guarda); false se a chamada pode ser evitada
+	bool updateUniform(GLint location, const void* data, uint32_t size);
+	bool changed(bool differs);
+
+	GLuint mProgram = kUnknown;
+	ProgramState* mProgramState = nullptr;
+	std::unordered_map<GLuint, ProgramState> mPrograms;
+
+	GLuint mVertexArray = kUnknown;
+	GLuint mActiveUnit = kUnknown;
+	struct TextureBinding {
+		GLenum target = 0;
+		GLuint texture = kUnknown;
+	};
+	static const int kTextureUnits = 32;
+	TextureBinding mTextures[kTextureUnits];
+	std::unordered_map<GLenum, GLuint> mBuffers;
+	std::unordered_map<uint64_t, GLuint> mBufferBases; // (alvo << 32) | índice
+	struct BufferRange {
+		GLuint buffer = kUnknown;
+		size_t offset = 0;
+		size_t size = 0;
+	};
+	std::unordered_map<uint64_t, BufferRange> mBufferRanges; // mesma chave; um ponto está em só um dos dois
+	std::unordered_map<GLenum, bool> mCapabilities;
+	float mClearColor[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+	int mDepthMask = -1; // -1: desconhecida
+	GLenum mBlendSource = kUnknown;
+	GLenum mBlendDestination = kUnknown;
+
+	GLCallCounters mFrame;
+	GLCallCounters mLastFrame;
+};
@@ -0,0 +1,183 @@
+#include "headless_context.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+
+// Prefere a plataforma "surfaceless" do Mesa (não precisa de X11/Wayland nem de /dev/dri)
+EGLDisplay openDisplay()
+{
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+	{
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+				return display;
+		}
+	}
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+		return display;
+	return EGL_NO_DISPLAY;
+}
+
+} // namespace
+#endif
+
+bool HeadlessContext::create(int width, int height)
+{
+#ifdef HAVE_EGL
+	EGLDisplay display = openDisplay();
+	if (display == EGL_NO_DISPLAY)
+	{
+		std::cout << "EGL: nenhum display disponivel" << std::endl;
+		return false;
+	}
+	mDisplay = display;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL: OpenGL desktop nao suportado" << std::endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttribs, &config, 1, &configCount);
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	// Sem config (ex: plataforma surfaceless) o contexto é criado sem nenhuma
+	EGLContext context = eglCreateContext(display, configCount > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cout << "EGL: nao foi possivel criar um contexto OpenGL 4.5 core" << std::endl;
+		destroy();
+		return false;
+	}
+	mContext = context;
+
+	// Sem superfície quando há EGL_KHR_surfaceless_context; senão, um pbuffer mínimo
+	// só para tornar o contexto corrente (o desenho vai sempre para o framebuffer próprio)
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		const EGLint pbufferAttribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+		EGLSurface surface = configCount > 0 ? eglCreatePbufferSurface(display, config, pbufferAttribs) : EGL_NO_SURFACE;
+		if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+		{
+			std::cout << "EGL: nao foi possivel ativar o contexto" << std::endl;
+			destroy();
+			return false;
+		}
+		mSurface = surface;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)getProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroy();
+		return false;
+	}
+
+	mWidth = width;
+	mHeight = height;
+	glGenRenderbuffers(1, &mColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, mColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &mDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &mFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Framebuffer offscreen incompleto" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+#else
+	(void)width;
+	(void)height;
+	std::cout << "Modo headless indisponivel: compilado sem EGL" << std::endl;
+	return false;
+#endif
+}
+
+void HeadlessContext::destroy()
+{
+#ifdef HAVE_EGL
+	if (mContext && mFramebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &mFramebuffer);
+		glDeleteRenderbuffers(1, &mColor);
+		glDeleteRenderbuffers(1, &mDepth);
+	}
+	if (mDisplay)
+	{
+		eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (mSurface)
+			eglDestroySurface(mDisplay, mSurface);
+		if (mContext)
+			eglDestroyContext(mDisplay, mContext);
+		eglTerminate(mDisplay);
+	}
+#endif
+	mDisplay = mContext = mSurface = nullptr;
+	mFramebuffer = mColor = mDepth = 0;
+	mWidth = mHeight = 0;
+}
+
+void HeadlessContext::readPixels(std::vector<uint8_t>& rgb) const
+{
+	const size_t stride = static_cast<size_t>(mWidth) * 3;
+	rgb.resize(stride * mHeight);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+
+	// O OpenGL devolve de baixo para cima
+	std::vector<uint8_t> row(stride);
+	for (int y = 0; y < mHeight / 2; y++)
+	{
+		uint8_t* top = &rgb[y * stride];
+		uint8_t* bottom = &rgb[(mHeight - 1 - y) * stride];
+		memcpy(row.data(), top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row.data(), stride);
+	}
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+#ifdef HAVE_EGL
+	return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+	(void)name;
+	return nullptr;
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// Contexto OpenGL sem janela, via EGL (pbuffer ou "surfaceless"), para rodar em máquinas
+// sem GPU/monitor com o Mesa llvmpipe. A renderização vai para um framebuffer próprio
+// (cor RGBA8 + profundidade) de width x height, que fica ligado após create().
+// Só disponível quando compilado com HAVE_EGL; caso contrário create() falha.
+class HeadlessContext
+{
+public:
+	HeadlessContext() = default;
+	~HeadlessContext() { destroy(); }
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// Cria o contexto (4.5 core), carrega as funções com a GLAD e cria o framebuffer
+	bool create(int width, int height);
+	void destroy();
+
+	int width() const { return mWidth; }
+	int height() const { return mHeight; }
+	GLuint framebuffer() const { return mFramebuffer; }
+
+	// Lê o framebuffer em RGB, 3 bytes por pixel, de cima para baixo
+	void readPixels(std::vector<uint8_t>& rgb) const;
+
+	// Equivalente ao glfwGetProcAddress para a GLAD
+	static void* getProcAddress(const char* name);
+
+private:
+	void* mDisplay = nullptr;
+	void* mContext = nullptr;
+	void* mSurface = nullptr;
+	GLuint mFramebuffer = 0;
+	GLuint mColor = 0;
+	GLuint mDepth = 0;
+	int mWidth = 0;
+	int mHeight = 0;
+};
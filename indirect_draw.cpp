@@ -0,0 +1,47 @@
+#include "indirect_draw.h"
+
+#include <cstring>
+
+bool IndirectDrawBuffer::supported()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	// O shader usa a extensão mesmo no 4.6 (#version 450), e drivers 4.6 a anunciam
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; i++)
+	{
+		const GLubyte* name = glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(reinterpret_cast<const char*>(name), "GL_ARB_shader_draw_parameters") == 0)
+			return major > 4 || (major == 4 && minor >= 3); // glMultiDrawElementsIndirect é do 4.3
+	}
+	return false;
+}
+
+void IndirectDrawBuffer::create(UploadRing& ring, GLuint drawDataBinding)
+{
+	mRing = &ring;
+	mDrawDataBinding = drawDataBinding;
+}
+
+void IndirectDrawBuffer::destroy()
+{
+	mRing = nullptr;
+	mCommands = mDraws = UploadAllocation();
+}
+
+void IndirectDrawBuffer::upload(const std::vector<DrawElementsIndirectCommand>& commands, const std::vector<DrawData>& draws, GLStateCache& state)
+{
+	// Comandos indiretos só precisam de alinhamento de 4 bytes
+	mCommands = mRing->allocate(commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(uint32_t));
+	if (!commands.empty() && mCommands.data)
+		memcpy(mCommands.data, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+
+	if (draws.empty())
+		return;
+	mDraws = mRing->allocate(draws.size() * sizeof(DrawData), mRing->storageAlignment());
+	if (mDraws.data)
+		memcpy(mDraws.data, draws.data(), draws.size() * sizeof(DrawData));
+	state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, mDrawDataBinding, mDraws.buffer, mDraws.offset, mDraws.size);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "gl_state_cache.h"
+#include "upload_ring.h"
+
+// Layout fixo do OpenGL para glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// Dados de um desenho lidos pelo shader em draws[drawBase + gl_DrawIDARB] (std430: só vec4)
+struct DrawData {
+	glm::vec4 boundsMin;    // xyz: dequantização dos vértices compactos
+	glm::vec4 boundsExtent;
+	glm::vec4 Ka;           // w: opacidade
+	glm::vec4 Kd;
+	glm::vec4 Ks;           // w: Ns
+};
+
+// Comandos de desenho indireto (GL_DRAW_INDIRECT_BUFFER) e os dados por desenho (SSBO) de
+// um quadro. Os dois são copiados para trechos do UploadRing, como as matrizes do
+// InstanceBuffer: o buffer de comandos é o do anel, e o deslocamento dos comandos do
+// quadro entra no parâmetro 'indirect' do desenho (commandOffset()).
+class IndirectDrawBuffer
+{
+public:
+	// O shader precisa de gl_DrawIDARB e gl_BaseInstanceARB (GL_ARB_shader_draw_parameters,
+	// ou OpenGL 4.6); sem eles o desenho indireto não tem como achar os seus dados
+	static bool supported();
+
+	// O SSBO dos dados por desenho fica no ponto de ligação 'drawDataBinding'
+	void create(UploadRing& ring, GLuint drawDataBinding);
+	void destroy();
+
+	// O SSBO dos dados é ligado por 'state', para o cache continuar sabendo o que está ligado
+	void upload(const std::vector<DrawElementsIndirectCommand>& commands, const std::vector<DrawData>& draws, GLStateCache& state);
+
+	// Buffer a ligar em GL_DRAW_INDIRECT_BUFFER e a posição do primeiro comando nele
+	GLuint commandBuffer() const { return mCommands.buffer; }
+	size_t commandOffset() const { return mCommands.offset; }
+
+private:
+	UploadRing* mRing = nullptr;
+	GLuint mDrawDataBinding = 0;
+	UploadAllocation mCommands;
+	UploadAllocation mDraws;
+};
@@ -0,0 +1,40 @@
+#include "instance_buffer.h"
+
+#include <cstring>
+
+void InstanceBuffer::create(UploadRing& ring, GLuint binding)
+{
+	mRing = &ring;
+	mBinding = binding;
+}
+
+void InstanceBuffer::destroy()
+{
+	mRing = nullptr;
+	mAllocation = UploadAllocation();
+	mCount = 0;
+}
+
+void InstanceBuffer::upload(const glm::mat4* models, size_t count, GLStateCache& state)
+{
+	glm::mat4* mapped = map(count);
+	if (mapped)
+		memcpy(mapped, models, count * sizeof(glm::mat4));
+	unmap(state);
+}
+
+glm::mat4* InstanceBuffer::map(size_t count)
+{
+	mCount = count;
+	if (count == 0)
+		return nullptr;
+	mAllocation = mRing->allocate(count * sizeof(glm::mat4), mRing->storageAlignment());
+	return static_cast<glm::mat4*>(mAllocation.data);
+}
+
+void InstanceBuffer::unmap(GLStateCache& state)
+{
+	// O mapeamento é coerente: basta ligar o trecho escrito
+	if (mCount)
+		state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, mBinding, mAllocation.buffer, mAllocation.offset, mAllocation.size);
+}
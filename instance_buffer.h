@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "gl_state_cache.h"
+#include "upload_ring.h"
+
+// Buffer de instâncias (SSBO) com uma matriz de modelo por objeto. O vertex shader
+// lê a matriz pelo gl_InstanceID, então um único glDrawElementsInstanced desenha
+// todos os objetos.
+//
+// As matrizes de cada quadro ficam num trecho do UploadRing, que já está mapeado: não há
+// glMapBufferRange nem orphaning por quadro, só a ligação do trecho ao SSBO.
+class InstanceBuffer
+{
+public:
+	// O trecho de cada quadro é ligado ao ponto 'binding' de GL_SHADER_STORAGE_BUFFER
+	void create(UploadRing& ring, GLuint binding);
+	void destroy();
+
+	// Substitui o conteúdo (cópia para o anel). A ligação passa por 'state', para o cache não
+	// ficar com uma visão velha do ponto de ligação
+	void upload(const glm::mat4* models, size_t count, GLStateCache& state);
+
+	// Alternativa ao upload: reserva espaço para 'count' matrizes para que quem as calcula
+	// escreva direto no anel. Retorna nullptr com 'count' 0; unmap() deve ser chamado antes
+	// de desenhar.
+	glm::mat4* map(size_t count);
+	void unmap(GLStateCache& state);
+
+	size_t count() const { return mCount; }
+
+private:
+	UploadRing* mRing = nullptr;
+	GLuint mBinding = 0;
+	UploadAllocation mAllocation;
+	size_t mCount = 0;
+};
@@ -0,0 +1,374 @@
+#include "job_system.h"
+#include "profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JOBS_SSE 1
+#endif
+
+namespace {
+
+// Tentativas de achar trabalho antes de um worker ocioso dormir
+const int kSpinsBeforeSleep = 64;
+
+// Sistema e worker da thread atual (a thread 0 é a que chamou create)
+thread_local const JobSystem* tSystem = nullptr;
+thread_local int tWorker = -1;
+
+inline void cpuPause()
+{
+#if defined(JOBS_SSE)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+} // namespace
+
+bool JobSystem::WorkDeque::push(Job* job)
+{
+	const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+	const int64_t top = mTop.load(std::memory_order_acquire);
+	if (bottom - top >= static_cast<int64_t>(mItems.size()))
+		return false;
+	mItems[bottom & (mItems.size() - 1)].store(job, std::memory_order_relaxed);
+	mBottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobSystem::WorkDeque::pop()
+{
+	// Reserva a posição de baixo antes de olhar o topo; a barreira ordena as duas coisas
+	// contra o steal(), que faz o inverso
+	const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+	mBottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = mTop.load(std::memory_order_relaxed);
+	if (top > bottom)
+	{
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job* job = mItems[bottom & (mItems.size() - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// Último item: disputa com quem rouba pelo topo
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobSystem::WorkDeque::steal()
+{
+	int64_t top = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = mBottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return nullptr;
+	Job* job = mItems[top & (mItems.size() - 1)].load(std::memory_order_relaxed);
+	if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+void JobSystem::create(unsigned threads)
+{
+	static_assert((kDequeCapacity & (kDequeCapacity - 1)) == 0, "a capacidade da deque precisa ser potência de 2");
+	mWorkerCount = threads > 0 ? threads : 1;
+	mDeques.reset(new WorkDeque[mWorkerCount]);
+	mQuit = false;
+	tSystem = this;
+	tWorker = 0;
+	for (unsigned w = 1; w < mWorkerCount; w++)
+		mThreads.emplace_back(&JobSystem::workerLoop, this, w);
+}
+
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mQuit = true;
+		mEpoch++;
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+	mThreads.clear();
+	mDeques.reset();
+	mWorkerCount = 0;
+	if (tSystem == this)
+	{
+		tSystem = nullptr;
+		tWorker = -1;
+	}
+}
+
+int JobSystem::currentWorker() const
+{
+	return tSystem == this ? tWorker : -1;
+}
+
+void JobSystem::submit(Job* job)
+{
+	if (mWorkerCount <= 1)
+	{
+		execute(job);
+		return;
+	}
+	const int worker = currentWorker();
+	if (worker >= 0)
+	{
+		if (!mDeques[worker].push(job))
+		{
+			execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mInjectedMutex);
+		mInjected.push_back(job);
+		mInjectedCount.fetch_add(1, std::memory_order_relaxed);
+		mInjectedTotal.fetch_add(1, std::memory_order_relaxed);
+	}
+	wake();
+}
+
+void JobSystem::wake()
+{
+	// Par da verificação do worker que vai dormir (workerLoop): ou ele vê a tarefa ao procurar
+	// de novo, ou esta leitura vê que ele está dormindo
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (mSleeping.load(std::memory_order_relaxed) == 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mEpoch++;
+	}
+	mWake.notify_one();
+}
+
+Job* JobSystem::findJob(int worker)
+{
+	if (worker >= 0)
+		if (Job* job = mDeques[worker].pop())
+			return job;
+
+	if (mInjectedCount.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(mInjectedMutex);
+		if (!mInjected.empty())
+		{
+			Job* job = mInjected.front();
+			mInjected.pop_front();
+			mInjectedCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	// Rouba das outras deques, começando pela vizinha
+	const unsigned start = worker >= 0 ? static_cast<unsigned>(worker) + 1 : 0;
+	for (unsigned i = 0; i < mWorkerCount; i++)
+	{
+		const unsigned victim = (start + i) % mWorkerCount;
+		if (static_cast<int>(victim) == worker)
+			continue;
+		if (Job* job = mDeques[victim].steal())
+		{
+			mStolen.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::execute(Job* job)
+{
+	// O contador é a última coisa tocada: depois dele quem espera pode liberar a tarefa
+	std::atomic<uint32_t>* counter = job->counter;
+	job->function(*job);
+	mExecuted.fetch_add(1, std::memory_order_relaxed);
+	if (counter)
+		counter->fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::runOne()
+{
+	if (mWorkerCount == 0)
+		return false;
+	Job* job = findJob(currentWorker());
+	if (!job)
+		return false;
+	execute(job);
+	return true;
+}
+
+void JobSystem::wait(const std::atomic<uint32_t>& counter)
+{
+	int idle = 0;
+	while (counter.load(std::memory_order_acquire) != 0)
+	{
+		if (runOne())
+		{
+			idle = 0;
+			continue;
+		}
+		// O que falta está rodando em outra thread
+		if (++idle < kSpinsBeforeSleep)
+			cpuPause();
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop(unsigned worker)
+{
+	tSystem = this;
+	tWorker = static_cast<int>(worker);
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mThreadNames.push_back("job " + std::to_string(worker));
+		profilerSetThreadName(mThreadNames.back().c_str());
+	}
+
+	int idle = 0;
+	for (;;)
+	{
+		if (Job* job = findJob(static_cast<int>(worker)))
+		{
+			execute(job);
+			idle = 0;
+			continue;
+		}
+		if (++idle < kSpinsBeforeSleep)
+		{
+			cpuPause();
+			continue;
+		}
+		idle = 0;
+
+		// Anuncia que vai dormir e procura mais uma vez: um envio feito antes disso é achado
+		// agora, e um feito depois vê mSleeping e muda a época
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		if (mQuit)
+			return;
+		const uint64_t epoch = mEpoch;
+		mSleeping.fetch_add(1, std::memory_order_seq_cst);
+		lock.unlock();
+		Job* job = findJob(static_cast<int>(worker));
+		if (job)
+		{
+			mSleeping.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			continue;
+		}
+		lock.lock();
+		mWake.wait(lock, [&]() { return mEpoch != epoch || mQuit; });
+		mSleeping.fetch_sub(1, std::memory_order_relaxed);
+		if (mQuit)
+			return;
+	}
+}
+
+JobStats JobSystem::stats() const
+{
+	JobStats stats;
+	stats.executed = mExecuted.load(std::memory_order_relaxed);
+	stats.stolen = mStolen.load(std::memory_order_relaxed);
+	stats.injected = mInjectedTotal.load(std::memory_order_relaxed);
+	return stats;
+}
+
+uint32_t JobGraph::add(const char* name, std::function<void()> function, bool mainThread)
+{
+	const uint32_t index = static_cast<uint32_t>(mNodes.size());
+	std::unique_ptr<Node> node(new Node());
+	node->name = name;
+	node->function = std::move(function);
+	node->mainThread = mainThread;
+	node->job.function = &JobGraph::runNode;
+	node->job.data = this;
+	node->job.begin = index;
+	mNodes.push_back(std::move(node));
+	return index;
+}
+
+void JobGraph::depend(uint32_t node, uint32_t dependency)
+{
+	mNodes[dependency]->successors.push_back(node);
+	mNodes[node]->dependencies++;
+}
+
+void JobGraph::run(JobSystem& jobs)
+{
+	mJobs = &jobs;
+	mStart = profilerNow();
+	mTimings.resize(mNodes.size());
+	mMainReady.clear();
+	mMainReadyCount.store(0, std::memory_order_relaxed);
+	for (const std::unique_ptr<Node>& node : mNodes)
+		node->pending.store(node->dependencies, std::memory_order_relaxed);
+	mRemaining.store(static_cast<uint32_t>(mNodes.size()), std::memory_order_release);
+
+	for (uint32_t i = 0; i < mNodes.size(); i++)
+		if (mNodes[i]->dependencies == 0)
+			ready(i);
+
+	// Nós da thread principal primeiro; no resto do tempo ajuda nos outros
+	while (mRemaining.load(std::memory_order_acquire) != 0)
+	{
+		if (mMainReadyCount.load(std::memory_order_acquire) > 0)
+		{
+			uint32_t node;
+			{
+				std::lock_guard<std::mutex> lock(mMainMutex);
+				node = mMainReady.back();
+				mMainReady.pop_back();
+				mMainReadyCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+			runNode(mNodes[node]->job);
+			continue;
+		}
+		if (!jobs.runOne())
+			std::this_thread::yield();
+	}
+}
+
+void JobGraph::ready(uint32_t index)
+{
+	Node& node = *mNodes[index];
+	if (node.mainThread)
+	{
+		std::lock_guard<std::mutex> lock(mMainMutex);
+		mMainReady.push_back(index);
+		mMainReadyCount.fetch_add(1, std::memory_order_release);
+		return;
+	}
+	mJobs->submit(&node.job);
+}
+
+void JobGraph::runNode(const Job& job)
+{
+	JobGraph& graph = *static_cast<JobGraph*>(job.data);
+	const uint32_t index = static_cast<uint32_t>(job.begin);
+	Node& node = *graph.mNodes[index];
+
+	const int64_t start = profilerNow();
+	node.function();
+	const int64_t end = profilerNow();
+	if (profilerEnabled())
+		profilerRecord(node.name, start, end);
+	JobTiming& timing = graph.mTimings[index];
+	timing.name = node.name;
+	timing.startMs = (start - graph.mStart) * 1e-6;
+	timing.ms = (end - start) * 1e-6;
+	timing.worker = graph.mJobs->currentWorker();
+
+	for (uint32_t successor : node.successors)
+		if (graph.mNodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			graph.ready(successor);
+	graph.mRemaining.fetch_sub(1, std::memory_order_acq_rel);
+}
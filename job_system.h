@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tarefa: chama function(job) e decrementa 'counter' (se houver) no fim. Quem cria a tarefa
+// mantém a memória dela (e do que 'data' aponta) viva até o contador zerar
+struct Job {
+	void (*function)(const Job& job) = nullptr;
+	void* data = nullptr;
+	size_t begin = 0, end = 0;
+	std::atomic<uint32_t>* counter = nullptr;
+};
+
+struct JobStats {
+	uint64_t executed = 0; // tarefas executadas (total)
+	uint64_t stolen = 0;   // das quais vieram da fila de outra thread
+	uint64_t injected = 0; // enviadas por threads de fora do sistema (ex: a simulação)
+};
+
+// Sistema de tarefas com roubo de trabalho.
+//
+// A thread que chama create() é o worker 0; as outras threads-1 são criadas aqui. Cada worker
+// tem uma deque Chase-Lev sem travas: o dono empilha e desempilha numa ponta (LIFO, a tarefa
+// mais recente ainda está no cache) e os outros roubam da ponta oposta (as mais antigas, em
+// geral os maiores pedaços de trabalho). Threads de fora (a da simulação) enviam por uma fila
+// comum com trava. Worker sem trabalho tenta roubar por um tempo e depois dorme até o próximo
+// envio.
+//
+// Esperar (wait, parallelFor) nunca bloqueia a thread: enquanto o contador não zera ela executa
+// outras tarefas, então tarefas podem criar e esperar subtarefas sem risco de deadlock.
+class JobSystem
+{
+public:
+	// Tarefas por deque; com a deque cheia a tarefa roda na hora, na thread que a enviou
+	static const size_t kDequeCapacity = 4096;
+
+	~JobSystem() { destroy(); }
+
+	// 'threads' conta a thread chamadora; 1 (ou sem create) executa tudo na hora
+	void create(unsigned threads);
+	void destroy();
+
+	unsigned workerCount() const { return mWorkerCount; }
+	// Worker da thread atual, ou -1 numa thread de fora do sistema
+	int currentWorker() const;
+
+	void submit(Job* job);
+	// Executa tarefas até 'counter' zerar
+	void wait(const std::atomic<uint32_t>& counter);
+	// Executa uma tarefa pendente, se houver
+	bool runOne();
+
+	// function(begin, end) para faixas de no máximo 'grain' elementos de [0, count), em
+	// paralelo; retorna quando todas terminam. A primeira faixa roda na thread chamadora
+	template <typename Function>
+	void parallelFor(size_t count, size_t grain, const Function& function)
+	{
+		if (count == 0)
+			return;
+		grain = grain ? grain : 1;
+		const size_t chunks = (count + grain - 1) / grain;
+		if (chunks == 1 || mWorkerCount <= 1)
+		{
+			function(size_t(0), count);
+			return;
+		}
+		std::vector<Job> jobs(chunks - 1);
+		std::atomic<uint32_t> pending(static_cast<uint32_t>(chunks - 1));
+		for (size_t c = 1; c < chunks; c++)
+		{
+			Job& job = jobs[c - 1];
+			job.function = &invokeRange<Function>;
+			job.data = const_cast<Function*>(&function);
+			job.begin = c * grain;
+			job.end = std::min(count, (c + 1) * grain);
+			job.counter = &pending;
+			submit(&job);
+		}
+		function(size_t(0), std::min(count, grain));
+		wait(pending);
+	}
+
+	JobStats stats() const;
+
+private:
+	// Deque de Chase-Lev (versão de Lê et al. para o modelo de memória do C11), capacidade fixa
+	class alignas(64) WorkDeque
+	{
+	public:
+		WorkDeque() : mItems(kDequeCapacity) {}
+		bool push(Job* job);  // só o dono; false se cheia
+		Job* pop();           // só o dono
+		Job* steal();         // qualquer thread
+	private:
+		alignas(64) std::atomic<int64_t> mTop{ 0 };
+		alignas(64) std::atomic<int64_t> mBottom{ 0 };
+		std::vector<std::atomic<Job*>> mItems;
+	};
+
+	template <typename Function>
+	static void invokeRange(const Job& job)
+	{
+		(*static_cast<const Function*>(job.data))(job.begin, job.end);
+	}
+
+	Job* findJob(int worker);
+	void execute(Job* job);
+	void workerLoop(unsigned worker);
+	void wake();
+
+	unsigned mWorkerCount = 0;
+	std::unique_ptr<WorkDeque[]> mDeques;
+	std::vector<std::thread> mThreads;
+	std::deque<std::string> mThreadNames; // nomes no profiler (precisam viver até o fim)
+
+	std::mutex mInjectedMutex;
+	std::deque<Job*> mInjected;
+	std::atomic<size_t> mInjectedCount{ 0 };
+
+	std::mutex mSleepMutex;
+	std::condition_variable mWake;
+	std::atomic<unsigned> mSleeping{ 0 };
+	uint64_t mEpoch = 0; // muda a cada envio com alguém dormindo (protegido por mSleepMutex)
+	bool mQuit = false;
+
+	std::atomic<uint64_t> mExecuted{ 0 };
+	std::atomic<uint64_t> mStolen{ 0 };
+	std::atomic<uint64_t> mInjectedTotal{ 0 };
+};
+
+struct JobTiming {
+	const char* name;
+	double startMs;  // desde o início de run()
+	double ms;
+	int worker;      // -1: thread de fora do sistema
+};
+
+// Grafo de tarefas de um quadro: montado uma vez e executado a cada quadro com run().
+//
+// Cada nó roda quando todos os nós de que depende terminaram. Nós marcados 'mainThread' (os
+// que chamam a GL, ou reservam no UploadRing) só rodam na thread que chamou run(); os outros em
+// qualquer worker, e podem usar parallelFor por dentro. O tempo de cada nó no último run() fica
+// em timings(), e cada nó também vira um evento do profiler na thread em que rodou.
+class JobGraph
+{
+public:
+	uint32_t add(const char* name, std::function<void()> function, bool mainThread = false);
+	// 'node' só começa depois que 'dependency' termina
+	void depend(uint32_t node, uint32_t dependency);
+
+	void run(JobSystem& jobs);
+
+	const std::vector<JobTiming>& timings() const { return mTimings; }
+	size_t size() const { return mNodes.size(); }
+
+private:
+	struct Node {
+		const char* name;
+		std::function<void()> function;
+		bool mainThread;
+		std::vector<uint32_t> successors;
+		uint32_t dependencies = 0;
+		std::atomic<uint32_t> pending{ 0 };
+		Job job;
+	};
+
+	static void runNode(const Job& job);
+	void ready(uint32_t node);
+
+	std::vector<std::unique_ptr<Node>> mNodes;
+	JobSystem* mJobs = nullptr;
+	std::atomic<uint32_t> mRemaining{ 0 };
+	std::mutex mMainMutex;
+	std::vector<uint32_t> mMainReady;       // nós de thread principal prontos
+	std::atomic<size_t> mMainReadyCount{ 0 };
+	int64_t mStart = 0;
+	std::vector<JobTiming> mTimings;
+};
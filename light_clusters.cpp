@@ -0,0 +1,232 @@
+#include "light_clusters.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHTS_SSE 1
+#endif
+
+static_assert(LightClusters::kClustersX % 4 == 0, "os testes SSE cobrem 4 clusters de uma linha por vez");
+static_assert(LightClusters::kClustersX <= 256 && LightClusters::kClustersY <= 256 && LightClusters::kClustersZ <= 256,
+	"as faixas de clusters das luzes são guardadas em uint8_t");
+
+namespace {
+
+// Tile (0..tiles-1) que contém a coordenada normalizada 'ndc' (-1..1)
+uint8_t tileOf(float ndc, uint32_t tiles)
+{
+	const float t = std::floor((ndc + 1.0f) * 0.5f * tiles);
+	return static_cast<uint8_t>(std::min(std::max(t, 0.0f), static_cast<float>(tiles - 1)));
+}
+
+// Faixa em coordenadas normalizadas de [center - radius, center + radius] projetado pelas
+// profundidades [nearDepth, farDepth]: a/d é monotônico em d para 'a' de sinal fixo, então
+// os extremos estão nas pontas
+void projectedRange(float center, float radius, float scale, float nearDepth, float farDepth, float& lo, float& hi)
+{
+	const float a = (center - radius) * scale, b = (center + radius) * scale;
+	lo = std::min(a / nearDepth, a / farDepth);
+	hi = std::max(b / nearDepth, b / farDepth);
+}
+
+} // namespace
+
+void LightClusters::setProjection(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	if (projection == mProjection && nearPlane == mNear && farPlane == mFar)
+		return;
+	mProjection = projection;
+	mNear = nearPlane;
+	mFar = farPlane;
+
+	const float logRatio = std::log(farPlane / nearPlane);
+	mSliceScale = kClustersZ / logRatio;
+	mSliceBias = -static_cast<float>(kClustersZ) * std::log(nearPlane) / logRatio;
+
+	mMinX.resize(kClusterCount);
+	mMinY.resize(kClusterCount);
+	mMinZ.resize(kClusterCount);
+	mMaxX.resize(kClusterCount);
+	mMaxY.resize(kClusterCount);
+	mMaxZ.resize(kClusterCount);
+	const float invX = 1.0f / projection[0][0], invY = 1.0f / projection[1][1];
+	for (uint32_t z = 0; z < kClustersZ; z++)
+	{
+		// Fatias exponenciais: profundidade d_k = near * (far / near)^(k / Z)
+		const float d0 = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / kClustersZ);
+		const float d1 = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z + 1) / kClustersZ);
+		for (uint32_t y = 0; y < kClustersY; y++)
+		{
+			const float ny0 = -1.0f + 2.0f * y / kClustersY, ny1 = -1.0f + 2.0f * (y + 1) / kClustersY;
+			for (uint32_t x = 0; x < kClustersX; x++)
+			{
+				const float nx0 = -1.0f + 2.0f * x / kClustersX, nx1 = -1.0f + 2.0f * (x + 1) / kClustersX;
+				// Caixa do tronco de pirâmide: as bordas do tile nas duas profundidades da fatia
+				const uint32_t c = x + kClustersX * (y + kClustersY * z);
+				mMinX[c] = std::min(nx0 * d0, nx0 * d1) * invX;
+				mMaxX[c] = std::max(nx1 * d0, nx1 * d1) * invX;
+				mMinY[c] = std::min(ny0 * d0, ny0 * d1) * invY;
+				mMaxY[c] = std::max(ny1 * d0, ny1 * d1) * invY;
+				mMinZ[c] = -d1;
+				mMaxZ[c] = -d0;
+			}
+		}
+	}
+}
+
+uint32_t LightClusters::sliceOf(float depth) const
+{
+	if (depth <= mNear)
+		return 0;
+	const float slice = std::floor(std::log(depth) * mSliceScale + mSliceBias);
+	return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(kClustersZ - 1)));
+}
+
+glm::vec4 LightClusters::shaderParams(int width, int height) const
+{
+	return glm::vec4(static_cast<float>(width) / kClustersX, static_cast<float>(height) / kClustersY, mSliceScale, mSliceBias);
+}
+
+void LightClusters::assign(const PointLight* lights, size_t count, const glm::mat4& view, JobSystem& jobs)
+{
+	PROFILE_SCOPE("assignLights");
+	auto start = std::chrono::steady_clock::now();
+	mStats = LightClusterStats();
+	mStats.lights = count;
+
+	// Espaço da câmera e faixa conservadora de clusters de cada luz; as que não alcançam o
+	// frustum ficam de fora
+	mRanges.clear();
+	const float scaleX = mProjection[0][0], scaleY = mProjection[1][1];
+	for (size_t i = 0; i < count; i++)
+	{
+		const PointLight& light = lights[i];
+		const glm::vec4 center = view * glm::vec4(light.position, 1.0f);
+		const float depth = -center.z, radius = light.radius;
+		if (radius <= 0.0f || depth + radius < mNear || depth - radius > mFar)
+			continue;
+		const float nearDepth = std::max(depth - radius, mNear), farDepth = std::min(depth + radius, mFar);
+		float loX, hiX, loY, hiY;
+		projectedRange(center.x, radius, scaleX, nearDepth, farDepth, loX, hiX);
+		projectedRange(center.y, radius, scaleY, nearDepth, farDepth, loY, hiY);
+		if (loX > 1.0f || hiX < -1.0f || loY > 1.0f || hiY < -1.0f)
+			continue;
+
+		LightRange range;
+		range.x = center.x;
+		range.y = center.y;
+		range.z = center.z;
+		range.radius = radius;
+		range.light = static_cast<uint32_t>(i);
+		range.x0 = tileOf(loX, kClustersX);
+		range.x1 = tileOf(hiX, kClustersX);
+		range.y0 = tileOf(loY, kClustersY);
+		range.y1 = tileOf(hiY, kClustersY);
+		range.z0 = static_cast<uint8_t>(sliceOf(nearDepth));
+		range.z1 = static_cast<uint8_t>(sliceOf(farDepth));
+		mRanges.push_back(range);
+	}
+	mStats.visibleLights = mRanges.size();
+
+	// Faixas contíguas de fatias por tarefa
+	const unsigned threads = jobs.workerCount();
+	const unsigned workers = (count >= kParallelThreshold && threads > 1) ? (threads < kClustersZ ? threads : kClustersZ) : 1;
+	mWorkers.resize(workers);
+	mClusters.resize(2 * kClusterCount);
+	for (unsigned t = 0; t < workers; t++)
+	{
+		mWorkers[t].firstSlice = kClustersZ * t / workers;
+		mWorkers[t].lastSlice = kClustersZ * (t + 1) / workers;
+	}
+	jobs.parallelFor(workers, 1, [this](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++)
+			assignSlices(mWorkers[t]);
+	});
+
+	// Compactação: as listas de cada tarefa vão em sequência, deslocadas pelo que veio antes
+	mIndices.clear();
+	for (const SliceWorker& worker : mWorkers)
+	{
+		const uint32_t base = static_cast<uint32_t>(mIndices.size());
+		const uint32_t first = worker.firstSlice * kClustersX * kClustersY, last = worker.lastSlice * kClustersX * kClustersY;
+		for (uint32_t c = first; c < last; c++)
+		{
+			mClusters[2 * c] += base;
+			const uint32_t lightCount = mClusters[2 * c + 1];
+			if (lightCount)
+				mStats.usedClusters++;
+			mStats.maxPerCluster = std::max<size_t>(mStats.maxPerCluster, lightCount);
+		}
+		mIndices.insert(mIndices.end(), worker.indices.begin(), worker.indices.end());
+	}
+	mStats.references = mIndices.size();
+	mStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::assignSlices(SliceWorker& worker)
+{
+	const uint32_t tiles = kClustersX * kClustersY;
+	worker.buckets.resize(tiles);
+	worker.indices.clear();
+	for (uint32_t z = worker.firstSlice; z < worker.lastSlice; z++)
+	{
+		for (std::vector<uint32_t>& bucket : worker.buckets)
+			bucket.clear();
+
+		for (const LightRange& range : mRanges)
+		{
+			if (z < range.z0 || z > range.z1)
+				continue;
+			const float r2 = range.radius * range.radius;
+			for (uint32_t y = range.y0; y <= range.y1; y++)
+			{
+				const uint32_t row = kClustersX * (y + kClustersY * z);
+#if defined(LIGHTS_SSE)
+				// Distância da esfera às caixas de 4 clusters da linha: max(min - c, c - max, 0) por eixo
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 cx = _mm_set1_ps(range.x), cy = _mm_set1_ps(range.y), cz = _mm_set1_ps(range.z);
+				const __m128 radius2 = _mm_set1_ps(r2);
+				for (uint32_t x = range.x0 & ~3u; x <= range.x1; x += 4)
+				{
+					const uint32_t c = row + x;
+					__m128 dx = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinX[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&mMaxX[c])));
+					__m128 dy = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinY[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&mMaxY[c])));
+					__m128 dz = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinZ[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&mMaxZ[c])));
+					dx = _mm_max_ps(dx, zero);
+					dy = _mm_max_ps(dy, zero);
+					dz = _mm_max_ps(dz, zero);
+					const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					const int bits = _mm_movemask_ps(_mm_cmple_ps(d2, radius2));
+					for (uint32_t lane = 0; lane < 4; lane++)
+						if ((bits & (1 << lane)) && x + lane >= range.x0 && x + lane <= range.x1)
+							worker.buckets[y * kClustersX + x + lane].push_back(range.light);
+				}
+#else
+				for (uint32_t x = range.x0; x <= range.x1; x++)
+				{
+					const uint32_t c = row + x;
+					const float dx = std::max(std::max(mMinX[c] - range.x, range.x - mMaxX[c]), 0.0f);
+					const float dy = std::max(std::max(mMinY[c] - range.y, range.y - mMaxY[c]), 0.0f);
+					const float dz = std::max(std::max(mMinZ[c] - range.z, range.z - mMaxZ[c]), 0.0f);
+					if (dx * dx + dy * dy + dz * dz <= r2)
+						worker.buckets[y * kClustersX + x].push_back(range.light);
+				}
+#endif
+			}
+		}
+
+		// Listas da fatia na ordem dos clusters, com o início relativo às listas da tarefa
+		for (uint32_t tile = 0; tile < tiles; tile++)
+		{
+			const std::vector<uint32_t>& bucket = worker.buckets[tile];
+			const uint32_t c = tile + tiles * z;
+			mClusters[2 * c] = static_cast<uint32_t>(worker.indices.size());
+			mClusters[2 * c + 1] = static_cast<uint32_t>(bucket.size());
+			worker.indices.insert(worker.indices.end(), bucket.begin(), bucket.end());
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+
+// GLM
+#include <glm/glm.hpp>
+
+// Luz pontual no mundo. O layout é o do struct PointLight do fragment shader em std430
+// (vec3 + float, vec3 + float), então o array vai para o SSBO sem conversão
+struct PointLight {
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 1.0f;     // alcance: a contribuição chega a zero nesta distância
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 1.0f;
+};
+
+struct LightClusterStats {
+	size_t lights = 0;         // luzes recebidas
+	size_t visibleLights = 0;  // que tocam o frustum e entraram em algum cluster
+	size_t references = 0;     // entradas nas listas (soma das luzes de todos os clusters)
+	size_t usedClusters = 0;   // clusters com pelo menos uma luz
+	size_t maxPerCluster = 0;  // maior lista
+	double milliseconds = 0.0; // atribuição inteira (transformação, testes e compactação)
+};
+
+// Iluminação por clusters: o frustum é dividido numa grade de kClustersX x kClustersY tiles
+// na tela por kClustersZ fatias de profundidade (exponenciais entre os planos próximo e
+// distante, para que os clusters tenham forma parecida em qualquer distância). A cada quadro
+// as luzes são distribuídas nos clusters que suas esferas tocam, e o fragment shader percorre
+// só a lista do seu cluster: o custo por pixel depende das luzes próximas dele, não do total.
+//
+// A atribuição roda na CPU. Cada luz é levada ao espaço da câmera e ganha a faixa conservadora
+// de tiles e fatias que a esfera pode cobrir; dentro dela a esfera é testada contra as caixas
+// dos clusters, 4 clusters vizinhos por vez (SSE). As fatias são repartidas entre tarefas do
+// JobSystem em faixas contíguas, e como o índice do cluster tem a fatia como eixo mais lento,
+// cada tarefa produz um trecho contíguo das listas: a compactação final só soma os deslocamentos.
+//
+// Saída no formato dos SSBOs: clusters() com (primeiro, contagem) por cluster e indices() com
+// as listas de luzes, concatenadas na ordem dos clusters.
+class LightClusters
+{
+public:
+	static const uint32_t kClustersX = 16;
+	static const uint32_t kClustersY = 16;
+	static const uint32_t kClustersZ = 24;
+	static const uint32_t kClusterCount = kClustersX * kClustersY * kClustersZ;
+	// Abaixo disto a atribuição fica numa tarefa só
+	static const size_t kParallelThreshold = 256;
+
+	// Projeção em perspectiva simétrica (glm::perspective); recalcula as caixas dos clusters só
+	// quando a projeção ou os planos mudam
+	void setProjection(const glm::mat4& projection, float nearPlane, float farPlane);
+
+	// Distribui as luzes (no mundo) nos clusters da câmera 'view'
+	void assign(const PointLight* lights, size_t count, const glm::mat4& view, JobSystem& jobs);
+
+	// Índice do cluster = x + kClustersX * (y + kClustersY * fatia); dois uint por cluster
+	const std::vector<uint32_t>& clusters() const { return mClusters; }
+	const std::vector<uint32_t>& indices() const { return mIndices; }
+
+	// Para o shader: tamanho do tile em pixels (xy) e escala e viés de log(profundidade) que
+	// dão a fatia (zw)
+	glm::vec4 shaderParams(int width, int height) const;
+	const LightClusterStats& stats() const { return mStats; }
+
+private:
+	// Luz no espaço da câmera e a faixa de clusters que a esfera pode tocar (inclusive)
+	struct LightRange {
+		float x, y, z, radius;
+		uint32_t light;
+		uint8_t x0, x1, y0, y1, z0, z1;
+	};
+
+	// Listas das fatias de uma tarefa antes da compactação
+	struct SliceWorker {
+		std::vector<std::vector<uint32_t>> buckets; // um por tile da fatia em andamento
+		std::vector<uint32_t> indices;
+		uint32_t firstSlice = 0, lastSlice = 0;
+	};
+
+	uint32_t sliceOf(float depth) const;
+	void assignSlices(SliceWorker& worker);
+
+	glm::mat4 mProjection = glm::mat4(0.0f);
+	float mNear = 0.0f, mFar = 0.0f;
+	float mSliceScale = 0.0f; // fatia = log(profundidade) * escala + viés
+	float mSliceBias = 0.0f;
+
+	// Caixas dos clusters no espaço da câmera (SoA, na ordem dos índices)
+	std::vector<float> mMinX, mMinY, mMinZ, mMaxX, mMaxY, mMaxZ;
+
+	std::vector<LightRange> mRanges;
+	std::vector<SliceWorker> mWorkers;
+	std::vector<uint32_t> mClusters;
+	std::vector<uint32_t> mIndices;
+	LightClusterStats mStats;
+};
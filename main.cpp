@@ -5,8 +5,19 @@
 #include <sstream>
 #include <vector>
 #include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
 
 using namespace std;
+namespace fs = std::filesystem;
 
 // STB_IMAGE
 #define STB_IMAGE_IMPLEMENTATION
@@ -23,12 +34,47 @@ using namespace std;
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "obj_parser.h"
+#include "material.h"
+#include "mesh_builder.h"
+#include "mesh_cache.h"
+#include "mesh_lod.h"
+#include "vertex_format.h"
+#include "instance_buffer.h"
+#include "animation.h"
+#include "headless_context.h"
+#include "frame_timing.h"
+#include "frame_capture.h"
+#include "profiler.h"
+#include "gl_state_cache.h"
+#include "texture_streamer.h"
+#include "shader_manager.h"
+#include "culling.h"
+#include "draw_queue.h"
+#include "geometry_pool.h"
+#include "indirect_draw.h"
+#include "upload_ring.h"
+#include "simulation.h"
+#include "software_rasterizer.h"
+#include "light_clusters.h"
+#include "job_system.h"
+#include "asset_cache.h"
+#include "scene.h"
+#include "trajectory.h"
+
 std::vector<glm::vec3> pontos;
-size_t ponto_atual = 0;
-float tempo_percorrido = 0.0f;
+const Trajectory* trajetoria = nullptr; // no lugar dos pontos, com --path arquivo.traj
 const float duracao_ponto = 2.0f; // duração de cada translação entre pontos em segundos
 
-void carregarPontos(const std::string& caminho) {
+// Objetos que percorrem o caminho de pontos (estado em SoA, avaliado em lote)
+AnimationSystem animation;
+const float espacamento_objetos = 3.0f; // distância entre objetos vizinhos na grade
+
+// Malhas, materiais, texturas e caminhos: cada conteúdo distinto é carregado uma vez e
+// compartilhado por todos os objetos que o citam
+AssetCache assets;
+
+void carregarPontos(const std::string& caminho, std::vector<glm::vec3>& destino = pontos) {
 	std::ifstream arquivo(caminho);
 	if (!arquivo.is_open()) {
 		std::cerr << "Erro ao abrir o arquivo de pontos: " << caminho << std::endl;
@@ -40,7 +86,7 @@ void carregarPontos(const std::string& caminho) {
 		std::istringstream iss(linha);
 		float x, y, z;
 		if (iss >> x >> y >> z) {
-			pontos.emplace_back(x, y, z);
+			destino.emplace_back(x, y, z);
 		}
 	}
 	arquivo.close();
@@ -50,47 +96,373 @@ glm::vec3 interpolar(const glm::vec3& ponto_inicial, const glm::vec3& ponto_fina
 	return ponto_inicial + t * (ponto_final - ponto_inicial);
 }
 
-struct Material {
-	glm::vec3 Ka; // Ambient reflectivity
-	glm::vec3 Kd; // Diffuse reflectivity
-	glm::vec3 Ks; // Specular reflectivity
-	glm::vec3 Ke; // Emissive coefficient
-	float Ns;     // Specular exponent
-	float Ni;     // Optical density
-	float d;      // Transparency
-	int illum;    // Illumination model
-	std::string map_Kd; // Diffuse texture map
+// Distribui os objetos numa grade no plano XZ, à frente da câmera, cada um começando
+// em um trecho diferente do caminho. O objeto 0 fica na origem, como na cena original.
+// Com uma trajetória, os objetos seguem os tempos dela, com as fases espalhadas pela gravação.
+void criarObjetos(AnimationSystem& sistema, size_t quantidade, InterpolationMode modo) {
+	sistema.clear();
+	uint32_t caminho = trajetoria ? sistema.addTrajectory(*trajetoria) : sistema.addPath(buildAnimationPath(pontos, modo, duracao_ponto));
+	size_t lado = (size_t)ceil(sqrt((double)quantidade));
+	for (size_t i = 0; i < quantidade; i++) {
+		float coluna = (float)(i % lado) - (float)((lado - 1) / 2);
+		float linha = (float)(i / lado);
+		glm::vec3 offset(coluna * espacamento_objetos, 0.0f, -linha * espacamento_objetos);
+		float fase = trajetoria ? (float)(trajetoria->duration() * i / quantidade)
+			: (i % pontos.size()) * duracao_ponto + fmod(i * 0.137f, duracao_ponto);
+		sistema.addObject(caminho, offset, fase);
+	}
+}
+
+// Objetos de uma cena (--scene). Cada arquivo de pontos ou trajetória distinto vira um caminho só;
+// os objetos sem caminho (ou com um arquivo sem pontos) ficam parados, num caminho de um ponto na origem.
+// A animação guarda os objetos por caminho, na ordem em que os caminhos aparecem: eles são
+// adicionados já nessa ordem, e 'modelos' recebe o modelo de cada um alinhado com as posições.
+void criarObjetosCena(AnimationSystem& sistema, const Scene& cena, InterpolationMode modo, std::vector<uint32_t>& modelos) {
+	sistema.clear();
+	modelos.clear();
+	const std::vector<glm::vec3> parado(1, glm::vec3(0.0f));
+	std::unordered_map<AssetId, uint32_t> caminhos;
+	std::vector<uint32_t> caminhoObjeto(cena.objects.size());
+	for (size_t o = 0; o < cena.objects.size(); o++) {
+		const AssetId arquivo = cena.objects[o].path;
+		auto encontrado = caminhos.find(arquivo);
+		if (encontrado == caminhos.end()) {
+			const Trajectory& trajetoriaCaminho = assets.trajectory(arquivo);
+			const std::vector<glm::vec3>& pontosCaminho = assets.points(arquivo);
+			if (arquivo != kInvalidAsset && !trajetoriaCaminho.isOpen() && pontosCaminho.empty())
+				std::cerr << "Nenhum ponto foi carregado de " << assets.path(arquivo) << ": objetos parados" << std::endl;
+			uint32_t caminho;
+			if (trajetoriaCaminho.isOpen())
+				caminho = sistema.addTrajectory(trajetoriaCaminho);
+			else
+				caminho = sistema.addPath(pontosCaminho.empty() ? buildAnimationPath(parado, INTERP_LINEAR, duracao_ponto)
+					: buildAnimationPath(pontosCaminho, modo, duracao_ponto));
+			encontrado = caminhos.emplace(arquivo, caminho).first;
+		}
+		caminhoObjeto[o] = encontrado->second;
+	}
+	for (uint32_t caminho = 0; caminho < caminhos.size(); caminho++) {
+		for (size_t o = 0; o < cena.objects.size(); o++) {
+			if (caminhoObjeto[o] != caminho)
+				continue;
+			// As cópias de um objeto na mesma grade de criarObjetos, a partir da posição dele
+			const SceneObject& objeto = cena.objects[o];
+			size_t lado = (size_t)ceil(sqrt((double)objeto.count));
+			for (size_t i = 0; i < objeto.count; i++) {
+				float coluna = (float)(i % lado) - (float)((lado - 1) / 2);
+				float linha = (float)(i / lado);
+				glm::vec3 offset(coluna * objeto.spacing, 0.0f, -linha * objeto.spacing);
+				sistema.addObject(caminho, objeto.position + offset, objeto.phase);
+				modelos.push_back(objeto.model);
+			}
+		}
+	}
+}
+
+// Órbita de uma luz pontual: um círculo horizontal (com uma leve ondulação vertical) em
+// torno de 'centro'
+struct LightOrbit {
+	glm::vec3 centro;
+	float raio;
+	float velocidade; // rad/s
+	float fase;
+};
+
+// Espalha as luzes sobre a grade de objetos, com alcance, cor e órbita variados. Os valores
+// vêm de um gerador fixo, então as execuções (e os quadros do modo headless) se repetem.
+std::vector<LightOrbit> criarLuzes(size_t quantidade, size_t quantidadeObjetos, std::vector<PointLight>& luzes) {
+	size_t lado = (size_t)ceil(sqrt((double)quantidadeObjetos));
+	size_t linhas = (quantidadeObjetos + lado - 1) / lado;
+	uint32_t semente = 12345u;
+	auto aleatorio = [&semente]() {
+		semente = semente * 1664525u + 1013904223u;
+		return (semente >> 8) * (1.0f / 16777216.0f);
+	};
+
+	std::vector<LightOrbit> orbitas(quantidade);
+	luzes.assign(quantidade, PointLight());
+	for (size_t i = 0; i < quantidade; i++) {
+		LightOrbit& orbita = orbitas[i];
+		orbita.centro.x = (aleatorio() - 0.5f) * lado * espacamento_objetos;
+		orbita.centro.y = 0.5f + aleatorio() * 2.0f;
+		orbita.centro.z = (0.5f - aleatorio() * linhas) * espacamento_objetos;
+		orbita.raio = 0.5f + aleatorio() * 1.5f;
+		orbita.velocidade = 0.3f + aleatorio() * 1.2f;
+		orbita.fase = glm::radians(360.0f * aleatorio());
+
+		// Cor pela matiz (paleta de cossenos), com o alcance entre 1 e 2 espaçamentos da grade
+		const float matiz = aleatorio();
+		luzes[i].color = glm::vec3(0.5f + 0.5f * cos(glm::radians(360.0f * matiz)),
+			0.5f + 0.5f * cos(glm::radians(360.0f * matiz + 120.0f)),
+			0.5f + 0.5f * cos(glm::radians(360.0f * matiz + 240.0f)));
+		luzes[i].radius = espacamento_objetos * (1.0f + aleatorio());
+		luzes[i].intensity = 2.0f;
+	}
+	return orbitas;
+}
+
+// Posições das luzes no tempo 'tempo' (s) da simulação
+void posicionarLuzes(const std::vector<LightOrbit>& orbitas, float tempo, std::vector<PointLight>& luzes) {
+	for (size_t i = 0; i < orbitas.size(); i++) {
+		const LightOrbit& orbita = orbitas[i];
+		const float angulo = orbita.fase + orbita.velocidade * tempo;
+		luzes[i].position = orbita.centro + glm::vec3(cos(angulo) * orbita.raio, 0.25f * sin(2.0f * angulo), sin(angulo) * orbita.raio);
+	}
+}
+
+// Câmera roteirizada do modo headless: percorre o caminho (Catmull-Rom com velocidade
+// constante) uma vez em 'duracao' segundos, sempre olhando para 'alvo'. Sem arquivo de
+// caminho, dá uma volta em torno da grade de objetos.
+AnimationPath criarCaminhoCamera(const std::string& arquivo, size_t quantidade, float duracao, glm::vec3& alvo) {
+	size_t lado = (size_t)ceil(sqrt((double)quantidade));
+	size_t linhas = (quantidade + lado - 1) / lado;
+	alvo = glm::vec3(0.0f, 0.0f, -(float)(linhas - 1) * espacamento_objetos * 0.5f);
+
+	std::vector<glm::vec3> pontosCamera;
+	if (!arquivo.empty())
+		carregarPontos(arquivo, pontosCamera);
+	if (pontosCamera.empty()) {
+		float raio = std::max(3.0f, lado * espacamento_objetos);
+		const int voltas = 8;
+		for (int i = 0; i < voltas; i++) {
+			float angulo = glm::radians(360.0f * i / voltas);
+			pontosCamera.push_back(alvo + glm::vec3(raio * sin(angulo), raio * 0.4f, raio * cos(angulo)));
+		}
+	}
+	return buildAnimationPath(pontosCamera, INTERP_ARC_LENGTH, duracao / pontosCamera.size());
+}
+
+// Nível de detalhe de uma malha (0: a original); as submalhas seguem a mesma ordem em todos
+struct MeshLevel {
+	GLsizei nIndices = 0;
+	std::vector<SubMesh> submeshes;
+};
+
+// Malha da cena: a faixa que ela ocupa no GeometryPool (VAO e buffers comuns a todas)
+struct Mesh {
+	GeometryRange geometry;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;
+	std::vector<MeshLevel> levels;
+	std::vector<float> levelErrors;       // erro de cada nível nas unidades do objeto (selectLod)
+	uint32_t firstGroup = 0;              // grupo de instâncias do nível 0; os dos outros níveis vêm em seguida
+	std::vector<NamedMaterial> materials; // na ordem de SubMesh::material
+};
+
+// Malha distinta da cena, lida numa tarefa: o cache binário mapeado ou, por falta de cache
+// válido, o OBJ esperando os níveis de detalhe. O envio ao pool fica para a thread do GL
+struct LoadedOBJ {
+	string path;
+	bool cached = false;
+	MappedFile cacheFile;
+	MeshCacheView cache;
+	MeshData data;
+	vector<string> sources;
+	ostringstream log; // mensagens da carga, mostradas depois na ordem das malhas
+};
+
+// Estado de desenho de um material: variante do shader, textura difusa e transparência
+struct DrawMaterial {
+	Material material;
+	GLuint program = 0;
+	uint32_t programIndex = 0; // campo de programa da chave de ordenação
+	TextureHandle texture = kInvalidTexture;
+	bool transparent = false;  // d < 1: desenhado depois dos opacos, de trás para frente
+};
+
+// Submalha de uma malha da cena com o material já na tabela única (0: material padrão)
+struct DrawPart {
+	uint32_t mesh;
+	uint32_t group;       // grupo de instâncias: a malha num nível de detalhe
+	uint32_t indexOffset; // relativo à malha
+	uint32_t indexCount;
+	uint32_t material;
+};
+
+// Sequência de comandos indiretos com o mesmo programa, textura e mistura (uma chamada)
+struct DrawBatch {
+	uint32_t first;
+	uint32_t count;
+	uint32_t material; // material do primeiro comando (define o estado da sequência)
+};
+
+// Uniforms comuns a todos os programas (bloco Frame dos shaders, std140): escritos uma vez por
+// quadro no UploadRing e ligados ao ponto 0 de GL_UNIFORM_BUFFER. Em std140 a mat3 ocupa três
+// colunas de vec4 e os vec3 são guardados como vec4.
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 normalMatrix[3];
+	glm::vec4 viewPos;
+	glm::vec4 lightPos;
+	glm::vec4 lightColor;
+	uint32_t clusterGrid[4];  // clusters em x, y e z (LightClusters) e número de luzes pontuais
+	glm::vec4 clusterParams;  // LightClusters::shaderParams
 };
 
+// Material das faces sem "usemtl" ou com um nome que não está em nenhum MTL
+Material materialPadrao() {
+	Material material;
+	material.Ka = glm::vec3(0.2f);
+	material.Kd = glm::vec3(0.8f);
+	return material;
+}
+
 // Protótipo da função de callback de teclado
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void process_input(GLFWwindow *window);
 
 // Protótipos das funções
-int setupShader();
-int setupGeometry();
-int loadTexture(string path);
-int loadSimpleOBJ(string filepath, int& nVerts, glm::vec3 color);
-std::unordered_map<std::string, Material> loadMTL(const std::string& filename);
+bool carregarCena(Scene& cena, vector<uint32_t>& modelosGrade);
+void criarTodosObjetos(const Scene& cena, const vector<uint32_t>& modelosGrade, vector<uint32_t>& modelos);
+bool openCachedOBJ(string filepath, glm::vec3 color, LoadedOBJ& obj);
+void loadSimpleOBJ(string filepath, glm::vec3 color, MeshData& meshData, vector<string>& sources, ostream& log = cout);
+Mesh storeMesh(GeometryPool& geometry, string filepath, glm::vec3 color, const MeshData& meshData, const vector<string>& sources);
+Mesh uploadMesh(GeometryPool& geometry, const MeshCacheView& meshData);
+int quantizationReport(string filepath);
+int animationBenchmark(size_t objectCount);
+int selfCheck();
+int softwareRender();
+
+// Opções de linha de comando
+struct Options {
+	unsigned loaderThreads = 1; // threads usadas na leitura dos arquivos OBJ (--threads N)
+	bool rebuildMeshCache = false; // ignora os caches de malha, textura e shader existentes (--rebuild-cache)
+	bool packedVertices = false;   // vértices quantizados de 16 bytes (--packed-vertices)
+	string quantReportPath;        // só mede o erro de quantização deste OBJ e sai (--quant-report arquivo)
+	size_t objectCount = 1;        // objetos desenhados com instancing (--objects N)
+	InterpolationMode interpolation = INTERP_LINEAR; // --interp linear|catmull-rom|arc-length
+	size_t animBenchmarkObjects = 0; // só roda o microbenchmark de animação e sai (--bench-anim N)
+	bool headless = false;         // renderiza fora da tela via EGL, sem janela (--headless)
+	size_t frames = 300;           // quadros medidos no modo headless (--frames N)
+	size_t warmupFrames = 2;       // quadros iniciais fora das medições (--warmup-frames N)
+	string cameraPathFile;         // caminho da câmera no modo headless (--camera-path arquivo)
+	string benchJsonPath;          // tempos por quadro em JSON (--bench-json arquivo)
+	vector<size_t> dumpFrames;     // quadros gravados como imagem no modo headless (--dump-frames 0,10,99)
+	string dumpPrefix = "frame";   // prefixo dos arquivos de imagem (--dump-prefix caminho/nome)
+	string dumpFormat = "ppm";     // formato das imagens: ppm ou png (--dump-format)
+	bool profile = false;          // profiler de CPU/GPU com resumo no console (--profile)
+	string profileTracePath = "trace.json"; // trace do Chrome gravado no fim e com F9 (--profile-trace arquivo)
+	size_t profileSummaryFrames = 120; // quadros por resumo do profiler (--profile-summary N, 0 desliga)
+	string shaderCacheDir = "shadercache"; // binários dos programas de shader (--shader-cache pasta, "" desliga)
+	size_t textureUploadBudget = 4 << 20; // bytes de textura enviados por quadro (--texture-budget KB)
+	bool culling = true;           // descarta os objetos fora do frustum (--no-culling desliga)
+	bool normalMatrixPerVertex = false; // inversa da matriz de modelo no vertex shader, para comparação (--normal-matrix-per-vertex)
+	bool compressTextures = true;  // texturas em BC1/BC3 no cache e na GPU (--uncompressed-textures desliga)
+	vector<string> meshPaths;      // malhas da cena, revezadas entre os objetos (--mesh arquivo, repetível; padrão ../cube.obj)
+	string scenePath;              // objetos, malhas, materiais e caminhos de um arquivo de cena, no lugar de --mesh e --objects (--scene arquivo)
+	string pathFile = "../pontos.txt"; // caminho dos objetos da grade: pontos em texto ou trajetória .traj (--path arquivo)
+	string convertPathInput;       // converte pontos em texto para trajetória e sai (--convert-path entrada.txt saida.traj)
+	string convertPathOutput;
+	bool multiDraw = true;         // glMultiDrawElementsIndirect por estado (--no-multi-draw: uma chamada por parte)
+	bool lod = true;               // nível de detalhe de cada objeto pela distância (--no-lod desliga)
+	float lodPixelError = 1.0f;    // erro projetado aceito na escolha do nível, em pixels (--lod-error px)
+	double simRate = 120.0;        // passos por segundo da simulação (animação e câmera) (--sim-rate Hz)
+	bool software = false;         // quadros do modo headless pelo rasterizador em CPU, sem GL (--software)
+	size_t lightCount = 0;         // luzes pontuais em movimento, com iluminação por clusters (--lights N)
+	unsigned jobThreads = 1;       // threads do sistema de tarefas do preparo dos quadros, contando a principal (--jobs N)
+	bool selfCheck = false;        // só roda as verificações dos caminhos paralelos e dos caches e sai (--self-check)
+};
+Options options;
+void parseArguments(int argc, char** argv);
 
 // Dimensões da janela (pode ser alterado em tempo de execução)
 const GLuint WIDTH = 1000, HEIGHT = 1000;
 
+// Fontes com as variantes do ShaderManager: TEXTURED, SPECULAR, INSTANCED, PACKED_VERTICES,
+// NORMAL_MATRIX_PER_VERTEX e MULTI_DRAW são definidos conforme os bits pedidos (ver ShaderFeature)
 const GLchar* vertexShaderSource = "#version 450 core\n"
+"#ifdef MULTI_DRAW\n"
+"#extension GL_ARB_shader_draw_parameters : require\n"
+"#endif\n"
 "layout (location = 0) in vec3 position;\n"
 "layout (location = 1) in vec3 normal;\n"
 "layout (location = 2) in vec2 texCoord;\n"
+"#ifdef INSTANCED\n"
+"// Uma matriz de modelo por instância (InstanceBuffer); instanceBase desloca os desenhos de\n"
+"// uma instância só (transparentes)\n"
+"layout (std430, binding = 0) readonly buffer Instances\n"
+"{\n"
+"    mat4 instanceModels[];\n"
+"};\n"
+"uniform int instanceBase;\n"
+"#else\n"
 "uniform mat4 model;\n"
-"uniform mat4 view;\n"
-"uniform mat4 projection;\n"
+"#endif\n"
+"#ifdef MULTI_DRAW\n"
+"// Dados de cada comando do glMultiDrawElementsIndirect (DrawData). gl_DrawIDARB recomeça em\n"
+"// cada chamada: drawBase é a posição do primeiro comando dela\n"
+"struct DrawData\n"
+"{\n"
+"    vec4 boundsMin;\n"
+"    vec4 boundsExtent;\n"
+"    vec4 Ka;\n"
+"    vec4 Kd;\n"
+"    vec4 Ks;\n"
+"};\n"
+"layout (std430, binding = 1) readonly buffer Draws\n"
+"{\n"
+"    DrawData draws[];\n"
+"};\n"
+"uniform int drawBase;\n"
+"flat out int drawIndex;\n"
+"#endif\n"
+"// Dados do quadro (FrameUniforms). normalMatrix: inversa transposta da matriz de modelo,\n"
+"// calculada uma vez por quadro na CPU (sem uso com NORMAL_MATRIX_PER_VERTEX)\n"
+"layout (std140, binding = 0) uniform Frame\n"
+"{\n"
+"    mat4 view;\n"
+"    mat4 projection;\n"
+"    mat3 normalMatrix;\n"
+"    vec4 viewPos;\n"
+"    vec4 lightPos;\n"
+"    vec4 lightColor;\n"
+"    uvec4 clusterGrid;\n"
+"    vec4 clusterParams;\n"
+"};\n"
 "out vec3 FragPos;\n"
 "out vec3 Normal;\n"
 "out vec2 TexCoord;\n"
+"#ifdef PACKED_VERTICES\n"
+"// Vértices compactos: posição em unorm16 relativa à caixa envolvente e normal em octaedro\n"
+"#ifndef MULTI_DRAW\n"
+"uniform vec3 boundsMin;\n"
+"uniform vec3 boundsExtent;\n"
+"#endif\n"
+"vec3 octDecode(vec2 e)\n"
+"{\n"
+"    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+"    float t = max(-n.z, 0.0);\n"
+"    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+"    return normalize(n);\n"
+"}\n"
+"#endif\n"
 "void main()\n"
 "{\n"
-"    FragPos = vec3(model * vec4(position, 1.0));\n"
-"    Normal = mat3(transpose(inverse(model))) * normal;\n"
+"#ifdef MULTI_DRAW\n"
+"    drawIndex = drawBase + gl_DrawIDARB;\n"
+"    vec3 boundsMin = draws[drawIndex].boundsMin.xyz;\n"
+"    vec3 boundsExtent = draws[drawIndex].boundsExtent.xyz;\n"
+"#endif\n"
+"#ifdef PACKED_VERTICES\n"
+"    vec3 pos = boundsMin + position * boundsExtent;\n"
+"    vec3 nrm = octDecode(normal.xy);\n"
+"#else\n"
+"    vec3 pos = position;\n"
+"    vec3 nrm = normal;\n"
+"#endif\n"
+"#if defined(INSTANCED) && defined(MULTI_DRAW)\n"
+"    mat4 model = instanceModels[gl_BaseInstanceARB + gl_InstanceID];\n"
+"#elif defined(INSTANCED)\n"
+"    mat4 model = instanceModels[instanceBase + gl_InstanceID];\n"
+"#endif\n"
+"    FragPos = vec3(model * vec4(pos, 1.0));\n"
+"#ifdef NORMAL_MATRIX_PER_VERTEX\n"
+"    Normal = mat3(transpose(inverse(model))) * nrm;\n"
+"#else\n"
+"    Normal = normalMatrix * nrm;\n"
+"#endif\n"
 "    TexCoord = texCoord;\n"
 "    gl_Position = projection * view * vec4(FragPos, 1.0);\n"
 "}\0";
@@ -100,87 +472,207 @@ const GLchar* fragmentShaderSource = "#version 450 core\n"
 "in vec3 Normal;\n"
 "in vec2 TexCoord;\n"
 "out vec4 color;\n"
-"uniform vec3 lightPos;\n"
-"uniform vec3 viewPos;\n"
-"uniform vec3 lightColor;\n"
+"layout (std140, binding = 0) uniform Frame\n"
+"{\n"
+"    mat4 view;\n"
+"    mat4 projection;\n"
+"    mat3 normalMatrix;\n"
+"    vec4 viewPos;\n"
+"    vec4 lightPos;\n"
+"    vec4 lightColor;\n"
+"    uvec4 clusterGrid;\n"
+"    vec4 clusterParams;\n"
+"};\n"
+"#ifdef TEXTURED\n"
 "uniform sampler2D ourTexture;\n"
+"#endif\n"
+"#ifdef MULTI_DRAW\n"
+"struct DrawData\n"
+"{\n"
+"    vec4 boundsMin;\n"
+"    vec4 boundsExtent;\n"
+"    vec4 Ka;\n"
+"    vec4 Kd;\n"
+"    vec4 Ks;\n"
+"};\n"
+"layout (std430, binding = 1) readonly buffer Draws\n"
+"{\n"
+"    DrawData draws[];\n"
+"};\n"
+"flat in int drawIndex;\n"
+"#else\n"
 "uniform vec3 Ka;\n"
 "uniform vec3 Kd;\n"
+"uniform float opacity;\n"
+"#ifdef SPECULAR\n"
 "uniform vec3 Ks;\n"
 "uniform float Ns;\n"
+"#endif\n"
+"#endif\n"
+"#ifdef CLUSTERED_LIGHTS\n"
+"// Luzes pontuais e as listas por cluster (LightClusters): clusters[c] = (primeiro, contagem)\n"
+"// em lightIndices\n"
+"struct PointLight\n"
+"{\n"
+"    vec3 position;\n"
+"    float radius;\n"
+"    vec3 color;\n"
+"    float intensity;\n"
+"};\n"
+"layout (std430, binding = 2) readonly buffer Lights\n"
+"{\n"
+"    PointLight lights[];\n"
+"};\n"
+"layout (std430, binding = 3) readonly buffer Clusters\n"
+"{\n"
+"    uvec2 clusters[];\n"
+"};\n"
+"layout (std430, binding = 4) readonly buffer LightIndices\n"
+"{\n"
+"    uint lightIndices[];\n"
+"};\n"
+"#endif\n"
 "void main()\n"
 "{\n"
+"#ifdef MULTI_DRAW\n"
+"    vec3 Ka = draws[drawIndex].Ka.xyz;\n"
+"    float opacity = draws[drawIndex].Ka.w;\n"
+"    vec3 Kd = draws[drawIndex].Kd.xyz;\n"
+"#ifdef SPECULAR\n"
+"    vec3 Ks = draws[drawIndex].Ks.xyz;\n"
+"    float Ns = draws[drawIndex].Ks.w;\n"
+"#endif\n"
+"#endif\n"
 "    // Ambient\n"
-"    vec3 ambient = Ka * lightColor;\n"
+"    vec3 ambient = Ka * lightColor.rgb;\n"
 "\n"
 "    // Diffuse\n"
 "    vec3 norm = normalize(Normal);\n"
-"    vec3 lightDir = normalize(lightPos - FragPos);\n"
+"    vec3 lightDir = normalize(lightPos.xyz - FragPos);\n"
 "    float diff = max(dot(norm, lightDir), 0.0);\n"
-"    vec3 diffuse = Kd * diff * lightColor;\n"
+"    vec3 diffuse = Kd * diff * lightColor.rgb;\n"
 "\n"
+"    vec3 result = ambient + diffuse;\n"
+"#ifdef SPECULAR\n"
 "    // Specular\n"
-"    vec3 viewDir = normalize(viewPos - FragPos);\n"
+"    vec3 viewDir = normalize(viewPos.xyz - FragPos);\n"
 "    vec3 reflectDir = reflect(-lightDir, norm);\n"
 "    float spec = pow(max(dot(viewDir, reflectDir), 0.0), Ns);\n"
-"    vec3 specular = Ks * spec * lightColor;\n"
-"\n"
-"    vec3 result = ambient + diffuse + specular;\n"
-"    color = texture(ourTexture, TexCoord) * vec4(result, 1.0);\n"
+"    result += Ks * spec * lightColor.rgb;\n"
+"#endif\n"
+"#ifdef CLUSTERED_LIGHTS\n"
+"    // Luzes pontuais: só as da lista do cluster do fragmento (tile na tela e fatia da\n"
+"    // profundidade, em escala logarítmica)\n"
+"    float viewDepth = -(view * vec4(FragPos, 1.0)).z;\n"
+"    uvec3 cell = uvec3(uvec2(gl_FragCoord.xy / clusterParams.xy),\n"
+"        uint(max(log(viewDepth) * clusterParams.z + clusterParams.w, 0.0)));\n"
+"    cell = min(cell, clusterGrid.xyz - 1u);\n"
+"    uvec2 list = clusters[cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)];\n"
+"    for (uint i = list.x; i < list.x + list.y; i++)\n"
+"    {\n"
+"        PointLight light = lights[lightIndices[i]];\n"
+"        vec3 toLight = light.position - FragPos;\n"
+"        float lightDistance = length(toLight);\n"
+"        // Inverso do quadrado, levado a zero suavemente no alcance da luz\n"
+"        float window = clamp(1.0 - pow(lightDistance / light.radius, 4.0), 0.0, 1.0);\n"
+"        vec3 radiance = light.color * (light.intensity * window * window / (1.0 + lightDistance * lightDistance));\n"
+"        vec3 pointDir = toLight / max(lightDistance, 1e-4);\n"
+"        result += Kd * max(dot(norm, pointDir), 0.0) * radiance;\n"
+"#ifdef SPECULAR\n"
+"        result += Ks * pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), Ns) * radiance;\n"
+"#endif\n"
+"    }\n"
+"#endif\n"
+"#ifdef TEXTURED\n"
+"    color = texture(ourTexture, TexCoord) * vec4(result, opacity);\n"
+"#else\n"
+"    color = vec4(result, opacity);\n"
+"#endif\n"
 "}\0";
 
-bool rotateX = false, rotateY = false, rotateZ = false;
-
-glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f);
-float scale = 1.0f;
-
+// Câmera do quadro: vem da simulação (teclado e mouse) ou do caminho do modo headless
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
-bool firstMouse = true;
-float yaw = -90.0f;
-float pitch = 0.0f;
-float lastX = WIDTH / 2.0;
-float lastY = HEIGHT / 2.0;
 float fov = 45.0f;
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+// Animação, câmera e as transformações do teclado avançam em passo fixo; os callbacks só
+// repassam eventos a ela
+Simulation simulation;
+// Tarefas do preparo dos quadros (animação, culling, instâncias, fila de desenhos, luzes); a
+// thread principal é o worker 0
+JobSystem jobs;
+bool traceRequested = false; // F9: grava o trace do profiler no próximo quadro
 
 // Função MAIN
-int main()
+int main(int argc, char** argv)
 {
+	parseArguments(argc, argv);
+	if (options.profile)
+	{
+		profilerSetEnabled(true);
+		profilerSetThreadName("main");
+	}
 
-	// Inicialização da GLFW
-	glfwInit();
-
-	//Muita atenção aqui: alguns ambientes não aceitam essas configurações
-	//Você deve adaptar para a versão do OpenGL suportada por sua placa
-	//Sugestão: comente essas linhas de código para desobrir a versão e
-	//depois atualize (por exemplo: 4.5 com 4 e 5)
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	//glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	//Essencial para computadores da Apple
+	// Modo ferramenta: não abre janela
+	if (!options.quantReportPath.empty())
+		return quantizationReport(options.quantReportPath);
+	if (!options.convertPathInput.empty())
+		return convertTrajectory(options.convertPathInput, options.convertPathOutput, duracao_ponto) ? 0 : -1;
+	if (options.animBenchmarkObjects)
+		return animationBenchmark(options.animBenchmarkObjects);
+	jobs.create(options.jobThreads);
+	if (options.selfCheck)
+		return selfCheck();
+	if (options.software)
+		return softwareRender();
+
+	GLFWwindow* window = nullptr;
+	HeadlessContext headless;
+	int width, height;
+	if (options.headless)
+	{
+		// Sem janela: contexto EGL e framebuffer próprio com o tamanho da janela normal
+		if (!headless.create(WIDTH, HEIGHT))
+			return -1;
+		width = headless.width();
+		height = headless.height();
+	}
+	else
+	{
+		// Inicialização da GLFW
+		glfwInit();
+
+		//Muita atenção aqui: alguns ambientes não aceitam essas configurações
+		//Você deve adaptar para a versão do OpenGL suportada por sua placa
+		//Sugestão: comente essas linhas de código para desobrir a versão e
+		//depois atualize (por exemplo: 4.5 com 4 e 5)
+		//glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+		//glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		//Essencial para computadores da Apple
 //#ifdef __APPLE__
 //	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 //#endif
 
-	// Criação da janela GLFW
-	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Ola 3D -- Eduardo!", nullptr, nullptr);
-	glfwMakeContextCurrent(window);
+		// Criação da janela GLFW
+		window = glfwCreateWindow(WIDTH, HEIGHT, "Ola 3D -- Eduardo!", nullptr, nullptr);
+		glfwMakeContextCurrent(window);
 
-	// Fazendo o registro da função de callback para a janela GLFW
-	glfwSetKeyCallback(window, key_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// Fazendo o registro da função de callback para a janela GLFW
+		glfwSetKeyCallback(window, key_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-	// GLAD: carrega todos os ponteiros d funções da OpenGL
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
+		// GLAD: carrega todos os ponteiros d funções da OpenGL
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+
+		}
 
+		glfwGetFramebufferSize(window, &width, &height);
 	}
 
 	// Obtendo as informações de versão
@@ -190,590 +682,1949 @@ int main()
 	cout << "OpenGL version supported " << version << endl;
 
 	// Definindo as dimensões da viewport com as mesmas dimensões da janela da aplicação
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
 	glViewport(0, 0, width, height);
 
-	carregarPontos("../pontos.txt");
-	if (pontos.empty()) {
-		std::cerr << "Nenhum ponto foi carregado. Encerrando a aplicação." << std::endl;
-		glfwTerminate();
+	// Malhas, MTLs e caminhos citados pela cena (--scene) ou por --mesh, pedidos ao cache de
+	// assets: cada conteúdo distinto é carregado uma vez. Os MTLs e os pontos são lidos em paralelo
+	Scene cena;
+	vector<uint32_t> gridModels; // sem --scene: o modelo de cada --mesh
+	if (!carregarCena(cena, gridModels)) {
+		if (!options.headless)
+			glfwTerminate();
 		return -1;
 	}
+	assets.preload(jobs);
+
+    // Todas as malhas da cena num só par de buffers com um VAO comum
+    GeometryPool geometry;
+    geometry.create(options.packedVertices ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FLOAT);
+    // Uma tarefa por malha distinta: o cache mapeado ou, sem cache válido, o OBJ. As lidas do OBJ
+    // ganham os níveis de detalhe todas juntas, em paralelo entre as malhas e as submalhas, antes
+    // de irem para o cache; o envio ao pool é na thread do GL
+    vector<LoadedOBJ> loaded(cena.meshes.size());
+    assets.loadAll(cena.meshes, jobs, [&](size_t m) -> size_t {
+        LoadedOBJ& obj = loaded[m];
+        obj.path = assets.path(cena.meshes[m]);
+        obj.cached = openCachedOBJ(obj.path, glm::vec3(0,0,0), obj);
+        if (!obj.cached)
+            loadSimpleOBJ(obj.path, glm::vec3(0,0,0), obj.data, obj.sources, obj.log);
+        return 0;
+    });
+    vector<MeshData*> lodMeshes;
+    for (LoadedOBJ& obj : loaded)
+    {
+        cout << obj.log.str();
+        if (!obj.cached)
+            lodMeshes.push_back(&obj.data);
+    }
+    if (!lodMeshes.empty())
+    {
+        auto lodStart = chrono::steady_clock::now();
+        buildLodChains(lodMeshes, options.loaderThreads);
+        cout << "Niveis de detalhe: " << lodMeshes.size() << " malhas em "
+            << chrono::duration<double, milli>(chrono::steady_clock::now() - lodStart).count() << " ms" << endl;
+    }
+    vector<Mesh> sceneMeshes(loaded.size());
+    for (size_t m = 0; m < loaded.size(); m++)
+    {
+        LoadedOBJ& obj = loaded[m];
+        auto uploadStart = chrono::steady_clock::now();
+        const size_t poolBytes = geometry.vertexBytes() + geometry.indexBytes();
+        if (obj.cached)
+            sceneMeshes[m] = uploadMesh(geometry, obj.cache);
+        else
+        {
+            cout << "  " << obj.path << ": " << lodTriangleCount(obj.data, 0);
+            for (size_t level = 1; level <= obj.data.lods.size(); level++)
+                cout << " -> " << lodTriangleCount(obj.data, level) << " (erro " << obj.data.lods[level - 1].error << ")";
+            cout << " triangulos" << endl;
+            sceneMeshes[m] = storeMesh(geometry, obj.path, glm::vec3(0,0,0), obj.data, obj.sources);
+        }
+        assets.addLoadTime(cena.meshes[m], chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count());
+        assets.setResidentBytes(cena.meshes[m], geometry.vertexBytes() + geometry.indexBytes() - poolBytes);
+    }
+    loaded.clear();
+    // Sem nenhuma malha com geometria não há o que desenhar, nem caixa para o culling
+    if (std::none_of(sceneMeshes.begin(), sceneMeshes.end(), [](const Mesh& mesh) { return !mesh.levels.empty(); }))
+    {
+        std::cerr << "Nenhuma malha foi carregada. Encerrando a aplicação." << std::endl;
+        geometry.destroy();
+        if (options.headless)
+            headless.destroy();
+        else
+            glfwTerminate();
+        return -1;
+    }
+    cout << "Pool de geometria: " << sceneMeshes.size() << " malhas, " << geometry.vertexBytes() / 1024 << " KB de vertices, "
+        << geometry.indexBytes() / 1024 << " KB de indices (" << geometry.widenedIndexBytes() / 1024
+        << " KB a mais por ampliar para 32 bits os indices de 16 bits)" << endl;
+
+    // Um Mesh por modelo da cena. Os que trocam os materiais são cópias com a mesma faixa do
+    // pool: só a lista de materiais muda, e as submalhas sem material ganham o padrão com a troca
+    vector<Mesh> meshes(cena.models.size());
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        const SceneModel& model = cena.models[m];
+        Mesh& mesh = meshes[m];
+        mesh = sceneMeshes[model.mesh];
+        if (model.material < 0)
+            continue;
+        const SceneMaterial& sceneMaterial = cena.materials[model.material];
+        for (NamedMaterial& named : mesh.materials)
+            sceneMaterial.apply(named.material, assets);
+        const int32_t fallback = (int32_t)mesh.materials.size();
+        bool unassigned = false;
+        for (MeshLevel& level : mesh.levels)
+            for (SubMesh& submesh : level.submeshes)
+                if (submesh.material < 0)
+                {
+                    submesh.material = fallback;
+                    unassigned = true;
+                }
+        if (unassigned)
+        {
+            mesh.materials.push_back({ "", materialPadrao() });
+            sceneMaterial.apply(mesh.materials.back().material, assets);
+        }
+    }
 
-	// Compilando e buildando o programa de shader
-	GLuint shaderID = setupShader();
-    glUseProgram(shaderID);
+    // Texturas (map_Kd de cada material) decodificadas em segundo plano e enviadas aos
+    // poucos a cada quadro; até lá o handle aponta para um placeholder
+    TextureStreamer textures;
+    textures.create(options.loaderThreads, options.textureUploadBudget, options.compressTextures, options.rebuildMeshCache);
+
+    // Tabela única de materiais: posição 0 é o material padrão (SubMesh::material == -1) e os
+    // de cada malha vêm em sequência. As submalhas de todas as malhas viram partes desenháveis.
+    vector<DrawMaterial> drawMaterials(1);
+    drawMaterials[0].material = materialPadrao();
+    // Cada nível de detalhe usado de cada malha é um grupo de instâncias, com as suas partes.
+    vector<DrawPart> parts;
+    vector<GLsizei> groupIndices; // índices desenhados por instância de cada grupo
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        Mesh& mesh = meshes[m];
+        const uint32_t materialBase = (uint32_t)drawMaterials.size();
+        for (const NamedMaterial& named : mesh.materials)
+        {
+            drawMaterials.emplace_back();
+            drawMaterials.back().material = named.material;
+        }
+        mesh.firstGroup = (uint32_t)groupIndices.size();
+        const size_t levels = options.lod ? mesh.levels.size() : std::min<size_t>(mesh.levels.size(), 1);
+        for (size_t level = 0; level < levels; level++)
+        {
+            for (const SubMesh& submesh : mesh.levels[level].submeshes)
+                parts.push_back({ (uint32_t)m, (uint32_t)groupIndices.size(), submesh.indexOffset, submesh.indexCount,
+                    submesh.material < 0 ? 0u : materialBase + (uint32_t)submesh.material });
+            groupIndices.push_back(mesh.levels[level].nIndices);
+        }
+        // Uma malha recusada pelo pool não tem níveis: um grupo sem partes, para os objetos dela
+        if (!levels)
+            groupIndices.push_back(0);
+    }
+    vector<bool> usedMaterials(drawMaterials.size(), false);
+    for (const DrawPart& part : parts)
+        usedMaterials[part.material] = true;
+    unordered_map<AssetId, TextureHandle> textureAssets; // para o relatório do cache de assets
+    for (size_t m = 0; m < drawMaterials.size(); m++)
+    {
+        DrawMaterial& drawMaterial = drawMaterials[m];
+        drawMaterial.transparent = drawMaterial.material.d < 1.0f;
+        // Arquivos com o mesmo conteúdo viram o mesmo asset, pedido ao streamer pelo mesmo
+        // caminho (pedidos do mesmo arquivo devolvem o mesmo handle)
+        if (usedMaterials[m] && !drawMaterial.material.map_Kd.empty())
+        {
+            const AssetId asset = assets.request(ASSET_TEXTURE, drawMaterial.material.map_Kd);
+            drawMaterial.texture = textures.request(assets.path(asset));
+            textureAssets.emplace(asset, drawMaterial.texture);
+        }
+    }
+    // No modo headless os quadros precisam ser reproduzíveis: espera as texturas
+    if (options.headless)
+        textures.finish();
+
+    // Desenho indireto: um glMultiDrawElementsIndirect por sequência de partes com o mesmo
+    // programa, textura e mistura; sem suporte, uma chamada por parte
+    const bool multiDraw = options.multiDraw && IndirectDrawBuffer::supported();
+    if (options.multiDraw && !multiDraw)
+        cout << "GL_ARB_shader_draw_parameters indisponivel: desenhando uma parte por chamada" << endl;
+    // Dados que mudam a cada quadro (matrizes, comandos indiretos, uniforms do quadro) num anel
+    // mapeado de forma persistente; o trecho inicial já comporta as matrizes de todos os objetos
+    // e, com --lights, as luzes e a grade de clusters (as listas crescem o anel se precisarem)
+    size_t ringBytes = options.objectCount * sizeof(glm::mat4) + (64 << 10);
+    if (options.lightCount)
+        ringBytes += options.lightCount * sizeof(PointLight) + LightClusters::kClusterCount * 2 * sizeof(uint32_t);
+    UploadRing uploadRing;
+    uploadRing.create(ringBytes);
+    IndirectDrawBuffer indirect;
+    if (multiDraw)
+        indirect.create(uploadRing, 1);
+
+    // Uma variante do shader por combinação usada pelos materiais; binários de execuções
+    // anteriores evitam a compilação (--rebuild-cache ignora os binários)
+    ShaderManager shaders;
+    shaders.create(vertexShaderSource, fragmentShaderSource, options.shaderCacheDir, !options.rebuildMeshCache);
+    uint32_t baseFeatures = SHADER_INSTANCED;
+    if (geometry.format() == VERTEX_FORMAT_PACKED)
+        baseFeatures |= SHADER_PACKED_VERTICES;
+    if (options.normalMatrixPerVertex)
+        baseFeatures |= SHADER_NORMAL_MATRIX_PER_VERTEX;
+    if (multiDraw)
+        baseFeatures |= SHADER_MULTI_DRAW;
+    if (options.lightCount)
+        baseFeatures |= SHADER_CLUSTERED_LIGHTS;
+    vector<GLuint> programs;
+    for (size_t m = 0; m < drawMaterials.size(); m++)
+    {
+        if (!usedMaterials[m])
+            continue;
+        DrawMaterial& drawMaterial = drawMaterials[m];
+        uint32_t features = baseFeatures;
+        if (drawMaterial.texture != kInvalidTexture)
+            features |= SHADER_TEXTURED;
+        if (drawMaterial.material.Ks != glm::vec3(0.0f))
+            features |= SHADER_SPECULAR;
+        drawMaterial.program = shaders.program(features);
+        auto known = find(programs.begin(), programs.end(), drawMaterial.program);
+        drawMaterial.programIndex = (uint32_t)(known - programs.begin());
+        if (known == programs.end())
+            programs.push_back(drawMaterial.program);
+    }
+    cout << "Shaders: " << shaders.stats().hits << " do cache, " << shaders.stats().misses << " compilados ("
+        << shaders.stats().rejected << " binarios recusados), " << shaders.stats().milliseconds << " ms" << endl;
+    cout << "Materiais: " << parts.size() << " submalhas, " << programs.size() << " variantes de shader" << endl;
 
-    GLuint texID = loadTexture("../Cube.png");
-    int nVerts;
-    GLuint VAO = loadSimpleOBJ("../cube.obj", nVerts, glm::vec3(0,0,0));
+    // Daqui em diante as mudanças de estado passam pelo cache, que pula as redundantes
+    GLStateCache glState;
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
     glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
     glm::vec3 objectColor(1.0f, 1.0f, 1.0f);
 
-    GLint modelLoc = glGetUniformLocation(shaderID, "model");
-    GLint viewLoc = glGetUniformLocation(shaderID, "view");
-    GLint projLoc = glGetUniformLocation(shaderID, "projection");
-    GLint lightPosLoc = glGetUniformLocation(shaderID, "lightPos");
-    GLint viewPosLoc = glGetUniformLocation(shaderID, "viewPos");
-    GLint lightColorLoc = glGetUniformLocation(shaderID, "lightColor");
-    GLint objectColorLoc = glGetUniformLocation(shaderID, "objectColor");
-
-    glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
     glm::mat4 projection = glm::perspective(glm::radians(fov), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
 
-    glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-    glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
-    glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-    glUniform3fv(objectColorLoc, 1, glm::value_ptr(objectColor));
-
-	std::unordered_map<std::string, Material> materials = loadMTL("../cube.mtl");
-	Material material = materials["Material"];
+    // Objetos da cena, ou a grade que segue o caminho (o objeto i usa a malha i % malhas);
+    // objectModels tem a malha de cada um, na ordem da animação. As matrizes de modelo vão para
+    // o buffer de instâncias, agrupadas por malha
+    vector<uint32_t> objectModels;
+    criarTodosObjetos(cena, gridModels, objectModels);
+    InstanceBuffer instances;
+    instances.create(uploadRing, 0);
+    ObjectCuller culler;
+    culler.setJobSystem(&jobs);
+    // Instâncias agrupadas por malha e nível de detalhe; com um só grupo as matrizes saem
+    // direto do culling ou da animação
+    const size_t groupCount = groupIndices.size();
+    const bool grouped = groupCount > 1;
+    vector<uint32_t> instanceFirst(groupCount, 0), instanceCount(groupCount, 0);
+    vector<glm::vec3> instancePositions; // na ordem do buffer (só com mais de um grupo)
+    vector<uint32_t> objectGroups;       // grupo de cada objeto desenhado no quadro
+    vector<uint8_t> objectLevels(animation.objectCount(), 0); // nível do quadro anterior (histerese)
+    vector<glm::vec3> meshCenters(meshes.size());
+
+    // O culling usa uma caixa só para todos os objetos: a união das caixas das malhas, com a
+    // esfera (centrada na caixa da união) que contém as esferas de todas
+    glm::vec3 sceneMin = meshes[0].boundsMin, sceneMax = meshes[0].boundsMax;
+    for (const Mesh& mesh : meshes)
+    {
+        sceneMin = glm::min(sceneMin, mesh.boundsMin);
+        sceneMax = glm::max(sceneMax, mesh.boundsMax);
+    }
+    float sceneRadius = 0.0f;
+    for (const Mesh& mesh : meshes)
+        sceneRadius = std::max(sceneRadius, glm::length((mesh.boundsMin + mesh.boundsMax) * 0.5f - (sceneMin + sceneMax) * 0.5f) + mesh.boundsRadius);
 
-	glUniform3f(glGetUniformLocation(shaderID, "Ka"), material.Ka.r, material.Ka.g, material.Ka.b);
-	glUniform3f(glGetUniformLocation(shaderID, "Kd"), material.Kd.r, material.Kd.g, material.Kd.b);
-	glUniform3f(glGetUniformLocation(shaderID, "Ks"), material.Ks.r, material.Ks.g, material.Ks.b);
-	glUniform1f(glGetUniformLocation(shaderID, "Ns"), material.Ns);
+    // O plano distante acompanha o tamanho da grade de objetos
+    float farPlane = std::max(100.0f, (float)ceil(sqrt((double)animation.objectCount())) * espacamento_objetos * 1.5f);
 
     // Definindo a matriz de projeção para a janela
-    projection = glm::perspective(glm::radians(fov), (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    projection = glm::perspective(glm::radians(fov), (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, farPlane);
 
-    glEnable(GL_DEPTH_TEST);
+    // Uniforms fixos de cada variante; câmera e luz vêm do bloco Frame, e os dos materiais a
+    // cada troca na fila de desenhos (ou do buffer de dados por desenho, com o desenho indireto)
+    for (GLuint program : programs)
+    {
+        glState.useProgram(program);
+        glState.setUniform("objectColor", objectColor);
+        glState.setUniform("ourTexture", 0);
+    }
+    // Luzes pontuais (--lights): órbitas fixas, posições a cada quadro pelo tempo da simulação.
+    // A grade de clusters segue a projeção
+    vector<PointLight> pointLights;
+    vector<LightOrbit> lightOrbits = criarLuzes(options.lightCount, animation.objectCount(), pointLights);
+    LightClusters lightClusters;
+    lightClusters.setProjection(projection, 0.1f, farPlane);
+
+    FrameUniforms frameUniforms;
+    frameUniforms.lightPos = glm::vec4(lightPos, 1.0f);
+    frameUniforms.lightColor = glm::vec4(lightColor, 1.0f);
+    frameUniforms.clusterGrid[0] = LightClusters::kClustersX;
+    frameUniforms.clusterGrid[1] = LightClusters::kClustersY;
+    frameUniforms.clusterGrid[2] = LightClusters::kClustersZ;
+    frameUniforms.clusterGrid[3] = (uint32_t)pointLights.size();
+    frameUniforms.clusterParams = lightClusters.shaderParams(width, height);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    DrawQueue drawQueue;
+    vector<DrawElementsIndirectCommand> indirectCommands;
+    vector<DrawData> drawData;
+    vector<DrawBatch> drawBatches;
+
+    glState.enable(GL_DEPTH_TEST);
+
+    // Modo headless: passo de tempo fixo (quadros reproduzíveis para comparar imagens)
+    // e câmera roteirizada no lugar do teclado e do mouse
+    const float headlessStep = 1.0f / 60.0f;
+    glm::vec3 cameraTarget;
+    AnimationPath cameraPath = criarCaminhoCamera(options.cameraPathFile, animation.objectCount(),
+        (options.warmupFrames + options.frames) * headlessStep, cameraTarget);
+
+    // A partir daqui a animação é da simulação. Com janela ela roda na sua thread, no ritmo do
+    // relógio; no modo headless avança na thread principal até o tempo de cada quadro, então
+    // os quadros continuam reproduzíveis
+    SimCamera initialCamera;
+    initialCamera.position = cameraPos;
+    initialCamera.front = cameraFront;
+    initialCamera.up = cameraUp;
+    simulation.create(animation, initialCamera, 1.0 / options.simRate, &jobs);
+    if (!options.headless)
+        simulation.start();
+    SimFrame simFrame;
+    SimulationStats summarySim;
+
+    // Tempos por quadro (CPU, GPU e intervalo entre quadros) para o JSON do benchmark
+    // Os primeiros quadros (compilação de shaders, primeiros uploads) ficam de fora
+    const bool measureFrames = options.headless || !options.benchJsonPath.empty();
+    GpuTimer gpuTimer;
+    if (measureFrames)
+        gpuTimer.create();
+    BenchmarkReport report;
+    chrono::steady_clock::time_point previousFrameStart, measureStart;
+    uint64_t measureStartSteps = 0;
+    vector<uint8_t> pixels;
+
+    // Profiler: escopos de CPU sempre compilados (custo desprezível desligado), GPU só com --profile
+    GpuProfiler gpuProfiler;
+    if (options.profile)
+        gpuProfiler.create();
+    int64_t summaryStart = profilerNow();
+
+    // Preparo do quadro como grafo de tarefas, montado uma vez: culling e luzes em paralelo, depois
+    // as instâncias e a fila de desenhos, cada nó repartindo o seu trabalho com parallelFor. Os nós
+    // que reservam no UploadRing ficam na thread principal (o anel e a GL são dela), e a submissão
+    // continua depois do grafo, também nela. Os nós leem o estado do quadro destas variáveis
+    glm::mat4 local(1.0f);
+    float currentFrame = 0.0f, scale = 1.0f;
+    size_t objectCount = 0, drawnObjects = 0;
+    glm::mat4* models = nullptr;
+    const size_t instancesPerJob = 8192;
+    vector<uint32_t> chunkGroups; // instâncias de cada (trecho, grupo), depois o cursor de cada um
+    vector<size_t> partBase;      // primeira posição de cada parte na fila de desenhos
+    auto objectPosition = [&](size_t object) { return glm::vec3(simFrame.x[object], simFrame.y[object], simFrame.z[object]); };
+    auto drawnPosition = [&](size_t i) { return options.culling ? culler.visiblePosition(i) : objectPosition(i); };
+
+    JobGraph frameGraph;
+    const uint32_t cullingNode = frameGraph.add("culling", [&]() {
+        // Só os objetos dentro do frustum viram instâncias
+        if (!options.culling)
+            return;
+        culler.update(simFrame.x.data(), simFrame.y.data(), simFrame.z.data(), objectCount, local,
+            sceneMin, sceneMax, sceneRadius);
+        culler.cull(Frustum::fromMatrix(projection * view));
+    });
+    const uint32_t lightsNode = frameGraph.add("lights", [&]() {
+        // Luzes pontuais nos clusters da câmera do quadro
+        if (!options.lightCount)
+            return;
+        posicionarLuzes(lightOrbits, currentFrame, pointLights);
+        lightClusters.assign(pointLights.data(), pointLights.size(), view, jobs);
+    });
+    const uint32_t mapNode = frameGraph.add("mapInstances", [&]() {
+        drawnObjects = options.culling ? culler.visibleCount() : objectCount;
+        models = instances.map(drawnObjects);
+    }, true);
+    const uint32_t instancesNode = frameGraph.add("instances", [&]() {
+        // As matrizes de modelo são escritas direto no buffer de instâncias, com as posições
+        // interpoladas e as transformações do teclado comuns a todos
+        if (!grouped)
+        {
+            instanceCount[0] = (uint32_t)drawnObjects;
+            if (models)
+                jobs.parallelFor(drawnObjects, instancesPerJob, [&](size_t begin, size_t end) {
+                    if (options.culling)
+                        culler.writeVisibleMatrices(local, models + begin, begin, end - begin);
+                    else
+                        writeTranslationMatrices(local, simFrame.x.data() + begin, simFrame.y.data() + begin,
+                            simFrame.z.data() + begin, end - begin, models + begin);
+                });
+            return;
+        }
 
-    while (!glfwWindowShouldClose(window))
+        // Grupo de cada objeto: a malha (objectModels) e o nível de detalhe cujo erro,
+        // projetado na tela à distância do objeto, fica abaixo de --lod-error pixels
+        for (size_t m = 0; m < meshes.size(); m++)
+            meshCenters[m] = glm::vec3(local * glm::vec4((meshes[m].boundsMin + meshes[m].boundsMax) * 0.5f, 1.0f));
+        const float pixelsPerUnit = height * 0.5f * projection[1][1] * scale;
+        const size_t chunks = (drawnObjects + instancesPerJob - 1) / instancesPerJob;
+        objectGroups.resize(drawnObjects);
+        chunkGroups.assign(chunks * groupCount, 0);
+        jobs.parallelFor(drawnObjects, instancesPerJob, [&](size_t begin, size_t end) {
+            uint32_t* counts = &chunkGroups[begin / instancesPerJob * groupCount];
+            for (size_t i = begin; i < end; i++)
+            {
+                size_t object = options.culling ? culler.visibleObject(i) : i;
+                const size_t m = objectModels[object];
+                const Mesh& mesh = meshes[m];
+                uint32_t level = 0;
+                if (options.lod && mesh.levels.size() > 1)
+                {
+                    float distance = glm::length(drawnPosition(i) + meshCenters[m] - cameraPos) - mesh.boundsRadius * scale;
+                    level = selectLod(mesh.levelErrors.data(), (uint32_t)mesh.levels.size(), distance, pixelsPerUnit,
+                        options.lodPixelError, objectLevels[object]);
+                    objectLevels[object] = (uint8_t)level;
+                }
+                objectGroups[i] = mesh.firstGroup + level;
+                counts[objectGroups[i]]++;
+            }
+        });
+
+        // Soma de prefixos na ordem (grupo, trecho): as instâncias de cada grupo ficam contíguas,
+        // na mesma ordem de uma passada só
+        uint32_t sum = 0;
+        for (size_t g = 0; g < groupCount; g++)
+        {
+            instanceFirst[g] = sum;
+            for (size_t c = 0; c < chunks; c++)
+            {
+                const uint32_t n = chunkGroups[c * groupCount + g];
+                chunkGroups[c * groupCount + g] = sum;
+                sum += n;
+            }
+            instanceCount[g] = sum - instanceFirst[g];
+        }
+        instancePositions.resize(drawnObjects);
+        jobs.parallelFor(drawnObjects, instancesPerJob, [&](size_t begin, size_t end) {
+            uint32_t* cursor = &chunkGroups[begin / instancesPerJob * groupCount];
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec3 position = drawnPosition(i);
+                uint32_t slot = cursor[objectGroups[i]]++;
+                instancePositions[slot] = position;
+                if (models)
+                {
+                    models[slot] = local;
+                    models[slot][3] += glm::vec4(position, 0.0f);
+                }
+            }
+        });
+    });
+    const uint32_t drawKeysNode = frameGraph.add("drawKeys", [&]() {
+        // Fila de desenhos: cada parte opaca é um desenho instanciado com todos os objetos da sua
+        // malha (o campo de profundidade fica 0); cada parte transparente vira um desenho por
+        // objeto, com a distância do centro do objeto à câmera. As posições de cada parte na fila
+        // são reservadas antes, e as chaves dos transparentes são geradas em paralelo
+        partBase.resize(parts.size());
+        size_t total = 0;
+        for (size_t p = 0; p < parts.size(); p++)
+        {
+            partBase[p] = total;
+            const uint32_t count = instanceCount[parts[p].group];
+            if (count)
+                total += drawMaterials[parts[p].material].transparent ? count : 1;
+        }
+        drawQueue.resize(total);
+        for (size_t p = 0; p < parts.size(); p++)
+        {
+            const DrawPart& part = parts[p];
+            const uint32_t first = instanceFirst[part.group], count = instanceCount[part.group];
+            if (!count)
+                continue;
+            const DrawMaterial& drawMaterial = drawMaterials[part.material];
+            const uint32_t texture = drawMaterial.texture == kInvalidTexture ? 0 : drawMaterial.texture + 1;
+            if (!drawMaterial.transparent)
+            {
+                drawQueue.set(partBase[p], opaqueSortKey(drawMaterial.programIndex, texture, part.material, 0), (uint32_t)p, first, count);
+                continue;
+            }
+            const Mesh& mesh = meshes[part.mesh];
+            const glm::vec3 center = glm::vec3(local * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            jobs.parallelFor(count, instancesPerJob, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++)
+                {
+                    const uint32_t slot = first + (uint32_t)k;
+                    glm::vec3 position = !grouped ? drawnPosition(slot) : instancePositions[slot];
+                    float depth = glm::dot(position + center - cameraPos, cameraFront);
+                    drawQueue.set(partBase[p] + k, transparentSortKey(depthBucket(depth, farPlane), drawMaterial.programIndex, texture,
+                        part.material), (uint32_t)p, slot, 1);
+                }
+            });
+        }
+        drawQueue.sort(jobs);
+    });
+    const uint32_t uploadLightsNode = frameGraph.add("uploadLights", [&]() {
+        // As luzes e as listas dos clusters vão para os SSBOs lidos pelo fragment shader
+        if (!options.lightCount)
+            return;
+        auto uploadStorage = [&](GLuint binding, const void* data, size_t bytes) {
+            // Um trecho vazio não pode ser ligado: reserva ao menos um vec4
+            UploadAllocation block = uploadRing.allocate(std::max<size_t>(bytes, 16), uploadRing.storageAlignment());
+            if (block.data && bytes)
+                memcpy(block.data, data, bytes);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, block.buffer, block.offset, block.size);
+        };
+        uploadStorage(2, pointLights.data(), pointLights.size() * sizeof(PointLight));
+        uploadStorage(3, lightClusters.clusters().data(), lightClusters.clusters().size() * sizeof(uint32_t));
+        uploadStorage(4, lightClusters.indices().data(), lightClusters.indices().size() * sizeof(uint32_t));
+    }, true);
+    frameGraph.depend(mapNode, cullingNode);
+    frameGraph.depend(instancesNode, mapNode);
+    frameGraph.depend(drawKeysNode, instancesNode);
+    frameGraph.depend(uploadLightsNode, lightsNode);
+
+    const size_t headlessFrames = options.warmupFrames + options.frames;
+    for (size_t frame = 0; options.headless ? frame < headlessFrames : !glfwWindowShouldClose(window); frame++)
     {
-        // Calcula o delta time do frame atual
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        PROFILE_SCOPE("frame");
+        gpuProfiler.beginFrame();
+        int gpuFrameScope = gpuProfiler.begin("frame");
+        glState.beginFrame();
+        // Espera (raramente) a GPU liberar o trecho do anel usado kFrames quadros atrás
+        uploadRing.beginFrame();
+
+        chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+        const bool measured = measureFrames && frame >= options.warmupFrames;
+        if (measured)
+        {
+            if (frame > options.warmupFrames)
+                report.frameMs.push_back(chrono::duration<double, milli>(frameStart - previousFrameStart).count());
+            else
+            {
+                measureStart = frameStart;
+                measureStartSteps = simulation.stats().steps;
+            }
+            previousFrameStart = frameStart;
+            gpuTimer.begin();
+        }
 
-        // Checa se houveram eventos de input (ex: teclado, mouse)
-        glfwPollEvents();
-        process_input(window);
+        if (!options.headless)
+        {
+            // Checa se houveram eventos de input (ex: teclado, mouse); os callbacks os põem na
+            // fila da simulação
+            PROFILE_SCOPE("input");
+            glfwPollEvents();
+        }
+
+        // Estado do quadro, interpolado entre os dois últimos passos da simulação
+        chrono::steady_clock::time_point prepStart = chrono::steady_clock::now();
+        if (options.headless)
+        {
+            const double time = frame * (double)headlessStep;
+            simulation.advanceTo(time);
+            simulation.interpolate(time, simFrame);
+        }
+        else
+        {
+            simulation.interpolate(simulation.clock() - simulation.step(), simFrame);
+        }
+        currentFrame = (float)simFrame.time;
+        scale = simFrame.scale;
 
-        // Limpa o buffer de cor
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (options.headless)
+        {
+            cameraPos = evaluatePath(cameraPath, currentFrame * cameraPath.rate);
+            cameraFront = glm::normalize(cameraTarget - cameraPos);
+        }
+        else
+        {
+            cameraPos = simFrame.camera.position;
+            cameraFront = simFrame.camera.front;
+            cameraUp = simFrame.camera.up;
+        }
 
-        glBindVertexArray(VAO);
-        glBindTexture(GL_TEXTURE_2D, texID);
+        // Limpa o buffer de cor (os transparentes do quadro anterior desligaram a escrita de profundidade)
+        glState.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glState.depthMask(true);
+        glState.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Atualiza a matriz de visualização (view) com base nas entradas do teclado e do mouse
         view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-    	tempo_percorrido += deltaTime;
-    	if (tempo_percorrido >= duracao_ponto) {
-    		tempo_percorrido = 0.0f;
-    		ponto_atual = (ponto_atual + 1) % pontos.size();
-    	}
-
-    	size_t proximo_ponto = (ponto_atual + 1) % pontos.size();
-    	float t = tempo_percorrido / duracao_ponto;
-    	translation = interpolar(pontos[ponto_atual], pontos[proximo_ponto], t);
-
-        // Atualiza a matriz de modelo (model) com base nas entradas do teclado
-        model = glm::translate(glm::mat4(1.0f), translation);
-        model = glm::scale(model, glm::vec3(scale, scale, scale));
-        if (rotateX) model = glm::rotate(model, (GLfloat)glfwGetTime(), glm::vec3(1.0f, 0.0f, 0.0f));
-        if (rotateY) model = glm::rotate(model, (GLfloat)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-        if (rotateZ) model = glm::rotate(model, (GLfloat)glfwGetTime(), glm::vec3(0.0f, 0.0f, 1.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-        // Draw the object
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glUniform1i(glGetUniformLocation(shaderID, "ourTexture"), 0);
-
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, nVerts);
-
-        // Swap buffers
-        glfwSwapBuffers(window);
-    }
 
-    glfwTerminate();
-    return 0;
-}
+        // Transformações do teclado comuns a todos os objetos
+        GLfloat angle = currentFrame;
+        local = glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, scale));
+        if (simFrame.rotateX) local = glm::rotate(local, angle, glm::vec3(1.0f, 0.0f, 0.0f));
+        if (simFrame.rotateY) local = glm::rotate(local, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        if (simFrame.rotateZ) local = glm::rotate(local, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        objectCount = simFrame.x.size();
 
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
-{
-    if (action == GLFW_PRESS || action == GLFW_REPEAT) {
-	    float velocity = 20.0f;
-        switch (key)
+        // Culling, luzes, instâncias e fila de desenhos (ver frameGraph); a thread principal
+        // executa os seus nós e ajuda nos outros
+        frameGraph.run(jobs);
+        instances.unmap(glState);
+        const double prepMs = chrono::duration<double, milli>(chrono::steady_clock::now() - prepStart).count();
+
+        textures.update();
+
+        // Draw the objects: na ordem das chaves, trocando programa, textura e mistura só quando mudam
         {
-        case GLFW_KEY_ESCAPE:
-            glfwSetWindowShouldClose(window, GL_TRUE);
-            break;
-        case GLFW_KEY_W:
-            cameraPos += cameraFront * deltaTime * velocity;
-            break;
-        case GLFW_KEY_S:
-            cameraPos -= cameraFront * deltaTime * velocity;
-            break;
-        case GLFW_KEY_A:
-            cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * deltaTime * velocity;
-            break;
-        case GLFW_KEY_D:
-            cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * deltaTime * velocity;
-            break;
-        case GLFW_KEY_Q:
-            translation.x += 0.1f;
-            break;
-        case GLFW_KEY_E:
-            translation.x -= 0.1f;
-            break;
-        case GLFW_KEY_R:
-            translation.y += 0.1f;
-            break;
-        case GLFW_KEY_F:
-            translation.y -= 0.1f;
-            break;
-        case GLFW_KEY_T:
-            translation.z += 0.1f;
-            break;
-        case GLFW_KEY_G:
-            translation.z -= 0.1f;
-            break;
-        case GLFW_KEY_Z:
-            scale += 0.1f;
-            break;
-        case GLFW_KEY_X:
-            scale -= 0.1f;
-            break;
-        case GLFW_KEY_1:
-            rotateX = !rotateX;
-            break;
-        case GLFW_KEY_2:
-            rotateY = !rotateY;
-            break;
-        case GLFW_KEY_3:
-            rotateZ = !rotateZ;
-            break;
-        default:
-            break;
+            PROFILE_SCOPE("draw");
+            PROFILE_GPU_SCOPE(gpuProfiler, "draw");
+            glState.bindVertexArray(geometry.vertexArray());
+            // Câmera e luz uma vez por quadro, para todos os programas. Todas as instâncias
+            // compartilham a parte 3x3 de 'local': uma matriz normal por quadro
+            {
+                const glm::mat3 normals = normalMatrix(local);
+                frameUniforms.view = view;
+                frameUniforms.projection = projection;
+                for (int c = 0; c < 3; c++)
+                    frameUniforms.normalMatrix[c] = glm::vec4(normals[c], 0.0f);
+                frameUniforms.viewPos = glm::vec4(cameraPos, 1.0f);
+                UploadAllocation frameBlock = uploadRing.allocate(sizeof(FrameUniforms), uploadRing.uniformAlignment());
+                if (frameBlock.data)
+                    memcpy(frameBlock.data, &frameUniforms, sizeof(FrameUniforms));
+                glState.bindBufferRange(GL_UNIFORM_BUFFER, 0, frameBlock.buffer, frameBlock.offset, frameBlock.size);
+            }
+            GLuint currentProgram = 0;
+            auto bindMaterial = [&](const DrawMaterial& drawMaterial) {
+                if (drawMaterial.program != currentProgram)
+                {
+                    currentProgram = drawMaterial.program;
+                    glState.useProgram(currentProgram);
+                }
+                if (drawMaterial.texture != kInvalidTexture)
+                    glState.bindTexture(0, GL_TEXTURE_2D, textures.texture(drawMaterial.texture));
+                if (drawMaterial.transparent)
+                {
+                    // Transparentes testam a profundidade dos opacos mas não a escrevem
+                    glState.enable(GL_BLEND);
+                    glState.depthMask(false);
+                }
+                else
+                {
+                    glState.disable(GL_BLEND);
+                    glState.depthMask(true);
+                }
+            };
+
+            if (multiDraw)
+            {
+                // Um comando indireto por desenho da fila, com material e caixa no buffer de dados;
+                // só programa, textura ou mistura diferentes abrem uma nova chamada
+                indirectCommands.clear();
+                drawData.clear();
+                drawBatches.clear();
+                for (const DrawCommand& command : drawQueue.commands())
+                {
+                    const DrawPart& part = parts[command.submesh];
+                    const Mesh& mesh = meshes[part.mesh];
+                    const DrawMaterial& drawMaterial = drawMaterials[part.material];
+                    const Material& material = drawMaterial.material;
+                    indirectCommands.push_back({ part.indexCount, command.instanceCount, mesh.geometry.firstIndex + part.indexOffset,
+                        mesh.geometry.baseVertex, command.firstInstance });
+                    drawData.push_back({ glm::vec4(mesh.boundsMin, 0.0f), glm::vec4(mesh.boundsMax - mesh.boundsMin, 0.0f),
+                        glm::vec4(material.Ka, drawMaterial.transparent ? material.d : 1.0f), glm::vec4(material.Kd, 0.0f),
+                        glm::vec4(material.Ks, material.Ns) });
+
+                    const DrawMaterial* previous = drawBatches.empty() ? nullptr : &drawMaterials[drawBatches.back().material];
+                    if (!previous || previous->program != drawMaterial.program || previous->texture != drawMaterial.texture
+                        || previous->transparent != drawMaterial.transparent)
+                        drawBatches.push_back({ (uint32_t)indirectCommands.size() - 1, 0, part.material });
+                    drawBatches.back().count++;
+                }
+                indirect.upload(indirectCommands, drawData, glState);
+                glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.commandBuffer());
+                for (const DrawBatch& batch : drawBatches)
+                {
+                    bindMaterial(drawMaterials[batch.material]);
+                    glState.setUniform("drawBase", (GLint)batch.first);
+                    glState.multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                        (const void*)(indirect.commandOffset() + batch.first * sizeof(DrawElementsIndirectCommand)),
+                        (GLsizei)batch.count, 0);
+                }
+            }
+            else
+            {
+                uint32_t currentMaterial = 0xFFFFFFFFu;
+                uint32_t currentMesh = 0xFFFFFFFFu;
+                for (const DrawCommand& command : drawQueue.commands())
+                {
+                    const DrawPart& part = parts[command.submesh];
+                    const Mesh& mesh = meshes[part.mesh];
+                    const DrawMaterial& drawMaterial = drawMaterials[part.material];
+                    if (drawMaterial.program != currentProgram)
+                        currentMaterial = currentMesh = 0xFFFFFFFFu;
+                    bindMaterial(drawMaterial);
+                    if (part.material != currentMaterial)
+                    {
+                        currentMaterial = part.material;
+                        glState.setUniform("Ka", drawMaterial.material.Ka);
+                        glState.setUniform("Kd", drawMaterial.material.Kd);
+                        glState.setUniform("Ks", drawMaterial.material.Ks);
+                        glState.setUniform("Ns", drawMaterial.material.Ns);
+                        glState.setUniform("opacity", drawMaterial.transparent ? drawMaterial.material.d : 1.0f);
+                    }
+                    if (part.mesh != currentMesh)
+                    {
+                        // Dequantização dos vértices compactos (só existe na variante PACKED_VERTICES)
+                        currentMesh = part.mesh;
+                        glState.setUniform("boundsMin", mesh.boundsMin);
+                        glState.setUniform("boundsExtent", mesh.boundsMax - mesh.boundsMin);
+                    }
+                    glState.setUniform("instanceBase", (GLint)command.firstInstance);
+                    glState.drawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)part.indexCount, GL_UNSIGNED_INT,
+                        (const void*)((size_t)(mesh.geometry.firstIndex + part.indexOffset) * sizeof(GLuint)),
+                        (GLsizei)command.instanceCount, mesh.geometry.baseVertex);
+                }
+            }
+        }
+
+        // Última leitura do anel no quadro: a fence protege o trecho até a GPU terminar
+        uploadRing.endFrame();
+
+        // Sem swap no modo headless: o flush faz o papel dele e entrega o quadro ao driver
+        if (options.headless)
+        {
+            PROFILE_SCOPE("flush");
+            glFlush();
+        }
+
+        if (measured)
+        {
+            gpuTimer.end();
+            report.cpuMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+            report.prepMs.push_back(prepMs);
+            const vector<JobTiming>& timings = frameGraph.timings();
+            if (report.jobNames.empty())
+                for (const JobTiming& timing : timings)
+                    report.jobNames.push_back(timing.name);
+            report.jobMs.resize(timings.size());
+            for (size_t n = 0; n < timings.size(); n++)
+                report.jobMs[n].push_back(timings[n].ms);
+            report.glCallsIssued += glState.frameCounters().issued;
+            report.glCallsElided += glState.frameCounters().elided;
+            report.drawCalls += glState.frameCounters().draws;
+            report.uploadBytes += uploadRing.stats().frameBytes;
+            for (size_t g = 0; g < groupCount; g++)
+                report.verticesPerFrame += (double)groupIndices[g] * instanceCount[g];
+            report.visibleObjects += drawnObjects;
+            if (options.culling)
+                report.cullMs.push_back(culler.stats().milliseconds);
+            if (options.lightCount)
+            {
+                report.lightAssignMs.push_back(lightClusters.stats().milliseconds);
+                report.lightReferences += lightClusters.stats().references;
+                report.maxLightsPerCluster = std::max(report.maxLightsPerCluster, lightClusters.stats().maxPerCluster);
+            }
+            gpuTimer.collect();
+        }
+
+        if (options.headless)
+        {
+            // Quadros pedidos em --dump-frames viram imagens para comparação
+            if (find(options.dumpFrames.begin(), options.dumpFrames.end(), frame) != options.dumpFrames.end())
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "_%04zu.", frame);
+                string path = options.dumpPrefix + name + options.dumpFormat;
+                PROFILE_SCOPE("readPixels");
+                headless.readPixels(pixels);
+                if (!saveFrameImage(path, width, height, pixels))
+                    cout << "Nao foi possivel gravar " << path << endl;
+            }
+        }
+        else
+        {
+            // Swap buffers
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+        }
+
+        gpuProfiler.end(gpuFrameScope);
+        gpuProfiler.endFrame();
+        if (options.profile && options.profileSummaryFrames && (frame + 1) % options.profileSummaryFrames == 0)
+        {
+            int64_t now = profilerNow();
+            printProfileSummary(cout, summaryStart, options.profileSummaryFrames, &gpuProfiler);
+            cout << "  GL: " << glState.lastFrameCounters().issued << " chamadas, "
+                << glState.lastFrameCounters().elided << " evitadas no ultimo quadro, "
+                << drawQueue.size() << " desenhos em " << glState.lastFrameCounters().draws << " chamadas" << endl;
+            cout << "  Texturas: " << textures.stats().resident << "/" << textures.stats().requested << " residentes, "
+                << textures.stats().bytesUploaded / 1024 << " KB enviados, "
+                << textures.stats().residentBytes / 1024 << " KB na GPU (" << textures.stats().uncompressedBytes / 1024
+                << " KB sem compressao), " << textures.stats().cacheHits << " do cache" << endl;
+            cout << "  Envio: " << uploadRing.stats().frameBytes / 1024 << " KB no ultimo quadro de "
+                << uploadRing.stats().capacity / 1024 << " KB por trecho, " << uploadRing.stats().fenceWaits << " esperas por fence ("
+                << uploadRing.stats().fenceWaitMs << " ms), " << uploadRing.stats().grows << " realocacoes" << endl;
+            {
+                // Ritmos da simulação e da renderização no intervalo do resumo (independentes com a thread)
+                const SimulationStats sim = simulation.stats();
+                const double seconds = (now - summaryStart) * 1e-9;
+                cout << "  Simulacao: " << (sim.steps - summarySim.steps) / seconds << " passos/s (alvo " << options.simRate
+                    << "), " << options.profileSummaryFrames / seconds << " quadros/s, " << sim.stepMs << " ms por passo, "
+                    << sim.events - summarySim.events << " eventos, " << sim.droppedEvents << " descartados, "
+                    << sim.skippedSteps << " passos pulados" << endl;
+                summarySim = sim;
+            }
+            {
+                // Nós do grafo de preparo no último quadro: duração, início relativo ao grafo e worker
+                const JobStats jobStats = jobs.stats();
+                cout << "  Tarefas: " << jobs.workerCount() << " threads, " << jobStats.executed << " executadas, "
+                    << jobStats.stolen << " roubadas, " << jobStats.injected << " de fora do sistema;";
+                for (const JobTiming& timing : frameGraph.timings())
+                    cout << " " << timing.name << " " << timing.ms << " ms (+" << timing.startMs << ", worker " << timing.worker << ")";
+                cout << endl;
+            }
+            if (grouped && options.lod)
+            {
+                // Instâncias por nível de detalhe, somando as malhas
+                vector<size_t> perLevel;
+                for (const Mesh& mesh : meshes)
+                    for (size_t level = 0; level < mesh.levels.size(); level++)
+                    {
+                        if (perLevel.size() <= level)
+                            perLevel.resize(level + 1, 0);
+                        perLevel[level] += instanceCount[mesh.firstGroup + level];
+                    }
+                cout << "  LOD: instancias por nivel";
+                for (size_t level = 0; level < perLevel.size(); level++)
+                    cout << (level ? ", " : " ") << perLevel[level];
+                cout << endl;
+            }
+            if (options.lightCount)
+                cout << "  Luzes: " << lightClusters.stats().visibleLights << " de " << lightClusters.stats().lights
+                    << " no frustum, " << lightClusters.stats().references << " referencias em " << lightClusters.stats().usedClusters
+                    << " clusters (ate " << lightClusters.stats().maxPerCluster << " por cluster), "
+                    << lightClusters.stats().milliseconds << " ms no ultimo quadro" << endl;
+            if (options.culling)
+                cout << "  Culling: " << culler.stats().visible << " visiveis, " << culler.stats().culled << " descartados, "
+                    << culler.stats().nodesVisited << " nos, " << culler.stats().rebuiltObjects << " reconstruidos, "
+                    << culler.stats().milliseconds << " ms no ultimo quadro" << endl;
+            summaryStart = now;
+        }
+        if (traceRequested)
+        {
+            traceRequested = false;
+            if (writeChromeTrace(options.profileTracePath, &gpuProfiler))
+                cout << "Trace gravado em " << options.profileTracePath << endl;
         }
     }
-}
 
-void mouse_callback(GLFWwindow* window, double xpos, double ypos)
-{
-    if (firstMouse)
+    if (options.profile)
     {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
+        if (writeChromeTrace(options.profileTracePath, &gpuProfiler))
+            cout << "Trace gravado em " << options.profileTracePath << endl;
+        gpuProfiler.destroy();
     }
 
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos;
-    lastX = xpos;
-    lastY = ypos;
+    if (measureFrames)
+    {
+        gpuTimer.collect(true);
+        gpuTimer.destroy();
+        report.gpuMs = gpuTimer.results();
+        report.renderer = (const char*)renderer;
+        report.version = (const char*)version;
+        report.width = width;
+        report.height = height;
+        report.objects = animation.objectCount();
+        report.normalMatrix = options.normalMatrixPerVertex ? "shader" : "cpu";
+        report.lod = options.lod;
+        report.lights = options.lightCount;
+        report.jobWorkers = jobs.workerCount();
+        report.fenceWaits = uploadRing.stats().fenceWaits;
+        report.fenceWaitMs = uploadRing.stats().fenceWaitMs;
+        const SimulationStats sim = simulation.stats();
+        const double measuredSeconds = chrono::duration<double>(previousFrameStart - measureStart).count();
+        report.simRate = options.simRate;
+        report.simStepMs = sim.stepMs;
+        report.simSkippedSteps = sim.skippedSteps;
+        report.droppedEvents = sim.droppedEvents;
+        if (measuredSeconds > 0.0)
+        {
+            report.simStepsPerSecond = (sim.steps - measureStartSteps) / measuredSeconds;
+            report.framesPerSecond = report.frameMs.size() / measuredSeconds;
+        }
+        if (!report.cpuMs.empty())
+        {
+            report.glCallsIssued /= report.cpuMs.size();
+            report.glCallsElided /= report.cpuMs.size();
+            report.drawCalls /= report.cpuMs.size();
+            report.uploadBytes /= report.cpuMs.size();
+            report.verticesPerFrame /= report.cpuMs.size();
+            report.visibleObjects /= report.cpuMs.size();
+            report.lightReferences /= report.cpuMs.size();
+        }
 
-    float sensitivity = 0.1f;
-    xoffset *= sensitivity;
-    yoffset *= sensitivity;
+        TimingStats cpu = computeTimingStats(report.cpuMs), gpu = computeTimingStats(report.gpuMs);
+        cout << report.cpuMs.size() << " quadros: CPU min " << cpu.min << " ms, mediana " << cpu.median << " ms, p99 " << cpu.p99
+            << " ms | GPU min " << gpu.min << " ms, mediana " << gpu.median << " ms, p99 " << gpu.p99 << " ms" << endl;
+        cout << "Chamadas GL por quadro: " << report.glCallsIssued << " enviadas, " << report.glCallsElided << " evitadas, "
+            << report.drawCalls << " de desenho (" << (multiDraw ? "multi-draw indireto" : "uma por parte") << ")" << endl;
+        cout << "Envio por quadro: " << report.uploadBytes / 1024.0 << " KB, " << report.fenceWaits << " esperas por fence ("
+            << report.fenceWaitMs << " ms no total)" << endl;
+        cout << "Simulacao: " << report.simStepsPerSecond << " passos/s (alvo " << report.simRate << "), "
+            << report.framesPerSecond << " quadros/s, " << report.simStepMs << " ms por passo, "
+            << report.simSkippedSteps << " passos pulados" << endl;
+        {
+            TimingStats prep = computeTimingStats(report.prepMs);
+            cout << "Preparo: mediana " << prep.median << " ms, p99 " << prep.p99 << " ms com " << report.jobWorkers
+                << " threads; mediana por no:";
+            for (size_t n = 0; n < report.jobNames.size(); n++)
+                cout << (n ? ", " : " ") << report.jobNames[n] << " " << computeTimingStats(report.jobMs[n]).median << " ms";
+            cout << endl;
+        }
+        if (options.culling)
+        {
+            TimingStats cull = computeTimingStats(report.cullMs);
+            cout << "Culling: " << report.visibleObjects << " de " << report.objects << " objetos visiveis em media, mediana "
+                << cull.median << " ms, p99 " << cull.p99 << " ms" << endl;
+        }
+        if (options.lightCount)
+        {
+            TimingStats assign = computeTimingStats(report.lightAssignMs);
+            cout << "Luzes: " << report.lights << " em " << LightClusters::kClusterCount << " clusters, "
+                << report.lightReferences << " referencias por quadro em media, ate " << report.maxLightsPerCluster
+                << " por cluster; atribuicao mediana " << assign.median << " ms, p99 " << assign.p99 << " ms" << endl;
+        }
+        // Vazão de vértices pela mediana da GPU (compare com e sem --normal-matrix-per-vertex)
+        if (gpu.median > 0.0)
+            cout << "Vertices: " << report.verticesPerFrame << " por quadro, " << report.verticesPerFrame / (gpu.median * 1000.0)
+                << " milhoes/s (matriz normal na " << report.normalMatrix << ", niveis de detalhe "
+                << (report.lod ? "ligados" : "desligados") << ")" << endl;
+        if (!options.benchJsonPath.empty() && !writeBenchmarkJson(options.benchJsonPath, report))
+            cout << "Nao foi possivel gravar " << options.benchJsonPath << endl;
+    }
 
-    yaw += xoffset;
-    pitch += yoffset;
+    // Texturas: o tempo de preparo e a memória de vídeo vêm do streamer
+    for (const auto& texture : textureAssets)
+    {
+        assets.addLoadTime(texture.first, textures.prepareMs(texture.second));
+        assets.setResidentBytes(texture.first, textures.residentBytes(texture.second));
+    }
+    assets.printReport(cout);
+
+    simulation.destroy();
+    jobs.destroy();
+    shaders.destroy();
+    textures.destroy();
+    instances.destroy();
+    indirect.destroy();
+    uploadRing.destroy();
+    geometry.destroy();
+    if (options.headless)
+        headless.destroy();
+    else
+        glfwTerminate();
+    return 0;
+}
 
-    if (pitch > 89.0f)
-        pitch = 89.0f;
-    if (pitch < -89.0f)
-        pitch = -89.0f;
+void parseArguments(int argc, char** argv)
+{
+	unsigned hw = std::thread::hardware_concurrency();
+	options.loaderThreads = hw > 0 ? hw : 1;
+	options.jobThreads = hw > 0 ? hw : 1;
 
-    glm::vec3 front;
-    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    front.y = sin(glm::radians(pitch));
-    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    cameraFront = glm::normalize(front);
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			int n = atoi(argv[++i]);
+			options.loaderThreads = n > 0 ? n : 1;
+		}
+		else if (strcmp(argv[i], "--rebuild-cache") == 0)
+		{
+			options.rebuildMeshCache = true;
+		}
+		else if (strcmp(argv[i], "--packed-vertices") == 0)
+		{
+			options.packedVertices = true;
+		}
+		else if (strcmp(argv[i], "--quant-report") == 0 && i + 1 < argc)
+		{
+			options.quantReportPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+		{
+			options.pathFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--convert-path") == 0 && i + 2 < argc)
+		{
+			options.convertPathInput = argv[++i];
+			options.convertPathOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.objectCount = n > 0 ? (size_t)n : 1;
+		}
+		else if (strcmp(argv[i], "--interp") == 0 && i + 1 < argc)
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "linear") == 0)
+				options.interpolation = INTERP_LINEAR;
+			else if (strcmp(mode, "catmull-rom") == 0)
+				options.interpolation = INTERP_CATMULL_ROM;
+			else if (strcmp(mode, "arc-length") == 0)
+				options.interpolation = INTERP_ARC_LENGTH;
+			else
+				std::cout << "Interpolacao desconhecida: " << mode << " (use linear, catmull-rom ou arc-length)" << std::endl;
+		}
+		else if (strcmp(argv[i], "--bench-anim") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.animBenchmarkObjects = n > 0 ? (size_t)n : 0;
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			options.headless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.frames = n > 0 ? (size_t)n : 1;
+		}
+		else if (strcmp(argv[i], "--warmup-frames") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.warmupFrames = n > 0 ? (size_t)n : 0;
+		}
+		else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+		{
+			options.cameraPathFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc)
+		{
+			options.benchJsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc)
+		{
+			// Lista separada por vírgulas
+			std::stringstream list(argv[++i]);
+			string item;
+			while (std::getline(list, item, ','))
+				if (!item.empty())
+					options.dumpFrames.push_back((size_t)atol(item.c_str()));
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			options.profile = true;
+		}
+		else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc)
+		{
+			options.profile = true;
+			options.profileTracePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--profile-summary") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.profileSummaryFrames = n > 0 ? (size_t)n : 0;
+		}
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+		{
+			long kb = atol(argv[++i]);
+			options.textureUploadBudget = kb > 0 ? (size_t)kb * 1024 : 0;
+		}
+		else if (strcmp(argv[i], "--no-culling") == 0)
+		{
+			options.culling = false;
+		}
+		else if (strcmp(argv[i], "--normal-matrix-per-vertex") == 0)
+		{
+			options.normalMatrixPerVertex = true;
+		}
+		else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+		{
+			options.shaderCacheDir = argv[++i];
+		}
+		else if (strcmp(argv[i], "--uncompressed-textures") == 0)
+		{
+			options.compressTextures = false;
+		}
+		else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+		{
+			options.meshPaths.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+		{
+			options.scenePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-multi-draw") == 0)
+		{
+			options.multiDraw = false;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			options.lod = false;
+		}
+		else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc)
+		{
+			float pixels = (float)atof(argv[++i]);
+			options.lodPixelError = pixels > 0.0f ? pixels : 1.0f;
+		}
+		else if (strcmp(argv[i], "--software") == 0)
+		{
+			options.software = true;
+		}
+		else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+		{
+			long n = atol(argv[++i]);
+			options.lightCount = n > 0 ? (size_t)n : 0;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+		{
+			int n = atoi(argv[++i]);
+			options.jobThreads = n > 0 ? n : 1;
+		}
+		else if (strcmp(argv[i], "--self-check") == 0)
+		{
+			options.selfCheck = true;
+		}
+		else if (strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc)
+		{
+			double rate = atof(argv[++i]);
+			options.simRate = rate > 0.0 ? rate : 120.0;
+		}
+		else if (strcmp(argv[i], "--dump-prefix") == 0 && i + 1 < argc)
+		{
+			options.dumpPrefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "--dump-format") == 0 && i + 1 < argc)
+		{
+			options.dumpFormat = argv[++i];
+			if (options.dumpFormat != "ppm" && options.dumpFormat != "png")
+			{
+				std::cout << "Formato de imagem desconhecido: " << options.dumpFormat << " (use ppm ou png)" << std::endl;
+				options.dumpFormat = "ppm";
+			}
+		}
+		else
+		{
+			std::cout << "Opcao desconhecida: " << argv[i] << std::endl;
+			std::cout << "Uso: compgraf [--threads N] [--rebuild-cache] [--packed-vertices] [--quant-report arquivo.obj]"
+				<< " [--objects N] [--interp linear|catmull-rom|arc-length] [--bench-anim N]"
+				<< " [--headless] [--frames N] [--warmup-frames N] [--camera-path arquivo] [--bench-json arquivo]"
+				<< " [--dump-frames 0,10,99] [--dump-prefix caminho] [--dump-format ppm|png]"
+				<< " [--profile] [--profile-trace arquivo.json] [--profile-summary N] [--texture-budget KB] [--uncompressed-textures]"
+				<< " [--shader-cache pasta] [--normal-matrix-per-vertex] [--no-culling] [--mesh arquivo.obj] [--scene arquivo]"
+				<< " [--path arquivo.txt|arquivo.traj] [--convert-path entrada.txt saida.traj]"
+				<< " [--no-multi-draw] [--no-lod] [--lod-error px] [--sim-rate Hz] [--software] [--lights N] [--jobs N]"
+				<< " [--self-check]" << std::endl;
+		}
+	}
+	if (options.meshPaths.empty())
+		options.meshPaths.push_back("../cube.obj");
+}
 
-	glm::vec3 right = glm::normalize(glm::cross(cameraFront,
-	glm::vec3(0.0,1.0,0.0)));
-	cameraUp = glm::normalize(glm::cross(right, cameraFront));
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
+{
+    // Fechar a janela e o trace ficam aqui; o resto vira um evento para a simulação
+    InputEvent event;
+    event.pressed = action == GLFW_PRESS || action == GLFW_REPEAT;
+    switch (key)
+    {
+    case GLFW_KEY_ESCAPE:
+        if (event.pressed)
+            glfwSetWindowShouldClose(window, GL_TRUE);
+        return;
+    case GLFW_KEY_F9:
+        if (event.pressed)
+            traceRequested = options.profile;
+        return;
+    case GLFW_KEY_W:
+        event.action = INPUT_MOVE_FORWARD;
+        break;
+    case GLFW_KEY_S:
+        event.action = INPUT_MOVE_BACK;
+        break;
+    case GLFW_KEY_A:
+        event.action = INPUT_MOVE_LEFT;
+        break;
+    case GLFW_KEY_D:
+        event.action = INPUT_MOVE_RIGHT;
+        break;
+    case GLFW_KEY_Z:
+        event.action = INPUT_SCALE_UP;
+        break;
+    case GLFW_KEY_X:
+        event.action = INPUT_SCALE_DOWN;
+        break;
+    case GLFW_KEY_1:
+        event.action = INPUT_TOGGLE_ROTATE_X;
+        break;
+    case GLFW_KEY_2:
+        event.action = INPUT_TOGGLE_ROTATE_Y;
+        break;
+    case GLFW_KEY_3:
+        event.action = INPUT_TOGGLE_ROTATE_Z;
+        break;
+    default:
+        return;
+    }
+    simulation.pushEvent(event);
 }
 
-void process_input(GLFWwindow *window)
+void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
-    // Checa se houveram eventos de input (ex: teclado, mouse)
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+    InputEvent event;
+    event.action = INPUT_LOOK;
+    event.x = (float)xpos;
+    event.y = (float)ypos;
+    simulation.pushEvent(event);
 }
 
-//Esta função está basntante hardcoded - objetivo é compilar e "buildar" um programa de
-// shader simples e único neste exemplo de código
-// O código fonte do vertex e fragment shader está nos arrays vertexShaderSource e
-// fragmentShader source no iniçio deste arquivo
-// A função retorna o identificador do programa de shader
-int setupShader()
+// Cena de --scene ou, sem ela, um modelo por malha de --mesh ('modelosGrade', revezados entre os
+// objetos da grade) e o caminho de --path. Os arquivos citados ficam pedidos ao cache
+bool carregarCena(Scene& cena, vector<uint32_t>& modelosGrade)
 {
-	// Vertex shader
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-	// Checando erros de compilação (exibição via log no terminal)
-	GLint success;
-	GLchar infoLog[512];
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	if (!success)
+	if (!options.scenePath.empty())
+	{
+		if (!loadScene(options.scenePath, assets, cena))
+			return false;
+		// O trecho inicial do anel de envio comporta as matrizes de todas as instâncias
+		options.objectCount = cena.instanceCount();
+		cout << "Cena " << options.scenePath << ": " << cena.objects.size() << " objetos (" << options.objectCount
+			<< " instancias), " << cena.meshes.size() << " malhas, " << cena.models.size() << " combinacoes de malha e material" << endl;
+		return true;
+	}
+
+	for (const string& path : options.meshPaths)
+		modelosGrade.push_back(cena.addModel(assets.request(ASSET_MESH, path), nullptr));
+	if (isTrajectoryFile(options.pathFile))
 	{
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-	// Fragment shader
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-	// Checando erros de compilação (exibição via log no terminal)
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success)
+		const AssetId arquivo = assets.request(ASSET_TRAJECTORY, options.pathFile);
+		trajetoria = &assets.trajectory(arquivo);
+		if (!trajetoria->isOpen())
+		{
+			std::cerr << "Erro ao abrir a trajetoria: " << options.pathFile << ". Encerrando a aplicação." << std::endl;
+			return false;
+		}
+		cout << "Trajetoria " << options.pathFile << ": " << trajetoria->sampleCount() << " amostras, "
+			<< trajetoria->duration() << " s" << endl;
+		return true;
+	}
+	const AssetId caminho = assets.request(ASSET_PATH, options.pathFile);
+	if (!assets.stats(caminho).readable)
+		std::cerr << "Erro ao abrir o arquivo de pontos: " << assets.path(caminho) << std::endl;
+	pontos = assets.points(caminho);
+	if (pontos.empty())
 	{
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-	// Linkando os shaders e criando o identificador do programa de shader
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-	// Checando por erros de linkagem
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-	}
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-
-	return shaderProgram;
+		std::cerr << "Nenhum ponto foi carregado. Encerrando a aplicação." << std::endl;
+		return false;
+	}
+	return true;
 }
 
-// Esta função está bastante harcoded - objetivo é criar os buffers que armazenam a
-// geometria de um triângulo
-// Apenas atributo coordenada nos vértices
-// 1 VBO com as coordenadas, VAO com apenas 1 ponteiro para atributo
-// A função retorna o identificador do VAO
-int setupGeometry()
+void criarTodosObjetos(const Scene& cena, const vector<uint32_t>& modelosGrade, vector<uint32_t>& modelos)
 {
-	// Aqui setamos as coordenadas x, y e z do triângulo e as armazenamos de forma
-	// sequencial, já visando mandar para o VBO (Vertex Buffer Objects)
-	// Cada atributo do vértice (coordenada, cores, coordenadas de textura, normal, etc)
-	// Pode ser arazenado em um VBO único ou em VBOs separados
-	GLfloat vertices[] = {
-		// Face frontal (vermelho)
-		// Triângulo 1
-		-0.5, -0.5,  0.5, 1.0, 0.0, 0.0,
-		 0.5, -0.5,  0.5, 1.0, 0.0, 0.0,
-		 0.5,  0.5,  0.5, 1.0, 0.0, 0.0,
-		// Triângulo 2
-		-0.5, -0.5,  0.5, 1.0, 0.0, 0.0,
-		 0.5,  0.5,  0.5, 1.0, 0.0, 0.0,
-		-0.5,  0.5,  0.5, 1.0, 0.0, 0.0,
-
-		// Face traseira (verde)
-		// Triângulo 3
-		-0.5, -0.5, -0.5, 0.0, 1.0, 0.0,
-		 0.5, -0.5, -0.5, 0.0, 1.0, 0.0,
-		 0.5,  0.5, -0.5, 0.0, 1.0, 0.0,
-		// Triângulo 4
-		-0.5, -0.5, -0.5, 0.0, 1.0, 0.0,
-		 0.5,  0.5, -0.5, 0.0, 1.0, 0.0,
-		-0.5,  0.5, -0.5, 0.0, 1.0, 0.0,
-
-		// Face superior (azul)
-		// Triângulo 5
-		-0.5,  0.5,  0.5, 0.0, 0.0, 1.0,
-		 0.5,  0.5,  0.5, 0.0, 0.0, 1.0,
-		 0.5,  0.5, -0.5, 0.0, 0.0, 1.0,
-		// Triângulo 6
-		-0.5,  0.5,  0.5, 0.0, 0.0, 1.0,
-		 0.5,  0.5, -0.5, 0.0, 0.0, 1.0,
-		-0.5,  0.5, -0.5, 0.0, 0.0, 1.0,
-
-		// Face inferior (amarelo)
-		// Triângulo 7
-		-0.5, -0.5,  0.5, 1.0, 1.0, 0.0,
-		 0.5, -0.5,  0.5, 1.0, 1.0, 0.0,
-		 0.5, -0.5, -0.5, 1.0, 1.0, 0.0,
-		// Triângulo 8
-		-0.5, -0.5,  0.5, 1.0, 1.0, 0.0,
-		 0.5, -0.5, -0.5, 1.0, 1.0, 0.0,
-		-0.5, -0.5, -0.5, 1.0, 1.0, 0.0,
-
-		// Face esquerda (magenta)
-		// Triângulo 9
-		-0.5, -0.5,  0.5, 1.0, 0.0, 1.0,
-		-0.5,  0.5,  0.5, 1.0, 0.0, 1.0,
-		-0.5,  0.5, -0.5, 1.0, 0.0, 1.0,
-		// Triângulo 10
-		-0.5, -0.5,  0.5, 1.0, 0.0, 1.0,
-		-0.5,  0.5, -0.5, 1.0, 0.0, 1.0,
-		-0.5, -0.5, -0.5, 1.0, 0.0, 1.0,
-
-		// Face direita (ciano)
-		// Triângulo 11
-		 0.5, -0.5,  0.5, 0.0, 1.0, 1.0,
-		 0.5,  0.5,  0.5, 0.0, 1.0, 1.0,
-		 0.5,  0.5, -0.5, 0.0, 1.0, 1.0,
-		// Triângulo 12
-		 0.5, -0.5,  0.5, 0.0, 1.0, 1.0,
-		 0.5,  0.5, -0.5, 0.0, 1.0, 1.0,
-		 0.5, -0.5, -0.5, 0.0, 1.0, 1.0,
-
-	};
-
+	if (!options.scenePath.empty())
+	{
+		criarObjetosCena(animation, cena, options.interpolation, modelos);
+		return;
+	}
+	criarObjetos(animation, options.objectCount, options.interpolation);
+	modelos.resize(animation.objectCount());
+	for (size_t i = 0; i < modelos.size(); i++)
+		modelos[i] = modelosGrade[i % modelosGrade.size()];
+}
 
-	GLuint VBO, VAO;
+bool openCachedOBJ(string filepath, glm::vec3 color, LoadedOBJ& obj)
+{
+	PROFILE_SCOPE("openCachedOBJ");
+	auto start = std::chrono::steady_clock::now();
+
+	// Caminho rápido: cache binário válido ao lado do OBJ, mapeado e enviado depois direto ao VBO
+	string cachePath = meshCachePath(filepath);
+	VertexFormat format = options.packedVertices ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FLOAT;
+	if (options.rebuildMeshCache || !openMeshCache(cachePath, color, format, obj.cacheFile, obj.cache))
+		return false;
+
+	uint64_t indices = 0;
+	const SubMesh* submeshes = obj.cache.levelSubmeshes(0);
+	for (uint32_t s = 0; s < obj.cache.header->submeshCount; s++)
+		indices += submeshes[s].indexCount;
+	obj.log << "OBJ " << filepath << ": cache " << cachePath << " (" << obj.cache.header->vertexCount << " vertices de "
+		<< obj.cache.header->vertexStride << " bytes, " << indices / 3 << " triangulos, "
+		<< obj.cache.header->levelCount << " niveis de detalhe) em "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << endl;
+	return true;
+}
 
-	//Geração do identificador do VBO
-	glGenBuffers(1, &VBO);
+void loadSimpleOBJ(string filepath, glm::vec3 color, MeshData& meshData, vector<string>& sources, ostream& log)
+{
+	PROFILE_SCOPE("loadSimpleOBJ");
+	ObjData obj;
+	ObjParseStats stats;
+	if (loadOBJFile(filepath, obj, &stats, options.loaderThreads))
+	{
+		log << "OBJ " << filepath << ": " << obj.positions.size() << " vertices, "
+			<< obj.triangleCount() << " triangulos, " << stats.seconds * 1000.0 << " ms, "
+			<< stats.megabytesPerSecond() << " MB/s (" << stats.threads << " threads)" << endl;
+		if (stats.malformedLines || stats.droppedTriangles)
+		{
+			log << "Aviso: " << stats.malformedLines << " linhas mal formadas e "
+				<< stats.droppedTriangles << " triangulos com indices invalidos ignorados" << endl;
+		}
 
-	//Faz a conexão (vincula) do buffer como um buffer de array
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		// Cada trinca v/vt/vn distinta vira um único vértice, referenciado pelos índices
+		MeshBuildStats buildStats;
+		buildIndexedMesh(obj, color, meshData, &buildStats);
+		size_t indexBytes = meshData.indices.size() * (meshData.fitsShortIndices() ? sizeof(GLushort) : sizeof(GLuint));
+		log << "Malha indexada: " << buildStats.corners << " -> " << buildStats.uniqueVertices << " vertices ("
+			<< buildStats.corners * kVertexFloats * sizeof(GLfloat) / 1024 << " KB -> "
+			<< (meshData.vertices.size() * sizeof(GLfloat) + indexBytes) / 1024 << " KB com indices), ACMR "
+			<< buildStats.acmrBefore << " -> " << buildStats.acmrAfter << ", " << meshData.submeshes.size() << " submalhas" << endl;
+
+		// Materiais das bibliotecas citadas em "mtllib" (caminhos relativos ao OBJ)
+		sources.push_back(filepath);
+		string directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+		std::unordered_map<std::string, Material> libraryMaterials;
+		for (const string& library : obj.materialLibraries)
+		{
+			string mtlPath = directory + library;
+			// Pelo cache de assets: um MTL citado por várias malhas é lido uma vez
+			const std::unordered_map<std::string, Material>& loaded = assets.materials(assets.request(ASSET_MATERIAL, mtlPath));
+			// Um nome repetido em outra biblioteca não substitui o primeiro
+			libraryMaterials.insert(loaded.begin(), loaded.end());
+			sources.push_back(mtlPath);
+		}
+		// As submalhas apontam para os nomes de "usemtl" na ordem do primeiro uso
+		for (const string& name : obj.materialNames)
+		{
+			auto found = libraryMaterials.find(name);
+			if (found == libraryMaterials.end())
+				log << "Aviso: material " << name << " nao encontrado nas bibliotecas de " << filepath << endl;
+			meshData.materials.push_back({ name, found != libraryMaterials.end() ? found->second : materialPadrao() });
+		}
+	}
+	else
+	{
+		log << "Problema ao encontrar o arquivo " << filepath << endl;
+	}
+}
 
-	//Envia os dados do array de floats para o buffer da OpenGl
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+Mesh storeMesh(GeometryPool& geometry, string filepath, glm::vec3 color, const MeshData& meshData, const vector<string>& sources)
+{
+	// Mesmo quando não for possível gravar o cache, a imagem em memória é usada para o envio
+	string cachePath = meshCachePath(filepath);
+	VertexFormat format = options.packedVertices ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FLOAT;
+	vector<char> image = serializeMeshCache(meshData, color, format, sources, cachePath);
+	if (!sources.empty() && !saveMeshCache(cachePath, image))
+		cout << "Aviso: nao foi possivel gravar o cache de malha " << cachePath << endl;
+	MeshCacheView cache;
+	cache.parse(image.data(), image.size(), cachePath);
+	return uploadMesh(geometry, cache);
+}
 
-	//Geração do identificador do VAO (Vertex Array Object)
-	glGenVertexArrays(1, &VAO);
+Mesh uploadMesh(GeometryPool& geometry, const MeshCacheView& meshData)
+{
+	Mesh mesh;
+	mesh.geometry = geometry.add(meshData);
+	mesh.boundsMin = meshData.boundsMin();
+	mesh.boundsMax = meshData.boundsMax();
+	mesh.boundsRadius = meshData.boundsRadius();
+	// Uma malha recusada pelo pool fica sem níveis (nada a desenhar)
+	if (mesh.geometry.indexCount)
+	{
+		mesh.levels.resize(meshData.header->levelCount);
+		for (uint32_t level = 0; level < meshData.header->levelCount; level++)
+		{
+			const SubMesh* submeshes = meshData.levelSubmeshes(level);
+			MeshLevel& meshLevel = mesh.levels[level];
+			meshLevel.submeshes.assign(submeshes, submeshes + meshData.header->submeshCount);
+			for (const SubMesh& submesh : meshLevel.submeshes)
+				meshLevel.nIndices += (GLsizei)submesh.indexCount;
+			mesh.levelErrors.push_back(meshData.levelErrors[level]);
+		}
+	}
+	mesh.materials = meshData.materials;
+	return mesh;
+}
 
-	// Vincula (bind) o VAO primeiro, e em seguida  conecta e seta o(s) buffer(s) de vértices
-	// e os ponteiros para os atributos
-	glBindVertexArray(VAO);
+int quantizationReport(string filepath)
+{
+	ObjData obj;
+	if (!loadOBJFile(filepath, obj, nullptr, options.loaderThreads))
+	{
+		cout << "Problema ao encontrar o arquivo " << filepath << endl;
+		return -1;
+	}
 
-	//Para cada atributo do vertice, criamos um "AttribPointer" (ponteiro para o atributo), indicando:
-	// Localização no shader * (a localização dos atributos devem ser correspondentes no layout especificado no vertex shader)
-	// Numero de valores que o atributo tem (por ex, 3 coordenadas xyz)
-	// Tipo do dado
-	// Se está normalizado (entre zero e um)
-	// Tamanho em bytes
-	// Deslocamento a partir do byte zero
+	MeshData meshData;
+	buildIndexedMesh(obj, glm::vec3(0.0f), meshData);
+	vector<PackedVertex> packed;
+	packVertices(meshData, packed);
+	QuantizationError error = measureQuantizationError(meshData, packed);
+
+	size_t floatBytes = meshData.vertexCount() * kVertexFloats * sizeof(GLfloat);
+	size_t packedBytes = packed.size() * sizeof(PackedVertex);
+	cout << "Quantizacao de " << filepath << " (" << meshData.vertexCount() << " vertices)" << endl;
+	cout << "  tamanho: " << floatBytes / 1024 << " KB (" << kVertexFloats * sizeof(GLfloat) << " B/vertice) -> "
+		<< packedBytes / 1024 << " KB (" << sizeof(PackedVertex) << " B/vertice)" << endl;
+	cout << "  posicao: erro max " << error.maxPosition << ", medio " << error.avgPosition
+		<< " (diagonal da caixa " << error.diagonal << ")" << endl;
+	cout << "  normal: erro max " << error.maxNormalDegrees << " graus, medio " << error.avgNormalDegrees << " graus" << endl;
+	cout << "  coordenada de textura: erro max " << error.maxTexCoord << endl;
+	return 0;
+}
 
-	//Atributo posição (x, y, z)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+// Microbenchmark da animação: o laço escalar original (interpolar + matrizes da GLM por
+// objeto) contra o AnimationSystem em cada modo de interpolação, em objetos por ms
+int animationBenchmark(size_t objectCount)
+{
+	// Os pontos de --path; com uma trajetória, a referência escalar lê as posições das amostras
+	// direto do arquivo mapeado, sem copiá-las, como o AnimationSystem faz com addTrajectory
+	const Trajectory* gravada = nullptr;
+	if (isTrajectoryFile(options.pathFile))
+	{
+		gravada = &assets.trajectory(assets.request(ASSET_TRAJECTORY, options.pathFile));
+		if (!gravada->isOpen())
+		{
+			std::cerr << "Erro ao abrir a trajetoria: " << options.pathFile << std::endl;
+			return -1;
+		}
+	}
+	else
+		carregarPontos(options.pathFile);
+	const size_t pointCount = gravada ? gravada->sampleCount() : pontos.size();
+	auto ponto = [&](size_t i) { return gravada ? gravada->samplePosition(i) : pontos[i]; };
+	if (pointCount == 0)
+	{
+		std::cerr << "Nenhum ponto foi carregado. Encerrando a aplicação." << std::endl;
+		return -1;
+	}
 
-	//Atributo cor (r, g, b)
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3*sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+	const int frames = 200;
+	const float dt = 1.0f / 60.0f;
+	const float scale = 1.0f;
+	vector<glm::mat4> models(objectCount);
+	auto objectsPerMs = [&](double seconds) { return objectCount * (double)frames / (seconds * 1000.0); };
+
+	// Referência escalar: o estado ponto_atual/tempo_percorrido de cada objeto num array de structs
+	struct ScalarObject { glm::vec3 offset; size_t ponto_atual; float tempo_percorrido; };
+	vector<ScalarObject> scalarObjects(objectCount);
+	size_t lado = (size_t)ceil(sqrt((double)objectCount));
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		float coluna = (float)(i % lado) - (float)((lado - 1) / 2);
+		scalarObjects[i].offset = glm::vec3(coluna * espacamento_objetos, 0.0f, -(float)(i / lado) * espacamento_objetos);
+		scalarObjects[i].ponto_atual = i % pointCount;
+		scalarObjects[i].tempo_percorrido = fmod(i * 0.137f, duracao_ponto);
+	}
 
+	auto start = chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			ScalarObject& object = scalarObjects[i];
+			object.tempo_percorrido += dt;
+			if (object.tempo_percorrido >= duracao_ponto) {
+				object.tempo_percorrido = 0.0f;
+				object.ponto_atual = (object.ponto_atual + 1) % pointCount;
+			}
+			size_t proximo_ponto = (object.ponto_atual + 1) % pointCount;
+			glm::vec3 position = object.offset + interpolar(ponto(object.ponto_atual), ponto(proximo_ponto), object.tempo_percorrido / duracao_ponto);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+			models[i] = glm::scale(model, glm::vec3(scale, scale, scale));
+		}
+	}
+	double scalarSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
+	cout << "Animacao de " << objectCount << " objetos, " << frames << " quadros" << endl;
+	cout << "  escalar (interpolar): " << objectsPerMs(scalarSeconds) << " objetos/ms" << endl;
 
-	// Observe que isso é permitido, a chamada para glVertexAttribPointer registrou o VBO como o objeto de buffer de vértice
-	// atualmente vinculado - para que depois possamos desvincular com segurança
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	const char* names[] = { "linear", "catmull-rom", "arc-length" };
+	glm::mat4 local = glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, scale));
+	if (!gravada)
+	{
+		for (int mode = INTERP_LINEAR; mode <= INTERP_ARC_LENGTH; mode++)
+		{
+			AnimationSystem system;
+			criarObjetos(system, objectCount, (InterpolationMode)mode);
 
-	// Desvincula o VAO (é uma boa prática desvincular qualquer buffer ou array para evitar bugs medonhos)
-	glBindVertexArray(0);
+			start = chrono::steady_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				system.update(dt);
+				system.writeMatrices(local, models.data());
+			}
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			cout << "  SoA " << names[mode] << ": " << objectsPerMs(seconds) << " objetos/ms ("
+				<< scalarSeconds / seconds << "x)" << endl;
+		}
+		return 0;
+	}
 
-	return VAO;
+	// Com --path arquivo.traj: a mesma animação seguindo a trajetória (os modos de interpolação
+	// acima montam um AnimationPath com cópia dos pontos, e ficam de fora), e buscas em tempos
+	// aleatórios (a linha do tempo arrastada para qualquer ponto)
+	trajetoria = gravada;
+	AnimationSystem system;
+	criarObjetos(system, objectCount, INTERP_LINEAR);
+	start = chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		system.update(dt);
+		system.writeMatrices(local, models.data());
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "  trajetoria (" << trajetoria->sampleCount() << " amostras): " << objectsPerMs(seconds) << " objetos/ms ("
+		<< scalarSeconds / seconds << "x)" << endl;
+
+	const size_t seeks = objectCount * frames;
+	uint32_t semente = 12345u;
+	size_t segmento = 0;
+	glm::vec3 soma(0.0f);
+	start = chrono::steady_clock::now();
+	for (size_t i = 0; i < seeks; i++)
+	{
+		semente = semente * 1664525u + 1013904223u;
+		double tempo = trajetoria->startTime() + trajetoria->duration() * ((semente >> 8) * (1.0 / 16777216.0));
+		soma += trajetoria->position(tempo, segmento);
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	soma /= (float)seeks;
+	cout << "  busca aleatoria: " << seeks / (seconds * 1000.0) << " buscas/ms (posicao media " << soma.x << ", "
+		<< soma.y << ", " << soma.z << ")" << endl;
+	return 0;
 }
 
-int loadTexture(string path)
+// Modo --self-check: confere os caminhos paralelos e os caches contra referências simples e
+// sai com -1 se algum divergir. Cobre o parallelFor do JobSystem, a ordem do radix sort da
+// DrawQueue (incluindo a estabilidade), os limites da BVH do culling depois de refits e
+// reconstruções (contra o teste de cada objeto, e a versão com tarefas contra a serial) e a
+// invalidação do cache de malhas (fonte alterada, só tocada, dependência que aparece)
+int selfCheck()
 {
-	GLuint texID;
-
-	// Gera o identificador da textura na memória
-	glGenTextures(1, &texID);
-	glBindTexture(GL_TEXTURE_2D, texID);
-
-	//Ajusta os parâmetros de wrapping e filtering
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	int falhas = 0;
+	auto relatar = [&](const string& nome, bool ok) {
+		cout << "  " << nome << ": " << (ok ? "ok" : "FALHOU") << endl;
+		if (!ok)
+			falhas++;
+	};
+	uint32_t semente = 12345u;
+	auto aleatorio = [&]() { semente = semente * 1664525u + 1013904223u; return semente >> 8; };
+	cout << "Verificacoes (" << jobs.workerCount() << " workers)" << endl;
 
-	//Carregamento da imagem
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+	// Cada índice visitado exatamente uma vez, com faixas de tamanhos desiguais no fim
+	{
+		const size_t count = 1000003;
+		vector<uint8_t> visitas(count, 0);
+		jobs.parallelFor(count, 1000, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				visitas[i]++;
+		});
+		relatar("parallelFor (" + to_string(count) + " indices)",
+			std::all_of(visitas.begin(), visitas.end(), [](uint8_t v) { return v == 1; }));
+	}
 
-	if (data)
+	// Radix sort contra std::stable_sort: firstInstance guarda a ordem de inserção, então as
+	// chaves repetidas também conferem a estabilidade. Uma fila abaixo do limite do paralelo
+	// e uma acima
+	for (size_t count : { (size_t)1000, DrawQueue::kParallelThreshold * 3 })
 	{
+		DrawQueue queue;
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint64_t key = aleatorio() % 10 == 0
+				? transparentSortKey(aleatorio() % 256, aleatorio() % 4, aleatorio() % 50, aleatorio() % 100)
+				: opaqueSortKey(aleatorio() % 4, aleatorio() % 50, aleatorio() % 100, aleatorio() % 256);
+			queue.add(key, (uint32_t)(aleatorio() % 16), (uint32_t)i, 1);
+		}
+		vector<DrawCommand> referencia = queue.commands();
+		std::stable_sort(referencia.begin(), referencia.end(),
+			[](const DrawCommand& a, const DrawCommand& b) { return a.key < b.key; });
+		queue.sort(jobs);
+		bool ok = queue.size() == referencia.size();
+		for (size_t i = 0; ok && i < referencia.size(); i++)
+			ok = queue.commands()[i].key == referencia[i].key && queue.commands()[i].firstInstance == referencia[i].firstInstance;
+		relatar("ordem do radix sort (" + to_string(count) + " desenhos)", ok);
+	}
 
-		if (nrChannels == 3) //jpg, bmp
+	// BVH: objetos andando um pouco a cada quadro (refit) e alguns saltando longe (subárvores
+	// degradadas, reconstruídas). Todo objeto claramente dentro do frustum tem que sair visível e
+	// todo objeto claramente fora, não; a versão com tarefas tem que dar a mesma lista da serial
+	{
+		const size_t count = 50000;
+		const glm::vec3 boundsMin(-0.5f), boundsMax(0.5f);
+		const float boundsRadius = glm::length(boundsMax);
+		const glm::mat4 local(1.0f);
+		vector<float> x(count), y(count), z(count);
+		auto coordenada = [&](float extensao) { return (aleatorio() % 65536) / 65536.0f * extensao - extensao * 0.5f; };
+		for (size_t i = 0; i < count; i++)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			x[i] = coordenada(300.0f);
+			y[i] = coordenada(30.0f);
+			z[i] = coordenada(300.0f);
 		}
-		else if (nrChannels == 4)
+		const glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 120.0f)
+			* glm::lookAt(glm::vec3(0.0f), glm::vec3(0.3f, -0.1f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		const Frustum frustum = Frustum::fromMatrix(viewProjection);
+		ObjectCuller paralelo, serial;
+		paralelo.setJobSystem(&jobs);
+		bool dentro = true, igual = true;
+		size_t reconstruidos = 0;
+		vector<uint8_t> visivel(count);
+		for (int frame = 0; frame < 8; frame++)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			for (size_t i = 0; i < count; i++)
+			{
+				x[i] += coordenada(0.5f);
+				z[i] += coordenada(0.5f);
+				if (frame % 3 == 2 && aleatorio() % 100 == 0)
+					x[i] += coordenada(200.0f);
+			}
+			paralelo.update(x.data(), y.data(), z.data(), count, local, boundsMin, boundsMax, boundsRadius);
+			serial.update(x.data(), y.data(), z.data(), count, local, boundsMin, boundsMax, boundsRadius);
+			paralelo.cull(frustum);
+			serial.cull(frustum);
+			if (frame > 0)
+				reconstruidos += paralelo.stats().rebuiltObjects;
+
+			std::fill(visivel.begin(), visivel.end(), 0);
+			for (size_t v = 0; v < paralelo.visibleCount(); v++)
+				visivel[paralelo.visibleObject(v)] = 1;
+			for (size_t i = 0; i < count; i++)
+			{
+				// A caixa do objeto contra cada plano, com uma margem para o arredondamento
+				float menor = std::numeric_limits<float>::max();
+				for (const glm::vec4& plane : frustum.planes)
+				{
+					const glm::vec3 normal(plane);
+					const float raio = glm::dot(glm::abs(normal), (boundsMax - boundsMin) * 0.5f);
+					menor = std::min(menor, glm::dot(normal, glm::vec3(x[i], y[i], z[i])) + plane.w + raio);
+				}
+				if ((menor > 1e-3f && !visivel[i]) || (menor < -1e-3f && visivel[i]))
+					dentro = false;
+			}
+			igual = igual && paralelo.visibleCount() == serial.visibleCount();
+			for (size_t v = 0; igual && v < paralelo.visibleCount(); v++)
+				igual = paralelo.visibleObject(v) == serial.visibleObject(v);
 		}
-		glGenerateMipmap(GL_TEXTURE_2D);
+		relatar("limites da BVH apos refit (" + to_string(count) + " objetos, " + to_string(reconstruidos)
+			+ " reconstruidos)", dentro);
+		relatar("culling com tarefas igual ao serial", igual);
 	}
-	else
+
+	// Cache de malhas numa pasta temporária: vale enquanto as fontes não mudam, é refeito quando o
+	// conteúdo muda, sobrevive a uma fonte só tocada (mesmo hash, data nova) e é refeito quando uma
+	// dependência que faltava aparece
 	{
-		std::cout << "Failed to load texture" << std::endl;
+		std::error_code ec;
+		const fs::path pasta = fs::temp_directory_path(ec) / "compgraf-self-check";
+		fs::remove_all(pasta, ec);
+		fs::create_directories(pasta, ec);
+		const string obj = (pasta / "malha.obj").string();
+		const string mtl = (pasta / "malha.mtl").string();
+		const string cachePath = meshCachePath(obj);
+		auto escrever = [](const string& caminho, const string& texto) {
+			std::ofstream arquivo(caminho, std::ios::binary | std::ios::trunc);
+			arquivo << texto;
+			return arquivo.good();
+		};
+		auto valido = [&]() {
+			MappedFile file;
+			MeshCacheView view;
+			return openMeshCache(cachePath, glm::vec3(1.0f), VERTEX_FORMAT_FLOAT, file, view);
+		};
+
+		MeshData mesh;
+		mesh.vertices.assign(11 * 3, 0.5f);
+		mesh.indices = { 0, 1, 2 };
+		mesh.submeshes.push_back({ 0, 3, -1 });
+		bool ok = escrever(obj, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n")
+			&& saveMeshCache(cachePath, serializeMeshCache(mesh, glm::vec3(1.0f), VERTEX_FORMAT_FLOAT, { obj, mtl }, cachePath));
+		relatar("cache de malha valido com as fontes intactas", ok && valido());
+
+		// Datas explícitas: a resolução do relógio do sistema de arquivos pode ser grossa
+		const fs::file_time_type data = fs::last_write_time(obj, ec);
+		ok = escrever(obj, "v 0 0 0\nv 2 0 0\nv 0 1 0\nf 1 2 3\n");
+		fs::last_write_time(obj, data + std::chrono::seconds(5), ec);
+		relatar("cache de malha invalido com a fonte alterada", ok && !valido());
+
+		ok = escrever(obj, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+		fs::last_write_time(obj, data + std::chrono::seconds(10), ec);
+		// A segunda abertura já encontra as datas atualizadas pela primeira
+		relatar("cache de malha valido com a fonte so tocada", ok && valido() && valido());
+
+		ok = escrever(mtl, "newmtl vermelho\nKd 1 0 0\n");
+		relatar("cache de malha invalido com a dependencia que faltava", ok && !valido());
+		fs::remove_all(pasta, ec);
 	}
 
-	stbi_image_free(data);
-
-	return texID;
+	cout << (falhas ? to_string(falhas) + " verificacao(oes) falharam" : string("Todas as verificacoes passaram")) << endl;
+	return falhas ? -1 : 0;
 }
 
-int loadSimpleOBJ(string filepath, int& nVerts, glm::vec3 color)
+// Modo --software: a cena do modo headless (objetos, caminho da câmera, quadros medidos e
+// imagens de --dump-frames) desenhada pelo SoftwareRasterizer, sem contexto GL. As malhas vêm
+// direto do OBJ, só com o nível 0 (o cache de malhas e os níveis de detalhe são do pool da GPU)
+int softwareRender()
 {
-	vector<glm::vec3> vertices;
-	vector <GLuint> indices;
-	vector <glm::vec2> texCoords;
-	vector <glm::vec3> normals;
-	vector <GLfloat> vbuffer;
-
-	ifstream inputFile;
-	inputFile.open(filepath.c_str());
-	if (inputFile.is_open())
+	Scene cena;
+	vector<uint32_t> gridModels;
+	if (!carregarCena(cena, gridModels))
+		return -1;
+	assets.preload(jobs);
+
+	// Uma tarefa por malha distinta da cena
+	const int width = WIDTH, height = HEIGHT;
+	vector<MeshData> meshes(cena.meshes.size());
+	vector<ostringstream> meshLogs(meshes.size());
+	assets.loadAll(cena.meshes, jobs, [&](size_t m) -> size_t {
+		vector<string> sources;
+		loadSimpleOBJ(assets.path(cena.meshes[m]), glm::vec3(0, 0, 0), meshes[m], sources, meshLogs[m]);
+		return meshes[m].vertices.size() * sizeof(float) + meshes[m].indices.size() * sizeof(uint32_t);
+	});
+	for (const ostringstream& log : meshLogs)
+		cout << log.str();
+	if (std::none_of(meshes.begin(), meshes.end(), [](const MeshData& mesh) { return !mesh.indices.empty(); }))
 	{
-		char line[100];
-		string sline;
+		std::cerr << "Nenhuma malha foi carregada. Encerrando a aplicação." << std::endl;
+		return -1;
+	}
 
-		while (!inputFile.eof())
+	SoftwareRasterizer raster;
+	raster.create(width, height, options.loaderThreads);
+	cout << "Rasterizador em software: " << width << "x" << height << ", " << raster.threadCount() << " threads, tiles de "
+		<< SoftwareRasterizer::kTileSize << " pixels" << endl;
+
+	// Materiais de cada submalha de cada modelo (a malha com a troca de materiais da cena) e as
+	// texturas distintas que eles citam, lidas em paralelo sem compressão, com os mips
+	vector<vector<Material>> modelMaterials(cena.models.size());
+	vector<vector<int32_t>> submeshTextures(cena.models.size()); // posição em textureAssets, ou -1
+	vector<AssetId> textureAssets;
+	unordered_map<AssetId, int32_t> textureIndices;
+	for (size_t m = 0; m < cena.models.size(); m++)
+	{
+		const SceneModel& model = cena.models[m];
+		const MeshData& mesh = meshes[model.mesh];
+		for (const SubMesh& submesh : mesh.submeshes)
 		{
-			inputFile.getline(line, 100);
-			sline = line;
-
-			string word;
-
-			istringstream ssline(line);
-			ssline >> word;
-			if (word == "v")
+			Material material = submesh.material < 0 ? materialPadrao() : mesh.materials[submesh.material].material;
+			if (model.material >= 0)
+				cena.materials[model.material].apply(material, assets);
+			int32_t texture = -1;
+			if (!material.map_Kd.empty())
 			{
-				glm::vec3 v;
-				ssline >> v.x >> v.y >> v.z;
-
-				vertices.push_back(v);
+				const AssetId asset = assets.request(ASSET_TEXTURE, material.map_Kd);
+				auto found = textureIndices.emplace(asset, (int32_t)textureAssets.size()).first;
+				if (found->second == (int32_t)textureAssets.size())
+					textureAssets.push_back(asset);
+				texture = found->second;
 			}
-			if (word == "vt")
-			{
-				glm::vec2 vt;
-				ssline >> vt.s >> vt.t;
+			modelMaterials[m].push_back(material);
+			submeshTextures[m].push_back(texture);
+		}
+	}
+	vector<TextureImage> textures(textureAssets.size());
+	assets.loadAll(textureAssets, jobs, [&](size_t t) -> size_t {
+		if (!loadTextureImage(assets.path(textureAssets[t]), false, options.rebuildMeshCache, options.loaderThreads, textures[t]))
+			return 0;
+		return textures[t].data.size();
+	});
+	for (size_t t = 0; t < textures.size(); t++)
+		if (textures[t].levels.empty())
+			cout << "Nao foi possivel carregar a textura " << assets.path(textureAssets[t]) << endl;
+
+	// Um material do rasterizador por submalha de cada modelo
+	vector<vector<uint32_t>> submeshMaterials(cena.models.size());
+	vector<vector<bool>> submeshTransparent(cena.models.size());
+	vector<bool> modelTransparent(cena.models.size(), false); // alguma submalha transparente
+	for (size_t m = 0; m < cena.models.size(); m++)
+	{
+		for (size_t s = 0; s < modelMaterials[m].size(); s++)
+		{
+			const Material& material = modelMaterials[m][s];
+			SoftwareMaterial softwareMaterial;
+			softwareMaterial.Ka = material.Ka;
+			softwareMaterial.Kd = material.Kd;
+			softwareMaterial.Ks = material.Ks;
+			softwareMaterial.Ns = material.Ns;
+			softwareMaterial.transparent = material.d < 1.0f;
+			softwareMaterial.opacity = softwareMaterial.transparent ? material.d : 1.0f;
+			softwareMaterial.specular = material.Ks != glm::vec3(0.0f);
+			const int32_t texture = submeshTextures[m][s];
+			if (texture >= 0 && !textures[texture].levels.empty())
+				softwareMaterial.texture = &textures[texture];
+			submeshMaterials[m].push_back(raster.addMaterial(softwareMaterial));
+			submeshTransparent[m].push_back(softwareMaterial.transparent);
+			if (softwareMaterial.transparent)
+				modelTransparent[m] = true;
+		}
+	}
 
-				texCoords.push_back(vt);
-			}
-			if (word == "vn")
-			{
-				glm::vec3 vn;
-				ssline >> vn.x >> vn.y >> vn.z;
+	// Objetos, simulação e câmera exatamente como no modo headless
+	const float frameStep = 1.0f / 60.0f;
+	const size_t frames = options.warmupFrames + options.frames;
+	vector<uint32_t> objectModels;
+	criarTodosObjetos(cena, gridModels, objectModels);
+	glm::vec3 cameraTarget;
+	AnimationPath cameraPath = criarCaminhoCamera(options.cameraPathFile, animation.objectCount(), frames * frameStep, cameraTarget);
+	simulation.create(animation, SimCamera(), 1.0 / options.simRate, &jobs);
+	SimFrame simFrame;
+
+	glm::vec3 sceneMin = meshes[0].boundsMin, sceneMax = meshes[0].boundsMax;
+	for (const MeshData& mesh : meshes)
+	{
+		sceneMin = glm::min(sceneMin, mesh.boundsMin);
+		sceneMax = glm::max(sceneMax, mesh.boundsMax);
+	}
+	float sceneRadius = 0.0f;
+	for (const MeshData& mesh : meshes)
+		sceneRadius = std::max(sceneRadius, glm::length((mesh.boundsMin + mesh.boundsMax) * 0.5f - (sceneMin + sceneMax) * 0.5f) + mesh.boundsRadius);
+	const float farPlane = std::max(100.0f, (float)ceil(sqrt((double)animation.objectCount())) * espacamento_objetos * 1.5f);
+
+	SoftwareFrame frameData;
+	frameData.projection = glm::perspective(glm::radians(fov), (GLfloat)width / (GLfloat)height, 0.1f, farPlane);
+	frameData.lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
+	frameData.lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	frameData.clearColor = glm::vec3(0.2f, 0.3f, 0.3f);
+
+	ObjectCuller culler;
+	culler.setJobSystem(&jobs);
+	vector<vector<glm::mat4>> meshModels(cena.models.size());
+	vector<pair<float, size_t>> transparentOrder;
+	vector<glm::mat4> transparentModels;
+	vector<size_t> transparentMeshes;
+	vector<uint8_t> pixels;
+
+	BenchmarkReport report;
+	RasterStats totals;
+	for (size_t frame = 0; frame < frames; frame++)
+	{
+		chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+		const double time = frame * (double)frameStep;
+		simulation.advanceTo(time);
+		simulation.interpolate(time, simFrame);
+
+		const glm::vec3 position = evaluatePath(cameraPath, (float)time * cameraPath.rate);
+		const glm::vec3 front = glm::normalize(cameraTarget - position);
+		frameData.view = glm::lookAt(position, position + front, glm::vec3(0.0f, 1.0f, 0.0f));
+		frameData.viewPos = position;
+
+		const float scale = simFrame.scale;
+		const GLfloat angle = (float)simFrame.time;
+		glm::mat4 local = glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, scale));
+		if (simFrame.rotateX) local = glm::rotate(local, angle, glm::vec3(1.0f, 0.0f, 0.0f));
+		if (simFrame.rotateY) local = glm::rotate(local, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		if (simFrame.rotateZ) local = glm::rotate(local, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+
+		// Matrizes agrupadas por modelo (objectModels), só dos visíveis
+		const size_t objectCount = simFrame.x.size();
+		if (options.culling)
+		{
+			culler.update(simFrame.x.data(), simFrame.y.data(), simFrame.z.data(), objectCount, local, sceneMin, sceneMax, sceneRadius);
+			culler.cull(Frustum::fromMatrix(frameData.projection * frameData.view));
+		}
+		const size_t drawnObjects = options.culling ? culler.visibleCount() : objectCount;
+		for (vector<glm::mat4>& models : meshModels)
+			models.clear();
+		transparentOrder.clear();
+		transparentModels.clear();
+		transparentMeshes.clear();
+		for (size_t i = 0; i < drawnObjects; i++)
+		{
+			const size_t object = options.culling ? culler.visibleObject(i) : i;
+			const glm::vec3 objectPosition = options.culling ? culler.visiblePosition(i)
+				: glm::vec3(simFrame.x[i], simFrame.y[i], simFrame.z[i]);
+			const size_t m = objectModels[object];
+			const MeshData& mesh = meshes[cena.models[m].mesh];
+			glm::mat4 model = local;
+			model[3] += glm::vec4(objectPosition, 0.0f);
+			meshModels[m].push_back(model);
+			if (!modelTransparent[m])
+				continue;
+			// Transparentes de trás para frente pelo centro do objeto, como na fila de desenhos
+			const glm::vec3 center = glm::vec3(model * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+			transparentOrder.push_back(make_pair(glm::dot(center - position, front), transparentModels.size()));
+			transparentModels.push_back(model);
+			transparentMeshes.push_back(m);
+		}
+		sort(transparentOrder.begin(), transparentOrder.end(), [](const pair<float, size_t>& a, const pair<float, size_t>& b) {
+			return a.first > b.first;
+		});
 
-				normals.push_back(vn);
-			}
-			if (word == "f")
-			{
-				string tokens[3];
+		raster.beginFrame(frameData);
+		for (size_t m = 0; m < cena.models.size(); m++)
+		{
+			const MeshData& mesh = meshes[cena.models[m].mesh];
+			for (size_t s = 0; s < mesh.submeshes.size(); s++)
+				if (!submeshTransparent[m][s])
+					raster.draw(mesh, mesh.submeshes[s].indexOffset, mesh.submeshes[s].indexCount,
+						submeshMaterials[m][s], meshModels[m].data(), meshModels[m].size());
+		}
+		for (const pair<float, size_t>& entry : transparentOrder)
+		{
+			const size_t m = transparentMeshes[entry.second];
+			const MeshData& mesh = meshes[cena.models[m].mesh];
+			for (size_t s = 0; s < mesh.submeshes.size(); s++)
+				if (submeshTransparent[m][s])
+					raster.draw(mesh, mesh.submeshes[s].indexOffset, mesh.submeshes[s].indexCount,
+						submeshMaterials[m][s], &transparentModels[entry.second], 1);
+		}
+		raster.endFrame();
 
-				ssline >> tokens[0] >> tokens[1] >> tokens[2];
+		if (frame >= options.warmupFrames)
+		{
+			const RasterStats& stats = raster.stats();
+			report.cpuMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+			totals.triangles += stats.triangles;
+			totals.rasterized += stats.rasterized;
+			totals.binned += stats.binned;
+			totals.pixels += stats.pixels;
+			totals.stolenTiles += stats.stolenTiles;
+			totals.setupMs += stats.setupMs;
+			totals.rasterMs += stats.rasterMs;
+			totals.totalMs += stats.totalMs;
+			report.visibleObjects += drawnObjects;
+		}
 
-				for (int i = 0; i < 3; i++)
-				{
-					//Recuperando os indices de v
-					int pos = tokens[i].find("/");
-					string token = tokens[i].substr(0, pos);
-					int index = atoi(token.c_str()) - 1;
-					indices.push_back(index);
-
-					vbuffer.push_back(vertices[index].x);
-					vbuffer.push_back(vertices[index].y);
-					vbuffer.push_back(vertices[index].z);
-
-					vbuffer.push_back(color.r);
-					vbuffer.push_back(color.g);
-					vbuffer.push_back(color.b);
-
-					//Recuperando os indices de vts
-					tokens[i] = tokens[i].substr(pos + 1);
-					pos = tokens[i].find("/");
-					token = tokens[i].substr(0, pos);
-					index = atoi(token.c_str()) - 1;
-					vbuffer.push_back(texCoords[index].s);
-					vbuffer.push_back(texCoords[index].t);
-
-					//Recuperando os indices de vns
-					tokens[i] = tokens[i].substr(pos + 1);
-					index = atoi(tokens[i].c_str()) - 1;
-					vbuffer.push_back(normals[index].x);
-					vbuffer.push_back(normals[index].y);
-					vbuffer.push_back(normals[index].z);
-				}
-			}
+		if (find(options.dumpFrames.begin(), options.dumpFrames.end(), frame) != options.dumpFrames.end())
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "_%04zu.", frame);
+			string path = options.dumpPrefix + name + options.dumpFormat;
+			raster.readPixels(pixels);
+			if (!saveFrameImage(path, width, height, pixels))
+				cout << "Nao foi possivel gravar " << path << endl;
 		}
 	}
-	else
+
+	// Vazão pelo tempo do rasterizador (montagem + tiles), comparável com a GPU de software (llvmpipe)
+	const size_t measured = report.cpuMs.size();
+	report.renderer = "compgraf SoftwareRasterizer";
+	report.version = to_string(raster.threadCount()) + " threads";
+	report.width = width;
+	report.height = height;
+	report.objects = animation.objectCount();
+	report.normalMatrix = "cpu";
+	report.frameMs = report.cpuMs;
+	if (measured)
 	{
-		cout << "Problema ao encontrar o arquivo " << filepath << endl;
+		report.verticesPerFrame = totals.triangles * 3.0 / measured;
+		report.visibleObjects /= measured;
+	}
+	if (totals.totalMs > 0.0)
+	{
+		report.trianglesPerSecond = totals.triangles / (totals.totalMs * 1e-3);
+		report.pixelsPerSecond = totals.pixels / (totals.totalMs * 1e-3);
 	}
-	inputFile.close();
-	GLuint VBO, VAO;
-	nVerts = vbuffer.size() / 11;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vbuffer.size() * sizeof(GLfloat), vbuffer.data(), GL_STATIC_DRAW);
-	glGenVertexArrays(1, &VAO);
-
-	glBindVertexArray(VAO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-	//Atributo cor (r, g, b)
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
-	//Atributo coordenada de textura (s, t)
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
-	//Atributo normal do vértice (x, y, z)
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(8 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(3);
-
-	// Observe que isso é permitido, a chamada para glVertexAttribPointer registrou o VBO como o objeto de buffer de vértice
-	// atualmente vinculado - para que depois possamos desvincular com segurança
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	// Desvincula o VAO (é uma boa prática desvincular qualquer buffer ou array para evitar bugs medonhos)
-	glBindVertexArray(0);
-	return VAO;
-}
 
-std::unordered_map<std::string, Material> loadMTL(const std::string& filename) {
-	std::unordered_map<std::string, Material> materials;
-	std::ifstream file(filename);
-	std::string line, key;
-	Material currentMaterial;
-	std::string materialName;
-
-	while (std::getline(file, line)) {
-		std::istringstream iss(line);
-		iss >> key;
-
-		if (key == "newmtl") {
-			iss >> materialName;
-			currentMaterial = Material();
-			materials[materialName] = currentMaterial;
-		} else if (key == "Ns") {
-			float ns;
-			iss >> ns;
-			currentMaterial.Ns = ns;
-		} else if (key == "Ka") {
-			iss >> currentMaterial.Ka.r >> currentMaterial.Ka.g >> currentMaterial.Ka.b;
-		} else if (key == "Kd") {
-			iss >> currentMaterial.Kd.r >> currentMaterial.Kd.g >> currentMaterial.Kd.b;
-		} else if (key == "Ks") {
-			iss >> currentMaterial.Ks.r >> currentMaterial.Ks.g >> currentMaterial.Ks.b;
-		} else if (key == "Ke") {
-			iss >> currentMaterial.Ke.r >> currentMaterial.Ke.g >> currentMaterial.Ke.b;
-		} else if (key == "Ni") {
-			iss >> currentMaterial.Ni;
-		} else if (key == "d") {
-			iss >> currentMaterial.d;
-		} else if (key == "illum") {
-			iss >> currentMaterial.illum;
-		} else if (key == "map_Kd") {
-			iss >> currentMaterial.map_Kd;
-		}
-
-		if (!materialName.empty()) {
-			materials[materialName] = currentMaterial;
-		}
-	}
-	return materials;
+	TimingStats cpu = computeTimingStats(report.cpuMs);
+	cout << measured << " quadros: min " << cpu.min << " ms, mediana " << cpu.median << " ms, p99 " << cpu.p99 << " ms" << endl;
+	if (measured)
+		cout << "Rasterizador: " << totals.triangles / measured << " triangulos por quadro (" << totals.rasterized / measured
+			<< " montados, " << totals.binned / measured << " nos tiles), " << totals.pixels / measured << " pixels sombreados, "
+			<< totals.setupMs / measured << " ms de montagem + " << totals.rasterMs / measured << " ms de tiles, "
+			<< (double)totals.stolenTiles / measured << " tiles roubados por quadro" << endl;
+	cout << "Vazao: " << report.trianglesPerSecond / 1e6 << " milhoes de triangulos/s, " << report.pixelsPerSecond / 1e6
+		<< " milhoes de pixels/s" << endl;
+	if (!options.benchJsonPath.empty() && !writeBenchmarkJson(options.benchJsonPath, report))
+		cout << "Nao foi possivel gravar " << options.benchJsonPath << endl;
+	assets.printReport(cout);
+
+	simulation.destroy();
+	raster.destroy();
+	jobs.destroy();
+	return 0;
 }
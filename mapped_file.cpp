@@ -0,0 +1,154 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		std::swap(mData, other.mData);
+		std::swap(mSize, other.mSize);
+		std::swap(mOpenEmpty, other.mOpenEmpty);
+#ifdef _WIN32
+		std::swap(mFile, other.mFile);
+		std::swap(mMapping, other.mMapping);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		mOpenEmpty = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const char*>(view);
+	mSize = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile)
+		CloseHandle(mFile);
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mSize = 0;
+	mOpenEmpty = false;
+}
+
+void MappedFile::adviseRandomAccess()
+{
+	// O Windows decide o read-ahead das páginas mapeadas sozinho
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	if (st.st_size == 0)
+	{
+		::close(fd);
+		mOpenEmpty = true;
+		return true;
+	}
+
+	void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// O mapeamento continua válido depois de fechar o descritor
+	::close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+
+	// Leitura é sequencial: pede ao kernel para fazer read-ahead agressivo
+	madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+	mData = static_cast<const char*>(addr);
+	mSize = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		munmap(const_cast<char*>(mData), mSize);
+	mData = nullptr;
+	mSize = 0;
+	mOpenEmpty = false;
+}
+
+void MappedFile::adviseRandomAccess()
+{
+	if (mData)
+		madvise(const_cast<char*>(mData), mSize, MADV_RANDOM);
+}
+
+#endif
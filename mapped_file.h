@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Arquivo mapeado em memória somente para leitura.
+// O conteúdo fica acessível via data()/size() enquanto o objeto existir,
+// sem cópia para buffers intermediários.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path) { open(path); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return mData != nullptr || mOpenEmpty; }
+	const char* data() const { return mData; }
+	size_t size() const { return mSize; }
+	const char* begin() const { return mData; }
+	const char* end() const { return mData + mSize; }
+
+	// O mapeamento parte do acesso sequencial (read-ahead agressivo). Para arquivos consultados
+	// em pontos esparsos, desliga o read-ahead: só as páginas tocadas são lidas
+	void adviseRandomAccess();
+
+private:
+	const char* mData = nullptr;
+	size_t mSize = 0;
+	bool mOpenEmpty = false; // arquivo existe mas tem 0 bytes (não pode ser mapeado)
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+};
@@ -0,0 +1,69 @@
+#include "material.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Caminhos de textura no MTL são relativos ao próprio arquivo MTL
+std::string resolveTexturePath(const std::string& directory, const std::string& path) {
+	if (path.empty() || directory.empty() || path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'))
+		return path;
+	return directory + path;
+}
+
+} // namespace
+
+std::unordered_map<std::string, Material> loadMTL(const std::string& filename) {
+	std::unordered_map<std::string, Material> materials;
+	std::ifstream file(filename);
+	std::string line, key;
+	Material currentMaterial;
+	std::string materialName;
+	const std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+	while (std::getline(file, line)) {
+		std::istringstream iss(line);
+		// Linhas em branco não podem repetir a chave da linha anterior
+		key.clear();
+		iss >> key;
+
+		if (key == "newmtl") {
+			iss >> materialName;
+			currentMaterial = Material();
+			materials[materialName] = currentMaterial;
+		} else if (key == "Ns") {
+			iss >> currentMaterial.Ns;
+		} else if (key == "Ka") {
+			iss >> currentMaterial.Ka.r >> currentMaterial.Ka.g >> currentMaterial.Ka.b;
+		} else if (key == "Kd") {
+			iss >> currentMaterial.Kd.r >> currentMaterial.Kd.g >> currentMaterial.Kd.b;
+		} else if (key == "Ks") {
+			iss >> currentMaterial.Ks.r >> currentMaterial.Ks.g >> currentMaterial.Ks.b;
+		} else if (key == "Ke") {
+			iss >> currentMaterial.Ke.r >> currentMaterial.Ke.g >> currentMaterial.Ke.b;
+		} else if (key == "Ni") {
+			iss >> currentMaterial.Ni;
+		} else if (key == "d") {
+			iss >> currentMaterial.d;
+		} else if (key == "Tr") {
+			// Tr é o complemento de d (exportadores antigos)
+			float tr;
+			if (iss >> tr)
+				currentMaterial.d = 1.0f - tr;
+		} else if (key == "illum") {
+			iss >> currentMaterial.illum;
+		} else if (key == "map_Kd") {
+			// Opções (ex: "-s 1 1 1") vêm antes do arquivo, que é o último campo da linha
+			std::string token, path;
+			while (iss >> token)
+				path = token;
+			currentMaterial.map_Kd = resolveTexturePath(directory, path);
+		}
+
+		if (!materialName.empty()) {
+			materials[materialName] = currentMaterial;
+		}
+	}
+	return materials;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+// GLM
+#include <glm/glm.hpp>
+
+struct Material {
+	glm::vec3 Ka = glm::vec3(0.0f); // Ambient reflectivity
+	glm::vec3 Kd = glm::vec3(0.0f); // Diffuse reflectivity
+	glm::vec3 Ks = glm::vec3(0.0f); // Specular reflectivity
+	glm::vec3 Ke = glm::vec3(0.0f); // Emissive coefficient
+	float Ns = 0.0f;   // Specular exponent
+	float Ni = 1.0f;   // Optical density
+	float d = 1.0f;    // Transparency
+	int illum = 2;     // Illumination model
+	std::string map_Kd; // Diffuse texture map (já com a pasta do MTL)
+};
+
+// Lê todos os materiais do arquivo (por nome). Os caminhos de textura relativos são
+// resolvidos contra a pasta do MTL.
+std::unordered_map<std::string, Material> loadMTL(const std::string& filename);
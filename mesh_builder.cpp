@@ -0,0 +1,426 @@
+#include "mesh_builder.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Tabela hash de endereçamento aberto (sondagem linear) de trinca v/vt/vn -> vértice.
+// Bem mais rápida que unordered_map para milhões de cantos, e sem alocação por inserção.
+class CornerTable
+{
+public:
+	explicit CornerTable(size_t expected)
+	{
+		size_t capacity = 16;
+		while (capacity < expected * 2)
+			capacity <<= 1;
+		mMask = capacity - 1;
+		mKeys.resize(capacity);
+		mValues.assign(capacity, kEmpty);
+	}
+
+	// Devolve o vértice da trinca; se ela ainda não existe, associa 'next' a ela
+	uint32_t findOrInsert(const ObjIndex& key, uint32_t next, bool& inserted)
+	{
+		size_t slot = hash(key) & mMask;
+		while (mValues[slot] != kEmpty)
+		{
+			const ObjIndex& k = mKeys[slot];
+			if (k.v == key.v && k.vt == key.vt && k.vn == key.vn)
+			{
+				inserted = false;
+				return mValues[slot];
+			}
+			slot = (slot + 1) & mMask;
+		}
+		mKeys[slot] = key;
+		mValues[slot] = next;
+		inserted = true;
+		return next;
+	}
+
+private:
+	static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+
+	static size_t hash(const ObjIndex& k)
+	{
+		uint64_t h = static_cast<uint32_t>(k.v) * 0x9E3779B97F4A7C15ull;
+		h ^= (static_cast<uint32_t>(k.vt) + 0x632BE59BD9B4E019ull) * 0xBF58476D1CE4E5B9ull;
+		h ^= (static_cast<uint32_t>(k.vn) + 0x85157AF5ull) * 0x94D049BB133111EBull;
+		return static_cast<size_t>(h ^ (h >> 31));
+	}
+
+	size_t mMask = 0;
+	std::vector<ObjIndex> mKeys;
+	std::vector<uint32_t> mValues;
+};
+
+// Parâmetros de pontuação do algoritmo de Forsyth
+const int kCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+const int kMaxValence = 32; // valências maiores usam a pontuação da última entrada
+
+// As pontuações dependem só da posição no cache e da valência, então são tabeladas
+// uma vez para evitar pow() no laço principal
+struct ScoreTables {
+	float cache[kCacheSize];
+	float valence[kMaxValence + 1];
+
+	ScoreTables()
+	{
+		for (int i = 0; i < kCacheSize; i++)
+		{
+			if (i < 3)
+			{
+				// Os três vértices do último triângulo recebem pontuação fixa, para não
+				// favorecer o mesmo triângulo de novo
+				cache[i] = kLastTriScore;
+			}
+			else
+			{
+				float scaler = 1.0f / (kCacheSize - 3);
+				cache[i] = std::pow(1.0f - (i - 3) * scaler, kCacheDecayPower);
+			}
+		}
+		valence[0] = 0.0f;
+		// Vértices com poucos triângulos restantes são priorizados para sair logo do caminho
+		for (int i = 1; i <= kMaxValence; i++)
+			valence[i] = kValenceBoostScale * std::pow(static_cast<float>(i), -kValenceBoostPower);
+	}
+};
+
+float vertexScore(const ScoreTables& tables, int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+	score += tables.valence[std::min<uint32_t>(remainingTriangles, kMaxValence)];
+	return score;
+}
+
+// Agrupa os triângulos por material, mantendo a ordem do arquivo dentro de cada grupo, e
+// cria uma submalha por grupo não vazio: primeiro os sem material, depois na ordem de
+// obj.materialNames
+void groupByMaterial(const ObjData& obj, std::vector<uint32_t>& indices, std::vector<SubMesh>& submeshes)
+{
+	submeshes.clear();
+	const size_t triangles = indices.size() / 3;
+	if (obj.materialRuns.empty())
+	{
+		submeshes.push_back({ 0, static_cast<uint32_t>(indices.size()), -1 });
+		return;
+	}
+
+	// Material de cada triângulo: posição 0 para "nenhum", m + 1 para materialNames[m]
+	std::vector<uint32_t> slot(triangles, 0);
+	for (size_t r = 0; r < obj.materialRuns.size(); r++)
+	{
+		size_t first = std::min<size_t>(obj.materialRuns[r].firstTriangle, triangles);
+		size_t last = r + 1 < obj.materialRuns.size() ? std::min<size_t>(obj.materialRuns[r + 1].firstTriangle, triangles) : triangles;
+		std::fill(slot.begin() + first, slot.begin() + last, static_cast<uint32_t>(obj.materialRuns[r].material + 1));
+	}
+
+	// Ordenação por contagem (estável)
+	std::vector<uint32_t> offsets(obj.materialNames.size() + 2, 0);
+	for (uint32_t s : slot)
+		offsets[s + 1]++;
+	for (size_t s = 1; s < offsets.size(); s++)
+		offsets[s] += offsets[s - 1];
+	for (size_t s = 0; s + 1 < offsets.size(); s++)
+		if (offsets[s + 1] > offsets[s])
+			submeshes.push_back({ offsets[s] * 3, (offsets[s + 1] - offsets[s]) * 3, static_cast<int32_t>(s) - 1 });
+	if (submeshes.size() == 1)
+		return;
+
+	std::vector<uint32_t> grouped(indices.size());
+	for (size_t t = 0; t < triangles; t++)
+	{
+		uint32_t* dst = &grouped[static_cast<size_t>(offsets[slot[t]]++) * 3];
+		memcpy(dst, &indices[t * 3], 3 * sizeof(uint32_t));
+	}
+	indices.swap(grouped);
+}
+
+// Forsyth dentro de cada submalha (os triângulos não podem sair da sua faixa). Os índices da
+// faixa são renumerados para vértices locais, então as tabelas do otimizador têm o tamanho
+// da submalha e não o da malha inteira.
+void optimizeSubmeshes(std::vector<uint32_t>& indices, const std::vector<SubMesh>& submeshes, size_t vertexCount)
+{
+	if (submeshes.size() <= 1)
+	{
+		optimizeVertexCache(indices, vertexCount);
+		return;
+	}
+
+	const uint32_t kNone = 0xFFFFFFFFu;
+	std::vector<uint32_t> local(vertexCount, kNone);
+	std::vector<uint32_t> global;
+	std::vector<uint32_t> range;
+	for (const SubMesh& submesh : submeshes)
+	{
+		range.assign(indices.begin() + submesh.indexOffset, indices.begin() + submesh.indexOffset + submesh.indexCount);
+		global.clear();
+		for (uint32_t& index : range)
+		{
+			if (local[index] == kNone)
+			{
+				local[index] = static_cast<uint32_t>(global.size());
+				global.push_back(index);
+			}
+			index = local[index];
+		}
+
+		optimizeVertexCache(range, global.size());
+
+		for (size_t i = 0; i < range.size(); i++)
+			indices[submesh.indexOffset + i] = global[range[i]];
+		for (uint32_t index : global)
+			local[index] = kNone;
+	}
+}
+
+} // namespace
+
+void buildIndexedMesh(const ObjData& obj, glm::vec3 color, MeshData& out, MeshBuildStats* stats)
+{
+	PROFILE_SCOPE("buildIndexedMesh");
+	const size_t corners = obj.corners.size();
+	CornerTable table(corners / 2 + 1);
+
+	out.vertices.clear();
+	out.indices.clear();
+	out.indices.reserve(corners);
+	out.vertices.reserve((corners / 2 + 1) * kVertexFloats);
+
+	uint32_t vertexCount = 0;
+	for (const ObjIndex& c : obj.corners)
+	{
+		bool inserted;
+		uint32_t index = table.findOrInsert(c, vertexCount, inserted);
+		if (inserted)
+		{
+			const glm::vec3& v = obj.positions[c.v];
+			// Coordenada de textura e normal são opcionais nas faces (ex: "f v//vn")
+			glm::vec2 vt = c.vt >= 0 ? obj.texCoords[c.vt] : glm::vec2(0.0f, 0.0f);
+			glm::vec3 vn = c.vn >= 0 ? obj.normals[c.vn] : glm::vec3(0.0f, 0.0f, 0.0f);
+			const float vertex[kVertexFloats] = {
+				v.x, v.y, v.z,
+				color.r, color.g, color.b,
+				vt.s, vt.t,
+				vn.x, vn.y, vn.z
+			};
+			out.vertices.insert(out.vertices.end(), vertex, vertex + kVertexFloats);
+			vertexCount++;
+		}
+		out.indices.push_back(index);
+	}
+
+	if (stats)
+	{
+		stats->corners = corners;
+		stats->uniqueVertices = vertexCount;
+		stats->acmrBefore = computeACMR(out.indices, vertexCount);
+	}
+
+	groupByMaterial(obj, out.indices, out.submeshes);
+	optimizeSubmeshes(out.indices, out.submeshes, vertexCount);
+	optimizeVertexFetch(out.vertices, out.indices, kVertexFloats);
+
+	if (stats)
+		stats->acmrAfter = computeACMR(out.indices, vertexCount);
+
+	computeBounds(out);
+}
+
+void computeBounds(MeshData& mesh)
+{
+	const size_t count = mesh.vertexCount();
+	if (count == 0)
+	{
+		mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+		mesh.boundsRadius = 0.0f;
+		return;
+	}
+	glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+	glm::vec3 hi = lo;
+	for (size_t i = 1; i < count; i++)
+	{
+		glm::vec3 p(mesh.vertices[i * kVertexFloats], mesh.vertices[i * kVertexFloats + 1], mesh.vertices[i * kVertexFloats + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	mesh.boundsMin = lo;
+	mesh.boundsMax = hi;
+
+	const glm::vec3 center = (lo + hi) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 d = glm::vec3(mesh.vertices[i * kVertexFloats], mesh.vertices[i * kVertexFloats + 1], mesh.vertices[i * kVertexFloats + 2]) - center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	mesh.boundsRadius = std::sqrt(radius2);
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Adjacência vértice -> triângulos em formato compacto (offsets + lista)
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+		remaining[index]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+	}
+
+	static const ScoreTables tables;
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(tables, -1, remaining[v]);
+
+	std::vector<char> emitted(triangleCount, 0);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	// Cache LRU simulado (+3 entradas para os vértices que acabaram de entrar)
+	uint32_t cache[kCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t scanCursor = 0; // para achar um triângulo novo quando o cache não oferece candidatos
+	long bestTriangle = -1;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (bestTriangle < 0)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = static_cast<long>(scanCursor);
+		}
+
+		const uint32_t* tri = &indices[bestTriangle * 3];
+		result.insert(result.end(), tri, tri + 3);
+		emitted[bestTriangle] = 1;
+
+		// Atualiza o cache: os três vértices vão para a frente, os demais são empurrados
+		uint32_t newCache[kCacheSize + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+			newCache[newCount++] = tri[k];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			uint32_t v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Remove o triângulo da adjacência dos seus vértices
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t* begin = &adjacency[offsets[v]];
+			uint32_t* end = begin + remaining[v];
+			uint32_t* it = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+			if (it != end)
+			{
+				std::swap(*it, *(end - 1));
+				remaining[v]--;
+			}
+		}
+
+		// Recalcula as pontuações dos vértices que estão (ou saíram) do cache
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < kCacheSize ? i : -1;
+			score[v] = vertexScore(tables, cachePosition[v], remaining[v]);
+		}
+
+		// Escolhe o melhor triângulo entre os que tocam o cache
+		float bestScore = -1.0f;
+		bestTriangle = -1;
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+			for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; j++)
+			{
+				uint32_t t = adjacency[j];
+				float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (s > bestScore)
+				{
+					bestScore = s;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, kCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices, int floatsPerVertex)
+{
+	const size_t vertexCount = vertices.size() / floatsPerVertex;
+	std::vector<uint32_t> remap(vertexCount, 0xFFFFFFFFu);
+	std::vector<float> reordered(vertices.size());
+
+	uint32_t next = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == 0xFFFFFFFFu)
+		{
+			memcpy(&reordered[static_cast<size_t>(next) * floatsPerVertex],
+				&vertices[static_cast<size_t>(index) * floatsPerVertex], floatsPerVertex * sizeof(float));
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+
+	// Vértices não referenciados por nenhum triângulo são descartados
+	reordered.resize(static_cast<size_t>(next) * floatsPerVertex);
+	vertices.swap(reordered);
+}
+
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize)
+{
+	if (indices.size() < 3)
+		return 0.0f;
+
+	// FIFO: guarda o "instante" em que cada vértice entrou no cache
+	std::vector<size_t> entered(vertexCount, 0);
+	size_t clock = cacheSize + 1;
+	size_t misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (clock - entered[index] > cacheSize)
+		{
+			entered[index] = clock++;
+			misses++;
+		}
+	}
+	return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "material.h"
+#include "obj_parser.h"
+
+// Número de floats por vértice no buffer intercalado:
+// posição (3), cor (3), coordenada de textura (2), normal (3)
+const int kVertexFloats = 11;
+
+// Faixa contígua do buffer de índices desenhada com um mesmo material
+struct SubMesh {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	int32_t material; // posição em MeshData::materials, ou -1 (material padrão)
+};
+
+// Nível de detalhe simplificado (ver mesh_lod.h). Os índices ficam depois dos do nível 0 no
+// mesmo buffer e usam os mesmos vértices; há uma submalha por submalha do nível 0, na mesma
+// ordem e com o mesmo material (uma submalha que não simplificou repete a faixa anterior).
+struct MeshLod {
+	// Desvio máximo em relação ao nível 0, nas unidades do objeto: a maior distância de um
+	// vértice do nível aos planos dos triângulos originais que ele substitui
+	float error = 0.0f;
+	std::vector<SubMesh> submeshes;
+};
+
+struct NamedMaterial {
+	std::string name;
+	Material material;
+};
+
+// Malha indexada pronta para envio à GPU
+struct MeshData {
+	std::vector<float> vertices;   // kVertexFloats floats por vértice
+	std::vector<uint32_t> indices; // 3 por triângulo
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;     // esfera envolvente centrada no meio da caixa
+	std::vector<SubMesh> submeshes;
+	std::vector<NamedMaterial> materials;
+	std::vector<MeshLod> lods;     // do mais detalhado para o mais simples, sem o nível 0
+
+	size_t vertexCount() const { return vertices.size() / kVertexFloats; }
+	size_t triangleCount() const { return indices.size() / 3; }
+	// Índices de 16 bits bastam enquanto todos os vértices couberem em um unsigned short
+	bool fitsShortIndices() const { return vertexCount() <= 65536; }
+};
+
+struct MeshBuildStats {
+	size_t corners = 0;       // vértices que o caminho não indexado enviaria
+	size_t uniqueVertices = 0;
+	float acmrBefore = 0.0f;  // ACMR na ordem original das faces
+	float acmrAfter = 0.0f;   // ACMR após a otimização para o cache de vértices
+};
+
+// Cria um vértice para cada trinca v/vt/vn distinta e o buffer de índices correspondente.
+// Os triângulos são agrupados por material (uma submalha por "usemtl" usado, com o índice
+// de obj.materialNames; quem monta 'out.materials' deve seguir essa ordem) e reordenados
+// para o cache pós-transformação (Forsyth) dentro de cada submalha; os vértices seguem a
+// ordem do primeiro uso. Também calcula a caixa envolvente.
+void buildIndexedMesh(const ObjData& obj, glm::vec3 color, MeshData& out, MeshBuildStats* stats = nullptr);
+
+// Caixa envolvente alinhada aos eixos das posições dos vértices e a esfera centrada nela
+// (raio até o vértice mais distante, menor que a meia diagonal da caixa)
+void computeBounds(MeshData& mesh);
+
+// Reordena os triângulos para reaproveitar o cache de vértices pós-transformação
+// (algoritmo de Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Reordena os vértices pela ordem do primeiro uso nos índices (melhora o acesso à memória
+// na busca de vértices) e reescreve os índices.
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices, int floatsPerVertex);
+
+// ACMR (average cache miss ratio): vértices transformados por triângulo, simulando um
+// cache FIFO de 'cacheSize' entradas. Vai de 3.0 (sem reuso) até ~0.5 (ideal).
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = 16);
@@ -0,0 +1,426 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = { 'C', 'G', 'M', 'E', 'S', 'H', 0, 0 };
+
+size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Escrita/leitura dos registros de tamanho variável (materiais e dependências)
+class Writer
+{
+public:
+	explicit Writer(std::vector<char>& buffer) : mBuffer(buffer) {}
+
+	void bytes(const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		mBuffer.insert(mBuffer.end(), p, p + size);
+	}
+	template <typename T> void value(const T& v) { bytes(&v, sizeof(T)); }
+	void vec3(const glm::vec3& v) { value(v.x); value(v.y); value(v.z); }
+	void string(const std::string& s)
+	{
+		value(static_cast<uint32_t>(s.size()));
+		bytes(s.data(), s.size());
+	}
+
+private:
+	std::vector<char>& mBuffer;
+};
+
+class Reader
+{
+public:
+	Reader(const char* begin, const char* end) : mPos(begin), mEnd(end) {}
+
+	bool ok() const { return mOk; }
+	template <typename T> T value()
+	{
+		T v{};
+		if (static_cast<size_t>(mEnd - mPos) < sizeof(T))
+		{
+			mOk = false;
+			return v;
+		}
+		memcpy(&v, mPos, sizeof(T));
+		mPos += sizeof(T);
+		return v;
+	}
+	glm::vec3 vec3()
+	{
+		float x = value<float>(), y = value<float>(), z = value<float>();
+		return glm::vec3(x, y, z);
+	}
+	std::string string()
+	{
+		uint32_t size = value<uint32_t>();
+		if (!mOk || static_cast<size_t>(mEnd - mPos) < size)
+		{
+			mOk = false;
+			return std::string();
+		}
+		std::string s(mPos, size);
+		mPos += size;
+		return s;
+	}
+
+private:
+	const char* mPos;
+	const char* mEnd;
+	bool mOk = true;
+};
+
+int64_t modificationTime(const fs::path& path)
+{
+	std::error_code ec;
+	auto time = fs::last_write_time(path, ec);
+	return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+bool describeSource(const fs::path& path, MeshCacheDependency& dep)
+{
+	MappedFile file;
+	if (!file.open(path.string()))
+		return false;
+	dep.size = file.size();
+	dep.mtime = modificationTime(path);
+	dep.hash = hashBytes(file.data(), file.size());
+	return true;
+}
+
+// 'path' (relativo ao diretório de trabalho) relativo à pasta 'directory'. Com os caminhos
+// absolutos o relativo sai certo também para um arquivo que não existe
+std::string relativeTo(const fs::path& directory, const std::string& path)
+{
+	std::error_code ec;
+	fs::path relative = fs::relative(fs::absolute(path), fs::absolute(directory.empty() ? fs::path(".") : directory), ec);
+	return ec || relative.empty() ? path : relative.generic_string();
+}
+
+// [offset, offset + count * stride) cabe em 'size', sem estourar a multiplicação
+bool fitsIn(uint64_t offset, uint64_t count, uint64_t stride, uint64_t size)
+{
+	return offset <= size && (stride == 0 || count <= (size - offset) / stride);
+}
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+} // namespace
+
+std::string meshCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+uint64_t hashBytes(const char* data, size_t size)
+{
+	// Quatro acumuladores independentes de 64 bits para aproveitar o paralelismo da CPU
+	const uint64_t k1 = 0x87C37B91114253D5ull, k2 = 0x4CF5AD432745937Full;
+	uint64_t h[4] = { size ^ k1, size ^ k2, rotl(size, 17) ^ k1, rotl(size, 31) ^ k2 };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint64_t w;
+			memcpy(&w, data + i + lane * 8, 8);
+			h[lane] = rotl(h[lane] ^ (w * k1), 31) * k2;
+		}
+	}
+	uint64_t tail = 0;
+	for (int shift = 0; i < size; i++, shift += 8)
+	{
+		if (shift == 64)
+		{
+			h[0] = rotl(h[0] ^ (tail * k1), 31) * k2;
+			tail = 0;
+			shift = 0;
+		}
+		tail |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << shift;
+	}
+	h[1] ^= tail * k2;
+
+	return mix(h[0] ^ rotl(h[1], 13) ^ rotl(h[2], 29) ^ rotl(h[3], 43));
+}
+
+std::vector<char> serializeMeshCache(const MeshData& mesh, glm::vec3 color, VertexFormat format,
+	const std::vector<std::string>& sources, const std::string& cachePath)
+{
+	const bool shortIndices = mesh.fitsShortIndices();
+
+	std::vector<PackedVertex> packed;
+	if (format == VERTEX_FORMAT_PACKED)
+		packVertices(mesh, packed);
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kMeshCacheVersion;
+	header.vertexFormat = format;
+	header.vertexStride = format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : kVertexFloats * sizeof(float);
+	header.indexSize = shortIndices ? 2 : 4;
+	header.vertexCount = mesh.vertexCount();
+	header.indexCount = mesh.indices.size();
+	header.submeshCount = static_cast<uint32_t>(mesh.submeshes.size());
+	header.materialCount = static_cast<uint32_t>(mesh.materials.size());
+	header.levelCount = static_cast<uint32_t>(1 + mesh.lods.size());
+	for (int k = 0; k < 3; k++)
+	{
+		header.boundsMin[k] = mesh.boundsMin[k];
+		header.boundsMax[k] = mesh.boundsMax[k];
+		header.color[k] = color[k];
+	}
+	header.boundsRadius = mesh.boundsRadius;
+
+	// Os blocos de dados ficam alinhados para serem usados direto do mapeamento
+	header.vertexOffset = alignUp(sizeof(MeshCacheHeader), 16);
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexCount * header.vertexStride, 16);
+	header.submeshOffset = alignUp(header.indexOffset + header.indexCount * header.indexSize, 16);
+	header.levelOffset = alignUp(header.submeshOffset + header.levelCount * header.submeshCount * sizeof(SubMesh), 16);
+	header.materialOffset = alignUp(header.levelOffset + header.levelCount * sizeof(float), 16);
+
+	std::vector<char> image(header.materialOffset, 0);
+	if (format == VERTEX_FORMAT_PACKED)
+		memcpy(&image[header.vertexOffset], packed.data(), packed.size() * sizeof(PackedVertex));
+	else
+		memcpy(&image[header.vertexOffset], mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+	if (shortIndices)
+	{
+		uint16_t* dst = reinterpret_cast<uint16_t*>(&image[header.indexOffset]);
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			dst[i] = static_cast<uint16_t>(mesh.indices[i]);
+	}
+	else
+	{
+		memcpy(&image[header.indexOffset], mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	}
+	if (!mesh.submeshes.empty())
+		memcpy(&image[header.submeshOffset], mesh.submeshes.data(), mesh.submeshes.size() * sizeof(SubMesh));
+	float* levelErrors = reinterpret_cast<float*>(&image[header.levelOffset]);
+	levelErrors[0] = 0.0f;
+	for (size_t level = 1; level < header.levelCount; level++)
+	{
+		const MeshLod& lod = mesh.lods[level - 1];
+		if (!lod.submeshes.empty())
+			memcpy(&image[header.submeshOffset + level * header.submeshCount * sizeof(SubMesh)], lod.submeshes.data(),
+				lod.submeshes.size() * sizeof(SubMesh));
+		levelErrors[level] = lod.error;
+	}
+
+	// As texturas, como as dependências, ficam relativas à pasta do cache (parse as resolve de volta)
+	const fs::path cacheDir = fs::path(cachePath).parent_path();
+	Writer writer(image);
+	for (const NamedMaterial& m : mesh.materials)
+	{
+		writer.string(m.name);
+		writer.vec3(m.material.Ka);
+		writer.vec3(m.material.Kd);
+		writer.vec3(m.material.Ks);
+		writer.vec3(m.material.Ke);
+		writer.value(m.material.Ns);
+		writer.value(m.material.Ni);
+		writer.value(m.material.d);
+		writer.value(static_cast<int32_t>(m.material.illum));
+		writer.string(m.material.map_Kd.empty() || fs::path(m.material.map_Kd).is_absolute() ? m.material.map_Kd
+			: relativeTo(cacheDir, m.material.map_Kd));
+	}
+
+	header.dependencyOffset = image.size();
+	for (const std::string& source : sources)
+	{
+		MeshCacheDependency dep;
+		if (!describeSource(source, dep))
+		{
+			dep.size = kMissingDependency;
+			dep.mtime = 0;
+			dep.hash = 0;
+		}
+		// O nome é gravado relativo à pasta do cache, para funcionar de qualquer diretório de trabalho
+		dep.name = relativeTo(cacheDir, source);
+		writer.string(dep.name);
+		writer.value(dep.size);
+		writer.value(dep.mtime);
+		writer.value(dep.hash);
+		header.dependencyCount++;
+	}
+
+	header.fileSize = image.size();
+	memcpy(image.data(), &header, sizeof(header));
+	return image;
+}
+
+bool saveMeshCache(const std::string& cachePath, const std::vector<char>& image)
+{
+	// Grava em um arquivo temporário e renomeia, para nunca deixar um cache pela metade
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		out.write(image.data(), static_cast<std::streamsize>(image.size()));
+		if (!out)
+			return false;
+	}
+	std::error_code ec;
+	fs::rename(tempPath, cachePath, ec);
+	if (ec)
+	{
+		fs::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+bool MeshCacheView::parse(const char* data, size_t size, const std::string& cachePath)
+{
+	if (size < sizeof(MeshCacheHeader))
+		return false;
+	const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(data);
+	if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kMeshCacheVersion || h->fileSize != size)
+		return false;
+	// Campos do cabeçalho com valores possíveis, e cada bloco dentro do arquivo (as contas não
+	// podem estourar: um cache corrompido não passa por válido)
+	const uint64_t expectedStride = h->vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : kVertexFloats * sizeof(float);
+	if ((h->vertexFormat != VERTEX_FORMAT_FLOAT && h->vertexFormat != VERTEX_FORMAT_PACKED)
+		|| h->vertexStride != expectedStride
+		|| (h->indexSize != 2 && h->indexSize != 4)
+		|| h->levelCount == 0
+		|| h->vertexOffset % 4 != 0 || h->indexOffset % 4 != 0 || h->submeshOffset % 4 != 0 || h->levelOffset % 4 != 0)
+		return false;
+	if (!fitsIn(h->vertexOffset, h->vertexCount, h->vertexStride, size)
+		|| !fitsIn(h->indexOffset, h->indexCount, h->indexSize, size)
+		|| !fitsIn(h->submeshOffset, static_cast<uint64_t>(h->levelCount) * h->submeshCount, sizeof(SubMesh), size)
+		|| !fitsIn(h->levelOffset, h->levelCount, sizeof(float), size)
+		|| h->materialOffset > h->dependencyOffset || h->dependencyOffset > size)
+		return false;
+	// Submalhas (de todos os níveis) dentro dos índices e com materiais existentes
+	const SubMesh* parts = reinterpret_cast<const SubMesh*>(data + h->submeshOffset);
+	for (uint64_t i = 0; i < static_cast<uint64_t>(h->levelCount) * h->submeshCount; i++)
+		if (static_cast<uint64_t>(parts[i].indexOffset) + parts[i].indexCount > h->indexCount
+			|| parts[i].material < -1 || parts[i].material >= static_cast<int64_t>(h->materialCount))
+			return false;
+
+	header = h;
+	vertices = data + h->vertexOffset;
+	indices = data + h->indexOffset;
+	submeshes = reinterpret_cast<const SubMesh*>(data + h->submeshOffset);
+	levelErrors = reinterpret_cast<const float*>(data + h->levelOffset);
+
+	materials.clear();
+	const fs::path cacheDir = fs::path(cachePath).parent_path();
+	Reader reader(data + h->materialOffset, data + h->dependencyOffset);
+	for (uint32_t i = 0; i < h->materialCount && reader.ok(); i++)
+	{
+		NamedMaterial m;
+		m.name = reader.string();
+		m.material.Ka = reader.vec3();
+		m.material.Kd = reader.vec3();
+		m.material.Ks = reader.vec3();
+		m.material.Ke = reader.vec3();
+		m.material.Ns = reader.value<float>();
+		m.material.Ni = reader.value<float>();
+		m.material.d = reader.value<float>();
+		m.material.illum = reader.value<int32_t>();
+		m.material.map_Kd = reader.string();
+		if (!m.material.map_Kd.empty() && fs::path(m.material.map_Kd).is_relative())
+			m.material.map_Kd = (cacheDir / m.material.map_Kd).lexically_normal().generic_string();
+		materials.push_back(m);
+	}
+
+	dependencies.clear();
+	Reader depReader(data + h->dependencyOffset, data + size);
+	for (uint32_t i = 0; i < h->dependencyCount && depReader.ok(); i++)
+	{
+		MeshCacheDependency dep;
+		dep.name = depReader.string();
+		dep.size = depReader.value<uint64_t>();
+		dep.mtime = depReader.value<int64_t>();
+		dep.hash = depReader.value<uint64_t>();
+		dependencies.push_back(dep);
+	}
+	return reader.ok() && depReader.ok();
+}
+
+bool openMeshCache(const std::string& cachePath, glm::vec3 color, VertexFormat format, MappedFile& file, MeshCacheView& view)
+{
+	if (!file.open(cachePath))
+		return false;
+	if (!view.parse(file.data(), file.size(), cachePath))
+	{
+		std::cout << "Cache de malha invalido ou de outra versao: " << cachePath << std::endl;
+		return false;
+	}
+	if (view.header->vertexFormat != format)
+		return false;
+	for (int k = 0; k < 3; k++)
+		if (view.header->color[k] != color[k])
+			return false;
+
+	fs::path cacheDir = fs::path(cachePath).parent_path();
+	std::vector<std::pair<uint64_t, int64_t>> refreshedTimes; // posição do campo no arquivo e data nova
+	uint64_t record = view.header->dependencyOffset;
+	for (const MeshCacheDependency& dep : view.dependencies)
+	{
+		// Registro: nome (tamanho + bytes), size, mtime, hash
+		const uint64_t mtimeOffset = record + sizeof(uint32_t) + dep.name.size() + sizeof(uint64_t);
+		record = mtimeOffset + sizeof(int64_t) + sizeof(uint64_t);
+
+		fs::path source = cacheDir / dep.name;
+		std::error_code ec;
+		uint64_t size = fs::file_size(source, ec);
+		if (dep.size == kMissingDependency)
+		{
+			// Continua faltando: nada mudou. Se apareceu, a malha precisa ser refeita com ela
+			if (ec)
+				continue;
+			return false;
+		}
+		if (ec || size != dep.size)
+			return false;
+		if (modificationTime(source) == dep.mtime)
+			continue;
+
+		// A data mudou (ex: checkout ou cópia), mas o conteúdo pode ser o mesmo
+		MeshCacheDependency current;
+		if (!describeSource(source, current) || current.hash != dep.hash)
+			return false;
+		refreshedTimes.emplace_back(mtimeOffset, current.mtime);
+	}
+	if (!refreshedTimes.empty())
+	{
+		// As datas novas vão numa cópia gravada como um cache novo (temporário e rename), para a
+		// próxima abertura não ler a fonte de novo. Quem ainda tem o arquivo antigo mapeado
+		// continua com ele intacto; se não der para trocar o arquivo, fica como está
+		std::vector<char> image(file.data(), file.data() + file.size());
+		for (const std::pair<uint64_t, int64_t>& time : refreshedTimes)
+			memcpy(&image[time.first], &time.second, sizeof(time.second));
+		saveMeshCache(cachePath, image);
+	}
+	return true;
+}
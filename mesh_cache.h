@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "mesh_builder.h"
+#include "vertex_format.h"
+
+// Formato binário do cache de malhas (arquivo "<fonte>.meshcache" ao lado do OBJ).
+// Aumente a versão sempre que o layout do arquivo ou dos vértices mudar.
+const uint32_t kMeshCacheVersion = 8;
+
+struct MeshCacheHeader {
+	char magic[8];            // "CGMESH\0\0"
+	uint32_t version;
+	uint32_t vertexStride;    // bytes por vértice
+	uint32_t indexSize;       // 2 ou 4 bytes por índice
+	uint32_t submeshCount;    // por nível de detalhe
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	float color[3];           // cor gravada nos vértices (parâmetro de loadSimpleOBJ)
+	float boundsRadius;       // esfera envolvente centrada na caixa
+	uint32_t materialCount;
+	uint32_t dependencyCount;
+	uint32_t vertexFormat;    // VertexFormat
+	uint32_t levelCount;      // níveis de detalhe, contando o 0 (a malha original)
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t submeshOffset;   // submeshCount submalhas de cada nível, nível a nível
+	uint64_t levelOffset;     // erro de cada nível (float)
+	uint64_t materialOffset;  // registros de tamanho variável
+	uint64_t dependencyOffset;
+	uint64_t fileSize;
+};
+
+// Arquivo de origem do qual o cache depende (OBJ e MTLs), para invalidação
+struct MeshCacheDependency {
+	std::string name; // relativo à pasta do cache
+	uint64_t size;    // kMissingDependency: não existia ao gerar o cache
+	int64_t mtime;
+	uint64_t hash;
+};
+
+// Tamanho gravado para uma fonte que não pôde ser lida (ex: um MTL citado que ainda não
+// existe): o cache vale enquanto ela continuar faltando, e é refeito quando ela aparece
+const uint64_t kMissingDependency = ~0ull;
+
+// Visão (sem cópia) sobre a imagem de um cache de malha, seja um arquivo mapeado
+// ou um buffer em memória. Os ponteiros valem enquanto a imagem existir.
+struct MeshCacheView {
+	const MeshCacheHeader* header = nullptr;
+	const void* vertices = nullptr;
+	const void* indices = nullptr;
+	const SubMesh* submeshes = nullptr;
+	const float* levelErrors = nullptr;
+	std::vector<NamedMaterial> materials;
+	std::vector<MeshCacheDependency> dependencies;
+
+	// Valida a estrutura da imagem e preenche os ponteiros. As texturas dos materiais são
+	// gravadas relativas à pasta de 'cachePath' e voltam relativas ao diretório de trabalho
+	bool parse(const char* data, size_t size, const std::string& cachePath);
+
+	size_t vertexBytes() const { return header->vertexCount * header->vertexStride; }
+	size_t indexBytes() const { return header->indexCount * header->indexSize; }
+	glm::vec3 boundsMin() const { return glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]); }
+	glm::vec3 boundsMax() const { return glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]); }
+	float boundsRadius() const { return header->boundsRadius; }
+	const SubMesh* levelSubmeshes(uint32_t level) const { return submeshes + static_cast<size_t>(level) * header->submeshCount; }
+};
+
+std::string meshCachePath(const std::string& sourcePath);
+
+// Hash de 64 bits do conteúdo (não criptográfico), usado na invalidação
+uint64_t hashBytes(const char* data, size_t size);
+
+// Monta a imagem do cache. 'sources' são os arquivos dos quais a malha foi gerada;
+// tamanho, data de modificação e hash de cada um são gravados para a invalidação (os que
+// faltam, com kMissingDependency).
+// 'format' escolhe o layout gravado: floats ou PackedVertex (quantizado).
+std::vector<char> serializeMeshCache(const MeshData& mesh, glm::vec3 color, VertexFormat format,
+	const std::vector<std::string>& sources, const std::string& cachePath);
+
+bool saveMeshCache(const std::string& cachePath, const std::vector<char>& image);
+
+// Mapeia o cache e verifica se ainda corresponde às fontes: tamanho diferente invalida;
+// se a data de modificação mudou, o hash do conteúdo decide (e, se confere, a data nova é
+// gravada no cache, para a fonte não ser lida de novo a cada abertura). Retorna false se o
+// cache não existe, é de outra versão/formato ou está desatualizado.
+bool openMeshCache(const std::string& cachePath, glm::vec3 color, VertexFormat format, MappedFile& file, MeshCacheView& view);
@@ -0,0 +1,460 @@
+#include "mesh_lod.h"
+#include "profiler.h"
+#include "run_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+const uint32_t kNone = 0xFFFFFFFFu;
+
+// Soma ponderada (pela área) dos quadrados das distâncias a planos: a metade superior da
+// matriz 4x4 simétrica e o peso total, para devolver o erro como distância
+struct Quadric {
+	double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+	double yy = 0.0, yz = 0.0, yw = 0.0;
+	double zz = 0.0, zw = 0.0;
+	double ww = 0.0;
+	double weight = 0.0;
+
+	// Plano n . p + d = 0 com 'n' unitário
+	void addPlane(double a, double b, double c, double d, double w)
+	{
+		xx += w * a * a; xy += w * a * b; xz += w * a * c; xw += w * a * d;
+		yy += w * b * b; yz += w * b * c; yw += w * b * d;
+		zz += w * c * c; zw += w * c * d;
+		ww += w * d * d;
+		weight += w;
+	}
+
+	Quadric& operator+=(const Quadric& q)
+	{
+		xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+		yy += q.yy; yz += q.yz; yw += q.yw;
+		zz += q.zz; zw += q.zw;
+		ww += q.ww;
+		weight += q.weight;
+		return *this;
+	}
+
+	// Distância média (raiz da média dos quadrados) de 'p' aos planos acumulados
+	float distance(const glm::vec3& p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		double e = xx * x * x + yy * y * y + zz * z * z + ww
+			+ 2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+		return weight > 0.0 ? static_cast<float>(std::sqrt(std::max(e, 0.0) / weight)) : 0.0f;
+	}
+};
+
+struct Collapse {
+	float cost;
+	uint32_t from; // removido: os triângulos dele passam a usar 'to'
+	uint32_t to;
+};
+
+// Cadeia de níveis de uma submalha
+struct SubmeshChain {
+	std::vector<std::vector<uint32_t>> levels; // índices de cada nível, nos vértices da malha
+	std::vector<float> errors;
+};
+
+// Estado de simplificação de uma submalha, com os vértices renumerados localmente
+class SubmeshSimplifier
+{
+public:
+	// 'fixed' marca os vértices da malha que não podem sair (costuras e fronteiras entre submalhas)
+	SubmeshSimplifier(const MeshData& mesh, const SubMesh& submesh, const std::vector<uint8_t>& fixed)
+	{
+		std::unordered_map<uint32_t, uint32_t> local;
+		local.reserve(submesh.indexCount);
+		mIndices.reserve(submesh.indexCount);
+		for (uint32_t i = 0; i < submesh.indexCount; i++)
+		{
+			const uint32_t index = mesh.indices[submesh.indexOffset + i];
+			auto inserted = local.emplace(index, static_cast<uint32_t>(mGlobal.size()));
+			if (inserted.second)
+				mGlobal.push_back(index);
+			mIndices.push_back(inserted.first->second);
+		}
+
+		const size_t count = mGlobal.size();
+		mPositions.resize(count);
+		mNormals.resize(count);
+		mLocked.resize(count);
+		for (size_t v = 0; v < count; v++)
+		{
+			const float* vertex = &mesh.vertices[static_cast<size_t>(mGlobal[v]) * kVertexFloats];
+			mPositions[v] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+			glm::vec3 normal(vertex[8], vertex[9], vertex[10]);
+			float length = glm::length(normal);
+			mNormals[v] = length > 0.0f ? normal / length : normal;
+			mLocked[v] = fixed[mGlobal[v]];
+		}
+
+		// Bordas abertas e arestas não-manifold: as que não têm exatamente dois triângulos
+		std::unordered_map<uint64_t, uint32_t> edges;
+		edges.reserve(mIndices.size());
+		for (size_t t = 0; t < mIndices.size(); t += 3)
+			for (int e = 0; e < 3; e++)
+				edges[edgeKey(mIndices[t + e], mIndices[t + (e + 1) % 3])]++;
+		for (const auto& edge : edges)
+			if (edge.second != 2)
+			{
+				mLocked[static_cast<uint32_t>(edge.first >> 32)] = 1;
+				mLocked[static_cast<uint32_t>(edge.first)] = 1;
+			}
+
+		// Quádrica de cada vértice: os planos dos triângulos em volta, pesados pela área. Os
+		// planos também ficam numa lista por vértice, para o erro máximo (maxDistance)
+		mQuadrics.resize(count);
+		mPlanesOf.resize(count);
+		for (size_t t = 0; t < mIndices.size(); t += 3)
+		{
+			const glm::vec3& p0 = mPositions[mIndices[t]];
+			glm::vec3 n = glm::cross(mPositions[mIndices[t + 1]] - p0, mPositions[mIndices[t + 2]] - p0);
+			float length = glm::length(n);
+			if (length <= 0.0f)
+				continue;
+			n /= length;
+			const double d = -glm::dot(n, p0);
+			const uint32_t plane = static_cast<uint32_t>(mPlanes.size());
+			mPlanes.emplace_back(n, static_cast<float>(d));
+			for (int k = 0; k < 3; k++)
+			{
+				mQuadrics[mIndices[t + k]].addPlane(n.x, n.y, n.z, d, length * 0.5);
+				mPlanesOf[mIndices[t + k]].push_back(plane);
+			}
+		}
+	}
+
+	size_t triangleCount() const { return mIndices.size() / 3; }
+	float error() const { return mError; }
+
+	// Colapsa até 'targetTriangles' ou até não sobrar colapso válido abaixo de 'errorLimit'
+	void simplify(size_t targetTriangles, float errorLimit, float normalCosine)
+	{
+		while (triangleCount() > targetTriangles && pass(targetTriangles, errorLimit, normalCosine) > 0)
+			;
+	}
+
+	// Triângulos atuais reordenados para o cache de vértices, nos índices da malha
+	void output(std::vector<uint32_t>& indices) const
+	{
+		indices = mIndices;
+		optimizeVertexCache(indices, mGlobal.size());
+		for (uint32_t& index : indices)
+			index = mGlobal[index];
+	}
+
+private:
+	static uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	// Triângulos que usam o vértice 'v' (lista refeita a cada passada)
+	const uint32_t* trianglesBegin(uint32_t v) const { return mAdjacency.data() + mAdjacencyOffsets[v]; }
+	const uint32_t* trianglesEnd(uint32_t v) const { return mAdjacency.data() + mAdjacencyOffsets[v + 1]; }
+
+	// Vizinhos de 'v' (sem repetição)
+	void neighbors(uint32_t v, std::vector<uint32_t>& out) const
+	{
+		out.clear();
+		for (const uint32_t* t = trianglesBegin(v); t != trianglesEnd(v); t++)
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t w = mIndices[*t * 3 + k];
+				if (w != v && std::find(out.begin(), out.end(), w) == out.end())
+					out.push_back(w);
+			}
+	}
+
+	// Condição de link: a aresta só pode ter os dois vizinhos em comum dos seus triângulos,
+	// senão o colapso cria uma aresta com mais de dois triângulos
+	bool keepsManifold(uint32_t from, uint32_t to)
+	{
+		neighbors(from, mScratchFrom);
+		neighbors(to, mScratchTo);
+		size_t common = 0;
+		for (uint32_t w : mScratchFrom)
+			if (std::find(mScratchTo.begin(), mScratchTo.end(), w) != mScratchTo.end())
+				common++;
+		return common <= 2;
+	}
+
+	// Maior distância de 'v' aos planos originais juntados nele: o custo dos colapsos é a média
+	// quadrática dessas distâncias (a quádrica), mas o erro do nível é o desvio máximo. A soma
+	// das listas não passa de três planos por triângulo original, então conferir os colapsos
+	// aplicados custa no máximo isso por passada
+	float maxDistance(uint32_t v) const
+	{
+		float distance = 0.0f;
+		for (uint32_t plane : mPlanesOf[v])
+			distance = std::max(distance, std::abs(glm::dot(glm::vec3(mPlanes[plane]), mPositions[v]) + mPlanes[plane].w));
+		return distance;
+	}
+
+	// Algum triângulo em volta de 'from' vira (ou quase degenera) ao mover o vértice para 'to'?
+	bool flips(uint32_t from, uint32_t to) const
+	{
+		for (const uint32_t* t = trianglesBegin(from); t != trianglesEnd(from); t++)
+		{
+			const uint32_t* tri = &mIndices[*t * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue; // some no colapso
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				before[k] = mPositions[tri[k]];
+				after[k] = tri[k] == from ? mPositions[to] : before[k];
+			}
+			glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+				return true;
+		}
+		return false;
+	}
+
+	// Uma passada: ordena os colapsos possíveis pelo custo e aplica os mais baratos que não
+	// mexem na vizinhança uns dos outros. Retorna quantos foram aplicados.
+	size_t pass(size_t targetTriangles, float errorLimit, float normalCosine)
+	{
+		const size_t count = mGlobal.size();
+		mAdjacencyOffsets.assign(count + 1, 0);
+		for (uint32_t index : mIndices)
+			mAdjacencyOffsets[index + 1]++;
+		for (size_t v = 0; v < count; v++)
+			mAdjacencyOffsets[v + 1] += mAdjacencyOffsets[v];
+		mAdjacency.resize(mIndices.size());
+		std::vector<uint32_t> cursor(mAdjacencyOffsets.begin(), mAdjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < mIndices.size(); i++)
+			mAdjacency[cursor[mIndices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		// Só o colapso mais barato de cada vértice: os outros dificilmente caberiam na mesma passada
+		mCandidates.assign(count, { errorLimit, kNone, kNone });
+		auto consider = [&](uint32_t from, uint32_t to) {
+			if (mLocked[from] || glm::dot(mNormals[from], mNormals[to]) < normalCosine)
+				return;
+			Quadric q = mQuadrics[from];
+			q += mQuadrics[to];
+			float cost = q.distance(mPositions[to]);
+			if (cost <= mCandidates[from].cost)
+				mCandidates[from] = { cost, from, to };
+		};
+		for (size_t t = 0; t < mIndices.size(); t += 3)
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = mIndices[t + e], b = mIndices[t + (e + 1) % 3];
+				consider(a, b);
+				consider(b, a);
+			}
+		mCandidates.erase(std::remove_if(mCandidates.begin(), mCandidates.end(), [](const Collapse& c) { return c.from == kNone; }),
+			mCandidates.end());
+		std::sort(mCandidates.begin(), mCandidates.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// Cada colapso interno tira dois triângulos
+		const size_t wanted = (triangleCount() - targetTriangles + 1) / 2;
+		std::vector<uint8_t> touched(count, 0);
+		std::vector<uint32_t> remap(count, kNone);
+		size_t applied = 0;
+		for (const Collapse& c : mCandidates)
+		{
+			if (applied >= wanted)
+				break;
+			if (touched[c.from] || touched[c.to] || !keepsManifold(c.from, c.to) || flips(c.from, c.to))
+				continue;
+			remap[c.from] = c.to;
+			mQuadrics[c.to] += mQuadrics[c.from];
+			mPlanesOf[c.to].insert(mPlanesOf[c.to].end(), mPlanesOf[c.from].begin(), mPlanesOf[c.from].end());
+			std::vector<uint32_t>().swap(mPlanesOf[c.from]);
+			mError = std::max(mError, maxDistance(c.to));
+			applied++;
+			// Os triângulos de 'from' mudam: nada em volta dele colapsa nesta passada
+			touched[c.to] = 1;
+			for (const uint32_t* t = trianglesBegin(c.from); t != trianglesEnd(c.from); t++)
+				for (int k = 0; k < 3; k++)
+					touched[mIndices[*t * 3 + k]] = 1;
+		}
+		if (!applied)
+			return 0;
+
+		size_t out = 0;
+		for (size_t t = 0; t < mIndices.size(); t += 3)
+		{
+			uint32_t tri[3];
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t index = mIndices[t + k];
+				tri[k] = remap[index] == kNone ? index : remap[index];
+			}
+			if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+				continue;
+			for (int k = 0; k < 3; k++)
+				mIndices[out++] = tri[k];
+		}
+		mIndices.resize(out);
+		return applied;
+	}
+
+	std::vector<uint32_t> mGlobal; // vértice local -> vértice da malha
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::vec3> mNormals;
+	std::vector<uint8_t> mLocked;
+	std::vector<Quadric> mQuadrics;
+	std::vector<glm::vec4> mPlanes;               // n, d de cada triângulo original
+	std::vector<std::vector<uint32_t>> mPlanesOf; // planos juntados em cada vértice
+	std::vector<uint32_t> mIndices; // locais
+	std::vector<uint32_t> mAdjacencyOffsets;
+	std::vector<uint32_t> mAdjacency;
+	std::vector<Collapse> mCandidates;
+	std::vector<uint32_t> mScratchFrom, mScratchTo;
+	float mError = 0.0f;
+};
+
+// Vértices que nenhum nível pode tirar do lugar: os que dividem a posição com outro
+// (costuras de UV ou de normal) e os usados por mais de uma submalha
+void findFixedVertices(const MeshData& mesh, std::vector<uint8_t>& fixed)
+{
+	const size_t count = mesh.vertexCount();
+	fixed.assign(count, 0);
+
+	std::vector<uint32_t> order(count);
+	for (uint32_t v = 0; v < count; v++)
+		order[v] = v;
+	auto position = [&](uint32_t v) { return &mesh.vertices[static_cast<size_t>(v) * kVertexFloats]; };
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+	});
+	for (size_t i = 1; i < count; i++)
+		if (std::equal(position(order[i - 1]), position(order[i - 1]) + 3, position(order[i])))
+			fixed[order[i - 1]] = fixed[order[i]] = 1;
+
+	std::vector<uint32_t> owner(count, kNone);
+	for (uint32_t s = 0; s < mesh.submeshes.size(); s++)
+	{
+		const SubMesh& submesh = mesh.submeshes[s];
+		for (uint32_t i = 0; i < submesh.indexCount; i++)
+		{
+			uint32_t index = mesh.indices[submesh.indexOffset + i];
+			if (owner[index] == kNone)
+				owner[index] = s;
+			else if (owner[index] != s)
+				fixed[index] = 1;
+		}
+	}
+}
+
+void buildChain(const MeshData& mesh, const SubMesh& submesh, const std::vector<uint8_t>& fixed,
+	const LodSettings& settings, SubmeshChain& chain)
+{
+	if (submesh.indexCount / 3 < settings.minTriangles)
+		return;
+	SubmeshSimplifier simplifier(mesh, submesh, fixed);
+	const float errorLimit = settings.maxError * mesh.boundsRadius;
+	size_t previous = simplifier.triangleCount();
+	for (unsigned level = 0; level < settings.maxLevels && previous >= settings.minTriangles; level++)
+	{
+		simplifier.simplify(static_cast<size_t>(previous * settings.reduction), errorLimit, settings.normalCosine);
+		const size_t triangles = simplifier.triangleCount();
+		if (triangles > previous * (1.0f - settings.minGain))
+			break;
+		chain.levels.emplace_back();
+		simplifier.output(chain.levels.back());
+		chain.errors.push_back(simplifier.error());
+		previous = triangles;
+	}
+}
+
+} // namespace
+
+void buildLodChains(const std::vector<MeshData*>& meshes, unsigned threads, const LodSettings& settings)
+{
+	PROFILE_SCOPE("buildLodChains");
+	std::vector<std::vector<uint8_t>> fixed(meshes.size());
+	runParallel(meshes.size(), threads, [&](size_t m) {
+		findFixedVertices(*meshes[m], fixed[m]);
+	});
+
+	// Uma tarefa por submalha de todas as malhas, as maiores primeiro para equilibrar as threads
+	struct Job {
+		size_t mesh;
+		size_t submesh;
+	};
+	std::vector<Job> jobs;
+	std::vector<std::vector<SubmeshChain>> chains(meshes.size());
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		chains[m].resize(meshes[m]->submeshes.size());
+		for (size_t s = 0; s < meshes[m]->submeshes.size(); s++)
+			jobs.push_back({ m, s });
+	}
+	std::sort(jobs.begin(), jobs.end(), [&](const Job& a, const Job& b) {
+		return meshes[a.mesh]->submeshes[a.submesh].indexCount > meshes[b.mesh]->submeshes[b.submesh].indexCount;
+	});
+	runParallel(jobs.size(), threads, [&](size_t j) {
+		const Job& job = jobs[j];
+		const MeshData& mesh = *meshes[job.mesh];
+		buildChain(mesh, mesh.submeshes[job.submesh], fixed[job.mesh], settings, chains[job.mesh][job.submesh]);
+	});
+
+	// Os níveis de cada malha vão para o fim do buffer de índices; uma submalha com menos
+	// níveis repete a sua última faixa nos níveis seguintes
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		MeshData& mesh = *meshes[m];
+		mesh.lods.clear();
+		size_t levels = 0;
+		for (const SubmeshChain& chain : chains[m])
+			levels = std::max(levels, chain.levels.size());
+		for (size_t level = 0; level < levels; level++)
+		{
+			MeshLod lod;
+			for (size_t s = 0; s < mesh.submeshes.size(); s++)
+			{
+				const SubmeshChain& chain = chains[m][s];
+				if (level < chain.levels.size())
+				{
+					const std::vector<uint32_t>& indices = chain.levels[level];
+					lod.submeshes.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(indices.size()),
+						mesh.submeshes[s].material });
+					mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+					lod.error = std::max(lod.error, chain.errors[level]);
+				}
+				else
+				{
+					lod.submeshes.push_back(level ? mesh.lods[level - 1].submeshes[s] : mesh.submeshes[s]);
+					if (!chain.errors.empty())
+						lod.error = std::max(lod.error, chain.errors.back());
+				}
+			}
+			mesh.lods.push_back(lod);
+		}
+	}
+}
+
+size_t lodTriangleCount(const MeshData& mesh, size_t level)
+{
+	const std::vector<SubMesh>& submeshes = level ? mesh.lods[level - 1].submeshes : mesh.submeshes;
+	size_t indices = 0;
+	for (const SubMesh& submesh : submeshes)
+		indices += submesh.indexCount;
+	return indices / 3;
+}
+
+uint32_t selectLod(const float* levelErrors, uint32_t levelCount, float distance, float pixelsPerUnit, float pixelError,
+	uint32_t current)
+{
+	const float scale = pixelsPerUnit / std::max(distance, 1e-4f);
+	uint32_t level = std::min(current, levelCount - 1);
+	// Mais detalhado enquanto o nível atual erra mais que o limite
+	while (level > 0 && levelErrors[level] * scale > pixelError)
+		level--;
+	// Mais simples só com folga
+	while (level + 1 < levelCount && levelErrors[level + 1] * scale <= pixelError * kLodHysteresis)
+		level++;
+	return level;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_builder.h"
+
+struct LodSettings {
+	unsigned maxLevels = 4;       // níveis além do 0
+	float reduction = 0.5f;       // triângulos de cada nível em relação ao anterior
+	size_t minTriangles = 64;     // submalhas com menos triângulos não ganham mais níveis
+	float minGain = 0.15f;        // um nível que não tira pelo menos essa fração dos triângulos encerra a cadeia
+	float maxError = 0.05f;       // colapsos com erro acima dessa fração do raio da malha são recusados
+	float normalCosine = 0.85f;   // normais dos vértices de uma aresta mais afastadas que isso impedem o colapso
+};
+
+// Gera a cadeia de níveis de detalhe (MeshData::lods) de cada malha por colapso de arestas
+// com métrica de erro quádrica (Garland e Heckbert): a cada passada, as arestas de menor
+// custo são colapsadas sobre um dos vértices, então os níveis só usam vértices existentes
+// e compartilham o buffer de vértices do nível 0. Cada nível continua os colapsos do
+// anterior. A quádrica (média quadrática das distâncias aos planos juntados) ordena e limita
+// os colapsos; o erro gravado é o máximo dessas distâncias até o nível, para selectLod não
+// subestimar o erro na tela.
+//
+// Vértices de costura (mesma posição com outra coordenada de textura ou normal), de borda
+// aberta e de fronteira entre materiais ficam fixos, assim as costuras de UV e os contornos
+// não se abrem. Colapsos que viram triângulos ou juntam vértices com normais muito
+// diferentes são recusados.
+//
+// As submalhas de todas as malhas são simplificadas em paralelo em 'threads' threads.
+void buildLodChains(const std::vector<MeshData*>& meshes, unsigned threads, const LodSettings& settings = LodSettings());
+
+// Triângulos do nível 'level' (0: a malha original)
+size_t lodTriangleCount(const MeshData& mesh, size_t level);
+
+// Nível a desenhar para um objeto a 'distance' da câmera (até a esfera envolvente): o mais
+// simples cujo erro projetado fica abaixo de 'pixelError' pixels. 'pixelsPerUnit' converte
+// uma unidade a uma unidade de distância em pixels (altura da tela / (2 tan(fov / 2)), vezes
+// a escala do objeto). Para não alternar entre dois níveis na fronteira, só passa para um
+// nível mais simples com folga (kLodHysteresis); 'current' é o nível do quadro anterior.
+const float kLodHysteresis = 0.75f;
+uint32_t selectLod(const float* levelErrors, uint32_t levelCount, float distance, float pixelsPerUnit, float pixelError,
+	uint32_t current);
@@ -0,0 +1,509 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include "run_parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+
+namespace {
+
+// Abaixo disso não compensa dividir o arquivo entre threads
+const size_t kMinChunkBytes = 256 * 1024;
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+inline bool isLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p))
+		++p;
+	return p;
+}
+
+inline const char* nextLine(const char* p, const char* end)
+{
+	const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+	return nl ? nl + 1 : end;
+}
+
+inline bool parseFloat(const char*& p, const char* end, float& value)
+{
+	p = skipBlanks(p, end);
+	// from_chars não aceita o sinal '+'
+	if (p < end && *p == '+')
+		++p;
+#if defined(__cpp_lib_to_chars)
+	std::from_chars_result r = std::from_chars(p, end, value);
+	if (r.ec != std::errc())
+		return false;
+	p = r.ptr;
+	return true;
+#else
+	// Biblioteca sem from_chars para float: copia o token para um buffer na pilha
+	char buf[64];
+	size_t n = 0;
+	while (p + n < end && n < sizeof(buf) - 1 && !isBlank(p[n]) && !isLineEnd(p[n]))
+	{
+		buf[n] = p[n];
+		++n;
+	}
+	buf[n] = '\0';
+	char* stop = nullptr;
+	value = strtof(buf, &stop);
+	if (stop == buf)
+		return false;
+	p += stop - buf;
+	return true;
+#endif
+}
+
+inline bool parseInt(const char*& p, const char* end, int& value)
+{
+	if (p < end && *p == '+')
+		++p;
+	std::from_chars_result r = std::from_chars(p, end, value);
+	if (r.ec != std::errc())
+		return false;
+	p = r.ptr;
+	return true;
+}
+
+// Valor usado para referências que não apontam para nenhum atributo (índice 0 ou
+// negativo além do início da lista). Diferente de -1, que significa "ausente".
+const int kInvalidIndex = -2;
+
+// Converte um índice OBJ (base 1, ou negativo relativo ao fim da lista) para base zero.
+// No modo em blocos (deferred) o índice relativo é resolvido só contra os atributos do
+// próprio bloco e pode ficar negativo até a correção com a soma de prefixos.
+inline int resolveIndex(int index, size_t count, bool deferred)
+{
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+	{
+		int resolved = static_cast<int>(count) + index;
+		return (resolved >= 0 || deferred) ? resolved : kInvalidIndex;
+	}
+	return kInvalidIndex;
+}
+
+// Posições (canto * 3 + atributo) de índices relativos que ainda precisam ser
+// deslocados pelo total de atributos dos blocos anteriores
+using RelativeRefs = std::vector<size_t>;
+
+// Lê um canto de face "v", "v/vt", "v//vn" ou "v/vt/vn".
+// relMask recebe um bit por atributo (v, vt, vn) escrito com índice negativo.
+inline bool parseCorner(const char*& p, const char* end, const ObjData& data, bool deferred,
+	ObjIndex& corner, unsigned& relMask)
+{
+	int v = 0, vt = 0, vn = 0;
+	if (!parseInt(p, end, v))
+		return false;
+	if (p < end && *p == '/')
+	{
+		++p;
+		if (p < end && *p != '/')
+		{
+			if (!parseInt(p, end, vt))
+				return false;
+		}
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (!parseInt(p, end, vn))
+				return false;
+		}
+	}
+	corner.v = resolveIndex(v, data.positions.size(), deferred);
+	corner.vt = vt != 0 ? resolveIndex(vt, data.texCoords.size(), deferred) : -1;
+	corner.vn = vn != 0 ? resolveIndex(vn, data.normals.size(), deferred) : -1;
+	relMask = (v < 0 ? 1u : 0u) | (vt < 0 ? 2u : 0u) | (vn < 0 ? 4u : 0u);
+	return true;
+}
+
+inline void emitCorner(ObjData& out, const ObjIndex& corner, unsigned relMask, RelativeRefs* relative)
+{
+	if (relative && relMask)
+	{
+		size_t pos = out.corners.size() * 3;
+		for (unsigned k = 0; k < 3; k++)
+			if (relMask & (1u << k))
+				relative->push_back(pos + k);
+	}
+	out.corners.push_back(corner);
+}
+
+// Lê os cantos de uma linha "f" e emite os triângulos do leque (0, i-1, i)
+inline bool parseFace(const char* p, const char* end, ObjData& out, RelativeRefs* relative)
+{
+	ObjIndex first{}, prev{};
+	unsigned firstMask = 0, prevMask = 0;
+	int count = 0;
+	while (true)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end || isLineEnd(*p) || *p == '#')
+			break;
+
+		ObjIndex corner;
+		unsigned mask;
+		if (!parseCorner(p, end, out, relative != nullptr, corner, mask))
+			return false;
+
+		if (count == 0)
+		{
+			first = corner;
+			firstMask = mask;
+		}
+		else if (count >= 2)
+		{
+			emitCorner(out, first, firstMask, relative);
+			emitCorner(out, prev, prevMask, relative);
+			emitCorner(out, corner, mask, relative);
+		}
+		prev = corner;
+		prevMask = mask;
+		++count;
+	}
+	return count >= 3;
+}
+
+inline bool validIndex(int index, size_t count, bool optional)
+{
+	if (index == -1)
+		return optional;
+	return index >= 0 && static_cast<size_t>(index) < count;
+}
+
+// Abre um trecho de material em 'firstTriangle'. Um trecho anterior sem nenhum triângulo é
+// substituído e um trecho com o mesmo material do anterior não é criado, então aplicar
+// os "usemtl" de uma vez ou bloco a bloco (e juntar depois) dá a mesma lista.
+void addMaterialRun(std::vector<ObjMaterialRun>& runs, uint32_t firstTriangle, int32_t material)
+{
+	if (!runs.empty() && runs.back().firstTriangle == firstTriangle)
+		runs.pop_back();
+	int32_t previous = runs.empty() ? -1 : runs.back().material;
+	if (previous != material)
+		runs.push_back({ firstTriangle, material });
+}
+
+int32_t materialIndex(std::vector<std::string>& names, const char* begin, const char* end)
+{
+	// Poucos materiais por arquivo: a busca linear basta
+	for (size_t i = 0; i < names.size(); i++)
+		if (names[i].size() == static_cast<size_t>(end - begin) && memcmp(names[i].data(), begin, end - begin) == 0)
+			return static_cast<int32_t>(i);
+	names.emplace_back(begin, end);
+	return static_cast<int32_t>(names.size() - 1);
+}
+
+// Remove triângulos que referenciam atributos inexistentes (preservando a ordem)
+// e desloca os trechos de material para as novas posições
+size_t dropInvalidTriangles(ObjData& data)
+{
+	std::vector<ObjMaterialRun> runs;
+	runs.swap(data.materialRuns);
+	size_t nextRun = 0;
+
+	size_t write = 0;
+	for (size_t read = 0; read + 2 < data.corners.size(); read += 3)
+	{
+		for (; nextRun < runs.size() && runs[nextRun].firstTriangle <= read / 3; nextRun++)
+			addMaterialRun(data.materialRuns, static_cast<uint32_t>(write / 3), runs[nextRun].material);
+
+		bool ok = true;
+		for (int k = 0; k < 3; k++)
+		{
+			const ObjIndex& c = data.corners[read + k];
+			ok = ok && validIndex(c.v, data.positions.size(), false)
+				&& validIndex(c.vt, data.texCoords.size(), true)
+				&& validIndex(c.vn, data.normals.size(), true);
+		}
+		if (ok)
+		{
+			if (write != read)
+			{
+				data.corners[write] = data.corners[read];
+				data.corners[write + 1] = data.corners[read + 1];
+				data.corners[write + 2] = data.corners[read + 2];
+			}
+			write += 3;
+		}
+	}
+	for (; nextRun < runs.size(); nextRun++)
+		addMaterialRun(data.materialRuns, static_cast<uint32_t>(write / 3), runs[nextRun].material);
+
+	size_t dropped = (data.corners.size() - write) / 3;
+	data.corners.resize(write);
+	return dropped;
+}
+
+inline bool isMaterialLibraryLine(const char* line, const char* lineEnd)
+{
+	return line[0] == 'm' && lineEnd - line > 7 && memcmp(line, "mtllib", 6) == 0 && isBlank(line[6]);
+}
+
+// Nomes depois de "mtllib": podem ser citados vários arquivos na mesma linha
+void parseMaterialLibraries(const char* q, const char* lineEnd, std::vector<std::string>& libraries)
+{
+	while (true)
+	{
+		q = skipBlanks(q, lineEnd);
+		const char* nameEnd = q;
+		while (nameEnd < lineEnd && !isBlank(*nameEnd) && !isLineEnd(*nameEnd))
+			++nameEnd;
+		if (nameEnd == q)
+			break;
+		libraries.emplace_back(q, nameEnd);
+		q = nameEnd;
+	}
+}
+
+// Laço principal do parser, compartilhado pelo modo serial e pelos blocos do modo paralelo.
+// Com relative != nullptr os índices negativos ficam pendentes de correção.
+void parseRange(const char* begin, const char* end, ObjData& out, ObjParseStats& stats, RelativeRefs* relative)
+{
+	const char* p = begin;
+	while (p < end)
+	{
+		const char* line = skipBlanks(p, end);
+		if (line >= end)
+			break;
+		p = nextLine(line, end);
+		if (line + 1 >= end)
+			continue;
+
+		bool ok = true;
+		if (line[0] == 'v' && isBlank(line[1]))
+		{
+			const char* q = line + 2;
+			glm::vec3 v;
+			ok = parseFloat(q, p, v.x) && parseFloat(q, p, v.y) && parseFloat(q, p, v.z);
+			if (ok)
+				out.positions.push_back(v);
+		}
+		else if (line[0] == 'v' && line[1] == 't' && line + 2 < end && isBlank(line[2]))
+		{
+			const char* q = line + 3;
+			glm::vec2 vt(0.0f, 0.0f);
+			// A coordenada t é opcional no formato
+			ok = parseFloat(q, p, vt.s);
+			if (ok)
+			{
+				if (!parseFloat(q, p, vt.t))
+					vt.t = 0.0f;
+				out.texCoords.push_back(vt);
+			}
+		}
+		else if (line[0] == 'v' && line[1] == 'n' && line + 2 < end && isBlank(line[2]))
+		{
+			const char* q = line + 3;
+			glm::vec3 vn;
+			ok = parseFloat(q, p, vn.x) && parseFloat(q, p, vn.y) && parseFloat(q, p, vn.z);
+			if (ok)
+				out.normals.push_back(vn);
+		}
+		else if (isMaterialLibraryLine(line, p))
+		{
+			parseMaterialLibraries(line + 7, p, out.materialLibraries);
+		}
+		else if (line[0] == 'u' && p - line > 7 && memcmp(line, "usemtl", 6) == 0 && isBlank(line[6]))
+		{
+			const char* name = skipBlanks(line + 7, p);
+			const char* nameEnd = p;
+			while (nameEnd > name && (isBlank(nameEnd[-1]) || isLineEnd(nameEnd[-1])))
+				--nameEnd;
+			ok = nameEnd > name;
+			if (ok)
+				addMaterialRun(out.materialRuns, static_cast<uint32_t>(out.corners.size() / 3),
+					materialIndex(out.materialNames, name, nameEnd));
+		}
+		else if (line[0] == 'f' && isBlank(line[1]))
+		{
+			size_t before = out.corners.size();
+			size_t relativeBefore = relative ? relative->size() : 0;
+			ok = parseFace(line + 2, p, out, relative);
+			if (!ok)
+			{
+				out.corners.resize(before);
+				if (relative)
+					relative->resize(relativeBefore);
+			}
+		}
+
+		if (!ok)
+			stats.malformedLines++;
+	}
+}
+
+struct Chunk {
+	const char* begin;
+	const char* end;
+	ObjData data;
+	ObjParseStats stats;
+	RelativeRefs relative;
+	// Soma de prefixos: quantidade de cada atributo nos blocos anteriores
+	size_t basePositions = 0, baseTexCoords = 0, baseNormals = 0, baseCorners = 0;
+};
+
+template <typename T>
+void copyInto(std::vector<T>& dst, size_t offset, const std::vector<T>& src)
+{
+	if (!src.empty())
+		memcpy(dst.data() + offset, src.data(), src.size() * sizeof(T));
+}
+
+} // namespace
+
+void parseOBJ(const char* begin, const char* end, ObjData& out, ObjParseStats& stats)
+{
+	parseRange(begin, end, out, stats, nullptr);
+	stats.droppedTriangles += dropInvalidTriangles(out);
+}
+
+void parseOBJParallel(const char* begin, const char* end, ObjData& out, ObjParseStats& stats, unsigned threads)
+{
+	size_t size = static_cast<size_t>(end - begin);
+	size_t chunkCount = std::min<size_t>(static_cast<size_t>(threads) * 4, size / kMinChunkBytes);
+	if (threads <= 1 || chunkCount < 2 || !out.positions.empty() || !out.corners.empty())
+	{
+		stats.threads = 1;
+		parseOBJ(begin, end, out, stats);
+		return;
+	}
+	stats.threads = threads;
+
+	// Divide o arquivo em blocos de tamanho parecido, sempre em início de linha
+	std::vector<Chunk> chunks(chunkCount);
+	const char* cursor = begin;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* target = (i + 1 == chunkCount) ? end : begin + size * (i + 1) / chunkCount;
+		if (target < cursor)
+			target = cursor;
+		const char* chunkEnd = (target < end) ? nextLine(target, end) : end;
+		// O alvo pode cair exatamente no início de uma linha; nesse caso não avança uma linha inteira
+		if (target > begin && target < end && target[-1] == '\n')
+			chunkEnd = target;
+		chunks[i].begin = cursor;
+		chunks[i].end = chunkEnd;
+		cursor = chunkEnd;
+	}
+
+	// Fase 1: cada bloco é lido de forma independente
+	runParallel(chunkCount, threads, [&](size_t i) {
+		PROFILE_SCOPE("parseOBJ chunk");
+		Chunk& c = chunks[i];
+		size_t estimatedLines = static_cast<size_t>(c.end - c.begin) / 32;
+		c.data.positions.reserve(estimatedLines / 4);
+		c.data.corners.reserve(estimatedLines);
+		parseRange(c.begin, c.end, c.data, c.stats, &c.relative);
+	});
+
+	// Soma de prefixos das contagens para posicionar cada bloco no resultado final
+	size_t positions = 0, texCoords = 0, normals = 0, corners = 0;
+	for (Chunk& c : chunks)
+	{
+		c.basePositions = positions;
+		c.baseTexCoords = texCoords;
+		c.baseNormals = normals;
+		c.baseCorners = corners;
+		positions += c.data.positions.size();
+		texCoords += c.data.texCoords.size();
+		normals += c.data.normals.size();
+		corners += c.data.corners.size();
+		stats.malformedLines += c.stats.malformedLines;
+		out.materialLibraries.insert(out.materialLibraries.end(),
+			c.data.materialLibraries.begin(), c.data.materialLibraries.end());
+
+		// Trechos de material: os nomes do bloco entram na tabela global (na ordem do primeiro
+		// uso, como no caminho serial) e os triângulos são deslocados pelos blocos anteriores
+		std::vector<int32_t> remap(c.data.materialNames.size());
+		for (size_t m = 0; m < remap.size(); m++)
+		{
+			const std::string& name = c.data.materialNames[m];
+			remap[m] = materialIndex(out.materialNames, name.data(), name.data() + name.size());
+		}
+		for (const ObjMaterialRun& run : c.data.materialRuns)
+			addMaterialRun(out.materialRuns, static_cast<uint32_t>(c.baseCorners / 3 + run.firstTriangle), remap[run.material]);
+	}
+	out.positions.resize(positions);
+	out.texCoords.resize(texCoords);
+	out.normals.resize(normals);
+	out.corners.resize(corners);
+
+	// Fase 2: copia os blocos para o lugar e corrige os índices relativos
+	runParallel(chunkCount, threads, [&](size_t i) {
+		PROFILE_SCOPE("parseOBJ chunk");
+		Chunk& c = chunks[i];
+		copyInto(out.positions, c.basePositions, c.data.positions);
+		copyInto(out.texCoords, c.baseTexCoords, c.data.texCoords);
+		copyInto(out.normals, c.baseNormals, c.data.normals);
+		copyInto(out.corners, c.baseCorners, c.data.corners);
+
+		for (size_t ref : c.relative)
+		{
+			ObjIndex& corner = out.corners[c.baseCorners + ref / 3];
+			int* index = (ref % 3 == 0) ? &corner.v : (ref % 3 == 1) ? &corner.vt : &corner.vn;
+			size_t base = (ref % 3 == 0) ? c.basePositions : (ref % 3 == 1) ? c.baseTexCoords : c.baseNormals;
+			*index += static_cast<int>(base);
+			if (*index < 0)
+				*index = kInvalidIndex;
+		}
+
+		// Libera a memória do bloco assim que copiado
+		c.data = ObjData();
+		c.relative = RelativeRefs();
+	});
+
+	stats.droppedTriangles += dropInvalidTriangles(out);
+}
+
+void findMaterialLibraries(const char* begin, const char* end, std::vector<std::string>& libraries)
+{
+	const char* p = begin;
+	while (p < end)
+	{
+		const char* line = skipBlanks(p, end);
+		if (line >= end)
+			break;
+		p = nextLine(line, end);
+		if (line + 1 < end && isMaterialLibraryLine(line, p))
+			parseMaterialLibraries(line + 7, p, libraries);
+	}
+}
+
+bool loadOBJFile(const std::string& filepath, ObjData& out, ObjParseStats* stats, unsigned threads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	MappedFile file;
+	if (!file.open(filepath))
+		return false;
+
+	ObjParseStats local;
+	ObjParseStats& s = stats ? *stats : local;
+	s.bytes = file.size();
+	s.threads = 1;
+
+	if (threads > 1)
+	{
+		parseOBJParallel(file.begin(), file.end(), out, s, threads);
+	}
+	else
+	{
+		// Estimativa grosseira para evitar realocações sucessivas nos arquivos grandes
+		size_t estimatedLines = file.size() / 32;
+		out.positions.reserve(estimatedLines / 4);
+		out.corners.reserve(estimatedLines);
+
+		parseOBJ(file.begin(), file.end(), out, s);
+	}
+
+	s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Índices (base zero) de um canto de face: posição, coordenada de textura e normal.
+// vt e vn valem -1 quando a face não os referencia (formas "v" e "v//vn", por exemplo).
+struct ObjIndex {
+	int v;
+	int vt;
+	int vn;
+};
+
+// Trecho de triângulos com o mesmo material ("usemtl"), até o início do próximo trecho.
+// Os triângulos antes do primeiro trecho não têm material (-1).
+struct ObjMaterialRun {
+	uint32_t firstTriangle;
+	int32_t material; // posição em ObjData::materialNames
+};
+
+// Resultado bruto do parser: atributos na ordem do arquivo e os cantos das faces,
+// já triangulados em leque (3 cantos consecutivos por triângulo).
+struct ObjData {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjIndex> corners;
+	std::vector<std::string> materialLibraries; // arquivos citados em "mtllib", na ordem
+	std::vector<std::string> materialNames;     // nomes citados em "usemtl", na ordem do primeiro uso
+	std::vector<ObjMaterialRun> materialRuns;   // crescentes em firstTriangle, materiais vizinhos diferentes
+
+	size_t triangleCount() const { return corners.size() / 3; }
+};
+
+struct ObjParseStats {
+	size_t bytes = 0;
+	double seconds = 0.0;
+	size_t malformedLines = 0;   // linhas v/vt/vn/f com números inválidos, usemtl sem nome
+	size_t droppedTriangles = 0; // triângulos com índices fora do intervalo
+	unsigned threads = 1;
+
+	double megabytesPerSecond() const { return seconds > 0.0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0; }
+};
+
+// Faz o parse do texto OBJ em [begin, end) sem alocações por linha.
+// Aceita faces nas formas v, v/vt, v//vn e v/vt/vn, índices negativos (relativos)
+// e polígonos com qualquer número de vértices (triangulados em leque).
+// "usemtl" abre um trecho de material; grupos ("g", "o") não mudam o estado de desenho e
+// são ignorados.
+void parseOBJ(const char* begin, const char* end, ObjData& out, ObjParseStats& stats);
+
+// Versão paralela: divide o texto em blocos (sempre em fim de linha), lê cada bloco em
+// uma thread e junta os resultados corrigindo os índices relativos com uma soma de
+// prefixos. O resultado é idêntico, byte a byte, ao de parseOBJ.
+// 'out' deve estar vazio; arquivos pequenos caem no caminho serial.
+void parseOBJParallel(const char* begin, const char* end, ObjData& out, ObjParseStats& stats, unsigned threads);
+
+// Só os arquivos citados em "mtllib" no texto [begin, end), na ordem, sem ler o resto do OBJ
+void findMaterialLibraries(const char* begin, const char* end, std::vector<std::string>& libraries);
+
+// Mapeia o arquivo em memória e faz o parse. Retorna false se o arquivo não puder ser aberto.
+// Com threads > 1 usa parseOBJParallel.
+bool loadOBJFile(const std::string& filepath, ObjData& out, ObjParseStats* stats = nullptr, unsigned threads = 1);
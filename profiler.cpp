@@ -0,0 +1,324 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> gProfilerEnabled{ false };
+
+namespace {
+
+// Eventos por thread; o mais antigo é sobrescrito quando o anel enche
+const size_t kRingCapacity = 1 << 14;
+const size_t kGpuEventCapacity = 1 << 14;
+const uint32_t kGpuThread = 0xFFFFFFFFu;
+
+struct ThreadRing {
+	uint32_t id = 0;
+	const char* name = nullptr;
+	std::atomic<bool> inUse{ false };
+	std::atomic<uint64_t> head{ 0 }; // total de eventos já escritos
+	ProfileEvent events[kRingCapacity];
+};
+
+// Os anéis nunca são liberados: o de uma thread que terminou é reaproveitado pela próxima
+// (ex: as threads de runParallel), para a memória não crescer a cada carregamento
+std::mutex gRingsMutex;
+std::vector<std::unique_ptr<ThreadRing>> gRings;
+
+ThreadRing* acquireRing()
+{
+	std::lock_guard<std::mutex> lock(gRingsMutex);
+	for (std::unique_ptr<ThreadRing>& ring : gRings)
+	{
+		bool expected = false;
+		if (ring->inUse.compare_exchange_strong(expected, true))
+			return ring.get();
+	}
+	gRings.emplace_back(new ThreadRing());
+	ThreadRing* ring = gRings.back().get();
+	ring->id = static_cast<uint32_t>(gRings.size());
+	ring->inUse = true;
+	return ring;
+}
+
+struct ThreadRingHandle {
+	ThreadRing* ring = nullptr;
+	~ThreadRingHandle()
+	{
+		if (ring)
+			ring->inUse.store(false, std::memory_order_release);
+	}
+	ThreadRing* get()
+	{
+		if (!ring)
+			ring = acquireRing();
+		return ring;
+	}
+};
+
+thread_local ThreadRingHandle tRing;
+
+// Cópia consistente do anel enquanto a thread dona pode estar escrevendo:
+// descarta as entradas que podem ter sido sobrescritas durante a cópia
+void snapshot(const ThreadRing& ring, std::vector<ProfileEvent>& out)
+{
+	uint64_t before = ring.head.load(std::memory_order_acquire);
+	uint64_t first = before > kRingCapacity ? before - kRingCapacity : 0;
+	size_t base = out.size();
+	for (uint64_t i = first; i < before; i++)
+		out.push_back(ring.events[i % kRingCapacity]);
+
+	uint64_t after = ring.head.load(std::memory_order_acquire);
+	uint64_t safe = after >= kRingCapacity ? after - kRingCapacity + 1 : 0;
+	if (safe > first)
+	{
+		size_t drop = static_cast<size_t>(std::min<uint64_t>(safe - first, before - first));
+		out.erase(out.begin() + base, out.begin() + base + drop);
+	}
+	for (size_t i = base; i < out.size(); i++)
+		out[i].thread = ring.id;
+}
+
+void writeEvent(std::ofstream& out, const ProfileEvent& e, int64_t base, int pid, uint32_t tid, bool& first)
+{
+	// trace_event usa microssegundos; relativos ao primeiro evento para não perder precisão
+	out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":" << pid
+		<< ",\"tid\":" << tid << ",\"ts\":" << (e.start - base) / 1000.0 << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+	first = false;
+}
+
+void writeName(std::ofstream& out, const char* kind, int pid, uint32_t tid, const std::string& name, bool& first)
+{
+	out << (first ? "\n" : ",\n") << "{\"name\":\"" << kind << "\",\"ph\":\"M\",\"pid\":" << pid
+		<< ",\"tid\":" << tid << ",\"args\":{\"name\":\"" << name << "\"}}";
+	first = false;
+}
+
+} // namespace
+
+void profilerSetEnabled(bool enabled)
+{
+	gProfilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t profilerNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profilerRecord(const char* name, int64_t start, int64_t end)
+{
+	ThreadRing* ring = tRing.get();
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	ProfileEvent& e = ring->events[head % kRingCapacity];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void profilerSetThreadName(const char* name)
+{
+	tRing.get()->name = name;
+}
+
+void profilerCpuEvents(std::vector<ProfileEvent>& out)
+{
+	std::lock_guard<std::mutex> lock(gRingsMutex);
+	for (const std::unique_ptr<ThreadRing>& ring : gRings)
+		snapshot(*ring, out);
+}
+
+void GpuProfiler::create()
+{
+	// Relógio da GPU -> relógio do profiler, para alinhar as trilhas no trace
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	mClockOffset = profilerNow() - gpuNow;
+	mEvents.clear();
+	mEventHead = 0;
+	mDroppedFrames = 0;
+	mCurrent = 0;
+	mCreated = true;
+}
+
+void GpuProfiler::destroy()
+{
+	for (FrameQueries& frame : mFrames)
+	{
+		if (!frame.queries.empty())
+			glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		frame = FrameQueries();
+	}
+	mCreated = false;
+}
+
+void GpuProfiler::beginFrame()
+{
+	if (!mCreated)
+		return;
+	mCurrent = (mCurrent + 1) % kLatency;
+	resolve(mFrames[mCurrent]);
+}
+
+void GpuProfiler::endFrame()
+{
+	if (!mCreated)
+		return;
+	FrameQueries& frame = mFrames[mCurrent];
+	frame.pending = frame.used > 0;
+}
+
+int GpuProfiler::begin(const char* name)
+{
+	if (!mCreated || !profilerEnabled())
+		return -1;
+	FrameQueries& frame = mFrames[mCurrent];
+	if (frame.used + 2 > frame.queries.size())
+	{
+		size_t old = frame.queries.size();
+		frame.queries.resize(old + 16);
+		glGenQueries(16, frame.queries.data() + old);
+	}
+	int scope = static_cast<int>(frame.used);
+	glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+	frame.names.push_back(name);
+	frame.used += 2;
+	return scope;
+}
+
+void GpuProfiler::end(int scope)
+{
+	if (scope < 0)
+		return;
+	glQueryCounter(mFrames[mCurrent].queries[scope + 1], GL_TIMESTAMP);
+}
+
+void GpuProfiler::resolve(FrameQueries& frame)
+{
+	if (frame.pending)
+	{
+		// Se a última query já está pronta, as anteriores do mesmo quadro também estão
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			for (size_t i = 0; i < frame.used; i += 2)
+			{
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(frame.queries[i + 1], GL_QUERY_RESULT, &end);
+				ProfileEvent e = { frame.names[i / 2], static_cast<int64_t>(start) + mClockOffset,
+					static_cast<int64_t>(end) + mClockOffset, kGpuThread };
+				if (mEvents.size() < kGpuEventCapacity)
+					mEvents.push_back(e);
+				else
+					mEvents[mEventHead] = e;
+				mEventHead = (mEventHead + 1) % kGpuEventCapacity;
+			}
+		}
+		else
+		{
+			mDroppedFrames++;
+		}
+	}
+	frame.used = 0;
+	frame.names.clear();
+	frame.pending = false;
+}
+
+void GpuProfiler::events(std::vector<ProfileEvent>& out) const
+{
+	if (mEvents.size() < kGpuEventCapacity)
+	{
+		out.insert(out.end(), mEvents.begin(), mEvents.end());
+		return;
+	}
+	out.insert(out.end(), mEvents.begin() + mEventHead, mEvents.end());
+	out.insert(out.end(), mEvents.begin(), mEvents.begin() + mEventHead);
+}
+
+bool writeChromeTrace(const std::string& path, const GpuProfiler* gpu)
+{
+	std::vector<ProfileEvent> cpu, gpuEvents;
+	profilerCpuEvents(cpu);
+	if (gpu)
+		gpu->events(gpuEvents);
+	int64_t base = INT64_MAX;
+	for (const ProfileEvent& e : cpu)
+		base = std::min(base, e.start);
+	for (const ProfileEvent& e : gpuEvents)
+		base = std::min(base, e.start);
+
+	std::ofstream out(path, std::ios::trunc);
+	if (!out)
+		return false;
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+
+	// Nomes das trilhas
+	writeName(out, "process_name", 1, 0, "CPU", first);
+	{
+		std::lock_guard<std::mutex> lock(gRingsMutex);
+		for (const std::unique_ptr<ThreadRing>& ring : gRings)
+		{
+			std::string name = ring->name ? ring->name : "thread " + std::to_string(ring->id);
+			writeName(out, "thread_name", 1, ring->id, name, first);
+		}
+	}
+	for (const ProfileEvent& e : cpu)
+		writeEvent(out, e, base, 1, e.thread, first);
+
+	if (gpu)
+	{
+		writeName(out, "process_name", 2, 0, "GPU", first);
+		for (const ProfileEvent& e : gpuEvents)
+			writeEvent(out, e, base, 2, 0, first);
+	}
+	out << "\n]}\n";
+	return static_cast<bool>(out);
+}
+
+void printProfileSummary(std::ostream& out, int64_t since, size_t frames, const GpuProfiler* gpu)
+{
+	struct Totals {
+		size_t count = 0;
+		double total = 0.0;
+		double max = 0.0;
+	};
+	// Agrupado por trilha (CPU/GPU) e nome do escopo
+	std::map<std::pair<bool, std::string>, Totals> totals;
+
+	std::vector<ProfileEvent> events;
+	profilerCpuEvents(events);
+	if (gpu)
+		gpu->events(events);
+	for (const ProfileEvent& e : events)
+	{
+		if (e.end < since)
+			continue;
+		double ms = (e.end - e.start) / 1.0e6;
+		Totals& t = totals[std::make_pair(e.thread == kGpuThread, std::string(e.name))];
+		t.count++;
+		t.total += ms;
+		t.max = std::max(t.max, ms);
+	}
+
+	frames = std::max<size_t>(frames, 1);
+	out << "Perfil dos ultimos " << frames << " quadros (media por quadro / maximo, ms):" << std::endl;
+	for (const auto& entry : totals)
+	{
+		out << "  " << (entry.first.first ? "GPU " : "CPU ") << entry.first.second << ": "
+			<< entry.second.total / frames << " / " << entry.second.max << std::endl;
+	}
+	if (gpu && gpu->droppedFrames())
+		out << "  (" << gpu->droppedFrames() << " quadros de GPU descartados por nao estarem prontos)" << std::endl;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// Profiler de quadros, CPU e GPU.
+//
+// CPU: PROFILE_SCOPE("nome") mede o escopo e grava o evento num anel da thread atual
+// (sem travas: cada thread só escreve no seu anel). Os nomes precisam ser literais,
+// pois só o ponteiro é guardado. Desligado, cada escopo custa uma leitura atômica relaxada;
+// compilando com PROFILER_DISABLED as macros somem.
+//
+// GPU: GpuProfiler marca GL_TIMESTAMP no início e no fim de cada escopo. As queries de
+// um quadro são lidas alguns quadros depois, só se já estiverem prontas (nunca espera a GPU).
+//
+// Os eventos podem ser exportados no formato trace_event do Chrome (chrome://tracing,
+// Perfetto) ou resumidos no console.
+
+extern std::atomic<bool> gProfilerEnabled;
+
+inline bool profilerEnabled()
+{
+	return gProfilerEnabled.load(std::memory_order_relaxed);
+}
+
+void profilerSetEnabled(bool enabled);
+
+// Relógio do profiler, em nanossegundos
+int64_t profilerNow();
+
+// Grava um evento no anel da thread atual
+void profilerRecord(const char* name, int64_t start, int64_t end);
+
+// Nome da thread atual no trace (literal ou string que viva até o fim do programa)
+void profilerSetThreadName(const char* name);
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : mName(name), mStart(profilerEnabled() ? profilerNow() : -1) {}
+	~ProfileScope()
+	{
+		if (mStart >= 0)
+			profilerRecord(mName, mStart, profilerNow());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* mName;
+	int64_t mStart;
+};
+
+// Evento já resolvido (CPU ou GPU), com tempos no relógio do profiler
+struct ProfileEvent {
+	const char* name;
+	int64_t start;
+	int64_t end;
+	uint32_t thread; // identificador da thread; a GPU tem uma trilha própria
+};
+
+class GpuProfiler
+{
+public:
+	// Quadros entre a emissão das queries e a leitura
+	static const int kLatency = 4;
+
+	void create();
+	void destroy();
+
+	// Lê o quadro emitido há kLatency quadros (se pronto) e começa um novo
+	void beginFrame();
+	void endFrame();
+
+	// Retorna o índice do escopo, ou -1 se o profiler está desligado
+	int begin(const char* name);
+	void end(int scope);
+
+	// Eventos lidos, do mais antigo ao mais novo (anel de tamanho fixo)
+	void events(std::vector<ProfileEvent>& out) const;
+	size_t droppedFrames() const { return mDroppedFrames; }
+
+private:
+	struct FrameQueries {
+		std::vector<GLuint> queries; // pares início/fim
+		std::vector<const char*> names;
+		size_t used = 0;
+		bool pending = false;
+	};
+
+	void resolve(FrameQueries& frame);
+
+	FrameQueries mFrames[kLatency];
+	int mCurrent = 0;
+	bool mCreated = false;
+	int64_t mClockOffset = 0; // relógio do profiler - relógio da GPU
+	std::vector<ProfileEvent> mEvents;
+	size_t mEventHead = 0;
+	size_t mDroppedFrames = 0;
+};
+
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, const char* name) : mProfiler(profiler), mScope(profiler.begin(name)) {}
+	~GpuProfileScope() { mProfiler.end(mScope); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& mProfiler;
+	int mScope;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(profiler, name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(profiler, name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, name)
+#endif
+
+// Todos os eventos de CPU ainda nos anéis (de todas as threads), sem ordem definida
+void profilerCpuEvents(std::vector<ProfileEvent>& out);
+
+// Exporta CPU e GPU (se 'gpu' não for nulo) como JSON trace_event do Chrome
+bool writeChromeTrace(const std::string& path, const GpuProfiler* gpu);
+
+// Resumo por escopo dos eventos terminados desde 'since': média por quadro e máximo, em ms
+void printProfileSummary(std::ostream& out, int64_t since, size_t frames, const GpuProfiler* gpu);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Executa job(i) para i em [0, count) distribuindo entre 'threads' threads criadas só para a
+// chamada (a thread chamadora também trabalha). Usado pelos carregadores, com o número de
+// threads de --threads
+template <typename Job>
+void runParallel(size_t count, unsigned threads, Job job)
+{
+	std::atomic<size_t> next{0};
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++)
+			job(i);
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads && t < count; t++)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+}
@@ -0,0 +1,244 @@
+#include "scene.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Como nas texturas do MTL: caminhos relativos partem da pasta do arquivo que os cita
+std::string resolvePath(const std::string& directory, const std::string& path)
+{
+	if (path.empty() || directory.empty() || path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'))
+		return path;
+	return directory + path;
+}
+
+bool readColor(std::istringstream& iss, glm::vec3& color)
+{
+	return static_cast<bool>(iss >> color.r >> color.g >> color.b);
+}
+
+} // namespace
+
+bool SceneMaterial::operator==(const SceneMaterial& other) const
+{
+	if (library != other.library || name != other.name || fields != other.fields)
+		return false;
+	const Material& a = values;
+	const Material& b = other.values;
+	return (!(fields & SCENE_MATERIAL_KA) || a.Ka == b.Ka) && (!(fields & SCENE_MATERIAL_KD) || a.Kd == b.Kd)
+		&& (!(fields & SCENE_MATERIAL_KS) || a.Ks == b.Ks) && (!(fields & SCENE_MATERIAL_NS) || a.Ns == b.Ns)
+		&& (!(fields & SCENE_MATERIAL_D) || a.d == b.d) && (!(fields & SCENE_MATERIAL_MAP_KD) || a.map_Kd == b.map_Kd);
+}
+
+void SceneMaterial::apply(Material& material, AssetCache& assets) const
+{
+	if (library != kInvalidAsset)
+	{
+		const std::unordered_map<std::string, Material>& materials = assets.materials(library);
+		auto found = materials.find(name);
+		if (found != materials.end())
+			material = found->second;
+	}
+	if (fields & SCENE_MATERIAL_KA)
+		material.Ka = values.Ka;
+	if (fields & SCENE_MATERIAL_KD)
+		material.Kd = values.Kd;
+	if (fields & SCENE_MATERIAL_KS)
+		material.Ks = values.Ks;
+	if (fields & SCENE_MATERIAL_NS)
+		material.Ns = values.Ns;
+	if (fields & SCENE_MATERIAL_D)
+		material.d = values.d;
+	if (fields & SCENE_MATERIAL_MAP_KD)
+		material.map_Kd = values.map_Kd;
+}
+
+uint32_t Scene::addModel(AssetId mesh, const SceneMaterial* material)
+{
+	SceneModel model = { 0, -1 };
+	while (model.mesh < meshes.size() && meshes[model.mesh] != mesh)
+		model.mesh++;
+	if (model.mesh == meshes.size())
+		meshes.push_back(mesh);
+
+	if (material && !material->empty())
+	{
+		model.material = 0;
+		while (model.material < static_cast<int32_t>(materials.size()) && !(materials[model.material] == *material))
+			model.material++;
+		if (model.material == static_cast<int32_t>(materials.size()))
+			materials.push_back(*material);
+	}
+
+	for (uint32_t m = 0; m < models.size(); m++)
+		if (models[m].mesh == model.mesh && models[m].material == model.material)
+			return m;
+	models.push_back(model);
+	return static_cast<uint32_t>(models.size() - 1);
+}
+
+size_t Scene::instanceCount() const
+{
+	size_t count = 0;
+	for (const SceneObject& object : objects)
+		count += object.count;
+	return count;
+}
+
+bool loadScene(const std::string& path, AssetCache& assets, Scene& scene)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cerr << "Erro ao abrir o arquivo de cena: " << path << std::endl;
+		return false;
+	}
+	const std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+	// Objeto em leitura: a malha e a sobrescrita só viram um modelo quando ele termina
+	bool open = false;
+	int objectLine = 0;
+	SceneObject object;
+	std::string mesh;
+	SceneMaterial material;
+	auto finishObject = [&]() {
+		if (!open)
+			return;
+		if (mesh.empty())
+		{
+			std::cout << "Aviso: objeto " << object.name << " (linha " << objectLine << " de " << path
+				<< ") sem malha, ignorado" << std::endl;
+			return;
+		}
+		object.model = scene.addModel(assets.request(ASSET_MESH, mesh), &material);
+		scene.objects.push_back(object);
+	};
+
+	std::string line, key, value;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		std::istringstream iss(line);
+		key.clear();
+		iss >> key;
+		if (key.empty() || key[0] == '#')
+			continue;
+
+		if (key == "object")
+		{
+			finishObject();
+			open = true;
+			objectLine = lineNumber;
+			object = SceneObject();
+			iss >> object.name;
+			mesh.clear();
+			material = SceneMaterial();
+			continue;
+		}
+		if (!open)
+		{
+			std::cout << "Aviso: linha " << lineNumber << " de " << path << " fora de um objeto: " << line << std::endl;
+			continue;
+		}
+
+		bool valid = true;
+		if (key == "mesh")
+		{
+			valid = static_cast<bool>(iss >> value);
+			if (valid)
+				mesh = resolvePath(directory, value);
+		}
+		else if (key == "position")
+			valid = static_cast<bool>(iss >> object.position.x >> object.position.y >> object.position.z);
+		else if (key == "path")
+		{
+			valid = static_cast<bool>(iss >> value);
+			if (valid)
+			{
+				const std::string file = resolvePath(directory, value);
+				object.path = assets.request(isTrajectoryFile(file) ? ASSET_TRAJECTORY : ASSET_PATH, file);
+			}
+		}
+		else if (key == "phase")
+			valid = static_cast<bool>(iss >> object.phase);
+		else if (key == "count")
+		{
+			long long count = 0;
+			valid = (iss >> count) && count > 0;
+			if (valid)
+				object.count = static_cast<size_t>(count);
+			float spacing;
+			if (iss >> spacing)
+				object.spacing = spacing;
+		}
+		else if (key == "material")
+		{
+			valid = static_cast<bool>(iss >> value >> material.name);
+			if (valid)
+				material.library = assets.request(ASSET_MATERIAL, resolvePath(directory, value));
+		}
+		else if (key == "Ka")
+		{
+			valid = readColor(iss, material.values.Ka);
+			if (valid)
+				material.fields |= SCENE_MATERIAL_KA;
+		}
+		else if (key == "Kd")
+		{
+			valid = readColor(iss, material.values.Kd);
+			if (valid)
+				material.fields |= SCENE_MATERIAL_KD;
+		}
+		else if (key == "Ks")
+		{
+			valid = readColor(iss, material.values.Ks);
+			if (valid)
+				material.fields |= SCENE_MATERIAL_KS;
+		}
+		else if (key == "Ns")
+		{
+			valid = static_cast<bool>(iss >> material.values.Ns);
+			if (valid)
+				material.fields |= SCENE_MATERIAL_NS;
+		}
+		else if (key == "d")
+		{
+			valid = static_cast<bool>(iss >> material.values.d);
+			if (valid)
+				material.fields |= SCENE_MATERIAL_D;
+		}
+		else if (key == "map_Kd")
+		{
+			valid = static_cast<bool>(iss >> value);
+			if (valid)
+			{
+				material.values.map_Kd = resolvePath(directory, value);
+				material.fields |= SCENE_MATERIAL_MAP_KD;
+			}
+		}
+		else if (key == "rotation" || key == "scale")
+		{
+			std::cout << "Aviso: " << key << " por objeto nao e suportado (linha " << lineNumber << " de " << path
+				<< "); so a posicao inicial e usada" << std::endl;
+			continue;
+		}
+		else
+		{
+			std::cout << "Aviso: diretiva desconhecida na linha " << lineNumber << " de " << path << ": " << key << std::endl;
+			continue;
+		}
+		if (!valid)
+			std::cout << "Aviso: linha " << lineNumber << " de " << path << " invalida: " << line << std::endl;
+	}
+	finishObject();
+
+	if (scene.objects.empty())
+	{
+		std::cerr << "Nenhum objeto na cena " << path << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "asset_cache.h"
+#include "material.h"
+
+// Campos de material trocados por um objeto da cena (SceneMaterial::fields)
+enum SceneMaterialField : uint32_t {
+	SCENE_MATERIAL_KA = 1 << 0,
+	SCENE_MATERIAL_KD = 1 << 1,
+	SCENE_MATERIAL_KS = 1 << 2,
+	SCENE_MATERIAL_NS = 1 << 3,
+	SCENE_MATERIAL_D = 1 << 4,
+	SCENE_MATERIAL_MAP_KD = 1 << 5,
+};
+
+// Sobrescrita de material de um objeto: vale para todas as submalhas da malha, inclusive as
+// sem material. Primeiro o material 'name' da biblioteca 'library' (se houver) substitui o da
+// malha; depois os campos marcados em 'fields' vêm de 'values'.
+struct SceneMaterial {
+	AssetId library = kInvalidAsset;
+	std::string name;
+	uint32_t fields = 0;
+	Material values;
+
+	bool empty() const { return library == kInvalidAsset && fields == 0; }
+	bool operator==(const SceneMaterial& other) const;
+	void apply(Material& material, AssetCache& assets) const;
+};
+
+// Malha com uma sobrescrita de material. Cada combinação distinta é desenhada como uma malha
+// à parte, mas com os mesmos vértices (a malha é carregada uma vez)
+struct SceneModel {
+	uint32_t mesh;     // em Scene::meshes
+	int32_t material;  // em Scene::materials; -1: os materiais do MTL da malha
+};
+
+// Entrada "object": 'count' cópias numa grade no plano XZ a partir de 'position'
+struct SceneObject {
+	std::string name;
+	uint32_t model = 0;            // em Scene::models
+	AssetId path = kInvalidAsset;  // pontos do caminho ou trajetória; sem eles os objetos ficam parados
+	glm::vec3 position = glm::vec3(0.0f);
+	float phase = 0.0f;            // tempo (s) já percorrido no caminho
+	size_t count = 1;
+	float spacing = 3.0f;
+};
+
+struct Scene {
+	std::vector<AssetId> meshes;          // malhas distintas, na ordem do primeiro uso
+	std::vector<SceneMaterial> materials; // sobrescritas distintas
+	std::vector<SceneModel> models;       // combinações (malha, sobrescrita) distintas
+	std::vector<SceneObject> objects;
+
+	// Modelo da malha com a sobrescrita (nullptr ou vazia: nenhuma), reaproveitando um igual
+	uint32_t addModel(AssetId mesh, const SceneMaterial* material);
+	size_t instanceCount() const;
+};
+
+// Lê um arquivo de cena: texto, uma diretiva por linha, '#' comenta.
+//
+//   object nome               começa um objeto; as linhas seguintes o descrevem
+//   mesh arquivo.obj          malha (obrigatória)
+//   position x y z            posição inicial (deslocamento sobre o caminho)
+//   path arquivo.txt          pontos do caminho (um "x y z" por linha); sem ele o objeto fica parado
+//   path arquivo.traj         ou uma trajetória gravada (convertTrajectory), seguida pelos tempos dela
+//   phase s                   tempo já percorrido no caminho, em segundos
+//   count n [espacamento]     n cópias numa grade, como a de --objects
+//   material arquivo.mtl nome troca os materiais da malha por este
+//   Ka/Kd/Ks r g b, Ns x, d x, map_Kd arquivo   troca só estes campos (depois de "material")
+//
+// A transformação inicial de um objeto é só a posição: a rotação e a escala são as comuns a todos
+// os objetos (a escala da simulação), pois as matrizes saem do AnimationSystem com uma única
+// matriz local e a matriz normal é calculada uma vez por quadro. "rotation" e "scale" são
+// avisadas como não suportadas.
+//
+// Caminhos relativos partem da pasta do arquivo de cena. Malhas, MTLs e caminhos são pedidos ao
+// cache já aqui (as texturas, quando os materiais são montados), então os arquivos iguais são
+// carregados uma vez. Linhas inválidas são avisadas e ignoradas. Retorna false se o arquivo não
+// abre ou não tem nenhum objeto.
+bool loadScene(const std::string& path, AssetCache& assets, Scene& scene);
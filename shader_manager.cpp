@@ -0,0 +1,249 @@
+#include "shader_manager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = { 'C', 'G', 'P', 'R', 'O', 'G', 0, 0 };
+
+const char* const kFeatureDefines[kShaderFeatureCount] = {
+	"TEXTURED", "SPECULAR", "INSTANCED", "PACKED_VERTICES", "NORMAL_MATRIX_PER_VERTEX", "MULTI_DRAW",
+	"CLUSTERED_LIGHTS"
+};
+
+std::string glString(GLenum name)
+{
+	const GLubyte* s = glGetString(name);
+	return s ? reinterpret_cast<const char*>(s) : "";
+}
+
+GLuint compileStage(GLenum stage, const std::string& source, const char* label)
+{
+	GLuint shader = glCreateShader(stage);
+	const GLchar* text = source.c_str();
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+	// Checando erros de compilação (exibição via log no terminal)
+	GLint success;
+	GLchar infoLog[512];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::" << label << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+	return shader;
+}
+
+} // namespace
+
+void ShaderManager::create(const char* vertexSource, const char* fragmentSource, const std::string& cacheDir, bool readCache)
+{
+	mVertexSource = vertexSource;
+	mFragmentSource = fragmentSource;
+	mCacheDir = cacheDir;
+	mReadCache = readCache;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	mBinarySupported = formats > 0 && !mCacheDir.empty();
+
+	const std::string driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+	mDriverHash = hashBytes(driver.data(), driver.size());
+}
+
+void ShaderManager::destroy()
+{
+	for (auto& entry : mPrograms)
+		if (entry.second)
+			glDeleteProgram(entry.second);
+	mPrograms.clear();
+	mStats = ShaderCacheStats();
+}
+
+std::string ShaderManager::featureNames(uint32_t features)
+{
+	std::string names;
+	for (uint32_t bit = 0; bit < kShaderFeatureCount; bit++)
+	{
+		if (!(features & (1u << bit)))
+			continue;
+		if (!names.empty())
+			names += '|';
+		names += kFeatureDefines[bit];
+	}
+	return names.empty() ? "BASE" : names;
+}
+
+GLuint ShaderManager::program(uint32_t features)
+{
+	auto it = mPrograms.find(features);
+	if (it != mPrograms.end())
+		return it->second;
+
+	PROFILE_SCOPE("buildShaderVariant");
+	auto start = std::chrono::steady_clock::now();
+
+	const std::string vertex = assemble(mVertexSource, features);
+	const std::string fragment = assemble(mFragmentSource, features);
+	const std::string both = vertex + '\0' + fragment;
+	const uint64_t sourceHash = hashBytes(both.data(), both.size());
+
+	std::string path;
+	if (mBinarySupported)
+	{
+		char name[40];
+		snprintf(name, sizeof(name), "%016llx.progbin", static_cast<unsigned long long>(sourceHash ^ mDriverHash));
+		path = (fs::path(mCacheDir) / name).string();
+	}
+
+	bool rejected = false;
+	GLuint program = mBinarySupported && mReadCache ? loadBinary(path, sourceHash, rejected) : 0;
+	const bool hit = program != 0;
+	if (!hit)
+	{
+		program = compile(vertex, fragment);
+		if (program && mBinarySupported)
+			saveBinary(path, program, sourceHash);
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	mStats.milliseconds += ms;
+	if (hit)
+		mStats.hits++;
+	else
+		mStats.misses++;
+	if (rejected)
+		mStats.rejected++;
+	std::cout << "Shader " << featureNames(features) << ": "
+		<< (hit ? "binario do cache" : rejected ? "binario recusado pelo driver, compilado" : "compilado")
+		<< " em " << ms << " ms" << std::endl;
+
+	mPrograms.emplace(features, program);
+	return program;
+}
+
+std::string ShaderManager::assemble(const std::string& source, uint32_t features) const
+{
+	// Os #defines precisam vir depois do #version, que tem de ser a primeira linha
+	size_t afterVersion = source.find('\n');
+	afterVersion = afterVersion == std::string::npos ? source.size() : afterVersion + 1;
+
+	std::string out = source.substr(0, afterVersion);
+	for (uint32_t bit = 0; bit < kShaderFeatureCount; bit++)
+		if (features & (1u << bit))
+			out += std::string("#define ") + kFeatureDefines[bit] + "\n";
+	out.append(source, afterVersion, std::string::npos);
+	return out;
+}
+
+GLuint ShaderManager::compile(const std::string& vertex, const std::string& fragment) const
+{
+	GLuint vertexShader = compileStage(GL_VERTEX_SHADER, vertex, "VERTEX");
+	GLuint fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragment, "FRAGMENT");
+
+	// Linkando os shaders e criando o identificador do programa de shader
+	GLuint shaderProgram = glCreateProgram();
+	if (mBinarySupported)
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(shaderProgram, vertexShader);
+	glAttachShader(shaderProgram, fragmentShader);
+	glLinkProgram(shaderProgram);
+	// Checando por erros de linkagem
+	GLint success;
+	GLchar infoLog[512];
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	if (!success)
+	{
+		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		glDeleteProgram(shaderProgram);
+		return 0;
+	}
+	return shaderProgram;
+}
+
+GLuint ShaderManager::loadBinary(const std::string& path, uint64_t sourceHash, bool& rejected) const
+{
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(ShaderCacheHeader))
+		return 0;
+	ShaderCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kShaderCacheVersion
+		|| header.sourceHash != sourceHash || header.driverHash != mDriverHash
+		|| header.binarySize != file.size() - sizeof(ShaderCacheHeader))
+		return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, file.data() + sizeof(ShaderCacheHeader), static_cast<GLsizei>(header.binarySize));
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		// O driver pode recusar binários mesmo com a mesma versão (ex: mudança de configuração)
+		glDeleteProgram(program);
+		rejected = true;
+		return 0;
+	}
+	return program;
+}
+
+void ShaderManager::saveBinary(const std::string& path, GLuint program, uint64_t sourceHash) const
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> image(sizeof(ShaderCacheHeader) + length);
+	GLenum binaryFormat = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &binaryFormat, image.data() + sizeof(ShaderCacheHeader));
+	if (written <= 0)
+		return;
+	image.resize(sizeof(ShaderCacheHeader) + written);
+
+	ShaderCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kShaderCacheVersion;
+	header.binaryFormat = binaryFormat;
+	header.sourceHash = sourceHash;
+	header.driverHash = mDriverHash;
+	header.binarySize = static_cast<uint64_t>(written);
+	memcpy(image.data(), &header, sizeof(header));
+
+	// Grava em um arquivo temporário e renomeia, para nunca deixar um binário pela metade
+	std::error_code ec;
+	fs::create_directories(mCacheDir, ec);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return;
+		out.write(image.data(), static_cast<std::streamsize>(image.size()));
+		if (!out)
+			return;
+	}
+	fs::rename(tempPath, path, ec);
+	if (ec)
+	{
+		fs::remove(tempPath, ec);
+		std::cout << "Nao foi possivel gravar o binario de shader " << path << std::endl;
+	}
+}
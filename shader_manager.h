@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// GLAD
+#include <glad/glad.h>
+
+// Bits de variante: cada um vira um "#define" logo depois do "#version" dos dois estágios
+enum ShaderFeature : uint32_t {
+	SHADER_TEXTURED = 1u << 0,        // multiplica pela textura difusa (ourTexture)
+	SHADER_SPECULAR = 1u << 1,        // termo especular de Phong (Ks, Ns)
+	SHADER_INSTANCED = 1u << 2,       // matriz de modelo do buffer de instâncias, senão o uniform 'model'
+	SHADER_PACKED_VERTICES = 1u << 3, // vértices quantizados (PackedVertex)
+	SHADER_NORMAL_MATRIX_PER_VERTEX = 1u << 4, // inversa da matriz de modelo no shader (referência do benchmark)
+	SHADER_MULTI_DRAW = 1u << 5,      // material e caixa de draws[gl_DrawIDARB] (glMultiDrawElementsIndirect)
+	SHADER_CLUSTERED_LIGHTS = 1u << 6, // luzes pontuais das listas do cluster do fragmento (LightClusters)
+};
+const uint32_t kShaderFeatureCount = 7;
+
+// Formato dos binários de programa ("<pasta>/<chave>.progbin").
+// Aumente a versão sempre que o layout do arquivo mudar.
+const uint32_t kShaderCacheVersion = 1;
+
+struct ShaderCacheHeader {
+	char magic[8];          // "CGPROG\0\0"
+	uint32_t version;
+	uint32_t binaryFormat;  // devolvido por glGetProgramBinary
+	uint64_t sourceHash;    // fontes da variante, já com os #defines
+	uint64_t driverHash;    // GL_VENDOR, GL_RENDERER e GL_VERSION
+	uint64_t binarySize;
+};
+
+struct ShaderCacheStats {
+	size_t hits = 0;        // variantes carregadas do binário
+	size_t misses = 0;      // variantes compiladas (sem binário ou rejeitado)
+	size_t rejected = 0;    // binários recusados pelo driver (contados também em misses)
+	double milliseconds = 0.0; // tempo total gasto montando programas
+};
+
+// Variantes de um par de shaders (vertex + fragment), montadas sob demanda.
+//
+// program(features) devolve o programa da combinação de bits pedida. Na primeira vez ele
+// procura o binário da variante no cache em disco; a chave é o hash das fontes montadas mais
+// o do driver, então mudar o shader ou atualizar o driver gera outro arquivo. Um binário que o
+// driver recusa (glProgramBinary sem GL_LINK_STATUS) é descartado e a variante é compilada.
+// Cada variante montada é registrada no console com a origem e o tempo gasto.
+class ShaderManager
+{
+public:
+	// 'cacheDir' vazio ou 'readCache' falso: sempre compila (o binário ainda é gravado)
+	void create(const char* vertexSource, const char* fragmentSource, const std::string& cacheDir, bool readCache);
+	void destroy();
+
+	// 0 se a compilação falhou (o erro vai para o console)
+	GLuint program(uint32_t features);
+
+	const ShaderCacheStats& stats() const { return mStats; }
+	static std::string featureNames(uint32_t features);
+
+private:
+	std::string assemble(const std::string& source, uint32_t features) const;
+	GLuint compile(const std::string& vertex, const std::string& fragment) const;
+	GLuint loadBinary(const std::string& path, uint64_t sourceHash, bool& rejected) const;
+	void saveBinary(const std::string& path, GLuint program, uint64_t sourceHash) const;
+
+	std::string mVertexSource;
+	std::string mFragmentSource;
+	std::string mCacheDir;
+	bool mReadCache = false;
+	bool mBinarySupported = false; // driver expõe algum formato de binário de programa
+	uint64_t mDriverHash = 0;
+	std::unordered_map<uint32_t, GLuint> mPrograms;
+	ShaderCacheStats mStats;
+};
@@ -0,0 +1,280 @@
+#include "simulation.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Velocidade da câmera com uma tecla de movimento pressionada (unidades por segundo)
+const float kCameraSpeed = 10.0f;
+// Graus de rotação da câmera por pixel de movimento do mouse
+const float kMouseSensitivity = 0.1f;
+// Atraso máximo em relação ao relógio antes de pular passos em vez de tentar alcançá-lo
+const double kMaxLag = 0.25;
+// Objetos por tarefa na atualização da animação e na interpolação
+const size_t kObjectsPerJob = 16384;
+
+void resizePositions(std::vector<float>& x, std::vector<float>& y, std::vector<float>& z, size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+}
+
+} // namespace
+
+void Simulation::create(AnimationSystem& animation, const SimCamera& camera, double step, JobSystem* jobs)
+{
+	mAnimation = &animation;
+	mJobs = jobs;
+	mStep = step > 0.0 ? step : 1.0 / 120.0;
+	mCamera = camera;
+	mSimTime = 0.0;
+	mClockOffset = 0.0;
+	mStepMsTotal = 0.0;
+	mStats = SimulationStats();
+	mFirstLook = true;
+
+	// Primeiro snapshot: o estado inicial parado, já publicado
+	const size_t count = animation.objectCount();
+	SimSnapshot& first = mSnapshots[1];
+	resizePositions(first.currentX, first.currentY, first.currentZ, count);
+	animation.copyPositions(first.currentX.data(), first.currentY.data(), first.currentZ.data());
+	first.previousX = first.currentX;
+	first.previousY = first.currentY;
+	first.previousZ = first.currentZ;
+	first.previousCamera = first.currentCamera = mCamera;
+	first.time = first.simTime = 0.0;
+	first.scale = mScale;
+	first.rotateX = mRotateX;
+	first.rotateY = mRotateY;
+	first.rotateZ = mRotateZ;
+	mFront = 0;
+	mBack = 2;
+	mLatest.store(1 | kFresh, std::memory_order_release);
+}
+
+void Simulation::destroy()
+{
+	stop();
+	mAnimation = nullptr;
+	mJobs = nullptr;
+}
+
+void Simulation::start()
+{
+	mStart = std::chrono::steady_clock::now();
+	mStop.store(false, std::memory_order_relaxed);
+	mThread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+	mStop.store(true, std::memory_order_relaxed);
+	if (mThread.joinable())
+		mThread.join();
+}
+
+double Simulation::clock() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+void Simulation::run()
+{
+	profilerSetThreadName("simulation");
+	while (!mStop.load(std::memory_order_relaxed))
+	{
+		// O passo que termina em T roda quando o relógio chega a T
+		const double due = mSimTime + mClockOffset + mStep;
+		const double now = clock();
+		if (now < due)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(due - now));
+			continue;
+		}
+		if (now - due > kMaxLag)
+		{
+			// Muito atrás (ex: processo suspenso): pula os passos em vez de correr para alcançar
+			const double skipped = std::floor((now - due) / mStep);
+			mClockOffset += skipped * mStep;
+			mStats.skippedSteps += static_cast<uint64_t>(skipped);
+		}
+		runStep();
+	}
+}
+
+void Simulation::advanceTo(double time)
+{
+	while (mSimTime + mClockOffset < time)
+		runStep();
+}
+
+bool Simulation::pushEvent(const InputEvent& event)
+{
+	if (mEvents.push(event))
+		return true;
+	mDroppedEvents++;
+	return false;
+}
+
+void Simulation::handleEvent(const InputEvent& event)
+{
+	switch (event.action)
+	{
+	case INPUT_MOVE_FORWARD:
+	case INPUT_MOVE_BACK:
+	case INPUT_MOVE_LEFT:
+	case INPUT_MOVE_RIGHT:
+		mMoving[event.action] = event.pressed;
+		break;
+	case INPUT_SCALE_UP:
+		if (event.pressed)
+			mScale += 0.1f;
+		break;
+	case INPUT_SCALE_DOWN:
+		if (event.pressed)
+			mScale -= 0.1f;
+		break;
+	case INPUT_TOGGLE_ROTATE_X:
+		if (event.pressed)
+			mRotateX = !mRotateX;
+		break;
+	case INPUT_TOGGLE_ROTATE_Y:
+		if (event.pressed)
+			mRotateY = !mRotateY;
+		break;
+	case INPUT_TOGGLE_ROTATE_Z:
+		if (event.pressed)
+			mRotateZ = !mRotateZ;
+		break;
+	case INPUT_LOOK:
+	{
+		if (mFirstLook)
+		{
+			mLastX = event.x;
+			mLastY = event.y;
+			mFirstLook = false;
+		}
+		mYaw += (event.x - mLastX) * kMouseSensitivity;
+		mPitch += (mLastY - event.y) * kMouseSensitivity;
+		mPitch = std::min(89.0f, std::max(-89.0f, mPitch));
+		mLastX = event.x;
+		mLastY = event.y;
+
+		glm::vec3 front;
+		front.x = std::cos(glm::radians(mYaw)) * std::cos(glm::radians(mPitch));
+		front.y = std::sin(glm::radians(mPitch));
+		front.z = std::sin(glm::radians(mYaw)) * std::cos(glm::radians(mPitch));
+		mCamera.front = glm::normalize(front);
+		glm::vec3 right = glm::normalize(glm::cross(mCamera.front, glm::vec3(0.0f, 1.0f, 0.0f)));
+		mCamera.up = glm::normalize(glm::cross(right, mCamera.front));
+		break;
+	}
+	}
+}
+
+void Simulation::runStep()
+{
+	PROFILE_SCOPE("simStep");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	SimSnapshot& snapshot = mSnapshots[mBack];
+
+	// Início do passo: o estado que o snapshot anterior tinha como final
+	const size_t count = mAnimation->objectCount();
+	resizePositions(snapshot.previousX, snapshot.previousY, snapshot.previousZ, count);
+	resizePositions(snapshot.currentX, snapshot.currentY, snapshot.currentZ, count);
+	mAnimation->copyPositions(snapshot.previousX.data(), snapshot.previousY.data(), snapshot.previousZ.data());
+	snapshot.previousCamera = mCamera;
+
+	InputEvent event;
+	while (mEvents.pop(event))
+	{
+		handleEvent(event);
+		mStats.events++;
+	}
+
+	const float dt = static_cast<float>(mStep);
+	const glm::vec3 right = glm::normalize(glm::cross(mCamera.front, mCamera.up));
+	if (mMoving[INPUT_MOVE_FORWARD])
+		mCamera.position += mCamera.front * kCameraSpeed * dt;
+	if (mMoving[INPUT_MOVE_BACK])
+		mCamera.position -= mCamera.front * kCameraSpeed * dt;
+	if (mMoving[INPUT_MOVE_LEFT])
+		mCamera.position -= right * kCameraSpeed * dt;
+	if (mMoving[INPUT_MOVE_RIGHT])
+		mCamera.position += right * kCameraSpeed * dt;
+
+	if (mJobs)
+		mJobs->parallelFor(count, kObjectsPerJob, [this, dt](size_t begin, size_t end) {
+			mAnimation->updateRange(dt, begin, end - begin);
+		});
+	else
+		mAnimation->update(dt);
+	mSimTime += mStep;
+
+	mAnimation->copyPositions(snapshot.currentX.data(), snapshot.currentY.data(), snapshot.currentZ.data());
+	snapshot.currentCamera = mCamera;
+	snapshot.time = mSimTime + mClockOffset;
+	snapshot.simTime = mSimTime;
+	snapshot.scale = mScale;
+	snapshot.rotateX = mRotateX;
+	snapshot.rotateY = mRotateY;
+	snapshot.rotateZ = mRotateZ;
+
+	mStats.steps++;
+	mStepMsTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	mStats.stepMs = mStepMsTotal / mStats.steps;
+	snapshot.stats = mStats;
+	publish();
+}
+
+void Simulation::publish()
+{
+	// Troca a posição escrita pela mais recente; a que volta pode ter sido lida ou não
+	mBack = mLatest.exchange(mBack | kFresh, std::memory_order_acq_rel) & ~kFresh;
+}
+
+void Simulation::interpolate(double time, SimFrame& out)
+{
+	PROFILE_SCOPE("simInterpolate");
+	if (mLatest.load(std::memory_order_acquire) & kFresh)
+		mFront = mLatest.exchange(mFront, std::memory_order_acq_rel) & ~kFresh;
+	const SimSnapshot& snapshot = mSnapshots[mFront];
+
+	// O snapshot cobre [time - step, time]; fora disso fica na ponta mais próxima
+	const float alpha = static_cast<float>(std::min(1.0, std::max(0.0, (time - snapshot.time) / mStep + 1.0)));
+	const size_t count = snapshot.currentX.size();
+	resizePositions(out.x, out.y, out.z, count);
+	auto blend = [&snapshot, &out, alpha](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			out.x[i] = snapshot.previousX[i] + (snapshot.currentX[i] - snapshot.previousX[i]) * alpha;
+			out.y[i] = snapshot.previousY[i] + (snapshot.currentY[i] - snapshot.previousY[i]) * alpha;
+			out.z[i] = snapshot.previousZ[i] + (snapshot.currentZ[i] - snapshot.previousZ[i]) * alpha;
+		}
+	};
+	if (mJobs)
+		mJobs->parallelFor(count, kObjectsPerJob, blend);
+	else
+		blend(0, count);
+
+	const SimCamera& a = snapshot.previousCamera;
+	const SimCamera& b = snapshot.currentCamera;
+	out.camera.position = glm::mix(a.position, b.position, alpha);
+	out.camera.front = glm::normalize(glm::mix(a.front, b.front, alpha));
+	out.camera.up = glm::normalize(glm::mix(a.up, b.up, alpha));
+	out.time = snapshot.simTime - (1.0 - alpha) * mStep;
+	out.scale = snapshot.scale;
+	out.rotateX = snapshot.rotateX;
+	out.rotateY = snapshot.rotateY;
+	out.rotateZ = snapshot.rotateZ;
+}
+
+SimulationStats Simulation::stats() const
+{
+	SimulationStats stats = mSnapshots[mFront].stats;
+	stats.droppedEvents = mDroppedEvents;
+	return stats;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "animation.h"
+#include "job_system.h"
+#include "spsc_queue.h"
+
+// Ações de entrada, já traduzidas das teclas pelos callbacks da GLFW
+enum InputAction : uint8_t {
+	INPUT_MOVE_FORWARD = 0,  // contínuas: valem enquanto a tecla está pressionada
+	INPUT_MOVE_BACK,
+	INPUT_MOVE_LEFT,
+	INPUT_MOVE_RIGHT,
+	INPUT_SCALE_UP,          // discretas: uma vez a cada pressão (ou repetição) da tecla
+	INPUT_SCALE_DOWN,
+	INPUT_TOGGLE_ROTATE_X,
+	INPUT_TOGGLE_ROTATE_Y,
+	INPUT_TOGGLE_ROTATE_Z,
+	INPUT_LOOK,              // cursor do mouse em (x, y)
+};
+
+struct InputEvent {
+	InputAction action = INPUT_LOOK;
+	bool pressed = false;
+	float x = 0.0f;
+	float y = 0.0f;
+};
+
+struct SimCamera {
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+	glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+};
+
+struct SimulationStats {
+	uint64_t steps = 0;          // passos dados (total)
+	uint64_t events = 0;         // eventos de entrada consumidos
+	uint64_t droppedEvents = 0;  // eventos perdidos com a fila cheia
+	uint64_t skippedSteps = 0;   // passos pulados quando a simulação ficou para trás do relógio
+	double stepMs = 0.0;         // custo médio de um passo
+};
+
+// Estado de um quadro, interpolado entre os dois últimos passos publicados
+struct SimFrame {
+	double time = 0.0;           // tempo simulado mostrado (s)
+	std::vector<float> x, y, z;  // posições dos objetos, na ordem de AnimationSystem::copyPositions
+	SimCamera camera;
+	float scale = 1.0f;
+	bool rotateX = false, rotateY = false, rotateZ = false;
+};
+
+// Simulação em passo fixo, separada da renderização.
+//
+// A animação dos objetos e a câmera controlada pelo teclado e pelo mouse avançam sempre 'step'
+// segundos por passo, numa thread própria (start) ou, sem thread, sob demanda (advanceTo, para
+// o modo headless reproduzível). Um quadro lento não muda mais a velocidade de nada, e a
+// renderização não espera a simulação.
+//
+// Entrada: os callbacks da GLFW (thread principal) põem eventos numa SpscQueue, consumida no
+// início de cada passo.
+//
+// Saída: cada passo publica um SimSnapshot com o estado no início e no fim do passo (o par que
+// a renderização interpola). Os snapshots ficam em três posições trocadas por um índice
+// atômico: a simulação escreve numa, a renderização lê outra e a terceira é a mais recente
+// publicada. Nenhum lado espera o outro, e a renderização sempre pega o último passo inteiro.
+class Simulation
+{
+public:
+	// Assume 'animation': dali em diante só a simulação o avança, e a renderização lê as
+	// posições por interpolate(). 'step' em segundos. Com 'jobs', a atualização da animação e a
+	// interpolação são repartidas em tarefas (a thread da simulação envia as suas de fora do
+	// sistema e ajuda a executá-las enquanto espera)
+	void create(AnimationSystem& animation, const SimCamera& camera, double step, JobSystem* jobs = nullptr);
+	void destroy();
+
+	void start();
+	void stop();
+
+	// Sem thread: dá na thread atual os passos que faltam até o último publicado cobrir 'time'
+	void advanceTo(double time);
+
+	// Thread dos callbacks (único produtor). false se a fila encheu e o evento se perdeu
+	bool pushEvent(const InputEvent& event);
+
+	// Renderização: estado no tempo 'time' do relógio da simulação. Com a thread, passe
+	// clock() - step(): o quadro mostra a simulação com um passo de atraso, sempre entre os
+	// dois estados do último snapshot
+	void interpolate(double time, SimFrame& out);
+
+	// Segundos desde start()
+	double clock() const;
+	double step() const { return mStep; }
+
+	// Do último snapshot lido por interpolate()
+	SimulationStats stats() const;
+
+private:
+	struct SimSnapshot {
+		double time = 0.0;      // tempo no relógio da simulação ao fim do passo
+		double simTime = 0.0;   // tempo simulado ao fim do passo (sem os passos pulados)
+		std::vector<float> previousX, previousY, previousZ;
+		std::vector<float> currentX, currentY, currentZ;
+		SimCamera previousCamera, currentCamera;
+		float scale = 1.0f;
+		bool rotateX = false, rotateY = false, rotateZ = false;
+		SimulationStats stats;
+	};
+
+	static const uint32_t kFresh = 4; // bit de mLatest: snapshot publicado ainda não lido
+
+	void run();
+	void runStep();
+	void handleEvent(const InputEvent& event);
+	void publish();
+
+	AnimationSystem* mAnimation = nullptr;
+	JobSystem* mJobs = nullptr;
+	double mStep = 1.0 / 120.0;
+
+	// Estado da simulação (só a thread da simulação toca)
+	SimCamera mCamera;
+	float mYaw = -90.0f;
+	float mPitch = 0.0f;
+	bool mFirstLook = true;
+	float mLastX = 0.0f, mLastY = 0.0f;
+	bool mMoving[4] = {};  // INPUT_MOVE_*
+	float mScale = 1.0f;
+	bool mRotateX = false, mRotateY = false, mRotateZ = false;
+	double mSimTime = 0.0;
+	double mClockOffset = 0.0; // tempo pulado por atraso: relógio = mSimTime + mClockOffset
+	double mStepMsTotal = 0.0;
+	SimulationStats mStats;
+
+	// Snapshots: mBack é da simulação, mFront da renderização, mLatest o último publicado
+	SimSnapshot mSnapshots[3];
+	uint32_t mBack = 2;
+	uint32_t mFront = 0;
+	std::atomic<uint32_t> mLatest{ 1 };
+
+	SpscQueue<InputEvent> mEvents{ 4096 };
+	uint64_t mDroppedEvents = 0; // só o produtor escreve
+
+	std::chrono::steady_clock::time_point mStart;
+	std::atomic<bool> mStop{ false };
+	std::thread mThread;
+};
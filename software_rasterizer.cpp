@@ -0,0 +1,614 @@
+#include "software_rasterizer.h"
+#include "animation.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTER_SSE 1
+#endif
+
+namespace {
+
+// Triângulos por tarefa da etapa de vértices: uma instância grande vira várias tarefas
+const uint32_t kTrianglesPerJob = 1024;
+
+// Os 4 pixels de um quad 2x2, na ordem (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1).
+// As comparações devolvem uma máscara de 4 bits, um por pixel.
+#if defined(RASTER_SSE)
+typedef __m128 quad;
+inline quad qset(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline quad qset1(float v) { return _mm_set1_ps(v); }
+inline quad qadd(quad a, quad b) { return _mm_add_ps(a, b); }
+inline quad qmul(quad a, quad b) { return _mm_mul_ps(a, b); }
+inline int qgt(quad a, quad b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+inline int qeq(quad a, quad b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+inline int qlt(quad a, quad b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+inline int qle(quad a, quad b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+inline void qstore(float* p, quad v) { _mm_storeu_ps(p, v); }
+#else
+struct quad { float v[4]; };
+inline quad qset(float a, float b, float c, float d) { return { { a, b, c, d } }; }
+inline quad qset1(float v) { return { { v, v, v, v } }; }
+inline quad qadd(quad a, quad b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline quad qmul(quad a, quad b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+inline int qgt(quad a, quad b) { int m = 0; for (int i = 0; i < 4; i++) m |= (a.v[i] > b.v[i]) << i; return m; }
+inline int qeq(quad a, quad b) { int m = 0; for (int i = 0; i < 4; i++) m |= (a.v[i] == b.v[i]) << i; return m; }
+inline int qlt(quad a, quad b) { int m = 0; for (int i = 0; i < 4; i++) m |= (a.v[i] < b.v[i]) << i; return m; }
+inline int qle(quad a, quad b) { int m = 0; for (int i = 0; i < 4; i++) m |= (a.v[i] <= b.v[i]) << i; return m; }
+inline void qstore(float* p, quad v) { memcpy(p, v.v, sizeof(v.v)); }
+#endif
+
+// Plano (valor na origem, d/dx, d/dy) avaliado nos 4 pixels do quad
+inline quad evalPlane(const float* plane, quad dx, quad dy)
+{
+	return qadd(qset1(plane[0]), qadd(qmul(qset1(plane[1]), dx), qmul(qset1(plane[2]), dy)));
+}
+
+inline uint32_t packColor(glm::vec4 c)
+{
+	c = glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f;
+	return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | ((uint32_t)c.a << 24);
+}
+
+inline glm::vec4 unpackColor(uint32_t c)
+{
+	return glm::vec4((float)(c & 0xFF), (float)((c >> 8) & 0xFF), (float)((c >> 16) & 0xFF), (float)(c >> 24)) * (1.0f / 255.0f);
+}
+
+// Bilinear com repetição (GL_REPEAT) num nível RGBA8
+glm::vec4 sampleBilinear(const TextureImage& image, size_t level, float u, float v)
+{
+	const TextureLevel& info = image.levels[level];
+	const uint8_t* texels = image.data.data() + info.offset;
+	const int w = (int)info.width, h = (int)info.height;
+	const float tx = u * w - 0.5f, ty = v * h - 0.5f;
+	const float fx = std::floor(tx), fy = std::floor(ty);
+	const float ax = tx - fx, ay = ty - fy;
+	auto wrap = [](int i, int n) { i %= n; return i < 0 ? i + n : i; };
+	const int x0 = wrap((int)fx, w), x1 = wrap((int)fx + 1, w);
+	const int y0 = wrap((int)fy, h), y1 = wrap((int)fy + 1, h);
+	auto texel = [&](int x, int y) {
+		const uint8_t* p = texels + ((size_t)y * w + x) * 4;
+		return glm::vec4(p[0], p[1], p[2], p[3]);
+	};
+	glm::vec4 top = glm::mix(texel(x0, y0), texel(x1, y0), ax);
+	glm::vec4 bottom = glm::mix(texel(x0, y1), texel(x1, y1), ax);
+	return glm::mix(top, bottom, ay) * (1.0f / 255.0f);
+}
+
+// Trilinear: 'lod' é log2 da maior variação, em texels do nível 0, entre pixels vizinhos
+glm::vec4 sampleTexture(const TextureImage& image, float u, float v, float lod)
+{
+	const float maxLevel = (float)(image.levels.size() - 1);
+	lod = std::min(std::max(lod, 0.0f), maxLevel);
+	const size_t level = (size_t)lod;
+	const float blend = lod - (float)level;
+	glm::vec4 color = sampleBilinear(image, level, u, v);
+	if (blend > 0.0f && level + 1 < image.levels.size())
+		color = glm::mix(color, sampleBilinear(image, level + 1, u, v), blend);
+	return color;
+}
+
+} // namespace
+
+void SoftwareRasterizer::create(int width, int height, unsigned threads)
+{
+	mWidth = width;
+	mHeight = height;
+	mStride = (width + 1) & ~1;
+	mTilesX = (width + kTileSize - 1) / kTileSize;
+	mTilesY = (height + kTileSize - 1) / kTileSize;
+	mColor.assign((size_t)mStride * ((height + 1) & ~1), 0);
+	mDepth.assign(mColor.size(), 1.0f);
+
+	mThreadCount = std::max(threads, 1u);
+	mWorkers.resize(mThreadCount);
+	for (Worker& worker : mWorkers)
+		worker.bins.resize((size_t)mTilesX * mTilesY);
+	mTileQueues.reset(new TileQueue[mThreadCount]);
+	mQuit = false;
+	for (unsigned t = 1; t < mThreadCount; t++)
+		mThreads.emplace_back(&SoftwareRasterizer::workerLoop, this, t);
+}
+
+void SoftwareRasterizer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+	mThreads.clear();
+	mWorkers.clear();
+	mTileQueues.reset();
+	mMaterials.clear();
+}
+
+uint32_t SoftwareRasterizer::addMaterial(const SoftwareMaterial& material)
+{
+	mMaterials.push_back(material);
+	return (uint32_t)mMaterials.size() - 1;
+}
+
+void SoftwareRasterizer::beginFrame(const SoftwareFrame& frame)
+{
+	mFrame = frame;
+	mViewProjection = frame.projection * frame.view;
+	mClearColor = packColor(glm::vec4(frame.clearColor, 1.0f));
+	mDraws.clear();
+	mModels.clear();
+}
+
+void SoftwareRasterizer::draw(const MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, uint32_t material,
+	const glm::mat4* models, size_t instanceCount)
+{
+	if (!indexCount || !instanceCount)
+		return;
+	mDraws.push_back({ &mesh, firstIndex, indexCount, material, mModels.size(), instanceCount });
+	mModels.insert(mModels.end(), models, models + instanceCount);
+}
+
+void SoftwareRasterizer::endFrame()
+{
+	PROFILE_SCOPE("softwareFrame");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mStats = RasterStats();
+
+	// Tarefas na ordem de envio e repartidas em faixas contíguas com quantidades parecidas de
+	// triângulos; a ordem das faixas é a ordem em que os tiles leem as listas
+	mJobs.clear();
+	for (uint32_t d = 0; d < mDraws.size(); d++)
+	{
+		const Draw& draw = mDraws[d];
+		const uint32_t triangles = draw.indexCount / 3;
+		for (uint32_t instance = 0; instance < draw.modelCount; instance++)
+			for (uint32_t first = 0; first < triangles; first += kTrianglesPerJob)
+				mJobs.push_back({ d, instance, first, std::min(kTrianglesPerJob, triangles - first) });
+		mStats.triangles += (size_t)triangles * draw.modelCount;
+	}
+	size_t job = 0, done = 0;
+	for (unsigned t = 0; t < mThreadCount; t++)
+	{
+		Worker& worker = mWorkers[t];
+		worker.firstJob = job;
+		const size_t target = mStats.triangles * (t + 1) / mThreadCount;
+		while (job < mJobs.size() && (done < target || t + 1 == mThreadCount))
+			done += mJobs[job++].triangleCount;
+		worker.lastJob = job;
+	}
+
+	runParallel(&SoftwareRasterizer::setupTask);
+	std::chrono::steady_clock::time_point setupEnd = std::chrono::steady_clock::now();
+
+	// Tiles em faixas contíguas por thread (vizinhos na mesma thread aproveitam o cache)
+	const uint32_t tiles = (uint32_t)(mTilesX * mTilesY);
+	for (unsigned t = 0; t < mThreadCount; t++)
+	{
+		mTileQueues[t].next.store(tiles * t / mThreadCount, std::memory_order_relaxed);
+		mTileQueues[t].end = tiles * (t + 1) / mThreadCount;
+	}
+	runParallel(&SoftwareRasterizer::tileTask);
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	for (const Worker& worker : mWorkers)
+	{
+		mStats.rasterized += worker.rasterized;
+		mStats.binned += worker.binned;
+		mStats.pixels += worker.pixels;
+		mStats.stolenTiles += worker.stolen;
+	}
+	mStats.setupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+	mStats.rasterMs = std::chrono::duration<double, std::milli>(end - setupEnd).count();
+	mStats.totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void SoftwareRasterizer::readPixels(std::vector<uint8_t>& rgb) const
+{
+	rgb.resize((size_t)mWidth * mHeight * 3);
+	for (int y = 0; y < mHeight; y++)
+	{
+		const uint32_t* row = &mColor[(size_t)(mHeight - 1 - y) * mStride];
+		uint8_t* out = &rgb[(size_t)y * mWidth * 3];
+		for (int x = 0; x < mWidth; x++)
+		{
+			out[x * 3 + 0] = (uint8_t)(row[x] & 0xFF);
+			out[x * 3 + 1] = (uint8_t)((row[x] >> 8) & 0xFF);
+			out[x * 3 + 2] = (uint8_t)((row[x] >> 16) & 0xFF);
+		}
+	}
+}
+
+void SoftwareRasterizer::workerLoop(unsigned worker)
+{
+	profilerSetThreadName("raster");
+	uint64_t seen = 0;
+	for (;;)
+	{
+		void (SoftwareRasterizer::*task)(unsigned) = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&] { return mQuit || mGeneration != seen; });
+			if (mQuit)
+				return;
+			seen = mGeneration;
+			task = mTask;
+		}
+		(this->*task)(worker);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (--mPending == 0)
+				mDone.notify_one();
+		}
+	}
+}
+
+void SoftwareRasterizer::runParallel(void (SoftwareRasterizer::*task)(unsigned))
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTask = task;
+		mPending = mThreadCount - 1;
+		mGeneration++;
+	}
+	mWake.notify_all();
+	(this->*task)(0);
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [&] { return mPending == 0; });
+}
+
+void SoftwareRasterizer::setupTask(unsigned index)
+{
+	PROFILE_SCOPE("rasterSetup");
+	Worker& worker = mWorkers[index];
+	worker.triangles.clear();
+	for (std::vector<uint32_t>& bin : worker.bins)
+		bin.clear();
+	worker.rasterized = worker.binned = worker.pixels = worker.stolen = 0;
+
+	for (size_t j = worker.firstJob; j < worker.lastJob; j++)
+	{
+		const Job& job = mJobs[j];
+		const Draw& draw = mDraws[job.draw];
+		const MeshData& mesh = *draw.mesh;
+		const glm::mat4& model = mModels[draw.firstModel + job.instance];
+		const glm::mat4 modelViewProjection = mViewProjection * model;
+		const glm::mat3 normals = normalMatrix(model);
+
+		// Cache de vértices: cada vértice da malha é transformado uma vez por tarefa
+		if (worker.stamps.size() < mesh.vertexCount())
+		{
+			worker.stamps.assign(mesh.vertexCount(), 0);
+			worker.vertices.resize(mesh.vertexCount());
+			worker.stamp = 0;
+		}
+		if (++worker.stamp == 0)
+		{
+			std::fill(worker.stamps.begin(), worker.stamps.end(), 0);
+			worker.stamp = 1;
+		}
+		auto vertex = [&](uint32_t v) -> const ClipVertex& {
+			ClipVertex& out = worker.vertices[v];
+			if (worker.stamps[v] != worker.stamp)
+			{
+				worker.stamps[v] = worker.stamp;
+				const float* in = &mesh.vertices[(size_t)v * kVertexFloats];
+				const glm::vec4 position(in[0], in[1], in[2], 1.0f);
+				const glm::vec3 world = glm::vec3(model * position);
+				const glm::vec3 normal = normals * glm::vec3(in[8], in[9], in[10]);
+				out.clip = modelViewProjection * position;
+				out.attributes[0] = world.x;
+				out.attributes[1] = world.y;
+				out.attributes[2] = world.z;
+				out.attributes[3] = normal.x;
+				out.attributes[4] = normal.y;
+				out.attributes[5] = normal.z;
+				out.attributes[6] = in[6];
+				out.attributes[7] = in[7];
+			}
+			return out;
+		};
+
+		const uint32_t* indices = &mesh.indices[draw.firstIndex + job.firstTriangle * 3];
+		for (uint32_t t = 0; t < job.triangleCount; t++, indices += 3)
+		{
+			const ClipVertex* v[3] = { &vertex(indices[0]), &vertex(indices[1]), &vertex(indices[2]) };
+
+			// Fora do volume de visão por inteiro (todos do lado de fora de um mesmo plano)
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; axis++)
+			{
+				outside = v[0]->clip[axis] > v[0]->clip.w && v[1]->clip[axis] > v[1]->clip.w && v[2]->clip[axis] > v[2]->clip.w;
+				outside = outside || (v[0]->clip[axis] < -v[0]->clip.w && v[1]->clip[axis] < -v[1]->clip.w
+					&& v[2]->clip[axis] < -v[2]->clip.w);
+			}
+			if (outside)
+				continue;
+
+			// Recorte no plano próximo (z >= -w); os outros planos ficam para a caixa na tela e
+			// o teste de profundidade
+			int inside = 0;
+			for (int k = 0; k < 3; k++)
+				inside += v[k]->clip.z >= -v[k]->clip.w;
+			if (inside == 3)
+			{
+				setupTriangle(worker, v[0], v[1], v[2], draw.material);
+				continue;
+			}
+			ClipVertex clipped[4];
+			int count = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				const ClipVertex& a = *v[k];
+				const ClipVertex& b = *v[(k + 1) % 3];
+				const float da = a.clip.z + a.clip.w, db = b.clip.z + b.clip.w;
+				if (da >= 0.0f)
+					clipped[count++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+				{
+					const float s = da / (da - db);
+					ClipVertex& c = clipped[count++];
+					c.clip = glm::mix(a.clip, b.clip, s);
+					for (int i = 0; i < kAttributes; i++)
+						c.attributes[i] = a.attributes[i] + (b.attributes[i] - a.attributes[i]) * s;
+				}
+			}
+			for (int k = 1; k + 1 < count; k++)
+				setupTriangle(worker, &clipped[0], &clipped[k], &clipped[k + 1], draw.material);
+		}
+	}
+}
+
+void SoftwareRasterizer::setupTriangle(Worker& worker, const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2,
+	uint32_t material)
+{
+	// Para a janela: x e y em pixels (y para cima), z em [0, 1]
+	const ClipVertex* v[3] = { v0, v1, v2 };
+	float sx[3], sy[3], sz[3], invW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		invW[k] = 1.0f / v[k]->clip.w;
+		sx[k] = (v[k]->clip.x * invW[k] * 0.5f + 0.5f) * mWidth;
+		sy[k] = (v[k]->clip.y * invW[k] * 0.5f + 0.5f) * mHeight;
+		sz[k] = v[k]->clip.z * invW[k] * 0.5f + 0.5f;
+	}
+
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	if (!(std::abs(area) > 0.0f) || !std::isfinite(area))
+		return;
+	// Sem descarte de faces traseiras (como no GL): os horários são invertidos para o mesmo
+	// teste de cobertura
+	int order[3] = { 0, 1, 2 };
+	if (area < 0.0f)
+	{
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+	const float x[3] = { sx[order[0]], sx[order[1]], sx[order[2]] };
+	const float y[3] = { sy[order[0]], sy[order[1]], sy[order[2]] };
+
+	Triangle t;
+	t.minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+	t.minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+	t.maxX = std::min(mWidth - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+	t.maxY = std::min(mHeight - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	t.originX = x[0];
+	t.originY = y[0];
+	for (int e = 0; e < 3; e++)
+	{
+		const int n = (e + 1) % 3;
+		t.edgeA[e] = y[e] - y[n];
+		t.edgeB[e] = x[n] - x[e];
+		t.edgeC[e] = t.edgeA[e] * (x[0] - x[e]) + t.edgeB[e] * (y[0] - y[e]);
+		// Aresta esquerda (o interior fica à direita) ou de cima (horizontal com o interior abaixo)
+		t.topLeft[e] = (t.edgeA[e] > 0.0f || (t.edgeA[e] == 0.0f && t.edgeB[e] < 0.0f)) ? 0xF : 0;
+	}
+
+	// Planos: valores na janela variam linearmente com z e 1/w; os atributos, divididos por w
+	const float invArea = 1.0f / area;
+	auto setPlane = [&](float* plane, const float* values) {
+		const float f0 = values[order[0]], d1 = values[order[1]] - f0, d2 = values[order[2]] - f0;
+		plane[0] = f0;
+		plane[1] = (d1 * (y[2] - y[0]) - d2 * (y[1] - y[0])) * invArea;
+		plane[2] = (d2 * (x[1] - x[0]) - d1 * (x[2] - x[0])) * invArea;
+	};
+	setPlane(t.planes[0], sz);
+	setPlane(t.planes[1], invW);
+	for (int i = 0; i < kAttributes; i++)
+	{
+		const float values[3] = { v[0]->attributes[i] * invW[0], v[1]->attributes[i] * invW[1], v[2]->attributes[i] * invW[2] };
+		setPlane(t.planes[2 + i], values);
+	}
+	t.material = material;
+
+	worker.triangles.push_back(t);
+	worker.rasterized++;
+	binTriangle(worker, worker.triangles.back(), (uint32_t)worker.triangles.size() - 1);
+}
+
+void SoftwareRasterizer::binTriangle(Worker& worker, const Triangle& t, uint32_t index)
+{
+	const int tx0 = t.minX / kTileSize, tx1 = t.maxX / kTileSize;
+	const int ty0 = t.minY / kTileSize, ty1 = t.maxY / kTileSize;
+	const bool single = tx0 == tx1 && ty0 == ty1;
+	for (int ty = ty0; ty <= ty1; ty++)
+	{
+		for (int tx = tx0; tx <= tx1; tx++)
+		{
+			if (!single)
+			{
+				// Tile fora de alguma aresta: testa o canto mais para dentro dela
+				bool outside = false;
+				for (int e = 0; e < 3 && !outside; e++)
+				{
+					const float cx = (float)((t.edgeA[e] > 0.0f ? tx + 1 : tx) * kTileSize) - t.originX;
+					const float cy = (float)((t.edgeB[e] > 0.0f ? ty + 1 : ty) * kTileSize) - t.originY;
+					outside = t.edgeA[e] * cx + t.edgeB[e] * cy + t.edgeC[e] < 0.0f;
+				}
+				if (outside)
+					continue;
+			}
+			worker.bins[(size_t)ty * mTilesX + tx].push_back(index);
+			worker.binned++;
+		}
+	}
+}
+
+void SoftwareRasterizer::tileTask(unsigned index)
+{
+	PROFILE_SCOPE("rasterTiles");
+	Worker& worker = mWorkers[index];
+	// Primeiro os tiles próprios, depois os que sobraram nas outras threads
+	for (unsigned k = 0; k < mThreadCount; k++)
+	{
+		const unsigned owner = (index + k) % mThreadCount;
+		TileQueue& queue = mTileQueues[owner];
+		for (;;)
+		{
+			const uint32_t tile = queue.next.fetch_add(1, std::memory_order_relaxed);
+			if (tile >= queue.end)
+				break;
+			rasterTile(worker, tile);
+			if (owner != index)
+				worker.stolen++;
+		}
+	}
+}
+
+void SoftwareRasterizer::rasterTile(Worker& worker, uint32_t tile)
+{
+	const int x0 = (int)(tile % mTilesX) * kTileSize, y0 = (int)(tile / mTilesX) * kTileSize;
+	const int x1 = std::min(x0 + kTileSize, mWidth), y1 = std::min(y0 + kTileSize, mHeight);
+
+	// A limpeza é feita aqui, tile a tile, com o tile ainda no cache da thread
+	for (int y = y0; y < ((y1 + 1) & ~1); y++)
+	{
+		std::fill_n(&mColor[(size_t)y * mStride + x0], ((x1 + 1) & ~1) - x0, mClearColor);
+		std::fill_n(&mDepth[(size_t)y * mStride + x0], ((x1 + 1) & ~1) - x0, 1.0f);
+	}
+
+	// Listas de todas as threads, na ordem das faixas: a ordem de envio
+	for (const Worker& source : mWorkers)
+		for (uint32_t t : source.bins[tile])
+			rasterTriangle(worker, source.triangles[t], x0, y0, x1, y1);
+}
+
+void SoftwareRasterizer::rasterTriangle(Worker& worker, const Triangle& t, int tileX0, int tileY0, int tileX1, int tileY1)
+{
+	const SoftwareMaterial& material = mMaterials[t.material];
+	// Quads alinhados em coordenadas pares; os tiles começam em coordenadas pares
+	const int qx0 = std::max(t.minX, tileX0) & ~1, qy0 = std::max(t.minY, tileY0) & ~1;
+	const int qx1 = std::min(t.maxX, tileX1 - 1), qy1 = std::min(t.maxY, tileY1 - 1);
+
+	const quad laneX = qset(0.5f, 1.5f, 0.5f, 1.5f), laneY = qset(0.5f, 0.5f, 1.5f, 1.5f);
+	const quad zero = qset1(0.0f), one = qset1(1.0f);
+	const quad stepX[3] = { qset1(t.edgeA[0] * 2.0f), qset1(t.edgeA[1] * 2.0f), qset1(t.edgeA[2] * 2.0f) };
+	float depth[4];
+	for (int y = qy0; y <= qy1; y += 2)
+	{
+		// Pixels fora do tile (a última linha ou coluna de um tile de tamanho ímpar na borda)
+		const int rowMask = y + 1 < tileY1 ? 0xF : 0x3;
+		const quad dy = qadd(qset1((float)y - t.originY), laneY);
+		quad dx = qadd(qset1((float)qx0 - t.originX), laneX);
+		quad edge[3];
+		for (int e = 0; e < 3; e++)
+			edge[e] = qadd(qadd(qmul(qset1(t.edgeA[e]), dx), qmul(qset1(t.edgeB[e]), dy)), qset1(t.edgeC[e]));
+
+		for (int x = qx0; x <= qx1; x += 2)
+		{
+			int mask = rowMask & (x + 1 < tileX1 ? 0xF : 0x5);
+			for (int e = 0; e < 3; e++)
+				mask &= qgt(edge[e], zero) | (qeq(edge[e], zero) & t.topLeft[e]);
+			if (mask)
+			{
+				const quad z = evalPlane(t.planes[0], dx, dy);
+				const size_t row0 = (size_t)y * mStride + x, row1 = row0 + mStride;
+				const quad stored = qset(mDepth[row0], mDepth[row0 + 1], mDepth[row1], mDepth[row1 + 1]);
+				// GL_LESS, e fora de [0, 1] (além do plano distante) não aparece
+				mask &= qlt(z, stored) & qle(z, one) & (qle(zero, z));
+				if (mask)
+				{
+					qstore(depth, z);
+					shadeQuad(worker, t, material, x, y, mask, depth);
+				}
+			}
+			for (int e = 0; e < 3; e++)
+				edge[e] = qadd(edge[e], stepX[e]);
+			dx = qadd(dx, qset1(2.0f));
+		}
+	}
+}
+
+void SoftwareRasterizer::shadeQuad(Worker& worker, const Triangle& t, const SoftwareMaterial& material, int x, int y,
+	int mask, const float* depth)
+{
+	// Atributos nos 4 pixels do quad, cobertos ou não: os vizinhos dão as derivadas
+	const quad dx = qadd(qset1((float)x - t.originX), qset(0.5f, 1.5f, 0.5f, 1.5f));
+	const quad dy = qadd(qset1((float)y - t.originY), qset(0.5f, 0.5f, 1.5f, 1.5f));
+	float invW[4];
+	float attributes[kAttributes][4];
+	qstore(invW, evalPlane(t.planes[1], dx, dy));
+	for (int i = 0; i < kAttributes; i++)
+		qstore(attributes[i], evalPlane(t.planes[2 + i], dx, dy));
+	for (int lane = 0; lane < 4; lane++)
+	{
+		const float w = 1.0f / invW[lane];
+		for (int i = 0; i < kAttributes; i++)
+			attributes[i][lane] *= w;
+	}
+
+	float lod = 0.0f;
+	if (material.texture)
+	{
+		const float width = (float)material.texture->width, height = (float)material.texture->height;
+		const float dudx = (attributes[6][1] - attributes[6][0]) * width, dvdx = (attributes[7][1] - attributes[7][0]) * height;
+		const float dudy = (attributes[6][2] - attributes[6][0]) * width, dvdy = (attributes[7][2] - attributes[7][0]) * height;
+		const float rho = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+		lod = rho > 0.0f ? 0.5f * std::log2(rho) : 0.0f;
+	}
+
+	const glm::vec3 lightColor = mFrame.lightColor;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		if (!(mask & (1 << lane)))
+			continue;
+		const glm::vec3 fragPos(attributes[0][lane], attributes[1][lane], attributes[2][lane]);
+		const glm::vec3 norm = glm::normalize(glm::vec3(attributes[3][lane], attributes[4][lane], attributes[5][lane]));
+
+		// O mesmo Phong do fragmentShaderSource
+		const glm::vec3 lightDir = glm::normalize(mFrame.lightPos - fragPos);
+		const float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+		glm::vec3 result = material.Ka * lightColor + material.Kd * diff * lightColor;
+		if (material.specular)
+		{
+			const glm::vec3 viewDir = glm::normalize(mFrame.viewPos - fragPos);
+			const glm::vec3 reflectDir = glm::reflect(-lightDir, norm);
+			result += material.Ks * std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), material.Ns) * lightColor;
+		}
+		glm::vec4 color(result, material.opacity);
+		if (material.texture)
+			color *= sampleTexture(*material.texture, attributes[6][lane], attributes[7][lane], lod);
+
+		const size_t pixel = (size_t)(y + (lane >> 1)) * mStride + x + (lane & 1);
+		if (material.transparent)
+		{
+			const glm::vec4 dst = unpackColor(mColor[pixel]);
+			mColor[pixel] = packColor(color * color.a + dst * (1.0f - color.a));
+		}
+		else
+		{
+			mColor[pixel] = packColor(color);
+			mDepth[pixel] = depth[lane];
+		}
+		worker.pixels++;
+	}
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "mesh_builder.h"
+#include "texture_cache.h"
+
+// Material como o fragment shader o vê (uniforms Ka, Kd, Ks, Ns, opacity e a textura)
+struct SoftwareMaterial {
+	glm::vec3 Ka = glm::vec3(0.0f);
+	glm::vec3 Kd = glm::vec3(0.0f);
+	glm::vec3 Ks = glm::vec3(0.0f);
+	float Ns = 0.0f;
+	float opacity = 1.0f;
+	bool specular = false;     // variante SPECULAR
+	bool transparent = false;  // mistura com o fundo e não escreve profundidade
+	const TextureImage* texture = nullptr; // RGBA8 sem compressão, com os mips; nullptr: sem textura
+};
+
+// Dados do quadro (os mesmos do bloco Frame dos shaders)
+struct SoftwareFrame {
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 viewPos = glm::vec3(0.0f);
+	glm::vec3 lightPos = glm::vec3(0.0f);
+	glm::vec3 lightColor = glm::vec3(1.0f);
+	glm::vec3 clearColor = glm::vec3(0.0f);
+};
+
+struct RasterStats {
+	size_t triangles = 0;      // enviados nos desenhos (por instância)
+	size_t rasterized = 0;     // depois do recorte e sem os de área nula ou fora da tela
+	size_t binned = 0;         // referências de triângulos nos tiles
+	size_t pixels = 0;         // pixels sombreados (passaram no teste de profundidade)
+	size_t stolenTiles = 0;    // tiles feitos por outra thread que não a dona
+	double setupMs = 0.0;      // vértices, recorte, montagem e distribuição nos tiles
+	double rasterMs = 0.0;     // tiles: cobertura, profundidade e sombreamento
+	double totalMs = 0.0;
+};
+
+// Rasterizador em software com a mesma saída do pipeline GL (Phong do fragmentShaderSource,
+// profundidade GL_LESS, mistura SRC_ALPHA / ONE_MINUS_SRC_ALPHA nos transparentes), para
+// máquinas sem GPU.
+//
+// O quadro é acumulado (draw) e executado em endFrame em duas etapas, cada uma em todas as
+// threads:
+// 1. Vértices e montagem: os desenhos viram tarefas (instância x faixa de triângulos),
+//    repartidas em faixas contíguas por thread. Os vértices são transformados uma vez por
+//    tarefa, os triângulos recortados no plano próximo e distribuídos nos tiles de
+//    kTileSize pixels que tocam. Cada thread tem as suas listas por tile, então a ordem de
+//    envio se mantém (thread 0, depois 1...) sem travas.
+// 2. Tiles: cada thread começa pelos seus tiles e, quando acabam, rouba os que faltam das
+//    outras. Dentro do tile os triângulos são percorridos em quads 2x2: as funções de aresta
+//    e a profundidade são avaliadas para os 4 pixels de uma vez (SSE), e o quad inteiro é
+//    interpolado, o que dá as derivadas das coordenadas de textura para escolher o mip
+//    (trilinear, como GL_LINEAR_MIPMAP_LINEAR).
+//
+// Envie os opacos antes dos transparentes, e estes de trás para frente (como a DrawQueue).
+class SoftwareRasterizer
+{
+public:
+	static const int kTileSize = 64;
+
+	void create(int width, int height, unsigned threads);
+	void destroy();
+
+	// Materiais ficam válidos até destroy(); os desenhos se referem a eles pela posição
+	uint32_t addMaterial(const SoftwareMaterial& material);
+
+	void beginFrame(const SoftwareFrame& frame);
+	// Os triângulos indices[firstIndex, firstIndex + indexCount) de 'mesh', uma vez por matriz
+	// de modelo. 'mesh' precisa continuar válida até endFrame; as matrizes são copiadas
+	void draw(const MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, uint32_t material,
+		const glm::mat4* models, size_t instanceCount);
+	void endFrame();
+
+	// RGB, 3 bytes por pixel, de cima para baixo (como saveFrameImage espera)
+	void readPixels(std::vector<uint8_t>& rgb) const;
+
+	int width() const { return mWidth; }
+	int height() const { return mHeight; }
+	unsigned threadCount() const { return mThreadCount; }
+	const RasterStats& stats() const { return mStats; }
+
+	// Atributos interpolados com correção de perspectiva: posição no mundo, normal e UV
+	static const int kAttributes = 8;
+
+private:
+	struct Draw {
+		const MeshData* mesh;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t material;
+		size_t firstModel;
+		size_t modelCount;
+	};
+
+	// Uma instância de um desenho, ou parte dela
+	struct Job {
+		uint32_t draw;
+		uint32_t instance;
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+	};
+
+	struct ClipVertex {
+		glm::vec4 clip;
+		float attributes[kAttributes];
+	};
+
+	// Triângulo montado em coordenadas de janela (y para cima, centros dos pixels em +0.5).
+	// Arestas e planos são relativos ao vértice 0 (origin) para não perder precisão
+	struct Triangle {
+		float edgeA[3], edgeB[3], edgeC[3]; // E(p) = A (px - ox) + B (py - oy) + C, > 0 dentro
+		int topLeft[3];                     // máscara de 4 lanes: E == 0 conta (regra top-left)
+		float originX, originY;
+		float planes[2 + kAttributes][3];   // z, 1/w e atributos/w: valor na origem, d/dx, d/dy
+		int minX, minY, maxX, maxY;         // caixa na tela, inclusive
+		uint32_t material;
+	};
+
+	struct Worker {
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t>> bins; // triângulos (em 'triangles') de cada tile
+		std::vector<ClipVertex> vertices;        // cache de vértices transformados da tarefa
+		std::vector<uint32_t> stamps;            // tarefa que preencheu cada posição do cache
+		uint32_t stamp = 0;
+		size_t firstJob = 0, lastJob = 0;        // faixa de tarefas da etapa 1
+		size_t rasterized = 0, binned = 0, pixels = 0, stolen = 0;
+	};
+
+	// Tiles de cada thread na etapa 2; 'next' é disputado por quem rouba
+	struct alignas(64) TileQueue {
+		std::atomic<uint32_t> next{ 0 };
+		uint32_t end = 0;
+	};
+
+	void workerLoop(unsigned worker);
+	void runParallel(void (SoftwareRasterizer::*task)(unsigned));
+
+	void setupTask(unsigned worker);
+	void tileTask(unsigned worker);
+	void setupTriangle(Worker& worker, const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2, uint32_t material);
+	void binTriangle(Worker& worker, const Triangle& triangle, uint32_t index);
+	void rasterTile(Worker& worker, uint32_t tile);
+	void rasterTriangle(Worker& worker, const Triangle& triangle, int tileX0, int tileY0, int tileX1, int tileY1);
+	void shadeQuad(Worker& worker, const Triangle& triangle, const SoftwareMaterial& material, int x, int y, int mask,
+		const float* depth);
+
+	int mWidth = 0, mHeight = 0;
+	int mStride = 0;              // largura par: os quads 2x2 nunca saem do buffer
+	int mTilesX = 0, mTilesY = 0;
+	std::vector<uint32_t> mColor; // RGBA8, linha 0 embaixo
+	std::vector<float> mDepth;
+
+	SoftwareFrame mFrame;
+	glm::mat4 mViewProjection = glm::mat4(1.0f);
+	uint32_t mClearColor = 0;
+	std::vector<SoftwareMaterial> mMaterials;
+	std::vector<Draw> mDraws;
+	std::vector<glm::mat4> mModels;
+	std::vector<Job> mJobs;
+	RasterStats mStats;
+
+	unsigned mThreadCount = 1;
+	std::vector<Worker> mWorkers;
+	std::unique_ptr<TileQueue[]> mTileQueues;
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	void (SoftwareRasterizer::*mTask)(unsigned) = nullptr;
+	uint64_t mGeneration = 0;
+	unsigned mPending = 0;
+	bool mQuit = false;
+};
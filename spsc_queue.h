@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fila circular sem travas para exatamente um produtor e um consumidor, cada um na sua thread.
+//
+// O produtor só escreve mTail e o consumidor só escreve mHead, cada índice na sua linha de
+// cache. Cada lado guarda a última cópia que leu do índice do outro e só a relê quando a fila
+// parece cheia (ou vazia), então no caso comum push e pop não tocam a linha do outro lado.
+// Os índices crescem sem voltar a zero; a posição no array é o índice & mMask.
+template <typename T>
+class SpscQueue
+{
+public:
+	// A capacidade é arredondada para cima até uma potência de 2
+	explicit SpscQueue(size_t capacity = 1024)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		mItems.resize(size);
+		mMask = size - 1;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Só o produtor. Com a fila cheia o item não entra e retorna false
+	bool push(const T& item)
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHeadCache == mItems.size())
+		{
+			mHeadCache = mHead.load(std::memory_order_acquire);
+			if (tail - mHeadCache == mItems.size())
+				return false;
+		}
+		mItems[tail & mMask] = item;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Só o consumidor. Retorna false se a fila está vazia
+	bool pop(T& item)
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTailCache)
+		{
+			mTailCache = mTail.load(std::memory_order_acquire);
+			if (head == mTailCache)
+				return false;
+		}
+		item = mItems[head & mMask];
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return mItems.size(); }
+
+private:
+	std::vector<T> mItems;
+	size_t mMask = 0;
+
+	// Lado do consumidor
+	alignas(64) std::atomic<size_t> mHead{ 0 };
+	size_t mTailCache = 0;
+
+	// Lado do produtor
+	alignas(64) std::atomic<size_t> mTail{ 0 };
+	size_t mHeadCache = 0;
+};
@@ -0,0 +1,377 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// STB_DXT
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+#include "stb_image.h"
+
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+#include "run_parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_CACHE_SSE 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = { 'C', 'G', 'T', 'E', 'X', 0, 0, 0 };
+
+// Resolução da tabela linear -> sRGB (erro bem abaixo de meio degrau de 8 bits)
+const int kLinearToSrgbSteps = 4096;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+int64_t modificationTime(const fs::path& path)
+{
+	std::error_code ec;
+	auto time = fs::last_write_time(path, ec);
+	return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+struct ColorTables {
+	float srgbToLinear[256];
+	uint8_t linearToSrgb[kLinearToSrgbSteps + 1];
+
+	ColorTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= kLinearToSrgbSteps; i++)
+		{
+			float l = static_cast<float>(i) / kLinearToSrgbSteps;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			linearToSrgb[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+		}
+	}
+};
+
+const ColorTables& colorTables()
+{
+	static const ColorTables tables;
+	return tables;
+}
+
+// Média de 4 pixels RGBA em float (um pixel por registrador no SSE)
+inline void average4(const float* a, const float* b, const float* c, const float* d, float* out)
+{
+#if defined(TEXTURE_CACHE_SSE)
+	__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)), _mm_add_ps(_mm_loadu_ps(c), _mm_loadu_ps(d)));
+	_mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+	for (int k = 0; k < 4; k++)
+		out[k] = (a[k] + b[k] + c[k] + d[k]) * 0.25f;
+#endif
+}
+
+// Reduz um nível linear pela metade; em dimensões ímpares a última linha/coluna é repetida
+void downsample(const std::vector<float>& src, int width, int height, std::vector<float>& dst, int dstWidth, int dstHeight)
+{
+	dst.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+	for (int y = 0; y < dstHeight; y++)
+	{
+		const int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		const float* row0 = &src[static_cast<size_t>(y0) * width * 4];
+		const float* row1 = &src[static_cast<size_t>(y1) * width * 4];
+		float* out = &dst[static_cast<size_t>(y) * dstWidth * 4];
+		for (int x = 0; x < dstWidth; x++)
+		{
+			const int x0 = std::min(2 * x, width - 1) * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+			average4(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out + x * 4);
+		}
+	}
+}
+
+void toLinear(const uint8_t* rgba, size_t pixels, std::vector<float>& out)
+{
+	const ColorTables& tables = colorTables();
+	out.resize(pixels * 4);
+	for (size_t i = 0; i < pixels; i++)
+	{
+		out[i * 4 + 0] = tables.srgbToLinear[rgba[i * 4 + 0]];
+		out[i * 4 + 1] = tables.srgbToLinear[rgba[i * 4 + 1]];
+		out[i * 4 + 2] = tables.srgbToLinear[rgba[i * 4 + 2]];
+		out[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+	}
+}
+
+void toSrgb(const std::vector<float>& linear, uint8_t* rgba)
+{
+	const ColorTables& tables = colorTables();
+	for (size_t i = 0; i < linear.size(); i += 4)
+	{
+		for (int k = 0; k < 3; k++)
+			rgba[i + k] = tables.linearToSrgb[static_cast<int>(std::clamp(linear[i + k], 0.0f, 1.0f) * kLinearToSrgbSteps + 0.5f)];
+		rgba[i + 3] = static_cast<uint8_t>(std::clamp(linear[i + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+size_t blockBytes(TextureFormat format)
+{
+	return format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+size_t levelBytes(TextureFormat format, uint32_t width, uint32_t height)
+{
+	if (format == TEXTURE_FORMAT_RGBA8)
+		return static_cast<size_t>(width) * height * 4;
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+} // namespace
+
+size_t TextureImage::uncompressedBytes() const
+{
+	size_t total = 0;
+	for (const TextureLevel& level : levels)
+		total += levelBytes(TEXTURE_FORMAT_RGBA8, level.width, level.height);
+	return total;
+}
+
+std::string textureCachePath(const std::string& sourcePath, bool compress)
+{
+	return sourcePath + (compress ? ".bc.texcache" : ".rgba.texcache");
+}
+
+void buildTextureImage(const uint8_t* rgba, int width, int height, bool compress, unsigned threads, TextureImage& out)
+{
+	PROFILE_SCOPE("buildTextureImage");
+
+	bool opaque = true;
+	for (size_t i = 0, n = static_cast<size_t>(width) * height; i < n && opaque; i++)
+		opaque = rgba[i * 4 + 3] == 255;
+
+	out.format = !compress ? TEXTURE_FORMAT_RGBA8 : opaque ? TEXTURE_FORMAT_BC1 : TEXTURE_FORMAT_BC3;
+	out.width = width;
+	out.height = height;
+	out.levels.clear();
+
+	// Cadeia de mips em RGBA8: o nível 0 é a própria imagem, os demais saem do filtro linear
+	std::vector<std::vector<uint8_t>> mips(1, std::vector<uint8_t>(rgba, rgba + static_cast<size_t>(width) * height * 4));
+	std::vector<uint32_t> widths(1, width), heights(1, height);
+	{
+		PROFILE_SCOPE("buildMipChain");
+		std::vector<float> linear, next;
+		toLinear(rgba, static_cast<size_t>(width) * height, linear);
+		int w = width, h = height;
+		while (w > 1 || h > 1)
+		{
+			int nw = std::max(w / 2, 1), nh = std::max(h / 2, 1);
+			downsample(linear, w, h, next, nw, nh);
+			linear.swap(next);
+			w = nw;
+			h = nh;
+			mips.emplace_back(static_cast<size_t>(w) * h * 4);
+			toSrgb(linear, mips.back().data());
+			widths.push_back(w);
+			heights.push_back(h);
+		}
+	}
+
+	size_t total = 0;
+	for (size_t l = 0; l < mips.size(); l++)
+	{
+		TextureLevel level;
+		level.width = widths[l];
+		level.height = heights[l];
+		level.offset = total;
+		level.size = levelBytes(out.format, level.width, level.height);
+		total += level.size;
+		out.levels.push_back(level);
+	}
+	out.data.assign(total, 0);
+
+	if (!compress)
+	{
+		for (size_t l = 0; l < mips.size(); l++)
+			memcpy(&out.data[out.levels[l].offset], mips[l].data(), mips[l].size());
+		return;
+	}
+
+	// Uma tarefa por linha de blocos de cada nível, para os níveis pequenos não ficarem sozinhos numa thread
+	PROFILE_SCOPE("encodeBlocks");
+	std::vector<std::pair<uint32_t, uint32_t>> rows; // (nível, linha de blocos)
+	for (uint32_t l = 0; l < out.levels.size(); l++)
+		for (uint32_t by = 0; by < (out.levels[l].height + 3) / 4; by++)
+			rows.emplace_back(l, by);
+
+	const int alpha = out.format == TEXTURE_FORMAT_BC3 ? 1 : 0;
+	const size_t bytesPerBlock = blockBytes(out.format);
+	runParallel(rows.size(), std::max(threads, 1u), [&](size_t i) {
+		const TextureLevel& level = out.levels[rows[i].first];
+		const uint8_t* src = mips[rows[i].first].data();
+		const uint32_t by = rows[i].second;
+		const uint32_t blocksX = (level.width + 3) / 4;
+		uint8_t* dst = &out.data[level.offset + static_cast<size_t>(by) * blocksX * bytesPerBlock];
+
+		uint8_t block[16 * 4];
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			// Blocos na borda repetem o último pixel
+			for (uint32_t py = 0; py < 4; py++)
+			{
+				uint32_t y = std::min(by * 4 + py, level.height - 1);
+				for (uint32_t px = 0; px < 4; px++)
+				{
+					uint32_t x = std::min(bx * 4 + px, level.width - 1);
+					memcpy(&block[(py * 4 + px) * 4], &src[(static_cast<size_t>(y) * level.width + x) * 4], 4);
+				}
+			}
+			stb_compress_dxt_block(dst + bx * bytesPerBlock, block, alpha, STB_DXT_HIGHQUAL);
+		}
+	});
+}
+
+std::vector<char> serializeTextureCache(const TextureImage& image, const std::string& sourcePath)
+{
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kTextureCacheVersion;
+	header.format = image.format;
+	header.width = image.width;
+	header.height = image.height;
+	header.levelCount = static_cast<uint32_t>(image.levels.size());
+	header.levelOffset = alignUp(sizeof(TextureCacheHeader), 16);
+	header.dataOffset = alignUp(header.levelOffset + image.levels.size() * sizeof(TextureLevel), 16);
+
+	MappedFile source;
+	if (source.open(sourcePath))
+	{
+		header.sourceSize = source.size();
+		header.sourceMtime = modificationTime(sourcePath);
+		header.sourceHash = hashBytes(source.data(), source.size());
+	}
+
+	header.fileSize = header.dataOffset + image.data.size();
+	std::vector<char> fileImage(header.fileSize, 0);
+	memcpy(fileImage.data(), &header, sizeof(header));
+	if (!image.levels.empty())
+		memcpy(&fileImage[header.levelOffset], image.levels.data(), image.levels.size() * sizeof(TextureLevel));
+	if (!image.data.empty())
+		memcpy(&fileImage[header.dataOffset], image.data.data(), image.data.size());
+	return fileImage;
+}
+
+bool saveTextureCache(const std::string& cachePath, const std::vector<char>& fileImage)
+{
+	// Grava em um arquivo temporário e renomeia, para nunca deixar um cache pela metade
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		out.write(fileImage.data(), static_cast<std::streamsize>(fileImage.size()));
+		if (!out)
+			return false;
+	}
+	std::error_code ec;
+	fs::rename(tempPath, cachePath, ec);
+	if (ec)
+	{
+		fs::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+bool loadTextureCache(const std::string& cachePath, const std::string& sourcePath, bool compress, TextureImage& out)
+{
+	MappedFile file;
+	if (!file.open(cachePath))
+		return false;
+	if (file.size() < sizeof(TextureCacheHeader))
+		return false;
+	TextureCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kTextureCacheVersion
+		|| header.fileSize != file.size() || header.format > TEXTURE_FORMAT_BC3
+		|| header.levelOffset + header.levelCount * sizeof(TextureLevel) > file.size()
+		|| header.dataOffset > file.size())
+	{
+		std::cout << "Cache de textura invalido ou de outra versao: " << cachePath << std::endl;
+		return false;
+	}
+	if ((header.format != TEXTURE_FORMAT_RGBA8) != compress)
+		return false;
+
+	std::error_code ec;
+	uint64_t size = fs::file_size(sourcePath, ec);
+	if (ec || size != header.sourceSize)
+		return false;
+	if (modificationTime(sourcePath) != header.sourceMtime)
+	{
+		// A data mudou (ex: checkout ou cópia), mas o conteúdo pode ser o mesmo
+		MappedFile source;
+		if (!source.open(sourcePath) || hashBytes(source.data(), source.size()) != header.sourceHash)
+			return false;
+	}
+
+	const TextureFormat format = static_cast<TextureFormat>(header.format);
+	const size_t dataSize = file.size() - header.dataOffset;
+	out.levels.resize(header.levelCount);
+	memcpy(out.levels.data(), file.data() + header.levelOffset, header.levelCount * sizeof(TextureLevel));
+	for (const TextureLevel& level : out.levels)
+		if (level.offset + level.size > dataSize || level.size != levelBytes(format, level.width, level.height))
+			return false;
+
+	out.format = format;
+	out.width = header.width;
+	out.height = header.height;
+	out.data.assign(file.data() + header.dataOffset, file.end());
+	return !out.levels.empty();
+}
+
+bool loadTextureImage(const std::string& path, bool compress, bool rebuildCache, unsigned threads, TextureImage& out,
+	bool* fromCache)
+{
+	const std::string cachePath = textureCachePath(path, compress);
+	if (fromCache)
+		*fromCache = false;
+	if (!rebuildCache && loadTextureCache(cachePath, path, compress, out))
+	{
+		if (fromCache)
+			*fromCache = true;
+		return true;
+	}
+
+	// Sempre 4 canais: linhas alinhadas e um único formato para os filtros. A inversão
+	// vertical é feita aqui porque stbi_set_flip_vertically_on_load é global.
+	out = TextureImage();
+	MappedFile file;
+	if (!file.open(path) || file.size() == 0)
+		return false;
+	int width = 0, height = 0, channels = 0;
+	unsigned char* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()),
+		static_cast<int>(file.size()), &width, &height, &channels, 4);
+	if (!data)
+		return false;
+	const size_t stride = static_cast<size_t>(width) * 4;
+	std::vector<uint8_t> pixels(stride * height);
+	for (int y = 0; y < height; y++)
+		memcpy(&pixels[y * stride], data + (height - 1 - y) * stride, stride);
+	stbi_image_free(data);
+
+	buildTextureImage(pixels.data(), width, height, compress, threads, out);
+	if (!saveTextureCache(cachePath, serializeTextureCache(out, path)))
+		std::cout << "Nao foi possivel gravar o cache de textura " << cachePath << std::endl;
+	return true;
+}
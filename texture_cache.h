@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Formato binário do cache de texturas (arquivo "<fonte>.bc.texcache" ou "<fonte>.rgba.texcache"
+// ao lado da imagem: um por modo de compressão, para o GL e o rasterizador em software não
+// invalidarem o cache um do outro).
+// Inspirado no KTX2: cabeçalho, tabela de níveis e os níveis de mip já no formato da GPU,
+// do maior para o menor. Aumente a versão sempre que o layout ou os filtros mudarem.
+const uint32_t kTextureCacheVersion = 1;
+
+enum TextureFormat : uint32_t {
+	TEXTURE_FORMAT_RGBA8 = 0, // sem compressão (GPU sem S3TC ou --uncompressed-textures)
+	TEXTURE_FORMAT_BC1 = 1,   // 8 bytes por bloco 4x4, imagens opacas
+	TEXTURE_FORMAT_BC3 = 2,   // 16 bytes por bloco 4x4, imagens com alfa
+};
+
+struct TextureCacheHeader {
+	char magic[8];            // "CGTEX\0\0\0"
+	uint32_t version;
+	uint32_t format;          // TextureFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t reserved;
+	uint64_t levelOffset;     // tabela de TextureLevel
+	uint64_t dataOffset;      // início dos níveis (offsets da tabela são relativos a ele)
+	uint64_t sourceSize;      // imagem de origem, para invalidação (como no cache de malhas)
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+	uint64_t fileSize;
+};
+
+struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset; // relativo ao início dos dados
+	uint64_t size;
+};
+
+// Textura pronta para upload: todos os níveis num único buffer, linhas de baixo para cima
+struct TextureImage {
+	TextureFormat format = TEXTURE_FORMAT_RGBA8;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<TextureLevel> levels;
+	std::vector<uint8_t> data;
+
+	bool compressed() const { return format != TEXTURE_FORMAT_RGBA8; }
+	// Memória de vídeo que a mesma cadeia de mips ocupa em RGBA8, para comparação
+	size_t uncompressedBytes() const;
+};
+
+std::string textureCachePath(const std::string& sourcePath, bool compress);
+
+// Gera a cadeia de mips completa a partir de uma imagem RGBA8 e codifica cada nível.
+// O filtro é uma média 2x2 feita em espaço linear (cor convertida de sRGB; alfa já é linear).
+// Com 'compress', imagens opacas viram BC1 e as com alfa BC3, codificadas em 'threads' threads.
+void buildTextureImage(const uint8_t* rgba, int width, int height, bool compress, unsigned threads, TextureImage& out);
+
+std::vector<char> serializeTextureCache(const TextureImage& image, const std::string& sourcePath);
+bool saveTextureCache(const std::string& cachePath, const std::vector<char>& fileImage);
+
+// Lê o cache e verifica se ainda corresponde à imagem de origem (tamanho, data e hash)
+// e ao modo de compressão pedido. Retorna false se não existe, é de outra versão ou está desatualizado.
+bool loadTextureCache(const std::string& cachePath, const std::string& sourcePath, bool compress, TextureImage& out);
+
+// Cadeia de mips de uma imagem: do cache, se válido (e não 'rebuildCache'), senão decodificada
+// com stb_image (linhas invertidas para ficar de baixo para cima, como a GL espera), gerada
+// por buildTextureImage e gravada no cache. 'fromCache' diz de onde veio. false se a imagem
+// não pôde ser lida.
+bool loadTextureImage(const std::string& path, bool compress, bool rebuildCache, unsigned threads, TextureImage& out,
+	bool* fromCache = nullptr);
@@ -0,0 +1,315 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "profiler.h"
+
+// EXT_texture_compression_s3tc (o loader do GLAD pode ter sido gerado sem a extensão)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+GLenum internalFormat(TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_FORMAT_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_RGBA8;
+	}
+}
+
+bool formatSupported(GLenum format)
+{
+	GLint supported = GL_FALSE;
+	glGetInternalformativ(GL_TEXTURE_2D, format, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+	return supported == GL_TRUE;
+}
+
+} // namespace
+
+void TextureStreamer::create(unsigned threads, size_t uploadBudget, bool compress, bool rebuildCache)
+{
+	mUploadBudget = uploadBudget;
+	mRebuildCache = rebuildCache;
+	mStopping = false;
+
+	mCompress = compress && formatSupported(GL_COMPRESSED_RGB_S3TC_DXT1_EXT) && formatSupported(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+	if (compress && !mCompress)
+		std::cout << "GPU sem suporte a S3TC: texturas ficam em RGBA8" << std::endl;
+
+	// Placeholder branco: a cor do material aparece até a textura real chegar
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+	glCreateTextures(GL_TEXTURE_2D, 1, &mPlaceholder);
+	glTextureStorage2D(mPlaceholder, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(mPlaceholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+	for (PboSlot& slot : mSlots)
+		glCreateBuffers(1, &slot.buffer);
+
+	for (unsigned t = 0; t < std::max(threads, 1u); t++)
+		mWorkers.emplace_back(&TextureStreamer::workerLoop, this);
+}
+
+void TextureStreamer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		mJobs.clear();
+	}
+	mWake.notify_all();
+	for (std::thread& worker : mWorkers)
+		worker.join();
+	mWorkers.clear();
+	mDecoded.clear();
+
+	for (PboSlot& slot : mSlots)
+	{
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		if (slot.buffer)
+			glDeleteBuffers(1, &slot.buffer);
+		slot = PboSlot();
+	}
+	for (Entry& entry : mEntries)
+		if (entry.texture)
+			glDeleteTextures(1, &entry.texture);
+	if (mPlaceholder)
+		glDeleteTextures(1, &mPlaceholder);
+	mPlaceholder = 0;
+	mEntries.clear();
+	mByPath.clear();
+	mPending = 0;
+	mNextSlot = 0;
+	mStats = TextureStreamStats();
+}
+
+TextureHandle TextureStreamer::request(const std::string& path)
+{
+	auto it = mByPath.find(path);
+	if (it != mByPath.end())
+		return it->second;
+
+	TextureHandle handle = static_cast<TextureHandle>(mEntries.size());
+	Entry entry;
+	entry.path = path;
+	mEntries.push_back(entry);
+	mByPath.emplace(path, handle);
+	mStats.requested++;
+	mPending++;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.emplace_back(handle, path);
+	}
+	mWake.notify_one();
+	return handle;
+}
+
+GLuint TextureStreamer::texture(TextureHandle handle) const
+{
+	if (handle < mEntries.size() && mEntries[handle].state == STATE_RESIDENT)
+		return mEntries[handle].texture;
+	return mPlaceholder;
+}
+
+bool TextureStreamer::resident(TextureHandle handle) const
+{
+	return handle < mEntries.size() && mEntries[handle].state == STATE_RESIDENT;
+}
+
+size_t TextureStreamer::residentBytes(TextureHandle handle) const
+{
+	return resident(handle) ? mEntries[handle].bytes : 0;
+}
+
+double TextureStreamer::prepareMs(TextureHandle handle) const
+{
+	return handle < mEntries.size() ? mEntries[handle].prepareMs : 0.0;
+}
+
+void TextureStreamer::update()
+{
+	PROFILE_SCOPE("textureStreaming");
+	mStats.lastFrameBytes = 0;
+	if (mPending == 0)
+		return;
+	retireUploads(false);
+	drainDecoded(mUploadBudget);
+}
+
+void TextureStreamer::finish()
+{
+	while (mPending > 0)
+	{
+		retireUploads(true);
+		drainDecoded(SIZE_MAX);
+
+		// Nada para enviar: espera um worker terminar (ou só faltam fences)
+		std::unique_lock<std::mutex> lock(mMutex);
+		if (mDecoded.empty())
+			mDecodedReady.wait_for(lock, std::chrono::milliseconds(10));
+	}
+}
+
+void TextureStreamer::workerLoop()
+{
+	if (profilerEnabled())
+		profilerSetThreadName("texture decode");
+	for (;;)
+	{
+		std::pair<TextureHandle, std::string> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+			if (mStopping)
+				return;
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		DecodedImage image;
+		image.handle = job.first;
+		auto start = std::chrono::steady_clock::now();
+		prepareImage(job.second, image);
+		image.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDecoded.push_back(std::move(image));
+		}
+		mDecodedReady.notify_one();
+	}
+}
+
+void TextureStreamer::prepareImage(const std::string& path, DecodedImage& decoded)
+{
+	PROFILE_SCOPE("decodeTexture");
+	// Uma thread por textura: os workers já trabalham em paralelo, e codificar cada uma em
+	// 'threads' threads criaria threads² de uma vez
+	loadTextureImage(path, mCompress, mRebuildCache, 1, decoded.image, &decoded.fromCache);
+}
+
+void TextureStreamer::retireUploads(bool wait)
+{
+	for (PboSlot& slot : mSlots)
+	{
+		if (!slot.fence)
+			continue;
+		GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		Entry& entry = mEntries[slot.handle];
+		entry.state = STATE_RESIDENT;
+		slot.handle = kInvalidTexture;
+		mStats.resident++;
+		mStats.residentBytes += entry.bytes;
+		mStats.uncompressedBytes += entry.uncompressedBytes;
+		mPending--;
+	}
+}
+
+void TextureStreamer::drainDecoded(size_t budget)
+{
+	size_t sent = 0;
+	for (;;)
+	{
+		DecodedImage image;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mDecoded.empty())
+				return;
+			image = std::move(mDecoded.front());
+			mDecoded.pop_front();
+		}
+
+		if (image.image.levels.empty())
+		{
+			std::cout << "Failed to load texture: " << mEntries[image.handle].path << std::endl;
+			mEntries[image.handle].state = STATE_FAILED;
+			mStats.failed++;
+			mPending--;
+			continue;
+		}
+
+		// Fora do orçamento ou sem PBO livre: volta para a fila e fica para o próximo quadro
+		size_t size = image.image.data.size();
+		if ((sent > 0 && sent + size > budget) || !upload(image))
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDecoded.push_front(std::move(image));
+			return;
+		}
+		sent += size;
+		if (image.fromCache)
+			mStats.cacheHits++;
+		mStats.lastFrameBytes += size;
+		mStats.bytesUploaded += size;
+	}
+}
+
+bool TextureStreamer::upload(DecodedImage& decoded)
+{
+	PboSlot& slot = mSlots[mNextSlot];
+	if (slot.fence)
+		return false;
+
+	const TextureImage& image = decoded.image;
+	const size_t size = image.data.size();
+	if (slot.capacity < size)
+	{
+		glNamedBufferData(slot.buffer, size, nullptr, GL_STREAM_DRAW);
+		slot.capacity = size;
+	}
+	// A fence garante que a GPU já leu o conteúdo anterior: não precisa sincronizar
+	void* dst = glMapNamedBufferRange(slot.buffer, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!dst)
+		return false;
+	memcpy(dst, image.data.data(), size);
+	glUnmapNamedBuffer(slot.buffer);
+
+	const GLenum format = internalFormat(image.format);
+	const GLsizei levels = static_cast<GLsizei>(image.levels.size());
+	GLuint texture = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, levels, format, image.width, image.height);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Cópia PBO -> textura feita pela GPU, um nível de mip por vez; as chamadas retornam sem esperar
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+	for (GLsizei l = 0; l < levels; l++)
+	{
+		const TextureLevel& level = image.levels[l];
+		const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(level.offset));
+		if (image.compressed())
+			glCompressedTextureSubImage2D(texture, l, 0, 0, level.width, level.height, format, static_cast<GLsizei>(level.size), offset);
+		else
+			glTextureSubImage2D(texture, l, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.handle = decoded.handle;
+	Entry& entry = mEntries[decoded.handle];
+	entry.texture = texture;
+	entry.state = STATE_UPLOADING;
+	entry.bytes = size;
+	entry.uncompressedBytes = image.uncompressedBytes();
+	entry.prepareMs = decoded.milliseconds;
+	mNextSlot = (mNextSlot + 1) % kPboCount;
+	return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "texture_cache.h"
+
+// Identificador de uma textura pedida ao TextureStreamer (índice interno)
+typedef uint32_t TextureHandle;
+const TextureHandle kInvalidTexture = 0xFFFFFFFFu;
+
+struct TextureStreamStats {
+	size_t requested = 0;
+	size_t resident = 0;
+	size_t failed = 0;
+	size_t bytesUploaded = 0;      // total desde o início
+	size_t lastFrameBytes = 0;     // enviados no último update()
+	size_t residentBytes = 0;      // memória de vídeo das texturas residentes
+	size_t uncompressedBytes = 0;  // o que as mesmas texturas ocupariam em RGBA8
+	size_t cacheHits = 0;          // texturas lidas do .texcache
+};
+
+// Carregamento assíncrono de texturas.
+//
+// request() só registra o pedido: um pool de threads lê o cache .texcache da imagem (mips
+// prontos, em BC1/BC3 quando a GPU aceita S3TC) ou, se ele falta ou está velho, decodifica a
+// imagem com stb_image, gera o cache e o grava. O resultado volta para a thread do GL, que
+// copia os níveis para um anel de PBOs e dispara a cópia PBO -> textura. Cada PBO tem uma
+// fence e só é reaproveitado quando a GPU terminou de ler dele, então o upload nunca espera a
+// GPU. Até a fence do seu upload sinalizar, a textura de um handle é um placeholder branco 1x1.
+//
+// update() deve ser chamado uma vez por quadro na thread do GL e envia no máximo
+// 'uploadBudget' bytes (sempre pelo menos uma textura, para as grandes não ficarem presas).
+// Usa as funções DSA do OpenGL 4.5: não muda as texturas ligadas (o GLStateCache continua válido).
+class TextureStreamer
+{
+public:
+	static const int kPboCount = 3;
+
+	// 'compress' pede BC1/BC3 (ignorado se a GPU não tem S3TC); 'rebuildCache' ignora os .texcache
+	void create(unsigned threads, size_t uploadBudget, bool compress, bool rebuildCache);
+	void destroy();
+
+	// Pedidos do mesmo arquivo devolvem o mesmo handle
+	TextureHandle request(const std::string& path);
+
+	// Textura a ligar para o handle: a real se já está residente, senão o placeholder
+	GLuint texture(TextureHandle handle) const;
+	bool resident(TextureHandle handle) const;
+	// Memória de vídeo de uma textura residente (0 antes disso)
+	size_t residentBytes(TextureHandle handle) const;
+	// Tempo de preparo num worker (leitura do .texcache ou decodificação e geração dos mips)
+	double prepareMs(TextureHandle handle) const;
+
+	// Recolhe as imagens decodificadas, verifica as fences e envia o que couber no orçamento
+	void update();
+
+	// Bloqueia até todos os pedidos estarem residentes (ou falharem), sem orçamento.
+	// Usado no modo headless para os quadros serem reproduzíveis.
+	void finish();
+
+	const TextureStreamStats& stats() const { return mStats; }
+	size_t uploadBudget() const { return mUploadBudget; }
+
+private:
+	enum State { STATE_DECODING, STATE_UPLOADING, STATE_RESIDENT, STATE_FAILED };
+
+	struct Entry {
+		std::string path;
+		State state = STATE_DECODING;
+		GLuint texture = 0;
+		size_t bytes = 0;             // memória de vídeo da cadeia de mips
+		size_t uncompressedBytes = 0;
+		double prepareMs = 0.0;
+	};
+
+	// Imagem preparada por um worker, com os mips e de baixo para cima (como o GL espera)
+	struct DecodedImage {
+		TextureHandle handle = kInvalidTexture;
+		TextureImage image; // sem níveis se a decodificação falhou
+		bool fromCache = false;
+		double milliseconds = 0.0; // tempo de prepareImage
+	};
+
+	struct PboSlot {
+		GLuint buffer = 0;
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+		TextureHandle handle = kInvalidTexture; // textura lendo deste PBO
+	};
+
+	void workerLoop();
+	void prepareImage(const std::string& path, DecodedImage& decoded);
+	// Fences sinalizadas: libera os PBOs e torna as texturas residentes
+	void retireUploads(bool wait);
+	// Envia imagens decodificadas até 'budget' bytes ou até o anel de PBOs encher
+	void drainDecoded(size_t budget);
+	bool upload(DecodedImage& decoded);
+
+	std::vector<Entry> mEntries;
+	std::unordered_map<std::string, TextureHandle> mByPath;
+	GLuint mPlaceholder = 0;
+	PboSlot mSlots[kPboCount];
+	int mNextSlot = 0;
+	size_t mUploadBudget = 0;
+	bool mCompress = false;     // só lido pelos workers depois de create()
+	bool mRebuildCache = false;
+	size_t mPending = 0; // pedidos ainda não residentes nem falhos
+	TextureStreamStats mStats;
+
+	// Compartilhado com os workers
+	std::mutex mMutex;
+	std::condition_variable mWake;          // há pedidos para os workers
+	std::condition_variable mDecodedReady;  // há imagens decodificadas
+	std::deque<std::pair<TextureHandle, std::string>> mJobs;
+	std::deque<DecodedImage> mDecoded;
+	bool mStopping = false;
+	std::vector<std::thread> mWorkers;
+};
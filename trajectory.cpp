@@ -0,0 +1,387 @@
+#include "trajectory.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = { 'C', 'G', 'T', 'R', 'A', 'J', 0, 0 };
+
+size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+inline bool isLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+inline bool parseNumber(const char*& p, const char* end, double& value)
+{
+	while (p < end && isBlank(*p))
+		++p;
+	// from_chars não aceita o sinal '+'
+	if (p < end && *p == '+')
+		++p;
+#if defined(__cpp_lib_to_chars)
+	std::from_chars_result r = std::from_chars(p, end, value);
+	if (r.ec != std::errc())
+		return false;
+	p = r.ptr;
+	return true;
+#else
+	// Biblioteca sem from_chars para ponto flutuante: copia o token para um buffer na pilha
+	char buf[64];
+	size_t n = 0;
+	while (p + n < end && n < sizeof(buf) - 1 && !isBlank(p[n]) && !isLineEnd(p[n]))
+	{
+		buf[n] = p[n];
+		++n;
+	}
+	buf[n] = '\0';
+	char* stop = nullptr;
+	value = strtod(buf, &stop);
+	if (stop == buf)
+		return false;
+	p += stop - buf;
+	return true;
+#endif
+}
+
+// Números no início da linha [p, end), até 'max'
+int parseLine(const char* p, const char* end, double* values, int max)
+{
+	int count = 0;
+	while (count < max && parseNumber(p, end, values[count]))
+		count++;
+	return count;
+}
+
+// Grava as amostras bloco a bloco, com o índice e os hashes dos blocos guardados à parte
+// (um double e um hash a cada kTrajectoryBlockSamples amostras)
+class TrajectoryWriter
+{
+public:
+	explicit TrajectoryWriter(std::ofstream& out) : mOut(out)
+	{
+		mBlock.reserve(kTrajectoryBlockSamples);
+	}
+
+	void add(double time, const glm::vec3& position)
+	{
+		if (mBlock.empty())
+			mIndex.push_back(time);
+		TrajectorySample sample = { position.x, position.y, position.z, static_cast<float>(time - mIndex.back()) };
+		mBlock.push_back(sample);
+		if (mCount == 0)
+		{
+			mMin = position;
+			mMax = position;
+		}
+		mMin = glm::min(mMin, position);
+		mMax = glm::max(mMax, position);
+		mLastTime = time;
+		mCount++;
+		if (mBlock.size() == kTrajectoryBlockSamples)
+			flush();
+	}
+
+	void flush()
+	{
+		if (mBlock.empty())
+			return;
+		const char* bytes = reinterpret_cast<const char*>(mBlock.data());
+		const size_t size = mBlock.size() * sizeof(TrajectorySample);
+		mBlockHashes.push_back(hashBytes(bytes, size));
+		mOut.write(bytes, static_cast<std::streamsize>(size));
+		mBlock.clear();
+	}
+
+	// Depois do último flush(): grava o índice e preenche o cabeçalho
+	void finish(TrajectoryHeader& header)
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, kMagic, sizeof(kMagic));
+		header.version = kTrajectoryVersion;
+		header.blockSamples = kTrajectoryBlockSamples;
+		header.sampleCount = mCount;
+		header.blockCount = mIndex.size();
+		header.startTime = mIndex.empty() ? 0.0 : mIndex.front();
+		header.endTime = mLastTime;
+		for (int k = 0; k < 3; k++)
+		{
+			header.boundsMin[k] = mMin[k];
+			header.boundsMax[k] = mMax[k];
+		}
+		header.sampleOffset = alignUp(sizeof(TrajectoryHeader), 16);
+		header.indexOffset = header.sampleOffset + mCount * sizeof(TrajectorySample);
+		header.fileSize = header.indexOffset + mIndex.size() * sizeof(double);
+
+		const char* index = reinterpret_cast<const char*>(mIndex.data());
+		mOut.write(index, static_cast<std::streamsize>(mIndex.size() * sizeof(double)));
+		mBlockHashes.push_back(hashBytes(index, mIndex.size() * sizeof(double)));
+		header.contentHash = hashBytes(reinterpret_cast<const char*>(mBlockHashes.data()), mBlockHashes.size() * sizeof(uint64_t));
+	}
+
+	size_t count() const { return mCount; }
+	double lastTime() const { return mLastTime; }
+
+private:
+	std::ofstream& mOut;
+	std::vector<TrajectorySample> mBlock;
+	std::vector<double> mIndex;
+	std::vector<uint64_t> mBlockHashes;
+	size_t mCount = 0;
+	double mLastTime = 0.0;
+	glm::vec3 mMin = glm::vec3(0.0f), mMax = glm::vec3(0.0f);
+};
+
+const TrajectoryHeader* validHeader(const char* data, size_t size)
+{
+	if (!data || size < sizeof(TrajectoryHeader))
+		return nullptr;
+	const TrajectoryHeader* h = reinterpret_cast<const TrajectoryHeader*>(data);
+	if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kTrajectoryVersion || h->fileSize != size)
+		return nullptr;
+	if (h->sampleCount == 0 || h->blockSamples == 0
+		|| h->blockCount != (h->sampleCount + h->blockSamples - 1) / h->blockSamples
+		|| h->sampleOffset % 16 != 0 || h->indexOffset % sizeof(double) != 0
+		|| h->sampleOffset + h->sampleCount * sizeof(TrajectorySample) > size
+		|| h->indexOffset + h->blockCount * sizeof(double) > size)
+		return nullptr;
+	return h;
+}
+
+} // namespace
+
+bool Trajectory::open(const std::string& path)
+{
+	close();
+	if (!mFile.open(path))
+		return false;
+	const TrajectoryHeader* header = validHeader(mFile.data(), mFile.size());
+	if (!header)
+	{
+		std::cout << "Trajetoria invalida ou de outra versao: " << path << std::endl;
+		mFile.close();
+		return false;
+	}
+	// As buscas saltam pelo arquivo: sem read-ahead, só as páginas tocadas são lidas
+	mFile.adviseRandomAccess();
+	mHeader = header;
+	mSamples = reinterpret_cast<const TrajectorySample*>(mFile.data() + header->sampleOffset);
+	mIndex = reinterpret_cast<const double*>(mFile.data() + header->indexOffset);
+	return true;
+}
+
+void Trajectory::close()
+{
+	mFile.close();
+	mHeader = nullptr;
+	mSamples = nullptr;
+	mIndex = nullptr;
+}
+
+glm::vec3 Trajectory::boundsMin() const
+{
+	return mHeader ? glm::vec3(mHeader->boundsMin[0], mHeader->boundsMin[1], mHeader->boundsMin[2]) : glm::vec3(0.0f);
+}
+
+glm::vec3 Trajectory::boundsMax() const
+{
+	return mHeader ? glm::vec3(mHeader->boundsMax[0], mHeader->boundsMax[1], mHeader->boundsMax[2]) : glm::vec3(0.0f);
+}
+
+double Trajectory::sampleTime(size_t sample) const
+{
+	return mIndex[sample / mHeader->blockSamples] + mSamples[sample].time;
+}
+
+glm::vec3 Trajectory::samplePosition(size_t sample) const
+{
+	const TrajectorySample& s = mSamples[sample];
+	return glm::vec3(s.x, s.y, s.z);
+}
+
+size_t Trajectory::seek(double time) const
+{
+	const size_t count = sampleCount();
+	if (count < 2 || time <= mHeader->startTime)
+		return 0;
+	if (time >= mHeader->endTime)
+		return count - 2;
+
+	// Último bloco que começa em 'time' ou antes; o primeiro começa em startTime < time
+	const double* blockEnd = mIndex + mHeader->blockCount;
+	const size_t block = static_cast<size_t>(std::upper_bound(mIndex, blockEnd, time) - mIndex) - 1;
+
+	// Dentro do bloco os tempos são relativos ao início dele. A comparação é em double, como em
+	// sampleTime(), para o segmento achado conter 'time' também pelos tempos de sampleTime()
+	const double relative = time - mIndex[block];
+	const TrajectorySample* first = mSamples + block * mHeader->blockSamples;
+	const TrajectorySample* last = mSamples + std::min<size_t>((block + 1) * mHeader->blockSamples, count);
+	const TrajectorySample* after = std::upper_bound(first, last, relative,
+		[](double t, const TrajectorySample& sample) { return t < sample.time; });
+	// after > first: a primeira amostra do bloco tem tempo relativo 0 <= relative. Se todas
+	// ficaram para trás, o segmento é o que liga o bloco ao seguinte
+	return std::min(static_cast<size_t>(after - mSamples) - 1, count - 2);
+}
+
+size_t Trajectory::locate(double time, size_t hint) const
+{
+	const size_t count = sampleCount();
+	if (count < 2)
+		return 0;
+	// No último segmento, os tempos depois do fim ficam nele (como em seek)
+	if (hint + 1 < count && time >= sampleTime(hint))
+	{
+		if (hint + 2 == count || time < sampleTime(hint + 1))
+			return hint;
+		if (hint + 3 == count || time < sampleTime(hint + 2))
+			return hint + 1;
+	}
+	return seek(time);
+}
+
+glm::vec3 Trajectory::position(double time, size_t& segment) const
+{
+	const size_t count = sampleCount();
+	if (count == 0)
+		return glm::vec3(0.0f);
+	if (count == 1)
+		return samplePosition(0);
+
+	segment = locate(time, segment);
+	const double t0 = sampleTime(segment), t1 = sampleTime(segment + 1);
+	const float f = t1 > t0 ? static_cast<float>(std::min(std::max((time - t0) / (t1 - t0), 0.0), 1.0)) : 1.0f;
+	const glm::vec3 a = samplePosition(segment);
+	return a + f * (samplePosition(segment + 1) - a);
+}
+
+bool isTrajectoryFile(const std::string& path)
+{
+	const std::string extension = ".traj";
+	return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+uint64_t trajectoryContentHash(const char* data, size_t size)
+{
+	const TrajectoryHeader* header = validHeader(data, size);
+	return header ? header->contentHash : 0;
+}
+
+bool convertTrajectory(const std::string& textPath, const std::string& trajectoryPath, float segmentDuration)
+{
+	PROFILE_SCOPE("convertTrajectory");
+	MappedFile text;
+	if (!text.open(textPath))
+	{
+		std::cerr << "Erro ao abrir o arquivo de pontos: " << textPath << std::endl;
+		return false;
+	}
+
+	// Grava em um arquivo temporário e renomeia, para nunca deixar uma trajetória pela metade
+	const std::string tempPath = trajectoryPath + ".tmp";
+	std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::cerr << "Erro ao criar o arquivo de trajetoria: " << trajectoryPath << std::endl;
+		return false;
+	}
+	auto discard = [&out, &tempPath]() {
+		out.close();
+		std::error_code ec;
+		fs::remove(tempPath, ec);
+		return false;
+	};
+
+	TrajectoryHeader header;
+	memset(&header, 0, sizeof(header));
+	std::vector<char> padding(alignUp(sizeof(TrajectoryHeader), 16), 0);
+	out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+	TrajectoryWriter writer(out);
+	int columns = 0; // 3 ou 4, pela primeira linha com números
+	size_t ignored = 0, lineNumber = 0;
+	glm::vec3 firstPoint(0.0f);
+	const char* p = text.begin();
+	const char* end = text.end();
+	while (p < end)
+	{
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = nl ? nl : end;
+		lineNumber++;
+
+		double values[4];
+		const int found = parseLine(p, lineEnd, values, 4);
+		p = nl ? nl + 1 : end;
+		if (columns == 0 && found >= 3)
+			columns = found == 4 ? 4 : 3;
+		if (columns == 0 || found < columns)
+		{
+			ignored += found > 0 ? 1 : 0;
+			continue;
+		}
+
+		if (columns == 3)
+		{
+			const glm::vec3 point((float)values[0], (float)values[1], (float)values[2]);
+			if (writer.count() == 0)
+				firstPoint = point;
+			writer.add(writer.count() * (double)segmentDuration, point);
+			continue;
+		}
+		if (writer.count() > 0 && values[0] < writer.lastTime())
+		{
+			std::cerr << "Tempo fora de ordem na linha " << lineNumber << " de " << textPath << ": " << values[0]
+				<< " depois de " << writer.lastTime() << std::endl;
+			return discard();
+		}
+		writer.add(values[0], glm::vec3((float)values[1], (float)values[2], (float)values[3]));
+	}
+	if (writer.count() == 0)
+	{
+		std::cerr << "Nenhum ponto foi carregado de " << textPath << std::endl;
+		return discard();
+	}
+	// Sem tempos, o caminho é fechado: o último trecho volta ao primeiro ponto
+	if (columns == 3)
+		writer.add(writer.count() * (double)segmentDuration, firstPoint);
+
+	writer.flush();
+	writer.finish(header);
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.close();
+	if (!out)
+	{
+		std::cerr << "Erro ao gravar o arquivo de trajetoria: " << trajectoryPath << std::endl;
+		return discard();
+	}
+	std::error_code ec;
+	fs::rename(tempPath, trajectoryPath, ec);
+	if (ec)
+	{
+		std::cerr << "Erro ao gravar o arquivo de trajetoria: " << trajectoryPath << std::endl;
+		return discard();
+	}
+
+	std::cout << "Trajetoria " << trajectoryPath << ": " << header.sampleCount << " amostras";
+	if (columns == 3)
+		std::cout << " (uma a cada " << segmentDuration << " s)";
+	std::cout << ", " << header.startTime << " a " << header.endTime << " s, " << header.blockCount << " blocos no indice, "
+		<< header.fileSize / 1024 << " KB";
+	if (ignored)
+		std::cout << ", " << ignored << " linhas ignoradas";
+	std::cout << std::endl;
+	return true;
+}
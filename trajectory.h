@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+
+// Formato binário de trajetórias gravadas (arquivo ".traj", gerado por convertTrajectory).
+// Aumente a versão sempre que o layout mudar.
+const uint32_t kTrajectoryVersion = 1;
+
+// Amostras por bloco: cada bloco tem uma entrada no índice de tempos
+const uint32_t kTrajectoryBlockSamples = 4096;
+
+struct TrajectoryHeader {
+	char magic[8];          // "CGTRAJ\0\0"
+	uint32_t version;
+	uint32_t blockSamples;  // amostras por bloco (a última pode ter menos)
+	uint64_t sampleCount;
+	uint64_t blockCount;
+	double startTime;       // tempo da primeira amostra (s)
+	double endTime;         // tempo da última
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t contentHash;   // das amostras e do índice, para o cache de assets não ler o arquivo todo
+	uint64_t sampleOffset;  // sampleCount TrajectorySample
+	uint64_t indexOffset;   // blockCount doubles: o tempo da primeira amostra de cada bloco
+	uint64_t fileSize;
+};
+
+// Uma amostra ocupa 16 bytes, como as entradas de AnimationPath::table. O tempo é relativo ao
+// início do bloco (no índice, em double): o arredondamento depende da duração de um bloco, não
+// de quanto tempo já passou desde o início da gravação
+struct TrajectorySample {
+	float x, y, z;
+	float time;
+};
+
+// Trajetória mapeada em memória, sem cópia: o que fica residente são só as páginas tocadas
+// pelas buscas (o índice e os blocos em volta dos tempos pedidos), não o arquivo inteiro.
+//
+// A posição entre duas amostras é interpolada linearmente; fora do intervalo gravado vale a
+// primeira ou a última. Tempos iguais em amostras vizinhas são um salto (a segunda vale).
+//
+// Só leitura depois de open(): pode ser consultada de várias threads, cada uma com o seu
+// segmento de partida (ver locate()).
+class Trajectory
+{
+public:
+	// Mapeia e valida o arquivo; false se não abre, não é uma trajetória ou é de outra versão
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return mHeader != nullptr; }
+
+	size_t sampleCount() const { return mHeader ? static_cast<size_t>(mHeader->sampleCount) : 0; }
+	double startTime() const { return mHeader ? mHeader->startTime : 0.0; }
+	double endTime() const { return mHeader ? mHeader->endTime : 0.0; }
+	double duration() const { return endTime() - startTime(); }
+	size_t fileBytes() const { return mFile.size(); }
+	glm::vec3 boundsMin() const;
+	glm::vec3 boundsMax() const;
+
+	double sampleTime(size_t sample) const;
+	glm::vec3 samplePosition(size_t sample) const;
+
+	// Segmento (amostras i e i + 1) que contém 'time', limitado ao intervalo gravado. Busca
+	// binária no índice de blocos e depois dentro do bloco: O(log n), tocando poucas páginas
+	size_t seek(double time) const;
+
+	// Como seek(), partindo do segmento da consulta anterior: a reprodução normal fica no mesmo
+	// segmento ou passa ao seguinte sem busca; saltos (em qualquer velocidade ou sentido) caem
+	// na busca binária
+	size_t locate(double time, size_t hint) const;
+
+	// Posição em 'time'; 'segment' é o ponto de partida de locate() e recebe o segmento achado
+	glm::vec3 position(double time, size_t& segment) const;
+
+private:
+	MappedFile mFile;
+	const TrajectoryHeader* mHeader = nullptr;
+	const TrajectorySample* mSamples = nullptr;
+	const double* mIndex = nullptr;
+};
+
+// Converte pontos em texto para uma trajetória. Cada linha é "x y z" ou "t x y z", conforme a
+// primeira linha com números; as outras linhas são ignoradas, como em carregarPontos.
+// - Com tempos: precisam ser crescentes (iguais são aceitos); o arquivo é rejeitado se não forem.
+// - Sem tempos: um ponto a cada 'segmentDuration' segundos e o primeiro repetido no fim, para a
+//   volta fechada do caminho linear (INTERP_LINEAR).
+// O texto é lido do arquivo mapeado e as amostras são gravadas à medida que são lidas: na memória
+// ficam só o bloco corrente e o índice.
+bool convertTrajectory(const std::string& textPath, const std::string& trajectoryPath, float segmentDuration);
+
+// Arquivos com a extensão ".traj" são trajetórias; os outros, pontos em texto
+bool isTrajectoryFile(const std::string& path);
+
+// Hash do conteúdo gravado no cabeçalho (0 se 'data' não é uma trajetória válida)
+uint64_t trajectoryContentHash(const char* data, size_t size);
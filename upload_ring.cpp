@@ -0,0 +1,127 @@
+#include "upload_ring.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+const GLbitfield kMapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+inline size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+void UploadRing::create(size_t frameBytes)
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mUniformAlignment = alignment > 0 ? static_cast<size_t>(alignment) : 256;
+	alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mStorageAlignment = alignment > 0 ? static_cast<size_t>(alignment) : 256;
+
+	mStats = UploadRingStats();
+	mFrame = 0;
+	mSegment = 0;
+	mOffset = 0;
+	createBuffer(frameBytes);
+}
+
+void UploadRing::destroy()
+{
+	for (GLsync& fence : mFences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	// Apagar o buffer também desfaz o mapeamento persistente
+	for (const auto& retired : mRetired)
+		glDeleteBuffers(1, &retired.first);
+	mRetired.clear();
+	if (mBuffer)
+		glDeleteBuffers(1, &mBuffer);
+	mBuffer = 0;
+	mMapped = nullptr;
+	mFrameBytes = 0;
+}
+
+void UploadRing::createBuffer(size_t frameBytes)
+{
+	// Todos os trechos começam alinhados para qualquer tipo de ligação
+	const size_t granularity = std::max<size_t>(256, std::max(mUniformAlignment, mStorageAlignment));
+	mFrameBytes = alignUp(std::max<size_t>(frameBytes, granularity), granularity);
+
+	glCreateBuffers(1, &mBuffer);
+	glNamedBufferStorage(mBuffer, mFrameBytes * kFrames, nullptr, kMapFlags);
+	mMapped = static_cast<char*>(glMapNamedBufferRange(mBuffer, 0, mFrameBytes * kFrames, kMapFlags));
+	mStats.capacity = mFrameBytes;
+}
+
+void UploadRing::beginFrame()
+{
+	PROFILE_SCOPE("uploadRingWait");
+	mSegment = static_cast<int>(mFrame % kFrames);
+	mOffset = 0;
+	mWritten = 0;
+
+	GLsync& fence = mFences[mSegment];
+	if (fence)
+	{
+		// Sem espera no caso comum: a GPU já terminou o quadro de kFrames atrás
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			do
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			while (status == GL_TIMEOUT_EXPIRED);
+			mStats.fenceWaits++;
+			mStats.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// Buffers substituídos cujo último quadro a GPU já terminou (a fence acima é a dele ou posterior)
+	mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(), [&](const std::pair<GLuint, uint64_t>& retired) {
+		if (retired.second + kFrames > mFrame)
+			return false;
+		glDeleteBuffers(1, &retired.first);
+		return true;
+	}), mRetired.end());
+}
+
+void UploadRing::endFrame()
+{
+	mFences[mSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mStats.frameBytes = mWritten;
+	mFrame++;
+}
+
+UploadAllocation UploadRing::allocate(size_t bytes, size_t alignment)
+{
+	UploadAllocation allocation;
+	size_t offset = alignUp(mOffset, alignment);
+	if (offset + bytes > mFrameBytes)
+	{
+		// O quadro não cabe: troca por um buffer maior; o antigo fica vivo até a GPU terminar
+		mRetired.push_back(std::make_pair(mBuffer, mFrame));
+		createBuffer(std::max(mFrameBytes * 2, offset + bytes));
+		mStats.grows++;
+		offset = 0;
+	}
+
+	const size_t base = static_cast<size_t>(mSegment) * mFrameBytes;
+	allocation.data = mMapped ? mMapped + base + offset : nullptr;
+	allocation.buffer = mBuffer;
+	allocation.offset = base + offset;
+	allocation.size = bytes;
+	mOffset = offset + bytes;
+	mWritten += bytes;
+	return allocation;
+}
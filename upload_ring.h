@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// Trecho do anel reservado para um quadro: escreva em 'data' e ligue 'buffer' a partir de
+// 'offset' (glBindBufferRange, ou o deslocamento de um desenho indireto)
+struct UploadAllocation {
+	void* data = nullptr;
+	GLuint buffer = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+struct UploadRingStats {
+	size_t frameBytes = 0;     // bytes reservados no último quadro fechado
+	size_t capacity = 0;       // bytes disponíveis por quadro
+	size_t fenceWaits = 0;     // vezes em que a CPU esperou a GPU liberar um trecho (total)
+	double fenceWaitMs = 0.0;  // tempo total dessas esperas
+	size_t grows = 0;          // buffers substituídos por um maior
+};
+
+// Anel de envio dos dados que mudam a cada quadro (matrizes de instância, comandos
+// indiretos, uniforms do quadro).
+//
+// Um só buffer com glNamedBufferStorage, mapeado uma vez (PERSISTENT | COHERENT) e dividido
+// em kFrames trechos, um por quadro em voo. Cada quadro escreve no seu trecho e fecha com
+// uma fence; antes de reutilizar o trecho, beginFrame() espera a fence de kFrames quadros
+// atrás, que normalmente já passou. Assim não há mapeamento, orphaning nem cópia do driver
+// por quadro, e a espera, quando existe, é explícita e contada.
+//
+// Se um quadro não cabe no trecho, o buffer é trocado por um maior na hora: o antigo
+// continua mapeado (o que já foi reservado no quadro segue válido) e só é apagado depois
+// que a GPU termina os quadros que o usaram.
+class UploadRing
+{
+public:
+	static const int kFrames = 3;
+
+	void create(size_t frameBytes);
+	void destroy();
+
+	// Espera a GPU liberar o trecho do quadro e começa a reservar do início dele
+	void beginFrame();
+	// Fecha o quadro com uma fence; chame depois do último comando que lê o anel
+	void endFrame();
+
+	// 'alignment' deve ser potência de 2 (ex: uniformAlignment())
+	UploadAllocation allocate(size_t bytes, size_t alignment);
+
+	size_t uniformAlignment() const { return mUniformAlignment; }
+	size_t storageAlignment() const { return mStorageAlignment; }
+	const UploadRingStats& stats() const { return mStats; }
+
+private:
+	void createBuffer(size_t frameBytes);
+
+	GLuint mBuffer = 0;
+	char* mMapped = nullptr;
+	size_t mFrameBytes = 0;
+	size_t mOffset = 0;     // no trecho do quadro atual
+	size_t mWritten = 0;    // reservado no quadro, somando os buffers substituídos nele
+	int mSegment = 0;
+	uint64_t mFrame = 0;
+	GLsync mFences[kFrames] = {};
+	std::vector<std::pair<GLuint, uint64_t>> mRetired; // buffer substituído e o último quadro que o usou
+	size_t mUniformAlignment = 256;
+	size_t mStorageAlignment = 256;
+	UploadRingStats mStats;
+};
@@ -0,0 +1,242 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFFu;
+
+	if (((bits >> 23) & 0xFFu) == 0xFFu)
+	{
+		// Infinito ou NaN
+		return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+	}
+	if (exponent >= 31)
+	{
+		// Grande demais: satura em infinito
+		return static_cast<uint16_t>(sign | 0x7C00u);
+	}
+	if (exponent <= 0)
+	{
+		// Subnormal (ou zero) em half
+		if (exponent < -10)
+			return static_cast<uint16_t>(sign);
+		mantissa |= 0x800000u;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		// Arredonda para o mais próximo (empate para par)
+		uint32_t remainder = mantissa & ((1u << shift) - 1u);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1u)))
+			half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFFu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+		half++; // pode propagar para o expoente, o que continua correto
+	return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+	uint32_t exponent = (value >> 10) & 0x1Fu;
+	uint32_t mantissa = value & 0x3FFu;
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// Subnormal: normaliza
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400u) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			mantissa &= 0x3FFu;
+			bits = sign | (exponent << 23) | (mantissa << 13);
+		}
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+namespace {
+
+inline int16_t toSnorm16(float v)
+{
+	v = std::max(-1.0f, std::min(1.0f, v));
+	return static_cast<int16_t>(std::lround(v * 32767.0f));
+}
+
+inline float fromSnorm16(int16_t v)
+{
+	// Mesma regra do OpenGL para snorm normalizado
+	return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+}
+
+inline float signNotZero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+inline float angleDegrees(glm::vec3 a, glm::vec3 b)
+{
+	float la = glm::length(a), lb = glm::length(b);
+	if (la == 0.0f || lb == 0.0f)
+		return 0.0f;
+	float c = std::max(-1.0f, std::min(1.0f, glm::dot(a, b) / (la * lb)));
+	return glm::degrees(std::acos(c));
+}
+
+} // namespace
+
+void octEncode(glm::vec3 n, int16_t out[2])
+{
+	float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (sum == 0.0f)
+	{
+		// Vértice sem normal: fica com (0, 0), que decodifica para +Z
+		out[0] = out[1] = 0;
+		return;
+	}
+	float x = n.x / sum, y = n.y / sum;
+	if (n.z < 0.0f)
+	{
+		// Hemisfério inferior é "dobrado" sobre os cantos do losango
+		float ox = (1.0f - std::fabs(y)) * signNotZero(x);
+		float oy = (1.0f - std::fabs(x)) * signNotZero(y);
+		x = ox;
+		y = oy;
+	}
+
+	// Testa os vizinhos do arredondamento e fica com o de menor erro angular (maior cosseno)
+	glm::vec3 unit = n / glm::length(n);
+	int16_t best[2] = { toSnorm16(x), toSnorm16(y) };
+	float bestCos = -2.0f;
+	int16_t base[2] = { best[0], best[1] };
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			int cx = base[0] + dx, cy = base[1] + dy;
+			if (cx < -32767 || cx > 32767 || cy < -32767 || cy > 32767)
+				continue;
+			int16_t candidate[2] = { static_cast<int16_t>(cx), static_cast<int16_t>(cy) };
+			float c = glm::dot(unit, octDecode(candidate));
+			if (c > bestCos)
+			{
+				bestCos = c;
+				best[0] = candidate[0];
+				best[1] = candidate[1];
+			}
+		}
+	}
+	out[0] = best[0];
+	out[1] = best[1];
+}
+
+glm::vec3 octDecode(const int16_t in[2])
+{
+	glm::vec3 n(fromSnorm16(in[0]), fromSnorm16(in[1]), 0.0f);
+	n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+void packVertices(const MeshData& mesh, std::vector<PackedVertex>& out)
+{
+	const size_t count = mesh.vertexCount();
+	out.resize(count);
+
+	glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+	glm::vec3 scale(extent.x > 0.0f ? 65535.0f / extent.x : 0.0f,
+		extent.y > 0.0f ? 65535.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 65535.0f / extent.z : 0.0f);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* v = &mesh.vertices[i * kVertexFloats];
+		PackedVertex& p = out[i];
+		for (int k = 0; k < 3; k++)
+		{
+			float q = (v[k] - mesh.boundsMin[k]) * scale[k];
+			p.position[k] = static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(65535.0f, q))));
+		}
+		p.position[3] = 0;
+		octEncode(glm::vec3(v[8], v[9], v[10]), p.normal);
+		p.texCoord[0] = floatToHalf(v[6]);
+		p.texCoord[1] = floatToHalf(v[7]);
+	}
+}
+
+glm::vec3 unpackPosition(const PackedVertex& v, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	glm::vec3 unorm(v.position[0] / 65535.0f, v.position[1] / 65535.0f, v.position[2] / 65535.0f);
+	return boundsMin + unorm * (boundsMax - boundsMin);
+}
+
+QuantizationError measureQuantizationError(const MeshData& mesh, const std::vector<PackedVertex>& packed)
+{
+	QuantizationError error;
+	error.diagonal = glm::length(mesh.boundsMax - mesh.boundsMin);
+
+	double sumPosition = 0.0, sumNormal = 0.0;
+	size_t normalCount = 0;
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		const float* v = &mesh.vertices[i * kVertexFloats];
+
+		glm::vec3 position(v[0], v[1], v[2]);
+		float dp = glm::length(unpackPosition(packed[i], mesh.boundsMin, mesh.boundsMax) - position);
+		error.maxPosition = std::max(error.maxPosition, dp);
+		sumPosition += dp;
+
+		glm::vec3 normal(v[8], v[9], v[10]);
+		if (glm::length(normal) > 0.0f)
+		{
+			float dn = angleDegrees(normal, octDecode(packed[i].normal));
+			error.maxNormalDegrees = std::max(error.maxNormalDegrees, dn);
+			sumNormal += dn;
+			normalCount++;
+		}
+
+		for (int k = 0; k < 2; k++)
+		{
+			float dt = std::fabs(halfToFloat(packed[i].texCoord[k]) - v[6 + k]);
+			error.maxTexCoord = std::max(error.maxTexCoord, dt);
+		}
+	}
+	if (!packed.empty())
+		error.avgPosition = static_cast<float>(sumPosition / packed.size());
+	if (normalCount)
+		error.avgNormalDegrees = static_cast<float>(sumNormal / normalCount);
+	return error;
+}
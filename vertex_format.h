@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "mesh_builder.h"
+
+// Layouts de vértice suportados no VBO
+enum VertexFormat : uint32_t {
+	VERTEX_FORMAT_FLOAT = 0,  // 11 floats (44 bytes): posição, cor, coordenada de textura, normal
+	VERTEX_FORMAT_PACKED = 1, // PackedVertex (16 bytes)
+};
+
+// Vértice compacto de 16 bytes:
+// - posição em unorm16, relativa à caixa envolvente da malha (o 4º valor é só alinhamento)
+// - normal codificada em octaedro, 2 x snorm16
+// - coordenada de textura em half float
+struct PackedVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texCoord[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex deve ter 16 bytes");
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// Codificação octaédrica de uma normal em dois snorm16 (e a decodificação equivalente à do shader)
+void octEncode(glm::vec3 n, int16_t out[2]);
+glm::vec3 octDecode(const int16_t in[2]);
+
+// Converte os vértices float de 'mesh' (kVertexFloats) para o layout compacto
+void packVertices(const MeshData& mesh, std::vector<PackedVertex>& out);
+
+// Reconstrói a posição a partir do unorm16, como o vertex shader faz
+glm::vec3 unpackPosition(const PackedVertex& v, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+struct QuantizationError {
+	float maxPosition = 0.0f;      // na unidade do modelo
+	float avgPosition = 0.0f;
+	float diagonal = 0.0f;         // diagonal da caixa envolvente, como referência
+	float maxNormalDegrees = 0.0f;
+	float avgNormalDegrees = 0.0f;
+	float maxTexCoord = 0.0f;
+};
+
+QuantizationError measureQuantizationError(const MeshData& mesh, const std::vector<PackedVertex>& packed);